@@ -37,11 +37,143 @@
     ((TSS2_RC)(TSS2_TYPES_RC_LAYER | TSS2_BASE_RC_BAD_REFERENCE))
 #define TSS2_TYPES_RC_INSUFFICIENT_BUFFER \
     ((TSS2_RC)(TSS2_TYPES_RC_LAYER | TSS2_BASE_RC_INSUFFICIENT_BUFFER))
+#define TSS2_TYPES_RC_TRY_AGAIN \
+    ((TSS2_RC)(TSS2_TYPES_RC_LAYER | TSS2_BASE_RC_TRY_AGAIN))
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/*
+ * libmarshal doesn't write to stderr. Log messages that are compiled in
+ * (see ./configure --with-marshal-log-level) and pass the runtime level set
+ * with Tss2_MU_SetLogLevel are kept in a fixed size in-memory ring that
+ * applications drain with Tss2_MU_ReadLog. When the ring is full new
+ * messages are dropped.
+ */
+#define TSS2_MU_LOG_DEBUG   0
+#define TSS2_MU_LOG_INFO    1
+#define TSS2_MU_LOG_WARNING 2
+#define TSS2_MU_LOG_ERROR   3
+#define TSS2_MU_LOG_OFF     4
+
+#define TSS2_MU_LOG_MESSAGE_SIZE 160
+
+typedef struct {
+    int level;
+    char message[TSS2_MU_LOG_MESSAGE_SIZE];
+} TSS2_MU_LOG_RECORD;
+
+void
+Tss2_MU_SetLogLevel(
+    int             level);
+
+size_t
+Tss2_MU_ReadLog(
+    TSS2_MU_LOG_RECORD *records,
+    size_t          count);
+
+/*
+ * Output sinks. Tss2_MU_MarshalSink serializes src with the given marshal
+ * function and passes the bytes to sink->write in order, in chunks, instead
+ * of into a buffer. This lets a structure be hashed (or written out) without
+ * a temporary buffer sized for it. *size (if non-NULL) receives the number of
+ * bytes written. An error returned by sink->write stops marshalling and is
+ * returned. marshal must be the Marshal function of a structure type, e.g.
+ * through TSS2_MU_MARSHAL_SINK(TPMT_PUBLIC, &pub, &sink, &size).
+ * Writes shorter than 256 bytes, including small TPM2B payloads, are copied
+ * into a staging buffer on the stack first; it is zeroed before returning.
+ */
+typedef TSS2_RC (*TSS2_MU_SINK_WRITE_FCN)(
+    void           *data,
+    uint8_t const  *bytes,
+    size_t          size);
+
+typedef struct {
+    TSS2_MU_SINK_WRITE_FCN write;
+    void           *data;
+} TSS2_MU_SINK;
+
+typedef TSS2_RC (*TSS2_MU_MARSHAL_FCN)(
+    void const     *src,
+    uint8_t         buffer[],
+    size_t          buffer_size,
+    size_t         *offset);
+
+TSS2_RC
+Tss2_MU_MarshalSink(
+    TSS2_MU_MARSHAL_FCN marshal,
+    void const     *src,
+    TSS2_MU_SINK const *sink,
+    size_t         *size);
+
+#define TSS2_MU_MARSHAL_SINK(type, src, sink, size) \
+    Tss2_MU_MarshalSink((TSS2_MU_MARSHAL_FCN)Tss2_MU_##type##_Marshal, \
+                        (src), (sink), (size))
+
+/*
+ * Resumable unmarshalling. A stream decodes a fixed sequence of fields
+ * (steps) from data that arrives in chunks, e.g. a response read from a
+ * socket. Each call to Tss2_MU_StreamFeed decodes every step that is
+ * complete with the bytes given so far; stream->step is the number of steps
+ * decoded. Fields are decoded in place from the chunk when they are
+ * entirely inside it. Only a field that straddles two chunks is collected
+ * in the caller provided staging buffer, which must be able to hold the
+ * largest single field.
+ *
+ * Tss2_MU_StreamFeed returns TSS2_RC_SUCCESS once all steps are decoded and
+ * TSS2_TYPES_RC_TRY_AGAIN while more data is needed. *used (if non-NULL)
+ * receives the number of bytes of data consumed, which is less than size
+ * only when the last step completed before the end of data. A field larger
+ * than the staging buffer yields TSS2_TYPES_RC_INSUFFICIENT_BUFFER; errors
+ * from the unmarshal functions are returned as is.
+ */
+typedef TSS2_RC (*TSS2_MU_UNMARSHAL_FCN)(
+    uint8_t const   buffer[],
+    size_t          buffer_size,
+    size_t         *offset,
+    void           *dest);
+
+typedef struct {
+    TSS2_MU_UNMARSHAL_FCN unmarshal;
+    void           *dest;
+} TSS2_MU_STREAM_STEP;
+
+#define TSS2_MU_STREAM_STEP_INIT(type, dest) \
+    { (TSS2_MU_UNMARSHAL_FCN)Tss2_MU_##type##_Unmarshal, (dest) }
+
+typedef struct {
+    TSS2_MU_STREAM_STEP const *steps;
+    size_t          step_count;
+    size_t          step;
+    size_t          consumed;
+    uint8_t        *staging;
+    size_t          staging_size;
+    size_t          staged;
+} TSS2_MU_STREAM;
+
+TSS2_RC
+Tss2_MU_StreamInit(
+    TSS2_MU_STREAM *stream,
+    TSS2_MU_STREAM_STEP const *steps,
+    size_t          step_count,
+    uint8_t        *staging,
+    size_t          staging_size);
+
+TSS2_RC
+Tss2_MU_StreamFeed(
+    TSS2_MU_STREAM *stream,
+    uint8_t const   data[],
+    size_t          size,
+    size_t         *used);
+
+/*
+ * Each Tss2_MU_<TYPE>_Size function stores in *size the number of bytes the
+ * matching Tss2_MU_<TYPE>_Marshal function would write for src. No buffer is
+ * written or allocated. The size field of a TPM2B that wraps a structure
+ * (e.g. TPM2B_PUBLIC) is ignored: the size is computed from the structure.
+ */
+
 TSS2_RC
 Tss2_MU_BYTE_Marshal(
     BYTE           src,
@@ -70,6 +202,11 @@ Tss2_MU_INT8_Unmarshal(
     size_t         *offset,
     INT8           *dest);
 
+TSS2_RC
+Tss2_MU_INT8_Size(
+    INT8            src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_INT16_Marshal(
     INT16           src,
@@ -84,6 +221,11 @@ Tss2_MU_INT16_Unmarshal(
     size_t         *offset,
     INT16          *dest);
 
+TSS2_RC
+Tss2_MU_INT16_Size(
+    INT16           src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_INT32_Marshal(
     INT32           src,
@@ -98,6 +240,11 @@ Tss2_MU_INT32_Unmarshal(
     size_t         *offset,
     INT32          *dest);
 
+TSS2_RC
+Tss2_MU_INT32_Size(
+    INT32           src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_INT64_Marshal(
     INT64           src,
@@ -112,6 +259,11 @@ Tss2_MU_INT64_Unmarshal(
     size_t         *offset,
     INT64          *dest);
 
+TSS2_RC
+Tss2_MU_INT64_Size(
+    INT64           src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_UINT8_Marshal(
     UINT8           src,
@@ -126,6 +278,11 @@ Tss2_MU_UINT8_Unmarshal(
     size_t         *offset,
     UINT8          *dest);
 
+TSS2_RC
+Tss2_MU_UINT8_Size(
+    UINT8           src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_UINT16_Marshal(
     UINT16          src,
@@ -140,6 +297,11 @@ Tss2_MU_UINT16_Unmarshal(
     size_t         *offset,
     UINT16         *dest);
 
+TSS2_RC
+Tss2_MU_UINT16_Size(
+    UINT16          src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_UINT32_Marshal(
     UINT32          src,
@@ -154,6 +316,11 @@ Tss2_MU_UINT32_Unmarshal(
     size_t         *offset,
     UINT32         *dest);
 
+TSS2_RC
+Tss2_MU_UINT32_Size(
+    UINT32          src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_UINT64_Marshal(
     UINT64          src,
@@ -168,6 +335,11 @@ Tss2_MU_UINT64_Unmarshal(
     size_t         *offset,
     UINT64         *dest);
 
+TSS2_RC
+Tss2_MU_UINT64_Size(
+    UINT64          src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPM_CC_Marshal(
     TPM_CC          src,
@@ -182,6 +354,11 @@ Tss2_MU_TPM_CC_Unmarshal(
     size_t         *offset,
     TPM_CC         *dest);
 
+TSS2_RC
+Tss2_MU_TPM_CC_Size(
+    TPM_CC          src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPM_ST_Marshal(
     TPM_ST          src,
@@ -196,6 +373,11 @@ Tss2_MU_TPM_ST_Unmarshal(
     size_t         *offset,
     TPM_ST         *dest);
 
+TSS2_RC
+Tss2_MU_TPM_ST_Size(
+    TPM_ST          src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMA_ALGORITHM_Marshal(
     TPMA_ALGORITHM  src,
@@ -210,6 +392,11 @@ Tss2_MU_TPMA_ALGORITHM_Unmarshal(
     size_t         *offset,
     TPMA_ALGORITHM *dest);
 
+TSS2_RC
+Tss2_MU_TPMA_ALGORITHM_Size(
+    TPMA_ALGORITHM  src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMA_CC_Marshal(
     TPMA_CC         src,
@@ -224,6 +411,11 @@ Tss2_MU_TPMA_CC_Unmarshal(
     size_t         *offset,
     TPMA_CC        *dest);
 
+TSS2_RC
+Tss2_MU_TPMA_CC_Size(
+    TPMA_CC         src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMA_LOCALITY_Marshal(
     TPMA_LOCALITY   src,
@@ -237,6 +429,11 @@ Tss2_MU_TPMA_LOCALITY_Unmarshal(
     size_t          buffer_size,
     size_t         *offset,
     TPMA_LOCALITY  *dest);
+
+TSS2_RC
+Tss2_MU_TPMA_LOCALITY_Size(
+    TPMA_LOCALITY   src,
+    size_t         *size);
 TSS2_RC
 
 Tss2_MU_TPMA_NV_Marshal(
@@ -252,6 +449,11 @@ Tss2_MU_TPMA_NV_Unmarshal(
     size_t         *offset,
     TPMA_NV        *dest);
 
+TSS2_RC
+Tss2_MU_TPMA_NV_Size(
+    TPMA_NV         src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMA_OBJECT_Marshal(
     TPMA_OBJECT     src,
@@ -266,6 +468,11 @@ Tss2_MU_TPMA_OBJECT_Unmarshal(
     size_t         *offset,
     TPMA_OBJECT    *dest);
 
+TSS2_RC
+Tss2_MU_TPMA_OBJECT_Size(
+    TPMA_OBJECT     src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMA_PERMANENT_Marshal(
     TPMA_PERMANENT  src,
@@ -280,6 +487,11 @@ Tss2_MU_TPMA_PERMANENT_Unmarshal(
     size_t         *offset,
     TPMA_PERMANENT *dest);
 
+TSS2_RC
+Tss2_MU_TPMA_PERMANENT_Size(
+    TPMA_PERMANENT  src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMA_SESSION_Marshal(
     TPMA_SESSION    src,
@@ -294,6 +506,11 @@ Tss2_MU_TPMA_SESSION_Unmarshal(
     size_t         *offset,
     TPMA_SESSION   *dest);
 
+TSS2_RC
+Tss2_MU_TPMA_SESSION_Size(
+    TPMA_SESSION    src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMA_STARTUP_CLEAR_Marshal(
     TPMA_STARTUP_CLEAR src,
@@ -308,6 +525,11 @@ Tss2_MU_TPMA_STARTUP_CLEAR_Unmarshal(
     size_t         *offset,
     TPMA_STARTUP_CLEAR *dest);
 
+TSS2_RC
+Tss2_MU_TPMA_STARTUP_CLEAR_Size(
+    TPMA_STARTUP_CLEAR src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPM2B_DIGEST_Marshal(
     TPM2B_DIGEST const *src,
@@ -322,6 +544,11 @@ Tss2_MU_TPM2B_DIGEST_Unmarshal(
     size_t         *offset,
     TPM2B_DIGEST   *dest);
 
+TSS2_RC
+Tss2_MU_TPM2B_DIGEST_Size(
+    TPM2B_DIGEST const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPM2B_ATTEST_Marshal(
     TPM2B_ATTEST const *src,
@@ -336,6 +563,11 @@ Tss2_MU_TPM2B_ATTEST_Unmarshal(
     size_t         *offset,
     TPM2B_ATTEST   *dest);
 
+TSS2_RC
+Tss2_MU_TPM2B_ATTEST_Size(
+    TPM2B_ATTEST const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPM2B_NAME_Marshal(
     TPM2B_NAME const *src,
@@ -350,6 +582,11 @@ Tss2_MU_TPM2B_NAME_Unmarshal(
     size_t         *offset,
     TPM2B_NAME     *dest);
 
+TSS2_RC
+Tss2_MU_TPM2B_NAME_Size(
+    TPM2B_NAME const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPM2B_MAX_NV_BUFFER_Marshal(
     TPM2B_MAX_NV_BUFFER const *src,
@@ -364,6 +601,11 @@ Tss2_MU_TPM2B_MAX_NV_BUFFER_Unmarshal(
     size_t         *offset,
     TPM2B_MAX_NV_BUFFER *dest);
 
+TSS2_RC
+Tss2_MU_TPM2B_MAX_NV_BUFFER_Size(
+    TPM2B_MAX_NV_BUFFER const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPM2B_SENSITIVE_DATA_Marshal(
     TPM2B_SENSITIVE_DATA const *src,
@@ -378,6 +620,11 @@ Tss2_MU_TPM2B_SENSITIVE_DATA_Unmarshal(
     size_t         *offset,
     TPM2B_SENSITIVE_DATA *dest);
 
+TSS2_RC
+Tss2_MU_TPM2B_SENSITIVE_DATA_Size(
+    TPM2B_SENSITIVE_DATA const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPM2B_ECC_PARAMETER_Marshal(
     TPM2B_ECC_PARAMETER const *src,
@@ -392,6 +639,11 @@ Tss2_MU_TPM2B_ECC_PARAMETER_Unmarshal(
     size_t         *offset,
     TPM2B_ECC_PARAMETER *dest);
 
+TSS2_RC
+Tss2_MU_TPM2B_ECC_PARAMETER_Size(
+    TPM2B_ECC_PARAMETER const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPM2B_PUBLIC_KEY_RSA_Marshal(
     TPM2B_PUBLIC_KEY_RSA const *src,
@@ -406,6 +658,11 @@ Tss2_MU_TPM2B_PUBLIC_KEY_RSA_Unmarshal(
     size_t         *offset,
     TPM2B_PUBLIC_KEY_RSA *dest);
 
+TSS2_RC
+Tss2_MU_TPM2B_PUBLIC_KEY_RSA_Size(
+    TPM2B_PUBLIC_KEY_RSA const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPM2B_PRIVATE_KEY_RSA_Marshal(
     TPM2B_PRIVATE_KEY_RSA const *src,
@@ -420,6 +677,11 @@ Tss2_MU_TPM2B_PRIVATE_KEY_RSA_Unmarshal(
     size_t         *offset,
     TPM2B_PRIVATE_KEY_RSA *dest);
 
+TSS2_RC
+Tss2_MU_TPM2B_PRIVATE_KEY_RSA_Size(
+    TPM2B_PRIVATE_KEY_RSA const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPM2B_PRIVATE_Marshal(
     TPM2B_PRIVATE const *src,
@@ -434,6 +696,11 @@ Tss2_MU_TPM2B_PRIVATE_Unmarshal(
     size_t         *offset,
     TPM2B_PRIVATE  *dest);
 
+TSS2_RC
+Tss2_MU_TPM2B_PRIVATE_Size(
+    TPM2B_PRIVATE const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPM2B_CONTEXT_SENSITIVE_Marshal(
     TPM2B_CONTEXT_SENSITIVE const *src,
@@ -448,6 +715,11 @@ Tss2_MU_TPM2B_CONTEXT_SENSITIVE_Unmarshal(
     size_t         *offset,
     TPM2B_CONTEXT_SENSITIVE *dest);
 
+TSS2_RC
+Tss2_MU_TPM2B_CONTEXT_SENSITIVE_Size(
+    TPM2B_CONTEXT_SENSITIVE const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPM2B_CONTEXT_DATA_Marshal(
     TPM2B_CONTEXT_DATA const *src,
@@ -462,6 +734,11 @@ Tss2_MU_TPM2B_CONTEXT_DATA_Unmarshal(
     size_t         *offset,
     TPM2B_CONTEXT_DATA *dest);
 
+TSS2_RC
+Tss2_MU_TPM2B_CONTEXT_DATA_Size(
+    TPM2B_CONTEXT_DATA const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPM2B_DATA_Marshal(
     TPM2B_DATA      const *src,
@@ -476,6 +753,11 @@ Tss2_MU_TPM2B_DATA_Unmarshal(
     size_t         *offset,
     TPM2B_DATA     *dest);
 
+TSS2_RC
+Tss2_MU_TPM2B_DATA_Size(
+    TPM2B_DATA      const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPM2B_SYM_KEY_Marshal(
     TPM2B_SYM_KEY   const *src,
@@ -490,6 +772,11 @@ Tss2_MU_TPM2B_SYM_KEY_Unmarshal(
     size_t         *offset,
     TPM2B_SYM_KEY  *dest);
 
+TSS2_RC
+Tss2_MU_TPM2B_SYM_KEY_Size(
+    TPM2B_SYM_KEY   const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPM2B_ECC_POINT_Marshal(
     TPM2B_ECC_POINT const *src,
@@ -504,6 +791,11 @@ Tss2_MU_TPM2B_ECC_POINT_Unmarshal(
     size_t          *offset,
     TPM2B_ECC_POINT *dest);
 
+TSS2_RC
+Tss2_MU_TPM2B_ECC_POINT_Size(
+    TPM2B_ECC_POINT const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPM2B_NV_PUBLIC_Marshal(
     TPM2B_NV_PUBLIC const *src,
@@ -518,6 +810,11 @@ Tss2_MU_TPM2B_NV_PUBLIC_Unmarshal(
     size_t          *offset,
     TPM2B_NV_PUBLIC *dest);
 
+TSS2_RC
+Tss2_MU_TPM2B_NV_PUBLIC_Size(
+    TPM2B_NV_PUBLIC const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPM2B_SENSITIVE_Marshal(
     TPM2B_SENSITIVE const *src,
@@ -532,6 +829,11 @@ Tss2_MU_TPM2B_SENSITIVE_Unmarshal(
     size_t          *offset,
     TPM2B_SENSITIVE *dest);
 
+TSS2_RC
+Tss2_MU_TPM2B_SENSITIVE_Size(
+    TPM2B_SENSITIVE const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPM2B_SENSITIVE_CREATE_Marshal(
     TPM2B_SENSITIVE_CREATE const *src,
@@ -546,6 +848,11 @@ Tss2_MU_TPM2B_SENSITIVE_CREATE_Unmarshal(
     size_t          *offset,
     TPM2B_SENSITIVE_CREATE *dest);
 
+TSS2_RC
+Tss2_MU_TPM2B_SENSITIVE_CREATE_Size(
+    TPM2B_SENSITIVE_CREATE const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPM2B_CREATION_DATA_Marshal(
     TPM2B_CREATION_DATA const *src,
@@ -560,6 +867,11 @@ Tss2_MU_TPM2B_CREATION_DATA_Unmarshal(
     size_t          *offset,
     TPM2B_CREATION_DATA *dest);
 
+TSS2_RC
+Tss2_MU_TPM2B_CREATION_DATA_Size(
+    TPM2B_CREATION_DATA const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPM2B_PUBLIC_Marshal(
     TPM2B_PUBLIC    const *src,
@@ -574,6 +886,11 @@ Tss2_MU_TPM2B_PUBLIC_Unmarshal(
     size_t          *offset,
     TPM2B_PUBLIC    *dest);
 
+TSS2_RC
+Tss2_MU_TPM2B_PUBLIC_Size(
+    TPM2B_PUBLIC    const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPM2B_ENCRYPTED_SECRET_Marshal(
     TPM2B_ENCRYPTED_SECRET  const *src,
@@ -588,6 +905,11 @@ Tss2_MU_TPM2B_ENCRYPTED_SECRET_Unmarshal(
     size_t          *offset,
     TPM2B_ENCRYPTED_SECRET *dest);
 
+TSS2_RC
+Tss2_MU_TPM2B_ENCRYPTED_SECRET_Size(
+    TPM2B_ENCRYPTED_SECRET  const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPM2B_ID_OBJECT_Marshal(
     TPM2B_ID_OBJECT const *src,
@@ -602,6 +924,11 @@ Tss2_MU_TPM2B_ID_OBJECT_Unmarshal(
     size_t          *offset,
     TPM2B_ID_OBJECT *dest);
 
+TSS2_RC
+Tss2_MU_TPM2B_ID_OBJECT_Size(
+    TPM2B_ID_OBJECT const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPM2B_IV_Marshal(
     TPM2B_IV const *src,
@@ -616,6 +943,11 @@ Tss2_MU_TPM2B_IV_Unmarshal(
     size_t          *offset,
     TPM2B_IV        *dest);
 
+TSS2_RC
+Tss2_MU_TPM2B_IV_Size(
+    TPM2B_IV const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPM2B_AUTH_Marshal(
     TPM2B_AUTH const *src,
@@ -630,6 +962,11 @@ Tss2_MU_TPM2B_AUTH_Unmarshal(
     size_t          *offset,
     TPM2B_AUTH      *dest);
 
+TSS2_RC
+Tss2_MU_TPM2B_AUTH_Size(
+    TPM2B_AUTH const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPM2B_EVENT_Marshal(
     TPM2B_EVENT const *src,
@@ -644,6 +981,11 @@ Tss2_MU_TPM2B_EVENT_Unmarshal(
     size_t          *offset,
     TPM2B_EVENT     *dest);
 
+TSS2_RC
+Tss2_MU_TPM2B_EVENT_Size(
+    TPM2B_EVENT const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPM2B_MAX_BUFFER_Marshal(
     TPM2B_MAX_BUFFER const *src,
@@ -658,6 +1000,11 @@ Tss2_MU_TPM2B_MAX_BUFFER_Unmarshal(
     size_t          *offset,
     TPM2B_MAX_BUFFER *dest);
 
+TSS2_RC
+Tss2_MU_TPM2B_MAX_BUFFER_Size(
+    TPM2B_MAX_BUFFER const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPM2B_NONCE_Marshal(
     TPM2B_NONCE const *src,
@@ -672,6 +1019,11 @@ Tss2_MU_TPM2B_NONCE_Unmarshal(
     size_t          *offset,
     TPM2B_NONCE     *dest);
 
+TSS2_RC
+Tss2_MU_TPM2B_NONCE_Size(
+    TPM2B_NONCE const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPM2B_OPERAND_Marshal(
     TPM2B_OPERAND const *src,
@@ -686,6 +1038,11 @@ Tss2_MU_TPM2B_OPERAND_Unmarshal(
     size_t          *offset,
     TPM2B_OPERAND   *dest);
 
+TSS2_RC
+Tss2_MU_TPM2B_OPERAND_Size(
+    TPM2B_OPERAND const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPM2B_TIMEOUT_Marshal(
     TPM2B_TIMEOUT const *src,
@@ -700,6 +1057,11 @@ Tss2_MU_TPM2B_TIMEOUT_Unmarshal(
     size_t          *offset,
     TPM2B_TIMEOUT   *dest);
 
+TSS2_RC
+Tss2_MU_TPM2B_TIMEOUT_Size(
+    TPM2B_TIMEOUT const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_CONTEXT_Marshal(
     TPMS_CONTEXT    const *src,
@@ -714,6 +1076,11 @@ Tss2_MU_TPMS_CONTEXT_Unmarshal(
     size_t         *offset,
     TPMS_CONTEXT   *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_CONTEXT_Size(
+    TPMS_CONTEXT    const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_TIME_INFO_Marshal(
     TPMS_TIME_INFO  const *src,
@@ -728,6 +1095,11 @@ Tss2_MU_TPMS_TIME_INFO_Unmarshal(
     size_t         *offset,
     TPMS_TIME_INFO *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_TIME_INFO_Size(
+    TPMS_TIME_INFO  const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_ECC_POINT_Marshal(
     TPMS_ECC_POINT  const *src,
@@ -742,6 +1114,11 @@ Tss2_MU_TPMS_ECC_POINT_Unmarshal(
     size_t         *offset,
     TPMS_ECC_POINT *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_ECC_POINT_Size(
+    TPMS_ECC_POINT  const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_NV_PUBLIC_Marshal(
     TPMS_NV_PUBLIC  const *src,
@@ -756,6 +1133,11 @@ Tss2_MU_TPMS_NV_PUBLIC_Unmarshal(
     size_t         *offset,
     TPMS_NV_PUBLIC *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_NV_PUBLIC_Size(
+    TPMS_NV_PUBLIC  const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_ALG_PROPERTY_Marshal(
     TPMS_ALG_PROPERTY  const *src,
@@ -770,6 +1152,11 @@ Tss2_MU_TPMS_ALG_PROPERTY_Unmarshal(
     size_t         *offset,
     TPMS_ALG_PROPERTY *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_ALG_PROPERTY_Size(
+    TPMS_ALG_PROPERTY  const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_ALGORITHM_DESCRIPTION_Marshal(
     TPMS_ALGORITHM_DESCRIPTION  const *src,
@@ -784,6 +1171,11 @@ Tss2_MU_TPMS_ALGORITHM_DESCRIPTION_Unmarshal(
     size_t         *offset,
     TPMS_ALGORITHM_DESCRIPTION *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_ALGORITHM_DESCRIPTION_Size(
+    TPMS_ALGORITHM_DESCRIPTION  const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_TAGGED_PROPERTY_Marshal(
     TPMS_TAGGED_PROPERTY  const *src,
@@ -798,6 +1190,11 @@ Tss2_MU_TPMS_TAGGED_PROPERTY_Unmarshal(
     size_t         *offset,
     TPMS_TAGGED_PROPERTY *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_TAGGED_PROPERTY_Size(
+    TPMS_TAGGED_PROPERTY  const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_CLOCK_INFO_Marshal(
     TPMS_CLOCK_INFO  const *src,
@@ -812,6 +1209,11 @@ Tss2_MU_TPMS_CLOCK_INFO_Unmarshal(
     size_t         *offset,
     TPMS_CLOCK_INFO *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_CLOCK_INFO_Size(
+    TPMS_CLOCK_INFO  const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_TIME_ATTEST_INFO_Marshal(
     TPMS_TIME_ATTEST_INFO  const *src,
@@ -826,6 +1228,11 @@ Tss2_MU_TPMS_TIME_ATTEST_INFO_Unmarshal(
     size_t         *offset,
     TPMS_TIME_ATTEST_INFO *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_TIME_ATTEST_INFO_Size(
+    TPMS_TIME_ATTEST_INFO  const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_CERTIFY_INFO_Marshal(
     TPMS_CERTIFY_INFO  const *src,
@@ -840,6 +1247,11 @@ Tss2_MU_TPMS_CERTIFY_INFO_Unmarshal(
     size_t         *offset,
     TPMS_CERTIFY_INFO *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_CERTIFY_INFO_Size(
+    TPMS_CERTIFY_INFO  const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_COMMAND_AUDIT_INFO_Marshal(
     TPMS_COMMAND_AUDIT_INFO  const *src,
@@ -854,6 +1266,11 @@ Tss2_MU_TPMS_COMMAND_AUDIT_INFO_Unmarshal(
     size_t         *offset,
     TPMS_COMMAND_AUDIT_INFO *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_COMMAND_AUDIT_INFO_Size(
+    TPMS_COMMAND_AUDIT_INFO  const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_SESSION_AUDIT_INFO_Marshal(
     TPMS_SESSION_AUDIT_INFO  const *src,
@@ -868,6 +1285,11 @@ Tss2_MU_TPMS_SESSION_AUDIT_INFO_Unmarshal(
     size_t         *offset,
     TPMS_SESSION_AUDIT_INFO *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_SESSION_AUDIT_INFO_Size(
+    TPMS_SESSION_AUDIT_INFO  const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_CREATION_INFO_Marshal(
     TPMS_CREATION_INFO  const *src,
@@ -882,6 +1304,11 @@ Tss2_MU_TPMS_CREATION_INFO_Unmarshal(
     size_t         *offset,
     TPMS_CREATION_INFO *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_CREATION_INFO_Size(
+    TPMS_CREATION_INFO  const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_NV_CERTIFY_INFO_Marshal(
     TPMS_NV_CERTIFY_INFO  const *src,
@@ -896,6 +1323,11 @@ Tss2_MU_TPMS_NV_CERTIFY_INFO_Unmarshal(
     size_t         *offset,
     TPMS_NV_CERTIFY_INFO *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_NV_CERTIFY_INFO_Size(
+    TPMS_NV_CERTIFY_INFO  const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_AUTH_COMMAND_Marshal(
     TPMS_AUTH_COMMAND  const *src,
@@ -910,6 +1342,11 @@ Tss2_MU_TPMS_AUTH_COMMAND_Unmarshal(
     size_t         *offset,
     TPMS_AUTH_COMMAND *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_AUTH_COMMAND_Size(
+    TPMS_AUTH_COMMAND  const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_AUTH_RESPONSE_Marshal(
     TPMS_AUTH_RESPONSE  const *src,
@@ -924,6 +1361,11 @@ Tss2_MU_TPMS_AUTH_RESPONSE_Unmarshal(
     size_t         *offset,
     TPMS_AUTH_RESPONSE *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_AUTH_RESPONSE_Size(
+    TPMS_AUTH_RESPONSE  const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_SENSITIVE_CREATE_Marshal(
     TPMS_SENSITIVE_CREATE  const *src,
@@ -938,6 +1380,11 @@ Tss2_MU_TPMS_SENSITIVE_CREATE_Unmarshal(
     size_t         *offset,
     TPMS_SENSITIVE_CREATE *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_SENSITIVE_CREATE_Size(
+    TPMS_SENSITIVE_CREATE  const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_SCHEME_HASH_Marshal(
     TPMS_SCHEME_HASH  const *src,
@@ -952,6 +1399,11 @@ Tss2_MU_TPMS_SCHEME_HASH_Unmarshal(
     size_t         *offset,
     TPMS_SCHEME_HASH *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_SCHEME_HASH_Size(
+    TPMS_SCHEME_HASH  const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_SCHEME_ECDAA_Marshal(
     TPMS_SCHEME_ECDAA  const *src,
@@ -966,6 +1418,11 @@ Tss2_MU_TPMS_SCHEME_ECDAA_Unmarshal(
     size_t         *offset,
     TPMS_SCHEME_ECDAA *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_SCHEME_ECDAA_Size(
+    TPMS_SCHEME_ECDAA  const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_SCHEME_XOR_Marshal(
     TPMS_SCHEME_XOR  const *src,
@@ -980,6 +1437,11 @@ Tss2_MU_TPMS_SCHEME_XOR_Unmarshal(
     size_t         *offset,
     TPMS_SCHEME_XOR *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_SCHEME_XOR_Size(
+    TPMS_SCHEME_XOR  const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_SIGNATURE_RSA_Marshal(
     TPMS_SIGNATURE_RSA  const *src,
@@ -994,6 +1456,11 @@ Tss2_MU_TPMS_SIGNATURE_RSA_Unmarshal(
     size_t         *offset,
     TPMS_SIGNATURE_RSA *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_SIGNATURE_RSA_Size(
+    TPMS_SIGNATURE_RSA  const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_SIGNATURE_ECC_Marshal(
     TPMS_SIGNATURE_ECC  const *src,
@@ -1008,6 +1475,11 @@ Tss2_MU_TPMS_SIGNATURE_ECC_Unmarshal(
     size_t         *offset,
     TPMS_SIGNATURE_ECC *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_SIGNATURE_ECC_Size(
+    TPMS_SIGNATURE_ECC  const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_NV_PIN_COUNTER_PARAMETERS_Marshal(
     TPMS_NV_PIN_COUNTER_PARAMETERS  const *src,
@@ -1022,6 +1494,11 @@ Tss2_MU_TPMS_NV_PIN_COUNTER_PARAMETERS_Unmarshal(
     size_t         *offset,
     TPMS_NV_PIN_COUNTER_PARAMETERS *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_NV_PIN_COUNTER_PARAMETERS_Size(
+    TPMS_NV_PIN_COUNTER_PARAMETERS  const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_CONTEXT_DATA_Marshal(
     TPMS_CONTEXT_DATA  const *src,
@@ -1036,6 +1513,11 @@ Tss2_MU_TPMS_CONTEXT_DATA_Unmarshal(
     size_t         *offset,
     TPMS_CONTEXT_DATA *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_CONTEXT_DATA_Size(
+    TPMS_CONTEXT_DATA  const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_PCR_SELECT_Marshal(
     TPMS_PCR_SELECT  const *src,
@@ -1050,6 +1532,11 @@ Tss2_MU_TPMS_PCR_SELECT_Unmarshal(
     size_t         *offset,
     TPMS_PCR_SELECT *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_PCR_SELECT_Size(
+    TPMS_PCR_SELECT  const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_PCR_SELECTION_Marshal(
     TPMS_PCR_SELECTION  const *src,
@@ -1064,6 +1551,11 @@ Tss2_MU_TPMS_PCR_SELECTION_Unmarshal(
     size_t         *offset,
     TPMS_PCR_SELECTION *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_PCR_SELECTION_Size(
+    TPMS_PCR_SELECTION  const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_TAGGED_PCR_SELECT_Marshal(
     TPMS_TAGGED_PCR_SELECT  const *src,
@@ -1078,6 +1570,11 @@ Tss2_MU_TPMS_TAGGED_PCR_SELECT_Unmarshal(
     size_t         *offset,
     TPMS_TAGGED_PCR_SELECT *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_TAGGED_PCR_SELECT_Size(
+    TPMS_TAGGED_PCR_SELECT  const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_QUOTE_INFO_Marshal(
     TPMS_QUOTE_INFO  const *src,
@@ -1092,6 +1589,11 @@ Tss2_MU_TPMS_QUOTE_INFO_Unmarshal(
     size_t         *offset,
     TPMS_QUOTE_INFO *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_QUOTE_INFO_Size(
+    TPMS_QUOTE_INFO  const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_CREATION_DATA_Marshal(
     TPMS_CREATION_DATA  const *src,
@@ -1106,6 +1608,11 @@ Tss2_MU_TPMS_CREATION_DATA_Unmarshal(
     size_t         *offset,
     TPMS_CREATION_DATA *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_CREATION_DATA_Size(
+    TPMS_CREATION_DATA  const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_ECC_PARMS_Marshal(
     TPMS_ECC_PARMS  const *src,
@@ -1120,6 +1627,11 @@ Tss2_MU_TPMS_ECC_PARMS_Unmarshal(
     size_t         *offset,
     TPMS_ECC_PARMS *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_ECC_PARMS_Size(
+    TPMS_ECC_PARMS  const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_ATTEST_Marshal(
     TPMS_ATTEST     const *src,
@@ -1134,6 +1646,11 @@ Tss2_MU_TPMS_ATTEST_Unmarshal(
     size_t         *offset,
     TPMS_ATTEST *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_ATTEST_Size(
+    TPMS_ATTEST     const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_ALGORITHM_DETAIL_ECC_Marshal(
     TPMS_ALGORITHM_DETAIL_ECC const *src,
@@ -1148,6 +1665,11 @@ Tss2_MU_TPMS_ALGORITHM_DETAIL_ECC_Unmarshal(
     size_t         *offset,
     TPMS_ALGORITHM_DETAIL_ECC *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_ALGORITHM_DETAIL_ECC_Size(
+    TPMS_ALGORITHM_DETAIL_ECC const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_CAPABILITY_DATA_Marshal(
     TPMS_CAPABILITY_DATA const *src,
@@ -1162,6 +1684,11 @@ Tss2_MU_TPMS_CAPABILITY_DATA_Unmarshal(
     size_t         *offset,
     TPMS_CAPABILITY_DATA *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_CAPABILITY_DATA_Size(
+    TPMS_CAPABILITY_DATA const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_KEYEDHASH_PARMS_Marshal(
     TPMS_KEYEDHASH_PARMS const *src,
@@ -1176,6 +1703,11 @@ Tss2_MU_TPMS_KEYEDHASH_PARMS_Unmarshal(
     size_t         *offset,
     TPMS_KEYEDHASH_PARMS *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_KEYEDHASH_PARMS_Size(
+    TPMS_KEYEDHASH_PARMS const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_RSA_PARMS_Marshal(
     TPMS_RSA_PARMS  const *src,
@@ -1190,6 +1722,11 @@ Tss2_MU_TPMS_RSA_PARMS_Unmarshal(
     size_t         *offset,
     TPMS_RSA_PARMS *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_RSA_PARMS_Size(
+    TPMS_RSA_PARMS  const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMS_SYMCIPHER_PARMS_Marshal(
     TPMS_SYMCIPHER_PARMS const *src,
@@ -1204,6 +1741,11 @@ Tss2_MU_TPMS_SYMCIPHER_PARMS_Unmarshal(
     size_t         *offset,
     TPMS_SYMCIPHER_PARMS *dest);
 
+TSS2_RC
+Tss2_MU_TPMS_SYMCIPHER_PARMS_Size(
+    TPMS_SYMCIPHER_PARMS const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPML_CC_Marshal(
     TPML_CC const *src,
@@ -1218,6 +1760,11 @@ Tss2_MU_TPML_CC_Unmarshal(
     size_t         *offset,
     TPML_CC        *dest);
 
+TSS2_RC
+Tss2_MU_TPML_CC_Size(
+    TPML_CC const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPML_CCA_Marshal(
     TPML_CCA const *src,
@@ -1232,6 +1779,11 @@ Tss2_MU_TPML_CCA_Unmarshal(
     size_t         *offset,
     TPML_CCA       *dest);
 
+TSS2_RC
+Tss2_MU_TPML_CCA_Size(
+    TPML_CCA const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPML_ALG_Marshal(
     TPML_ALG const *src,
@@ -1246,6 +1798,11 @@ Tss2_MU_TPML_ALG_Unmarshal(
     size_t         *offset,
     TPML_ALG       *dest);
 
+TSS2_RC
+Tss2_MU_TPML_ALG_Size(
+    TPML_ALG const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPML_HANDLE_Marshal(
     TPML_HANDLE const *src,
@@ -1260,6 +1817,11 @@ Tss2_MU_TPML_HANDLE_Unmarshal(
     size_t         *offset,
     TPML_HANDLE    *dest);
 
+TSS2_RC
+Tss2_MU_TPML_HANDLE_Size(
+    TPML_HANDLE const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPML_DIGEST_Marshal(
     TPML_DIGEST const *src,
@@ -1274,6 +1836,11 @@ Tss2_MU_TPML_DIGEST_Unmarshal(
     size_t         *offset,
     TPML_DIGEST    *dest);
 
+TSS2_RC
+Tss2_MU_TPML_DIGEST_Size(
+    TPML_DIGEST const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPML_DIGEST_VALUES_Marshal(
     TPML_DIGEST_VALUES const *src,
@@ -1288,6 +1855,11 @@ Tss2_MU_TPML_DIGEST_VALUES_Unmarshal(
     size_t         *offset,
     TPML_DIGEST_VALUES *dest);
 
+TSS2_RC
+Tss2_MU_TPML_DIGEST_VALUES_Size(
+    TPML_DIGEST_VALUES const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPML_PCR_SELECTION_Marshal(
     TPML_PCR_SELECTION const *src,
@@ -1302,6 +1874,11 @@ Tss2_MU_TPML_PCR_SELECTION_Unmarshal(
     size_t         *offset,
     TPML_PCR_SELECTION *dest);
 
+TSS2_RC
+Tss2_MU_TPML_PCR_SELECTION_Size(
+    TPML_PCR_SELECTION const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPML_ALG_PROPERTY_Marshal(
     TPML_ALG_PROPERTY const *src,
@@ -1316,6 +1893,11 @@ Tss2_MU_TPML_ALG_PROPERTY_Unmarshal(
     size_t         *offset,
     TPML_ALG_PROPERTY *dest);
 
+TSS2_RC
+Tss2_MU_TPML_ALG_PROPERTY_Size(
+    TPML_ALG_PROPERTY const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPML_ECC_CURVE_Marshal(
     TPML_ECC_CURVE const *src,
@@ -1330,6 +1912,11 @@ Tss2_MU_TPML_ECC_CURVE_Unmarshal(
     size_t         *offset,
     TPML_ECC_CURVE *dest);
 
+TSS2_RC
+Tss2_MU_TPML_ECC_CURVE_Size(
+    TPML_ECC_CURVE const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPML_TAGGED_PCR_PROPERTY_Marshal(
     TPML_TAGGED_PCR_PROPERTY const *src,
@@ -1344,6 +1931,11 @@ Tss2_MU_TPML_TAGGED_PCR_PROPERTY_Unmarshal(
     size_t         *offset,
     TPML_TAGGED_PCR_PROPERTY *dest);
 
+TSS2_RC
+Tss2_MU_TPML_TAGGED_PCR_PROPERTY_Size(
+    TPML_TAGGED_PCR_PROPERTY const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPML_TAGGED_TPM_PROPERTY_Marshal(
     TPML_TAGGED_TPM_PROPERTY const *src,
@@ -1358,6 +1950,11 @@ Tss2_MU_TPML_TAGGED_TPM_PROPERTY_Unmarshal(
     size_t         *offset,
     TPML_TAGGED_TPM_PROPERTY *dest);
 
+TSS2_RC
+Tss2_MU_TPML_TAGGED_TPM_PROPERTY_Size(
+    TPML_TAGGED_TPM_PROPERTY const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPML_INTEL_PTT_PROPERTY_Marshal(
     TPML_INTEL_PTT_PROPERTY const *src,
@@ -1372,6 +1969,11 @@ Tss2_MU_TPML_INTEL_PTT_PROPERTY_Unmarshal(
     size_t         *offset,
     TPML_INTEL_PTT_PROPERTY *dest);
 
+TSS2_RC
+Tss2_MU_TPML_INTEL_PTT_PROPERTY_Size(
+    TPML_INTEL_PTT_PROPERTY const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMU_HA_Marshal(
     TPMU_HA const *src,
@@ -1388,6 +1990,12 @@ Tss2_MU_TPMU_HA_Unmarshal(
     uint32_t       selector_value,
     TPMU_HA       *dest);
 
+TSS2_RC
+Tss2_MU_TPMU_HA_Size(
+    TPMU_HA const *src,
+    uint32_t       selector_value,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMU_CAPABILITIES_Marshal(
     TPMU_CAPABILITIES const *src,
@@ -1404,6 +2012,12 @@ Tss2_MU_TPMU_CAPABILITIES_Unmarshal(
     uint32_t       selector_value,
     TPMU_CAPABILITIES *dest);
 
+TSS2_RC
+Tss2_MU_TPMU_CAPABILITIES_Size(
+    TPMU_CAPABILITIES const *src,
+    uint32_t       selector_value,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMU_ATTEST_Marshal(
     TPMU_ATTEST const *src,
@@ -1420,6 +2034,12 @@ Tss2_MU_TPMU_ATTEST_Unmarshal(
     uint32_t       selector_value,
     TPMU_ATTEST *dest);
 
+TSS2_RC
+Tss2_MU_TPMU_ATTEST_Size(
+    TPMU_ATTEST const *src,
+    uint32_t       selector_value,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMU_SYM_KEY_BITS_Marshal(
     TPMU_SYM_KEY_BITS const *src,
@@ -1436,6 +2056,12 @@ Tss2_MU_TPMU_SYM_KEY_BITS_Unmarshal(
     uint32_t       selector_value,
     TPMU_SYM_KEY_BITS *dest);
 
+TSS2_RC
+Tss2_MU_TPMU_SYM_KEY_BITS_Size(
+    TPMU_SYM_KEY_BITS const *src,
+    uint32_t       selector_value,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMU_SYM_MODE_Marshal(
     TPMU_SYM_MODE const *src,
@@ -1452,6 +2078,12 @@ Tss2_MU_TPMU_SYM_MODE_Unmarshal(
     uint32_t       selector_value,
     TPMU_SYM_MODE *dest);
 
+TSS2_RC
+Tss2_MU_TPMU_SYM_MODE_Size(
+    TPMU_SYM_MODE const *src,
+    uint32_t       selector_value,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMU_SIG_SCHEME_Marshal(
     TPMU_SIG_SCHEME const *src,
@@ -1468,6 +2100,12 @@ Tss2_MU_TPMU_SIG_SCHEME_Unmarshal(
     uint32_t       selector_value,
     TPMU_SIG_SCHEME *dest);
 
+TSS2_RC
+Tss2_MU_TPMU_SIG_SCHEME_Size(
+    TPMU_SIG_SCHEME const *src,
+    uint32_t       selector_value,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMU_KDF_SCHEME_Marshal(
     TPMU_KDF_SCHEME const *src,
@@ -1484,6 +2122,12 @@ Tss2_MU_TPMU_KDF_SCHEME_Unmarshal(
     uint32_t       selector_value,
     TPMU_KDF_SCHEME *dest);
 
+TSS2_RC
+Tss2_MU_TPMU_KDF_SCHEME_Size(
+    TPMU_KDF_SCHEME const *src,
+    uint32_t       selector_value,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMU_ASYM_SCHEME_Marshal(
     TPMU_ASYM_SCHEME const *src,
@@ -1500,6 +2144,12 @@ Tss2_MU_TPMU_ASYM_SCHEME_Unmarshal(
     uint32_t       selector_value,
     TPMU_ASYM_SCHEME *dest);
 
+TSS2_RC
+Tss2_MU_TPMU_ASYM_SCHEME_Size(
+    TPMU_ASYM_SCHEME const *src,
+    uint32_t       selector_value,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMU_SCHEME_KEYEDHASH_Marshal(
     TPMU_SCHEME_KEYEDHASH const *src,
@@ -1516,6 +2166,12 @@ Tss2_MU_TPMU_SCHEME_KEYEDHASH_Unmarshal(
     uint32_t       selector_value,
     TPMU_SCHEME_KEYEDHASH *dest);
 
+TSS2_RC
+Tss2_MU_TPMU_SCHEME_KEYEDHASH_Size(
+    TPMU_SCHEME_KEYEDHASH const *src,
+    uint32_t       selector_value,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMU_SIGNATURE_Marshal(
     TPMU_SIGNATURE const *src,
@@ -1532,6 +2188,12 @@ Tss2_MU_TPMU_SIGNATURE_Unmarshal(
     uint32_t       selector_value,
     TPMU_SIGNATURE *dest);
 
+TSS2_RC
+Tss2_MU_TPMU_SIGNATURE_Size(
+    TPMU_SIGNATURE const *src,
+    uint32_t       selector_value,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMU_SENSITIVE_COMPOSITE_Marshal(
     TPMU_SENSITIVE_COMPOSITE const *src,
@@ -1548,6 +2210,12 @@ Tss2_MU_TPMU_SENSITIVE_COMPOSITE_Unmarshal(
     uint32_t       selector_value,
     TPMU_SENSITIVE_COMPOSITE *dest);
 
+TSS2_RC
+Tss2_MU_TPMU_SENSITIVE_COMPOSITE_Size(
+    TPMU_SENSITIVE_COMPOSITE const *src,
+    uint32_t       selector_value,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMU_ENCRYPTED_SECRET_Marshal(
     TPMU_ENCRYPTED_SECRET const *src,
@@ -1564,6 +2232,12 @@ Tss2_MU_TPMU_ENCRYPTED_SECRET_Unmarshal(
     uint32_t       selector_value,
     TPMU_ENCRYPTED_SECRET *dest);
 
+TSS2_RC
+Tss2_MU_TPMU_ENCRYPTED_SECRET_Size(
+    TPMU_ENCRYPTED_SECRET const *src,
+    uint32_t       selector_value,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMU_PUBLIC_PARMS_Marshal(
     TPMU_PUBLIC_PARMS const *src,
@@ -1580,6 +2254,12 @@ Tss2_MU_TPMU_PUBLIC_PARMS_Unmarshal(
     uint32_t       selector_value,
     TPMU_PUBLIC_PARMS *dest);
 
+TSS2_RC
+Tss2_MU_TPMU_PUBLIC_PARMS_Size(
+    TPMU_PUBLIC_PARMS const *src,
+    uint32_t       selector_value,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMU_PUBLIC_ID_Marshal(
     TPMU_PUBLIC_ID const *src,
@@ -1596,6 +2276,12 @@ Tss2_MU_TPMU_PUBLIC_ID_Unmarshal(
     uint32_t       selector_value,
     TPMU_PUBLIC_ID *dest);
 
+TSS2_RC
+Tss2_MU_TPMU_PUBLIC_ID_Size(
+    TPMU_PUBLIC_ID const *src,
+    uint32_t       selector_value,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMT_HA_Marshal(
     TPMT_HA const *src,
@@ -1610,6 +2296,11 @@ Tss2_MU_TPMT_HA_Unmarshal(
     size_t        *offset,
     TPMT_HA *dest);
 
+TSS2_RC
+Tss2_MU_TPMT_HA_Size(
+    TPMT_HA const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMT_SYM_DEF_Marshal(
     TPMT_SYM_DEF const *src,
@@ -1624,6 +2315,11 @@ Tss2_MU_TPMT_SYM_DEF_Unmarshal(
     size_t        *offset,
     TPMT_SYM_DEF  *dest);
 
+TSS2_RC
+Tss2_MU_TPMT_SYM_DEF_Size(
+    TPMT_SYM_DEF const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMT_SYM_DEF_OBJECT_Marshal(
     TPMT_SYM_DEF_OBJECT const *src,
@@ -1638,6 +2334,11 @@ Tss2_MU_TPMT_SYM_DEF_OBJECT_Unmarshal(
     size_t        *offset,
     TPMT_SYM_DEF_OBJECT *dest);
 
+TSS2_RC
+Tss2_MU_TPMT_SYM_DEF_OBJECT_Size(
+    TPMT_SYM_DEF_OBJECT const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMT_KEYEDHASH_SCHEME_Marshal(
     TPMT_KEYEDHASH_SCHEME const *src,
@@ -1652,6 +2353,11 @@ Tss2_MU_TPMT_KEYEDHASH_SCHEME_Unmarshal(
     size_t        *offset,
     TPMT_KEYEDHASH_SCHEME *dest);
 
+TSS2_RC
+Tss2_MU_TPMT_KEYEDHASH_SCHEME_Size(
+    TPMT_KEYEDHASH_SCHEME const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMT_SIG_SCHEME_Marshal(
     TPMT_SIG_SCHEME const *src,
@@ -1666,6 +2372,11 @@ Tss2_MU_TPMT_SIG_SCHEME_Unmarshal(
     size_t        *offset,
     TPMT_SIG_SCHEME *dest);
 
+TSS2_RC
+Tss2_MU_TPMT_SIG_SCHEME_Size(
+    TPMT_SIG_SCHEME const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMT_KDF_SCHEME_Marshal(
     TPMT_KDF_SCHEME const *src,
@@ -1680,6 +2391,11 @@ Tss2_MU_TPMT_KDF_SCHEME_Unmarshal(
     size_t        *offset,
     TPMT_KDF_SCHEME *dest);
 
+TSS2_RC
+Tss2_MU_TPMT_KDF_SCHEME_Size(
+    TPMT_KDF_SCHEME const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMT_ASYM_SCHEME_Marshal(
     TPMT_ASYM_SCHEME const *src,
@@ -1694,6 +2410,11 @@ Tss2_MU_TPMT_ASYM_SCHEME_Unmarshal(
     size_t        *offset,
     TPMT_ASYM_SCHEME *dest);
 
+TSS2_RC
+Tss2_MU_TPMT_ASYM_SCHEME_Size(
+    TPMT_ASYM_SCHEME const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMT_RSA_SCHEME_Marshal(
     TPMT_RSA_SCHEME const *src,
@@ -1708,6 +2429,11 @@ Tss2_MU_TPMT_RSA_SCHEME_Unmarshal(
     size_t        *offset,
     TPMT_RSA_SCHEME *dest);
 
+TSS2_RC
+Tss2_MU_TPMT_RSA_SCHEME_Size(
+    TPMT_RSA_SCHEME const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMT_RSA_DECRYPT_Marshal(
     TPMT_RSA_DECRYPT const *src,
@@ -1722,6 +2448,11 @@ Tss2_MU_TPMT_RSA_DECRYPT_Unmarshal(
     size_t        *offset,
     TPMT_RSA_DECRYPT *dest);
 
+TSS2_RC
+Tss2_MU_TPMT_RSA_DECRYPT_Size(
+    TPMT_RSA_DECRYPT const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMT_ECC_SCHEME_Marshal(
     TPMT_ECC_SCHEME const *src,
@@ -1736,6 +2467,11 @@ Tss2_MU_TPMT_ECC_SCHEME_Unmarshal(
     size_t        *offset,
     TPMT_ECC_SCHEME *dest);
 
+TSS2_RC
+Tss2_MU_TPMT_ECC_SCHEME_Size(
+    TPMT_ECC_SCHEME const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMT_SIGNATURE_Marshal(
     TPMT_SIGNATURE const *src,
@@ -1750,6 +2486,11 @@ Tss2_MU_TPMT_SIGNATURE_Unmarshal(
     size_t        *offset,
     TPMT_SIGNATURE *dest);
 
+TSS2_RC
+Tss2_MU_TPMT_SIGNATURE_Size(
+    TPMT_SIGNATURE const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMT_SENSITIVE_Marshal(
     TPMT_SENSITIVE const *src,
@@ -1764,6 +2505,11 @@ Tss2_MU_TPMT_SENSITIVE_Unmarshal(
     size_t        *offset,
     TPMT_SENSITIVE *dest);
 
+TSS2_RC
+Tss2_MU_TPMT_SENSITIVE_Size(
+    TPMT_SENSITIVE const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMT_PUBLIC_Marshal(
     TPMT_PUBLIC    const *src,
@@ -1778,6 +2524,11 @@ Tss2_MU_TPMT_PUBLIC_Unmarshal(
     size_t        *offset,
     TPMT_PUBLIC   *dest);
 
+TSS2_RC
+Tss2_MU_TPMT_PUBLIC_Size(
+    TPMT_PUBLIC    const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMT_PUBLIC_PARMS_Marshal(
     TPMT_PUBLIC_PARMS const *src,
@@ -1792,6 +2543,11 @@ Tss2_MU_TPMT_PUBLIC_PARMS_Unmarshal(
     size_t        *offset,
     TPMT_PUBLIC_PARMS *dest);
 
+TSS2_RC
+Tss2_MU_TPMT_PUBLIC_PARMS_Size(
+    TPMT_PUBLIC_PARMS const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMT_TK_CREATION_Marshal(
     TPMT_TK_CREATION const *src,
@@ -1806,6 +2562,11 @@ Tss2_MU_TPMT_TK_CREATION_Unmarshal(
     size_t        *offset,
     TPMT_TK_CREATION *dest);
 
+TSS2_RC
+Tss2_MU_TPMT_TK_CREATION_Size(
+    TPMT_TK_CREATION const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMT_TK_VERIFIED_Marshal(
     TPMT_TK_VERIFIED const *src,
@@ -1820,6 +2581,11 @@ Tss2_MU_TPMT_TK_VERIFIED_Unmarshal(
     size_t        *offset,
     TPMT_TK_VERIFIED *dest);
 
+TSS2_RC
+Tss2_MU_TPMT_TK_VERIFIED_Size(
+    TPMT_TK_VERIFIED const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMT_TK_AUTH_Marshal(
     TPMT_TK_AUTH   const *src,
@@ -1834,6 +2600,11 @@ Tss2_MU_TPMT_TK_AUTH_Unmarshal(
     size_t        *offset,
     TPMT_TK_AUTH  *dest);
 
+TSS2_RC
+Tss2_MU_TPMT_TK_AUTH_Size(
+    TPMT_TK_AUTH   const *src,
+    size_t         *size);
+
 TSS2_RC
 Tss2_MU_TPMT_TK_HASHCHECK_Marshal(
     TPMT_TK_HASHCHECK const *src,
@@ -1848,6 +2619,105 @@ Tss2_MU_TPMT_TK_HASHCHECK_Unmarshal(
     size_t        *offset,
     TPMT_TK_HASHCHECK *dest);
 
+TSS2_RC
+Tss2_MU_TPMT_TK_HASHCHECK_Size(
+    TPMT_TK_HASHCHECK const *src,
+    size_t         *size);
+
+/*
+ * Views validate a marshalled structure once and record where its fields
+ * are, without decoding it. The view points into the caller's buffer, which
+ * must outlive it. Offsets are relative to buffer. TPM2B fields are returned
+ * as pointer / size pairs into the buffer, other fields are decoded when the
+ * accessor is called.
+ */
+typedef struct {
+    uint8_t const  *buffer;
+    UINT16          size;
+    TPMI_ST_ATTEST  type;
+    UINT16          extraData;
+    UINT16          clockInfo;
+    UINT16          attested;
+    UINT16          pcrDigest;      /* TPM_ST_ATTEST_QUOTE only */
+} TSS2_MU_TPMS_ATTEST_VIEW;
+
+typedef struct {
+    uint8_t const  *buffer;
+    UINT16          size;
+    TPMI_ALG_PUBLIC type;
+    TPMI_ALG_HASH   nameAlg;
+    UINT16          parameters;
+    UINT16          unique;
+} TSS2_MU_TPM2B_PUBLIC_VIEW;
+
+TSS2_RC
+Tss2_MU_TPMS_ATTEST_View(
+    uint8_t const  buffer[],
+    size_t         buffer_size,
+    size_t        *offset,
+    TSS2_MU_TPMS_ATTEST_VIEW *view);
+
+TSS2_RC
+Tss2_MU_TPMS_ATTEST_View_QualifiedSigner(
+    TSS2_MU_TPMS_ATTEST_VIEW const *view,
+    uint8_t const **name,
+    size_t         *size);
+
+TSS2_RC
+Tss2_MU_TPMS_ATTEST_View_ExtraData(
+    TSS2_MU_TPMS_ATTEST_VIEW const *view,
+    uint8_t const **data,
+    size_t         *size);
+
+TSS2_RC
+Tss2_MU_TPMS_ATTEST_View_ClockInfo(
+    TSS2_MU_TPMS_ATTEST_VIEW const *view,
+    TPMS_CLOCK_INFO *clockInfo);
+
+TSS2_RC
+Tss2_MU_TPMS_ATTEST_View_FirmwareVersion(
+    TSS2_MU_TPMS_ATTEST_VIEW const *view,
+    UINT64         *firmwareVersion);
+
+TSS2_RC
+Tss2_MU_TPMS_ATTEST_View_PcrDigest(
+    TSS2_MU_TPMS_ATTEST_VIEW const *view,
+    uint8_t const **digest,
+    size_t         *size);
+
+TSS2_RC
+Tss2_MU_TPMS_ATTEST_View_Attested(
+    TSS2_MU_TPMS_ATTEST_VIEW const *view,
+    TPMU_ATTEST    *attested);
+
+TSS2_RC
+Tss2_MU_TPM2B_PUBLIC_View(
+    uint8_t const  buffer[],
+    size_t         buffer_size,
+    size_t        *offset,
+    TSS2_MU_TPM2B_PUBLIC_VIEW *view);
+
+TSS2_RC
+Tss2_MU_TPM2B_PUBLIC_View_PublicArea(
+    TSS2_MU_TPM2B_PUBLIC_VIEW const *view,
+    uint8_t const **data,
+    size_t         *size);
+
+TSS2_RC
+Tss2_MU_TPM2B_PUBLIC_View_ObjectAttributes(
+    TSS2_MU_TPM2B_PUBLIC_VIEW const *view,
+    TPMA_OBJECT    *objectAttributes);
+
+TSS2_RC
+Tss2_MU_TPM2B_PUBLIC_View_Parameters(
+    TSS2_MU_TPM2B_PUBLIC_VIEW const *view,
+    TPMU_PUBLIC_PARMS *parameters);
+
+TSS2_RC
+Tss2_MU_TPM2B_PUBLIC_View_Unique(
+    TSS2_MU_TPM2B_PUBLIC_VIEW const *view,
+    TPMU_PUBLIC_ID *unique);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,90 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+#ifndef TCTI_CACHE_H
+#define TCTI_CACHE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sapi/tpm20.h>
+
+/*
+ * The cache TCTI sits between the SAPI and another TCTI (the 'downstream'
+ * TCTI) and answers repeated read-only commands from memory. Only
+ * GetCapability (for data that doesn't change at runtime), ReadPublic and
+ * NV_ReadPublic without sessions are cached, keyed by the exact command
+ * bytes. Entries are dropped when a command that may change their result
+ * (NV_Write, FlushContext, Startup, ...) passes through, so the cache is
+ * only coherent if all commands that change the TPM go through it.
+ *
+ * PCR_Read is only cached with 'cache_pcrs' set, and dropped on
+ * PCR_Extend, PCR_Event etc. The kernel (IMA, the boot event log) and
+ * other users of the TPM device extend PCRs without going through any TCTI,
+ * so only set it when nothing else can reach the TPM.
+ */
+typedef struct {
+    TSS2_TCTI_CONTEXT *downstream;
+    size_t max_entries;     /* 0 selects TCTI_CACHE_MAX_ENTRIES */
+    int cache_pcrs;         /* also cache PCR_Read, see above */
+} TCTI_CACHE_CONF;
+
+typedef struct {
+    UINT64 hits;            /* answered from the cache */
+    UINT64 misses;          /* cacheable but sent to the TPM */
+    UINT64 uncacheable;     /* not a cacheable command */
+    UINT64 invalidations;   /* entries dropped by a mutating command */
+    UINT64 evictions;       /* entries dropped to make room */
+} TCTI_CACHE_STATS;
+
+/* Upper limit on the number of cached responses. */
+#define TCTI_CACHE_MAX_ENTRIES 32
+/* Commands longer than this are never cached. */
+#define TCTI_CACHE_KEY_MAX 64
+
+TSS2_RC InitCacheTcti (
+    TSS2_TCTI_CONTEXT *tctiContext, // OUT
+    size_t *contextSize,            // IN/OUT
+    const TCTI_CACHE_CONF *config   // IN
+    );
+TSS2_RC TctiCacheGetStats (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    TCTI_CACHE_STATS *stats
+    );
+/*
+ * Drop every cached response, for callers that know the TPM was changed
+ * behind the cache's back.
+ */
+TSS2_RC TctiCacheInvalidate (
+    TSS2_TCTI_CONTEXT *tctiContext
+    );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TCTI_CACHE_H */
@@ -47,6 +47,10 @@ TSS2_RC PlatformCommand(
     TSS2_TCTI_CONTEXT *tctiContext,     /* in */
     char cmd );
 
+/*
+ * A hostname starting with '/' is the path of an AF_UNIX socket, e.g. the
+ * one the resource manager listens on. The port is ignored then.
+ */
 typedef struct {
     const char *hostname;
     uint16_t port;
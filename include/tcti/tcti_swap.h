@@ -0,0 +1,95 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+
+#ifndef TCTI_SWAP_H
+#define TCTI_SWAP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sapi/tpm20.h>
+
+/*
+ * The swap TCTI sits between the SAPI and another TCTI (the 'downstream'
+ * TCTI, typically the device or socket TCTI). It hands out virtual handles
+ * for transient objects and keeps at most 'max_loaded_objects' objects and
+ * 'max_loaded_sessions' sessions in TPM memory, swapping the least recently
+ * used ones out with ContextSave / ContextLoad as commands reference them.
+ * Pinned objects are only swapped out when nothing else can be.
+ * Commands that reference a transient object or session this instance
+ * didn't create are answered with TPM_RC_HANDLE without reaching the TPM,
+ * so instances sharing a downstream TCTI can't touch each other's.
+ * Sessions the app saves with ContextSave stay tracked until the app
+ * flushes them or loads them back with ContextLoad.
+ */
+typedef struct {
+    TSS2_TCTI_CONTEXT *downstream;
+    size_t max_loaded_objects;   /* 0 selects MAX_LOADED_OBJECTS */
+    size_t max_loaded_sessions;  /* 0 selects MAX_LOADED_SESSIONS */
+} TCTI_SWAP_CONF;
+
+typedef struct {
+    UINT64 hits;        /* referenced handle was already loaded */
+    UINT64 misses;      /* referenced handle had to be loaded */
+    UINT64 saves;       /* contexts saved to make room */
+    UINT64 loads;       /* contexts loaded back */
+} TCTI_SWAP_STATS;
+
+/* Upper limit on the number of objects and sessions tracked at once. */
+#define TCTI_SWAP_MAX_ENTRIES 64
+/* Virtual handles for transient objects are allocated from this value. */
+#define TCTI_SWAP_VHANDLE_FIRST 0x80ff0000
+
+TSS2_RC InitSwapTcti (
+    TSS2_TCTI_CONTEXT *tctiContext, // OUT
+    size_t *contextSize,            // IN/OUT
+    const TCTI_SWAP_CONF *config    // IN
+    );
+/* Keep (or stop keeping) the object with virtual handle 'handle' loaded. */
+TSS2_RC TctiSwapPin (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    TPM_HANDLE handle,
+    int pinned
+    );
+TSS2_RC TctiSwapGetStats (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    TCTI_SWAP_STATS *stats
+    );
+/*
+ * Save every loaded object and session, leaving TPM memory free for another
+ * user of the downstream TCTI. They are loaded back on next use.
+ */
+TSS2_RC TctiSwapSaveAll (
+    TSS2_TCTI_CONTEXT *tctiContext
+    );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TCTI_SWAP_H */
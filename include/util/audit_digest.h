@@ -0,0 +1,116 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+#ifndef TSS2_AUDIT_DIGEST_H
+#define TSS2_AUDIT_DIGEST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sapi/tpm20.h>
+#include <util/common.h>
+
+/*
+ * Host side copy of a TPM audit digest. Each audited command extends the
+ * running digest the same way the TPM does:
+ *
+ *   digest = H(digest || cpHash || rpHash)
+ *
+ * with cpHash and rpHash computed from the SAPI's cpBuffer and rpBuffer.
+ * The TPM signed value (GetSessionAuditDigest / GetCommandAuditDigest) is
+ * then only needed when a caller wants attestation, and can be checked
+ * against the local value with Tss2_AuditDigest_Verify.
+ *
+ * For each audited command call Tss2_AuditDigest_Command after the
+ * command's _Prepare (before it is executed) and Tss2_AuditDigest_Response
+ * after its _Complete.
+ */
+typedef enum {
+    /* session audit digests start as a digest of all zeros */
+    AUDIT_DIGEST_SESSION,
+    /* the command audit digest starts as the empty buffer */
+    AUDIT_DIGEST_COMMAND,
+} AUDIT_DIGEST_TYPE;
+
+typedef struct {
+    AUDIT_DIGEST_TYPE type;
+    TPMI_ALG_HASH alg;
+    TPM2B_DIGEST digest;
+    /* cpHash of the command in flight */
+    TPM2B_DIGEST cp_hash;
+    UINT8 command_code[4];
+    UINT8 pending;
+    UINT64 count;
+} AUDIT_DIGEST;
+
+TSS2_RC Tss2_AuditDigest_Init (
+    AUDIT_DIGEST      *audit,
+    AUDIT_DIGEST_TYPE  type,
+    TPMI_ALG_HASH      alg
+    );
+/*
+ * Compute the cpHash of the prepared command in 'sys_context'. 'names' are
+ * the Names of the entities in the command's handle area, in order (for
+ * PCRs, sessions and permanent handles the Name is the handle itself).
+ */
+TSS2_RC Tss2_AuditDigest_Command (
+    AUDIT_DIGEST     *audit,
+    TSS2_SYS_CONTEXT *sys_context,
+    const TPM2B_NAME *names,
+    size_t            name_count
+    );
+/*
+ * Compute the rpHash of the completed command and extend the digest. Only
+ * successful commands are audited: if the TPM returned an error the pending
+ * cpHash is discarded and Tss2_Sys_GetRpBuffer's TSS2_SYS_RC_BAD_SEQUENCE
+ * is returned, not the TPM's response code. Callers check the response
+ * code of the command itself first.
+ */
+TSS2_RC Tss2_AuditDigest_Response (
+    AUDIT_DIGEST     *audit,
+    TSS2_SYS_CONTEXT *sys_context
+    );
+TSS2_RC Tss2_AuditDigest_Get (
+    AUDIT_DIGEST *audit,
+    TPM2B_DIGEST *digest
+    );
+/*
+ * Compare the local digest with the one in a TPMS_ATTEST returned by
+ * GetSessionAuditDigest or GetCommandAuditDigest. The signature over
+ * 'audit_info' is not checked here. Returns TSS2_UTIL_RC_BAD_VALUE if the
+ * digests differ.
+ */
+TSS2_RC Tss2_AuditDigest_Verify (
+    AUDIT_DIGEST       *audit,
+    const TPM2B_ATTEST *audit_info
+    );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TSS2_AUDIT_DIGEST_H */
@@ -0,0 +1,50 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+
+#ifndef TSS2_UTIL_COMMON_H
+#define TSS2_UTIL_COMMON_H
+
+#include <sapi/tpm20.h>
+
+/*
+ * Response codes returned by the SAPI utility library. These use the
+ * "feature" error level so they can be told apart from the SAPI, TCTI and
+ * TPM errors that are passed through unchanged.
+ */
+#define TSS2_UTIL_ERROR(base_rc) \
+    ((TSS2_RC)(TSS2_FEATURE_ERROR_LEVEL | (base_rc)))
+
+#define TSS2_UTIL_RC_GENERAL_FAILURE     TSS2_UTIL_ERROR (TSS2_BASE_RC_GENERAL_FAILURE)
+#define TSS2_UTIL_RC_BAD_REFERENCE       TSS2_UTIL_ERROR (TSS2_BASE_RC_BAD_REFERENCE)
+#define TSS2_UTIL_RC_BAD_VALUE           TSS2_UTIL_ERROR (TSS2_BASE_RC_BAD_VALUE)
+#define TSS2_UTIL_RC_BAD_SEQUENCE        TSS2_UTIL_ERROR (TSS2_BASE_RC_BAD_SEQUENCE)
+#define TSS2_UTIL_RC_INSUFFICIENT_BUFFER TSS2_UTIL_ERROR (TSS2_BASE_RC_INSUFFICIENT_BUFFER)
+#define TSS2_UTIL_RC_TRY_AGAIN           TSS2_UTIL_ERROR (TSS2_BASE_RC_TRY_AGAIN)
+#define TSS2_UTIL_RC_IO_ERROR            TSS2_UTIL_ERROR (TSS2_BASE_RC_IO_ERROR)
+#define TSS2_UTIL_RC_NOT_SUPPORTED       TSS2_UTIL_ERROR (TSS2_BASE_RC_NOT_SUPPORTED)
+
+#endif /* TSS2_UTIL_COMMON_H */
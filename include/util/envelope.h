@@ -0,0 +1,188 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+#ifndef TSS2_ENVELOPE_H
+#define TSS2_ENVELOPE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sapi/tpm20.h>
+#include <util/common.h>
+
+/*
+ * Envelope encryption of bulk data. Instead of sealing every secret in its
+ * own TPM object (one Create per secret, one Load / Unseal per read and at
+ * most MAX_SYM_DATA bytes each) a single AES-256 data encryption key (DEK)
+ * is sealed in a keyedhash object under 'parent', and records of any size
+ * are encrypted on the host with AES-256-GCM.
+ *
+ * The DEK is unsealed (Load, Unseal, FlushContext) on first use and kept
+ * for 'ttl' seconds in a page locked with mlock(2) and excluded from core
+ * dumps. Tss2_Envelope_Init fails if the page can't be locked (see
+ * RLIMIT_MEMLOCK) unless the caller sets 'allow_unlocked'. It is wiped on Tss2_Envelope_Forget, on Tss2_Envelope_Finalize and
+ * once the TTL has run out. Expiry is lazy: there is no timer, the TTL is
+ * checked by Tss2_Envelope_Seal, Tss2_Envelope_Unseal and
+ * Tss2_Envelope_Expire. A process that may sit idle past the TTL should call
+ * Tss2_Envelope_Expire from its own timer. Reading ten thousand records
+ * costs one Unseal.
+ *
+ * OpenSSL keeps the expanded AES-256-GCM key schedule in ordinary heap
+ * memory, so every record keys the cipher context from the locked DEK and
+ * cleanses it again before returning. The schedule only exists for the
+ * duration of one Seal or Unseal.
+ *
+ * A sealed record is
+ *     version (1) | IV (12) | ciphertext | GCM tag (16)
+ * with a random IV per record, so a DEK shouldn't encrypt more than 2^32
+ * records. The version byte and the caller's 'aad' are authenticated too.
+ *
+ * An envelope context isn't thread safe.
+ */
+typedef struct _ENVELOPE ENVELOPE;
+
+#define ENVELOPE_VERSION     1
+#define ENVELOPE_KEY_SIZE    32
+#define ENVELOPE_IV_SIZE     12
+#define ENVELOPE_TAG_SIZE    16
+#define ENVELOPE_OVERHEAD    (1 + ENVELOPE_IV_SIZE + ENVELOPE_TAG_SIZE)
+#define ENVELOPE_DEFAULT_TTL 300
+
+typedef struct {
+    TSS2_SYS_CONTEXT *sys_context;
+    /* the storage key the DEK is sealed under */
+    TPMI_DH_OBJECT parent;
+    /* password of 'parent', NULL for an empty one */
+    const TPM2B_AUTH *parent_auth;
+    /* seconds the unsealed DEK is kept, ENVELOPE_DEFAULT_TTL when 0 */
+    UINT32 ttl;
+    /* keep going with a DEK page that may be swapped out if mlock fails */
+    int allow_unlocked;
+} ENVELOPE_CONF;
+
+typedef struct {
+    /* TPM Unseal operations */
+    UINT64 unseals;
+    UINT64 sealed;
+    UINT64 opened;
+    /* records that failed authentication */
+    UINT64 rejected;
+    /* DEKs wiped because the TTL ran out */
+    UINT64 expired;
+    /*
+     * 0 if mlock failed and 'allow_unlocked' was set, the DEK is still
+     * wiped but may be swapped out.
+     */
+    int locked;
+} ENVELOPE_STATS;
+
+/*
+ * Initialize an envelope context. When 'envelope' is NULL the size of the
+ * context is returned in 'size'. No DEK is set up yet, see
+ * Tss2_Envelope_CreateKey and Tss2_Envelope_SetKey.
+ */
+TSS2_RC Tss2_Envelope_Init (
+    ENVELOPE            *envelope,  // OUT
+    size_t              *size,      // IN/OUT
+    const ENVELOPE_CONF *config     // IN
+    );
+/*
+ * Generate a new DEK and seal it under the parent with TPM2_Create. The
+ * sealed object is protected by 'key_auth' (may be NULL). The blobs must be
+ * stored by the caller and handed to Tss2_Envelope_SetKey later, the new
+ * DEK is ready for use right away.
+ */
+TSS2_RC Tss2_Envelope_CreateKey (
+    ENVELOPE         *envelope,
+    const TPM2B_AUTH *key_auth,
+    TPM2B_PRIVATE    *out_private,
+    TPM2B_PUBLIC     *out_public
+    );
+/*
+ * Use the DEK sealed in 'in_private' / 'in_public'. Nothing is sent to the
+ * TPM until a record is sealed or opened.
+ */
+TSS2_RC Tss2_Envelope_SetKey (
+    ENVELOPE            *envelope,
+    const TPM2B_AUTH    *key_auth,
+    const TPM2B_PRIVATE *in_private,
+    const TPM2B_PUBLIC  *in_public
+    );
+/*
+ * Encrypt 'data' into 'record'. 'record_size' holds the size of the buffer
+ * and receives the size of the record, 'data_size' + ENVELOPE_OVERHEAD. If
+ * the buffer is too small TSS2_UTIL_RC_INSUFFICIENT_BUFFER is returned with
+ * the required size.
+ */
+TSS2_RC Tss2_Envelope_Seal (
+    ENVELOPE      *envelope,
+    const uint8_t *aad,
+    size_t         aad_size,
+    const uint8_t *data,
+    size_t         data_size,
+    uint8_t       *record,       // OUT
+    size_t        *record_size   // IN/OUT
+    );
+/*
+ * Decrypt and authenticate 'record'. Returns TSS2_UTIL_RC_BAD_VALUE if the
+ * record was modified, sealed with another DEK or with different 'aad'.
+ * 'data' is wiped whenever decryption fails, it never holds plaintext that
+ * wasn't authenticated.
+ */
+TSS2_RC Tss2_Envelope_Unseal (
+    ENVELOPE      *envelope,
+    const uint8_t *aad,
+    size_t         aad_size,
+    const uint8_t *record,
+    size_t         record_size,
+    uint8_t       *data,         // OUT
+    size_t        *data_size     // IN/OUT
+    );
+/* Wipe the unsealed DEK now, the next record unseals it again. */
+void Tss2_Envelope_Forget (
+    ENVELOPE *envelope
+    );
+/*
+ * Wipe the unsealed DEK if its TTL has run out. Returns 1 if no unsealed
+ * DEK is left, 0 if it is still within its TTL.
+ */
+int Tss2_Envelope_Expire (
+    ENVELOPE *envelope
+    );
+TSS2_RC Tss2_Envelope_GetStats (
+    ENVELOPE       *envelope,
+    ENVELOPE_STATS *stats
+    );
+void Tss2_Envelope_Finalize (
+    ENVELOPE *envelope
+    );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TSS2_ENVELOPE_H */
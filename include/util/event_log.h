@@ -0,0 +1,123 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+#ifndef TSS2_EVENT_LOG_H
+#define TSS2_EVENT_LOG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <sapi/tpm20.h>
+#include <util/common.h>
+#include <util/pcr.h>
+
+/*
+ * Parser for TCG PC Client measured boot event logs in the crypto agile
+ * format (TCG_PCR_EVENT2 records after a Spec ID Event03 header), as found
+ * in /sys/kernel/security/tpm0/binary_bios_measurements.
+ *
+ * The log is mapped read-only and parsed in place, events are handed out
+ * one at a time with their data pointing into the mapping, so nothing is
+ * copied or allocated per event. The digest sizes of all algorithms come
+ * from the header, events with algorithms this library doesn't know can be
+ * stepped over.
+ *
+ * Tss2_EventLog_Replay recomputes the PCR values from the log into a
+ * PCR_MATRIX (see util/pcr.h) which Tss2_Pcr_VerifyQuote compares with a
+ * quote.
+ */
+typedef struct _EVENT_LOG EVENT_LOG;
+
+#define EV_NO_ACTION 0x00000003
+/* the most algorithms accepted in the Spec ID header */
+#define EVENT_LOG_MAX_ALGORITHMS 16
+
+typedef struct {
+    /* file to map, if NULL the log is taken from 'buffer' */
+    const char *path;
+    /* a log in memory, must stay valid as long as the context */
+    const uint8_t *buffer;
+    size_t size;
+} EVENT_LOG_CONF;
+
+typedef struct {
+    UINT32 pcr;
+    UINT32 type;
+    /* digests of algorithms with more than sizeof (TPMU_HA) bytes are left out */
+    TPML_DIGEST_VALUES digests;
+    /* event data, points into the log */
+    const uint8_t *data;
+    UINT32 size;
+} EVENT_LOG_EVENT;
+
+/*
+ * Map the log and parse its header. When 'log' is NULL the size of the
+ * context is returned in 'size'. Returns TSS2_UTIL_RC_NOT_SUPPORTED for
+ * logs in the SHA1 only format.
+ */
+TSS2_RC Tss2_EventLog_Init (
+    EVENT_LOG            *log,     // OUT
+    size_t               *size,    // IN/OUT
+    const EVENT_LOG_CONF *config   // IN
+    );
+/*
+ * Hand out the next event. At the end of the log 'end' is set and 'event'
+ * left alone. Returns TSS2_UTIL_RC_BAD_VALUE for a malformed record, the
+ * log can't be read past it.
+ */
+TSS2_RC Tss2_EventLog_Next (
+    EVENT_LOG       *log,
+    EVENT_LOG_EVENT *event,        // OUT
+    int             *end           // OUT
+    );
+/* Go back to the first event. */
+TSS2_RC Tss2_EventLog_Rewind (
+    EVENT_LOG *log
+    );
+/*
+ * Replay the whole log into 'matrix', one bank for every algorithm of the
+ * header the software hash provider supports. PCRs start out the way they
+ * are after TPM2_Startup: zero, all ones for the DRTM PCRs 17 to 22 and the
+ * startup locality in PCR 0 if the log records one. Events of type
+ * EV_NO_ACTION are not extended. The iterator position isn't changed.
+ */
+TSS2_RC Tss2_EventLog_Replay (
+    EVENT_LOG  *log,
+    PCR_MATRIX *matrix             // OUT
+    );
+TSS2_RC Tss2_EventLog_Finalize (
+    EVENT_LOG *log
+    );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TSS2_EVENT_LOG_H */
@@ -0,0 +1,145 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+#ifndef TSS2_KEY_CACHE_H
+#define TSS2_KEY_CACHE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sapi/tpm20.h>
+#include <util/common.h>
+
+/*
+ * A cache of a key hierarchy. Keys are registered with their parent, by
+ * Name, together with their TPM2B_PRIVATE / TPM2B_PUBLIC blobs, starting
+ * from roots that are already in the TPM (a persistent key or a primary
+ * the application keeps loaded). Tss2_KeyCache_Load returns a handle for
+ * any registered key: a key that is still loaded costs no TPM command at
+ * all, otherwise its missing ancestors are loaded first, from the top.
+ *
+ * At most 'max_loaded' keys are kept loaded. When a slot is needed the
+ * least recently used key is saved with ContextSave and flushed; bringing
+ * it back is a single ContextLoad, no matter how deep it is, since its
+ * parent doesn't have to be loaded for that. Saved contexts don't survive a
+ * TPM Reset, a context the TPM refuses is dropped and the key is loaded
+ * from its blobs again.
+ *
+ * Only password authorizations are supported for the parents, they are
+ * copied when the key is registered.
+ */
+typedef struct _KEY_CACHE KEY_CACHE;
+
+/* a key and its parent must be loaded at the same time */
+#define KEY_CACHE_MIN_LOADED     2
+#define KEY_CACHE_DEFAULT_LOADED 3
+
+typedef struct {
+    TSS2_SYS_CONTEXT *sys_context;
+    /* the number of keys that can be registered, roots included */
+    size_t key_count;
+    /* transient slots the cache may use, KEY_CACHE_DEFAULT_LOADED when 0 */
+    size_t max_loaded;
+} KEY_CACHE_CONF;
+
+typedef struct {
+    /* Load found the key loaded */
+    UINT64 hits;
+    /* TPM2_Load from the blobs */
+    UINT64 loads;
+    /* keys brought back with ContextLoad */
+    UINT64 context_loads;
+    /* keys evicted with ContextSave */
+    UINT64 context_saves;
+    /* saved contexts the TPM refused */
+    UINT64 stale;
+    size_t loaded;
+} KEY_CACHE_STATS;
+
+/*
+ * When 'cache' is NULL the size required for a cache described by 'config'
+ * is returned in 'size'.
+ */
+TSS2_RC Tss2_KeyCache_Init (
+    KEY_CACHE            *cache,   // OUT
+    size_t               *size,    // IN/OUT
+    const KEY_CACHE_CONF *config   // IN
+    );
+/*
+ * Register a key that is loaded in the TPM and stays there, the cache
+ * never flushes it. Its Name is read with ReadPublic and returned in
+ * 'name'. 'auth' authorizes loading children under it, NULL for an empty
+ * password.
+ */
+TSS2_RC Tss2_KeyCache_AddRoot (
+    KEY_CACHE               *cache,
+    TPMI_DH_OBJECT           handle,
+    const TPMS_AUTH_COMMAND *auth,
+    TPM2B_NAME              *name     // OUT
+    );
+/*
+ * Register a key under the key named 'parent'. No TPM command is sent. Its
+ * Name is returned in 'name'. 'auth' is used when children are loaded
+ * under this key, NULL for an empty password.
+ */
+TSS2_RC Tss2_KeyCache_AddKey (
+    KEY_CACHE               *cache,
+    const TPM2B_NAME        *parent,
+    const TPM2B_PRIVATE     *in_private,
+    const TPM2B_PUBLIC      *in_public,
+    const TPMS_AUTH_COMMAND *auth,
+    TPM2B_NAME              *name     // OUT
+    );
+/*
+ * Make the key named 'name' available and return its handle. The handle
+ * stays valid until the next call on the cache. Returns
+ * TSS2_UTIL_RC_BAD_VALUE for a key that isn't registered.
+ */
+TSS2_RC Tss2_KeyCache_Load (
+    KEY_CACHE        *cache,
+    const TPM2B_NAME *name,
+    TPMI_DH_OBJECT   *handle          // OUT
+    );
+/* Forget a key and everything below it, flushing what's loaded. */
+TSS2_RC Tss2_KeyCache_Remove (
+    KEY_CACHE        *cache,
+    const TPM2B_NAME *name
+    );
+TSS2_RC Tss2_KeyCache_GetStats (
+    KEY_CACHE       *cache,
+    KEY_CACHE_STATS *stats
+    );
+/* Flush every key the cache loaded. Roots are left alone. */
+void Tss2_KeyCache_Finalize (
+    KEY_CACHE *cache
+    );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TSS2_KEY_CACHE_H */
@@ -0,0 +1,136 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+#ifndef TSS2_KEY_POOL_H
+#define TSS2_KEY_POOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sapi/tpm20.h>
+#include <util/common.h>
+
+/*
+ * A key pool creates keys for a set of registered templates ahead of time
+ * so handing one out costs a single Load instead of a Create (which for RSA
+ * keys means prime generation on the TPM).
+ *
+ * The library doesn't start threads. Background creation is driven by
+ * Tss2_KeyPool_Service, which the application calls from its idle path or
+ * event loop: it sends one Create at a time with the asynchronous SAPI
+ * functions (ExecuteAsync / ExecuteFinish) and collects the result on a
+ * later call. The pool's sys_context should therefore be dedicated to the
+ * pool, eg on its own connection to the resource manager.
+ */
+typedef struct _KEY_POOL KEY_POOL;
+
+#define KEY_POOL_MAX_DEPTH 16
+
+typedef struct {
+    TPMI_DH_OBJECT parent;
+    /*
+     * Authorization for the parent, used for both Create and Load. Only
+     * password authorizations can be replayed like this.
+     */
+    TSS2_SYS_CMD_AUTHS const *parent_auths;
+    TPM2B_SENSITIVE_CREATE sensitive;
+    TPM2B_PUBLIC template;
+    /* keys kept ready for this template, at most KEY_POOL_MAX_DEPTH */
+    size_t depth;
+} KEY_POOL_TEMPLATE;
+
+typedef struct {
+    /* used for background creation only */
+    TSS2_SYS_CONTEXT *sys_context;
+    const KEY_POOL_TEMPLATE *templates;
+    size_t template_count;
+    /* minimum time between two background Creates in ms, 0 for no limit */
+    UINT32 refill_interval;
+} KEY_POOL_CONF;
+
+typedef struct {
+    /* Acquire served from the pool */
+    UINT64 hits;
+    /* Acquire that had to Create the key itself */
+    UINT64 misses;
+    /* keys created in the background */
+    UINT64 created;
+    /* background Creates that failed */
+    UINT64 errors;
+    /* keys ready right now */
+    size_t available;
+} KEY_POOL_STATS;
+
+/*
+ * Initialize a pool. When 'pool' is NULL the size required for a pool
+ * described by 'config' is returned in 'size'. Templates are copied. No
+ * TPM commands are sent until Tss2_KeyPool_Service is called.
+ */
+TSS2_RC Tss2_KeyPool_Init (
+    KEY_POOL            *pool,   // OUT
+    size_t              *size,   // IN/OUT
+    const KEY_POOL_CONF *config  // IN
+    );
+/*
+ * Make progress on refilling the pool, waiting at most 'timeout' ms for an
+ * outstanding Create (TSS2_TCTI_TIMEOUT_BLOCK to wait until it's done).
+ * Returns TSS2_UTIL_RC_TRY_AGAIN while there's work left and
+ * TSS2_RC_SUCCESS once every template is filled to its depth.
+ */
+TSS2_RC Tss2_KeyPool_Service (
+    KEY_POOL *pool,
+    int32_t   timeout
+    );
+/*
+ * Load a key for template 'index' using 'sys_context'. A pre-created key is
+ * used when one is ready, otherwise the key is created on the spot. If
+ * 'sys_context' is the pool's own context an outstanding background Create
+ * is completed first. 'out_public' and 'name' may be NULL.
+ */
+TSS2_RC Tss2_KeyPool_Acquire (
+    KEY_POOL         *pool,
+    TSS2_SYS_CONTEXT *sys_context,
+    size_t            index,
+    TPM_HANDLE       *object_handle,
+    TPM2B_PUBLIC     *out_public,
+    TPM2B_NAME       *name
+    );
+TSS2_RC Tss2_KeyPool_GetStats (
+    KEY_POOL       *pool,
+    size_t          index,
+    KEY_POOL_STATS *stats
+    );
+/* Complete any outstanding Create and discard the pre-created keys. */
+void Tss2_KeyPool_Finalize (
+    KEY_POOL *pool
+    );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TSS2_KEY_POOL_H */
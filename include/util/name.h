@@ -0,0 +1,61 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+#ifndef TSS2_NAME_H
+#define TSS2_NAME_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sapi/tpm20.h>
+#include <util/common.h>
+
+/*
+ * Names of objects and NV indices computed on the host:
+ *
+ *   Name = nameAlg || H_nameAlg(public area)
+ *
+ * The public area is marshalled straight into the hash, so there is no
+ * limit on its size and no intermediate copy. Returns
+ * TSS2_UTIL_RC_BAD_VALUE for a nameAlg of TPM_ALG_NULL (the Name is then
+ * the handle) and TSS2_UTIL_RC_NOT_SUPPORTED for hash algorithms the
+ * library can't compute.
+ */
+TSS2_RC Tss2_Name_FromPublic (
+    const TPMT_PUBLIC *public_area,
+    TPM2B_NAME        *name
+    );
+TSS2_RC Tss2_Name_FromNvPublic (
+    const TPMS_NV_PUBLIC *nv_public,
+    TPM2B_NAME           *name
+    );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TSS2_NAME_H */
@@ -0,0 +1,127 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+#ifndef TSS2_NV_COUNTER_H
+#define TSS2_NV_COUNTER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sapi/tpm20.h>
+#include <util/common.h>
+
+/*
+ * A monotonic counter backed by a TPM NV counter index that doesn't cost an
+ * NV write per increment. Each NV_Increment takes a lease of 'lease'
+ * logical values: with the NV counter at C, values up to C * lease may be
+ * handed out, and only the logical increment that crosses that high-water
+ * mark increments the index again. The physical increment rate is the
+ * logical rate divided by 'lease'.
+ *
+ * The current lease (the NV counter value it belongs to and the last
+ * logical value handed out) is kept in a journal, a small file shared and
+ * flock(2)ed by all processes using the counter, or in the context if
+ * 'journal' is NULL. A journal is only resumed in the boot that wrote it,
+ * it isn't synced to disk. When the journal is missing, was written in an
+ * earlier boot or belongs to an older NV counter value, all values of the
+ * current lease are considered used and the next increment starts a new
+ * lease, so a restart costs at most 'lease' values.
+ *
+ * Replacing the journal with an older copy of itself in the same boot
+ * REPEATS values of the current lease, nothing can tell the copy from the
+ * original. The journal must be writable only by the users of the counter,
+ * put it on a tmpfs like /run.
+ */
+typedef struct _NV_COUNTER NV_COUNTER;
+
+#define NV_COUNTER_DEFAULT_LEASE 1024
+
+typedef struct {
+    TSS2_SYS_CONTEXT *sys_context;
+    /* an index with TPM_NT_COUNTER */
+    TPMI_RH_NV_INDEX nv_index;
+    /* the authorization handle for NV_Read / NV_Increment, 0 for nv_index */
+    TPMI_RH_NV_AUTH auth_handle;
+    /* password of 'auth_handle', NULL for an empty one */
+    const TPM2B_AUTH *auth;
+    /* logical values per NV_Increment, NV_COUNTER_DEFAULT_LEASE when 0 */
+    UINT64 lease;
+    /* journal file, NULL to keep the lease in this context only */
+    const char *journal;
+} NV_COUNTER_CONF;
+
+typedef struct {
+    /* logical increments and the values they handed out */
+    UINT64 increments;
+    UINT64 values;
+    /* TPM commands */
+    UINT64 nv_increments;
+    UINT64 nv_reads;
+    /* values given up with a lost lease */
+    UINT64 skipped;
+} NV_COUNTER_STATS;
+
+/*
+ * Initialize a counter, reading the NV counter with NV_Read and opening
+ * or creating the journal. When 'counter' is NULL the size of the context
+ * is returned in 'size'. Returns TSS2_UTIL_RC_BAD_VALUE if the journal
+ * belongs to another index or lease size.
+ */
+TSS2_RC Tss2_NvCounter_Init (
+    NV_COUNTER            *counter,  // OUT
+    size_t                *size,     // IN/OUT
+    const NV_COUNTER_CONF *config    // IN
+    );
+/*
+ * Advance the counter by 'count' and return the new value. The values
+ * from the old value + 1 up to 'value' belong to the caller. Returns
+ * TSS2_UTIL_RC_BAD_VALUE for a 'count' of 0.
+ */
+TSS2_RC Tss2_NvCounter_Increment (
+    NV_COUNTER *counter,
+    UINT64      count,
+    UINT64     *value    // OUT
+    );
+/* The last value handed out, without a TPM command. */
+TSS2_RC Tss2_NvCounter_Read (
+    NV_COUNTER *counter,
+    UINT64     *value    // OUT
+    );
+TSS2_RC Tss2_NvCounter_GetStats (
+    NV_COUNTER       *counter,
+    NV_COUNTER_STATS *stats
+    );
+/* Unmap and close the journal. The current lease stays usable for others. */
+void Tss2_NvCounter_Finalize (
+    NV_COUNTER *counter
+    );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TSS2_NV_COUNTER_H */
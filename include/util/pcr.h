@@ -0,0 +1,161 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+#ifndef TSS2_PCR_H
+#define TSS2_PCR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <sapi/tpm20.h>
+#include <util/common.h>
+
+/*
+ * Multi-bank PCR helpers. A PCR_Read response carries at most eight
+ * digests (TPML_DIGEST), so reading every PCR of several banks takes a
+ * number of calls. The selection is split into the fewest chunks that can
+ * be answered by one PCR_Read each (ceil(selected / 8)), the chunks are
+ * sent back to back and the answers are reassembled into a dense host side
+ * matrix indexed by bank and PCR number.
+ *
+ * The TPM increments its pcrUpdateCounter with every PCR change. If the
+ * counter moves between two chunks the matrix would mix values from before
+ * and after the change, the read is then started over.
+ */
+#define PCR_READ_MAX_DIGESTS 8
+/* the number of times a torn read is started over before giving up */
+#define PCR_READ_RETRIES     3
+
+typedef struct {
+    TPMI_ALG_HASH hash;
+    /* the PCRs present in 'digests', same layout as TPMS_PCR_SELECTION */
+    BYTE pcrSelect[PCR_SELECT_MAX];
+    TPM2B_DIGEST digests[IMPLEMENTATION_PCR];
+} PCR_BANK;
+
+typedef struct {
+    UINT32 update_counter;
+    UINT32 count;
+    PCR_BANK banks[HASH_COUNT];
+} PCR_MATRIX;
+
+/*
+ * Split 'selection' into chunks of at most PCR_READ_MAX_DIGESTS PCRs, each
+ * a valid pcrSelectionIn for PCR_Read. The bank order of 'selection' is
+ * kept. When 'chunks' is NULL the number of chunks is returned in 'count',
+ * otherwise 'count' holds the capacity of 'chunks' on input and the number
+ * used on output.
+ */
+TSS2_RC Tss2_Pcr_Partition (
+    const TPML_PCR_SELECTION *selection,  // IN
+    TPML_PCR_SELECTION       *chunks,     // OUT
+    size_t                   *count       // IN/OUT
+    );
+/*
+ * Read all PCRs in 'selection' into 'matrix'. PCRs that aren't allocated
+ * in a bank are left out of the bank's pcrSelect. Returns
+ * TSS2_UTIL_RC_TRY_AGAIN if the PCRs kept changing during the read.
+ */
+TSS2_RC Tss2_Pcr_ReadAll (
+    TSS2_SYS_CONTEXT         *sys_context,
+    const TPML_PCR_SELECTION *selection,  // IN
+    PCR_MATRIX               *matrix      // OUT
+    );
+/* The value of PCR 'pcr' in bank 'hash', NULL if it wasn't read. */
+const TPM2B_DIGEST* Tss2_Pcr_MatrixGet (
+    const PCR_MATRIX *matrix,
+    TPMI_ALG_HASH     hash,
+    UINT32            pcr
+    );
+/*
+ * Extend 'event' into PCR 'pcr' of every bank in 'banks' that has the PCR
+ * allocated (Tss2_TpmInfo_GetPcrBanks gives the active banks). The event
+ * is hashed on the host once per bank and sent with a single PCR_Extend.
+ * The digests are returned in 'digests' if it isn't NULL.
+ */
+TSS2_RC Tss2_Pcr_Extend (
+    TSS2_SYS_CONTEXT         *sys_context,
+    TPMI_DH_PCR               pcr,
+    TSS2_SYS_CMD_AUTHS const *cmd_auths,
+    const TPML_PCR_SELECTION *banks,
+    const uint8_t            *event,
+    size_t                    event_size,
+    TPML_DIGEST_VALUES       *digests     // OUT, may be NULL
+    );
+/*
+ * Apply an extend to the host side copy of the PCRs, new = H(old || digest)
+ * for each bank of 'digests' the matrix holds 'pcr' for. Banks the matrix
+ * doesn't know are skipped.
+ */
+TSS2_RC Tss2_Pcr_MatrixExtend (
+    PCR_MATRIX               *matrix,
+    UINT32                    pcr,
+    const TPML_DIGEST_VALUES *digests
+    );
+/*
+ * The composite digest of the PCRs in 'selection', the way TPM2_Quote
+ * computes pcrDigest: 'hash' over the concatenated values, bank by bank in
+ * the order of 'selection', lowest PCR first. Every selected PCR must be in
+ * the matrix.
+ */
+TSS2_RC Tss2_Pcr_MatrixDigest (
+    const PCR_MATRIX         *matrix,
+    const TPML_PCR_SELECTION *selection,
+    TPMI_ALG_HASH             hash,
+    TPM2B_DIGEST             *digest      // OUT
+    );
+/*
+ * Non-zero if both selections have the same banks in the same order and
+ * select the same PCRs in each. sizeofSelect may differ.
+ */
+int Tss2_Pcr_SelectionEqual (
+    const TPML_PCR_SELECTION *a,
+    const TPML_PCR_SELECTION *b
+    );
+/*
+ * Compare the matrix with the TPMS_ATTEST returned by Quote. 'selection'
+ * is the PCR selection the quote must cover, the one passed to Quote: a
+ * quote over fewer PCRs would match its own pcrDigest whatever the other
+ * PCRs hold. 'hash' is the hash of the signing scheme, which the TPM used
+ * for pcrDigest. The signature over 'quoted' is not checked here. Returns
+ * TSS2_UTIL_RC_BAD_VALUE if the selections or the digests differ.
+ */
+TSS2_RC Tss2_Pcr_VerifyQuote (
+    const PCR_MATRIX         *matrix,
+    const TPML_PCR_SELECTION *selection,
+    const TPM2B_ATTEST       *quoted,
+    TPMI_ALG_HASH             hash
+    );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TSS2_PCR_H */
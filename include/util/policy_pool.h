@@ -0,0 +1,183 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+
+#ifndef TSS2_POLICY_POOL_H
+#define TSS2_POLICY_POOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sapi/tpm20.h>
+#include <util/common.h>
+
+/*
+ * A policy session pool keeps a fixed number of policy sessions alive
+ * between operations. Instead of StartAuthSession / Policy* / FlushContext
+ * for every authorization, an acquired session is reset with PolicyRestart
+ * and the cached assertion sequence is replayed. The StartAuthSession cost
+ * (including any salt decryption on the TPM) is paid once per slot.
+ *
+ * Idle sessions in excess of 'max_loaded' are kept in saved form
+ * (ContextSave) so they don't hold on to the TPM's session memory, and are
+ * swapped back in with ContextLoad when they're handed out again.
+ *
+ * Every session is started with a fresh random nonceCaller. For salted or
+ * bound sessions and for PolicyAuthValue the caller needs the nonces to
+ * derive the session key and compute command HMACs: they are available from
+ * Tss2_PolicyPool_GetNonces while the session is acquired. The pool doesn't
+ * see the responses to commands the session authorizes, so the caller has
+ * to hand the last nonceTPM back with Tss2_PolicyPool_SetNonceTpm before
+ * releasing the session, or the next holder computes HMACs with a stale one.
+ */
+typedef struct _POLICY_POOL POLICY_POOL;
+
+typedef enum {
+    POLICY_ASSERT_COMMAND_CODE,
+    POLICY_ASSERT_PCR,
+    POLICY_ASSERT_LOCALITY,
+    POLICY_ASSERT_AUTH_VALUE,
+    POLICY_ASSERT_PASSWORD,
+    POLICY_ASSERT_CALLBACK,
+} POLICY_ASSERT_TYPE;
+
+/*
+ * Callback used for assertions that aren't covered by one of the built in
+ * types above (PolicySigned, PolicyNV etc). It must send exactly the
+ * assertion(s) for 'session' and return the resulting response code.
+ */
+typedef TSS2_RC (*POLICY_ASSERT_CB) (
+    TSS2_SYS_CONTEXT *sys_context,
+    TPMI_SH_POLICY    session,
+    void             *data);
+
+typedef struct {
+    POLICY_ASSERT_TYPE type;
+    union {
+        TPM_CC command_code;
+        struct {
+            TPM2B_DIGEST digest;
+            TPML_PCR_SELECTION pcrs;
+        } pcr;
+        TPMA_LOCALITY locality;
+        struct {
+            POLICY_ASSERT_CB func;
+            void *data;
+        } callback;
+    } u;
+} POLICY_ASSERTION;
+
+typedef struct {
+    TSS2_SYS_CONTEXT *sys_context;
+    /* number of sessions kept by the pool, at most MAX_ACTIVE_SESSIONS */
+    size_t slot_count;
+    /* idle sessions left loaded, at most MAX_LOADED_SESSIONS */
+    size_t max_loaded;
+    /* StartAuthSession parameters, shared by all slots */
+    TPMI_DH_OBJECT tpm_key;
+    TPMI_DH_ENTITY bind;
+    TPM2B_ENCRYPTED_SECRET *encrypted_salt;
+    TPMT_SYM_DEF symmetric;
+    TPMI_ALG_HASH auth_hash;
+    /* assertions replayed after each PolicyRestart, must outlive the pool */
+    const POLICY_ASSERTION *assertions;
+    size_t assertion_count;
+} POLICY_POOL_CONF;
+
+typedef struct {
+    UINT64 acquired;
+    UINT64 started;
+    UINT64 restarted;
+    UINT64 saved;
+    UINT64 loaded;
+} POLICY_POOL_STATS;
+
+typedef struct {
+    /* StartAuthSession nonces, the session key is derived from these */
+    TPM2B_NONCE nonce_caller;
+    TPM2B_NONCE nonce_tpm_start;
+    /* most recent nonceTPM, for the HMAC of the next command */
+    TPM2B_NONCE nonce_tpm;
+} POLICY_POOL_NONCES;
+
+/* Flags for Tss2_PolicyPool_Release */
+#define POLICY_POOL_RELEASE_FLUSHED (1 << 0)
+
+/*
+ * Initialize a pool. When 'pool' is NULL the size required for a pool
+ * described by 'config' is returned in 'size'. No TPM commands are sent,
+ * sessions are started on demand by Tss2_PolicyPool_Acquire.
+ */
+TSS2_RC Tss2_PolicyPool_Init (
+    POLICY_POOL            *pool,   // OUT
+    size_t                 *size,   // IN/OUT
+    const POLICY_POOL_CONF *config  // IN
+    );
+/*
+ * Hand out a policy session with the assertion sequence already applied.
+ * Returns TSS2_UTIL_RC_TRY_AGAIN when every slot is in use.
+ */
+TSS2_RC Tss2_PolicyPool_Acquire (
+    POLICY_POOL    *pool,
+    TPMI_SH_POLICY *session
+    );
+/*
+ * Return a session to the pool. Callers must use the session with
+ * continueSession SET; if the TPM flushed it anyway pass
+ * POLICY_POOL_RELEASE_FLUSHED and the slot is started afresh next time.
+ */
+TSS2_RC Tss2_PolicyPool_Release (
+    POLICY_POOL    *pool,
+    TPMI_SH_POLICY  session,
+    UINT32          flags
+    );
+/* Nonces of an acquired session. */
+TSS2_RC Tss2_PolicyPool_GetNonces (
+    POLICY_POOL        *pool,
+    TPMI_SH_POLICY      session,
+    POLICY_POOL_NONCES *nonces
+    );
+/* Record the nonceTPM of the last response for an acquired session. */
+TSS2_RC Tss2_PolicyPool_SetNonceTpm (
+    POLICY_POOL       *pool,
+    TPMI_SH_POLICY     session,
+    const TPM2B_NONCE *nonce_tpm
+    );
+TSS2_RC Tss2_PolicyPool_GetStats (
+    POLICY_POOL       *pool,
+    POLICY_POOL_STATS *stats
+    );
+/* Flush every session owned by the pool, loaded or saved. */
+void Tss2_PolicyPool_Finalize (
+    POLICY_POOL *pool
+    );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TSS2_POLICY_POOL_H */
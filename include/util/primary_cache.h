@@ -0,0 +1,123 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+#ifndef TSS2_PRIMARY_CACHE_H
+#define TSS2_PRIMARY_CACHE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sapi/tpm20.h>
+#include <util/common.h>
+
+/*
+ * A primary key cache avoids regenerating the same primary key in every
+ * process. The first CreatePrimary for a template saves the resulting
+ * object with ContextSave into a store file shared by all processes, later
+ * requests for the same hierarchy and template get it back with a single
+ * ContextLoad. Entries are addressed by the hierarchy and the SHA256 of the
+ * marshalled TPM2B_PUBLIC template. Requests with a non-empty userAuth or
+ * sensitive data are never cached, they always run CreatePrimary, so nothing
+ * derived from those secrets is written to the store.
+ *
+ * A cache hit doesn't send the hierarchy authorization to the TPM:
+ * ContextLoad needs none. Anyone who can read the store file can load the
+ * cached primary keys, so its permissions (0600 when created) are what
+ * stands in for the hierarchy auth. Don't share a store between users that
+ * don't all know it.
+ *
+ * Saved object contexts don't survive a TPM Reset. When loading a cached
+ * context fails with TPM_RC_INTEGRITY or TPM_RC_HANDLE the key is created
+ * again and the entry replaced, so callers never see the difference. Other
+ * errors (e.g. TPM_RC_OBJECT_MEMORY) are returned and the entry is kept.
+ *
+ * The store file is mapped into memory and guarded with flock(2), it must
+ * be on a file system that supports both.
+ */
+typedef struct _PRIMARY_CACHE PRIMARY_CACHE;
+
+#define PRIMARY_CACHE_DEFAULT_ENTRIES 16
+
+typedef struct {
+    TSS2_SYS_CONTEXT *sys_context;
+    const char *path;
+    /*
+     * Entries in a newly created store file, 0 selects
+     * PRIMARY_CACHE_DEFAULT_ENTRIES. An existing store keeps its size.
+     */
+    size_t entry_count;
+} PRIMARY_CACHE_CONF;
+
+typedef struct {
+    UINT64 hits;
+    UINT64 misses;
+    /* cached contexts that failed to load, usually after a TPM Reset */
+    UINT64 stale;
+    /* requests with sensitive data, passed straight to CreatePrimary */
+    UINT64 uncacheable;
+} PRIMARY_CACHE_STATS;
+
+/*
+ * Initialize a cache, opening or creating the store file. When 'cache' is
+ * NULL the size of the context is returned in 'size'. Returns
+ * TSS2_UTIL_RC_BAD_VALUE if the file exists but isn't a store.
+ */
+TSS2_RC Tss2_PrimaryCache_Init (
+    PRIMARY_CACHE            *cache,  // OUT
+    size_t                   *size,   // IN/OUT
+    const PRIMARY_CACHE_CONF *config  // IN
+    );
+/*
+ * Drop-in for Tss2_Sys_CreatePrimary without the creation data. The key is
+ * loaded from the cache when possible, in which case 'cmd_auths' isn't used.
+ * 'out_public' and 'name' may be NULL.
+ * As with CreatePrimary the caller flushes 'object_handle' when done.
+ */
+TSS2_RC Tss2_PrimaryCache_CreatePrimary (
+    PRIMARY_CACHE            *cache,
+    TPMI_RH_HIERARCHY         hierarchy,
+    TSS2_SYS_CMD_AUTHS const *cmd_auths,
+    TPM2B_SENSITIVE_CREATE   *in_sensitive,
+    TPM2B_PUBLIC             *in_public,
+    TPM_HANDLE               *object_handle,
+    TPM2B_PUBLIC             *out_public,
+    TPM2B_NAME               *name
+    );
+TSS2_RC Tss2_PrimaryCache_GetStats (
+    PRIMARY_CACHE       *cache,
+    PRIMARY_CACHE_STATS *stats
+    );
+/* Unmap and close the store file. Loaded objects are left alone. */
+void Tss2_PrimaryCache_Finalize (
+    PRIMARY_CACHE *cache
+    );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TSS2_PRIMARY_CACHE_H */
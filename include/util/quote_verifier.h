@@ -0,0 +1,144 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+#ifndef TSS2_QUOTE_VERIFIER_H
+#define TSS2_QUOTE_VERIFIER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+#include <sapi/tpm20.h>
+#include <util/common.h>
+#include <util/pcr.h>
+
+/*
+ * Host side verification of TPM2_Quote results in batches, for servers
+ * checking quotes from many machines. For each quote the TPMS_ATTEST is
+ * checked through a zero-copy view (magic, type and the caller's nonce in
+ * extraData), the signature is verified against the AK public key and,
+ * if expected PCR values are given, the quote must cover the expected PCR
+ * selection and pcrDigest is compared with their composite digest.
+ *
+ * The AK must be a restricted signing key that can't leave its TPM (sign,
+ * restricted and fixedTPM set). Only those keys refuse to sign data that
+ * starts with TPM_GENERATED_VALUE, any other key could sign a forged
+ * TPMS_ATTEST.
+ *
+ * Items of a batch are spread over worker threads. AK public keys are
+ * converted to OpenSSL keys once and kept, by Name, in an LRU table
+ * shared by the workers, so a fleet quoting with a few thousand AKs pays
+ * the conversion only on the first quote of each.
+ *
+ * RSASSA and RSAPSS signatures with RSA keys and ECDSA signatures with
+ * NIST P-256 / P-384 keys are supported.
+ */
+typedef struct _QUOTE_VERIFIER QUOTE_VERIFIER;
+
+#define QUOTE_VERIFIER_DEFAULT_KEYS 64
+
+typedef struct {
+    /* worker threads besides the calling one, 0 verifies in the caller only */
+    unsigned int threads;
+    /* AK public keys kept, QUOTE_VERIFIER_DEFAULT_KEYS when 0 */
+    size_t key_count;
+} QUOTE_VERIFIER_CONF;
+
+typedef enum {
+    QUOTE_VERIFY_OK = 0,
+    /* not a well formed TPMS_ATTEST of type TPM_ST_ATTEST_QUOTE */
+    QUOTE_VERIFY_MALFORMED,
+    /*
+     * the AK public key isn't a restricted signing key or can't be used
+     * with the signature
+     */
+    QUOTE_VERIFY_BAD_KEY,
+    QUOTE_VERIFY_BAD_SIGNATURE,
+    /* extraData differs from 'qualifying_data' */
+    QUOTE_VERIFY_BAD_NONCE,
+    /* pcrSelect or pcrDigest differ from the expected PCRs */
+    QUOTE_VERIFY_BAD_PCRS,
+    /* missing parameters or a failure on the host */
+    QUOTE_VERIFY_ERROR,
+} QUOTE_VERIFY_RESULT;
+
+typedef struct {
+    const TPM2B_ATTEST   *quoted;
+    const TPMT_SIGNATURE *signature;
+    const TPM2B_PUBLIC   *ak_public;
+    /* the values the quoted PCRs must have, NULL to skip the check */
+    const PCR_MATRIX     *expected;
+    /*
+     * the PCRs the quote must cover, as passed to Quote. Required with
+     * 'expected': a quote over fewer PCRs would match its own pcrDigest.
+     */
+    const TPML_PCR_SELECTION *pcr_select;
+    /* the nonce passed to Quote, NULL to skip the check */
+    const TPM2B_DATA     *qualifying_data;
+    QUOTE_VERIFY_RESULT   result;    // OUT
+} QUOTE_VERIFY_ITEM;
+
+typedef struct {
+    UINT64 verified;
+    UINT64 rejected;
+    UINT64 key_hits;
+    UINT64 key_misses;
+} QUOTE_VERIFIER_STATS;
+
+/*
+ * When 'verifier' is NULL the size of the context is returned in 'size'.
+ */
+TSS2_RC Tss2_QuoteVerifier_Init (
+    QUOTE_VERIFIER            *verifier,  // OUT
+    size_t                    *size,      // IN/OUT
+    const QUOTE_VERIFIER_CONF *config     // IN
+    );
+/*
+ * Verify 'count' items, setting the result of each. Returns
+ * TSS2_RC_SUCCESS if all of them are QUOTE_VERIFY_OK and
+ * TSS2_UTIL_RC_BAD_VALUE otherwise. Several threads may verify batches on
+ * the same verifier.
+ */
+TSS2_RC Tss2_QuoteVerifier_Batch (
+    QUOTE_VERIFIER    *verifier,
+    QUOTE_VERIFY_ITEM *items,
+    size_t             count
+    );
+TSS2_RC Tss2_QuoteVerifier_GetStats (
+    QUOTE_VERIFIER       *verifier,
+    QUOTE_VERIFIER_STATS *stats
+    );
+TSS2_RC Tss2_QuoteVerifier_Finalize (
+    QUOTE_VERIFIER *verifier
+    );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TSS2_QUOTE_VERIFIER_H */
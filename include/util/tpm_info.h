@@ -0,0 +1,120 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+#ifndef TSS2_TPM_INFO_H
+#define TSS2_TPM_INFO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sapi/tpm20.h>
+#include <util/common.h>
+
+/*
+ * A snapshot of what a TPM supports: its fixed properties, algorithms,
+ * commands, ECC curves and allocated PCR banks. Everything is fetched once,
+ * following moreData across as many GetCapability calls as needed, and
+ * kept in sorted arrays so lookups are a binary search without any TPM
+ * round trip.
+ *
+ * The snapshot can be stored in a file so later processes skip the queries
+ * altogether. The file records the identity of the TPM it was taken from
+ * (manufacturer, vendor strings and firmware version); with 'verify' set
+ * that identity is checked with one GetCapability before the file is
+ * used, otherwise the file is trusted as is. A missing, unreadable or
+ * mismatching file is replaced with a fresh snapshot.
+ *
+ * Variable properties (TPM_PT_PERMANENT, lockout counters, ...) change at
+ * runtime and are not part of the snapshot.
+ */
+typedef struct _TPM_INFO TPM_INFO;
+
+typedef struct {
+    /* only needed when the snapshot has to be taken or verified */
+    TSS2_SYS_CONTEXT *sys_context;
+    /* file to load the snapshot from and store it to, may be NULL */
+    const char *path;
+    int verify;
+} TPM_INFO_CONF;
+
+/*
+ * Take or load the snapshot. When 'info' is NULL the size of the context is
+ * returned in 'size'.
+ */
+TSS2_RC Tss2_TpmInfo_Init (
+    TPM_INFO            *info,    // OUT
+    size_t              *size,    // IN/OUT
+    const TPM_INFO_CONF *config   // IN
+    );
+/* Store the snapshot in 'path', replacing the file atomically. */
+TSS2_RC Tss2_TpmInfo_Save (
+    TPM_INFO   *info,
+    const char *path
+    );
+/*
+ * Look up a fixed TPM property, TPM_PT_MAX_COMMAND_SIZE for instance.
+ * Returns TSS2_UTIL_RC_NOT_SUPPORTED if the TPM didn't report it.
+ */
+TSS2_RC Tss2_TpmInfo_GetProperty (
+    TPM_INFO *info,
+    TPM_PT    property,
+    UINT32   *value
+    );
+/*
+ * The attributes of an algorithm, TSS2_UTIL_RC_NOT_SUPPORTED if the TPM
+ * doesn't implement it. 'attributes' may be NULL.
+ */
+TSS2_RC Tss2_TpmInfo_GetAlgorithm (
+    TPM_INFO       *info,
+    TPM_ALG_ID      alg,
+    TPMA_ALGORITHM *attributes
+    );
+/*
+ * The attributes of a command, TSS2_UTIL_RC_NOT_SUPPORTED if the TPM
+ * doesn't implement it. 'attributes' may be NULL.
+ */
+TSS2_RC Tss2_TpmInfo_GetCommand (
+    TPM_INFO *info,
+    TPM_CC    command_code,
+    TPMA_CC  *attributes
+    );
+/* TSS2_UTIL_RC_NOT_SUPPORTED unless the TPM implements 'curve'. */
+TSS2_RC Tss2_TpmInfo_GetCurve (
+    TPM_INFO      *info,
+    TPM_ECC_CURVE  curve
+    );
+/* The PCR banks and the PCRs allocated in each. */
+TSS2_RC Tss2_TpmInfo_GetPcrBanks (
+    TPM_INFO           *info,
+    TPML_PCR_SELECTION *banks
+    );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TSS2_TPM_INFO_H */
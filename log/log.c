@@ -1,3 +1,7 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
 #include "log.h"
 
 /*
@@ -23,6 +27,10 @@ static const struct log_string {
     {
         ERROR,
         "ERROR",
+    },
+    {
+        OFF,
+        "OFF",
     }
 };
 /*
@@ -41,3 +49,122 @@ level_to_str (log_level level)
     }
     return "unknown";
 }
+
+log_level log_runtime_level = WARNING;
+
+void
+log_set_level (log_level level)
+{
+    __atomic_store_n (&log_runtime_level, level, __ATOMIC_RELAXED);
+}
+/*
+ * The ring is a bounded multi-producer queue: every slot carries a sequence
+ * number telling producers and the reader whose turn it is. A producer
+ * claims a slot by advancing 'head' with a compare and swap, fills it and
+ * then publishes it by bumping the slot's sequence number. No locks are
+ * taken, so logging from a signal handler or a thread that's holding some
+ * other lock can't deadlock.
+ *
+ * Slot i starts out with sequence i. The value stored is the sequence
+ * minus i so the zero initialized ring is ready to use without a
+ * (racy) initialization step.
+ */
+typedef struct {
+    size_t sequence;
+    log_record record;
+} log_slot;
+
+static struct {
+    size_t head;
+    size_t tail;
+    size_t dropped;
+    log_slot slots [LOG_RING_SIZE];
+} ring;
+
+#define RING_INDEX(pos) ((pos) & (LOG_RING_SIZE - 1))
+#define SLOT_SEQUENCE_LOAD(pos) \
+    (__atomic_load_n (&ring.slots [RING_INDEX (pos)].sequence, \
+                      __ATOMIC_ACQUIRE) + RING_INDEX (pos))
+#define SLOT_SEQUENCE_STORE(pos, seq) \
+    __atomic_store_n (&ring.slots [RING_INDEX (pos)].sequence, \
+                      (seq) - RING_INDEX (pos), \
+                      __ATOMIC_RELEASE)
+
+void
+log_write (log_level   level,
+           const char *module,
+           const char *file,
+           int         line,
+           const char *fmt,
+           ...)
+{
+    log_slot *slot;
+    size_t pos, seq;
+    va_list ap;
+    int size;
+
+    if (!log_enabled (level)) {
+        return;
+    }
+    pos = __atomic_load_n (&ring.head, __ATOMIC_RELAXED);
+    for (;;) {
+        seq = SLOT_SEQUENCE_LOAD (pos);
+        if (seq == pos) {
+            if (__atomic_compare_exchange_n (&ring.head, &pos, pos + 1, 0,
+                                             __ATOMIC_RELAXED,
+                                             __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if ((intptr_t)(seq - pos) < 0) {
+            __atomic_fetch_add (&ring.dropped, 1, __ATOMIC_RELAXED);
+            return;
+        } else {
+            pos = __atomic_load_n (&ring.head, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot = &ring.slots [RING_INDEX (pos)];
+    slot->record.level = level;
+    size = snprintf (slot->record.message,
+                     sizeof (slot->record.message),
+                     "%s:%s:%s:%d ",
+                     level_to_str (level),
+                     module,
+                     file,
+                     line);
+    if (size >= 0 && (size_t)size < sizeof (slot->record.message)) {
+        va_start (ap, fmt);
+        vsnprintf (&slot->record.message [size],
+                   sizeof (slot->record.message) - size,
+                   fmt,
+                   ap);
+        va_end (ap);
+    }
+    SLOT_SEQUENCE_STORE (pos, pos + 1);
+}
+
+size_t
+log_read (log_record *records,
+          size_t      count)
+{
+    size_t pos, seq, i;
+
+    for (i = 0; i < count; ++i) {
+        pos = __atomic_load_n (&ring.tail, __ATOMIC_RELAXED);
+        seq = SLOT_SEQUENCE_LOAD (pos);
+        if (seq != pos + 1) {
+            break;
+        }
+        records [i] = ring.slots [RING_INDEX (pos)].record;
+        __atomic_store_n (&ring.tail, pos + 1, __ATOMIC_RELAXED);
+        SLOT_SEQUENCE_STORE (pos, pos + LOG_RING_SIZE);
+    }
+
+    return i;
+}
+
+size_t
+log_dropped (void)
+{
+    return __atomic_load_n (&ring.dropped, __ATOMIC_RELAXED);
+}
@@ -1,14 +1,68 @@
 #ifndef LOG_H
 #define LOG_H
 
+#include <stdarg.h>
+#include <stddef.h>
+
+/*
+ * Numeric log levels usable in preprocessor conditionals. These match the
+ * log_level enumeration below and TSS2_MU_LOG_* in sapi/tss2_mu.h.
+ */
+#define LOG_LEVEL_DEBUG   0
+#define LOG_LEVEL_INFO    1
+#define LOG_LEVEL_WARNING 2
+#define LOG_LEVEL_ERROR   3
+#define LOG_LEVEL_OFF     4
+
 typedef enum {
-    DEBUG,
-    INFO,
-    WARNING,
-    ERROR,
-    OFF
+    DEBUG = LOG_LEVEL_DEBUG,
+    INFO = LOG_LEVEL_INFO,
+    WARNING = LOG_LEVEL_WARNING,
+    ERROR = LOG_LEVEL_ERROR,
+    OFF = LOG_LEVEL_OFF
 } log_level;
 
+/* size of a formatted message in the ring, longer ones are truncated */
+#define LOG_MESSAGE_SIZE 160
+/* number of messages the ring holds, must be a power of two */
+#define LOG_RING_SIZE    64
+
+typedef struct {
+    log_level level;
+    char message [LOG_MESSAGE_SIZE];
+} log_record;
+
 const char* level_to_str (log_level level);
 
+/*
+ * Runtime filter: messages below this level are dropped before they're
+ * formatted. Defaults to WARNING.
+ */
+extern log_level log_runtime_level;
+
+static inline int
+log_enabled (log_level level)
+{
+    return level >= __atomic_load_n (&log_runtime_level, __ATOMIC_RELAXED);
+}
+void log_set_level (log_level level);
+/*
+ * Format a message into the ring buffer. Safe to call from any number of
+ * threads concurrently without locking. When the ring is full the message
+ * is dropped and counted.
+ */
+void log_write (log_level   level,
+                const char *module,
+                const char *file,
+                int         line,
+                const char *fmt,
+                ...) __attribute__ ((format (printf, 5, 6)));
+/*
+ * Remove up to 'count' messages from the ring, oldest first. Only one
+ * reader may drain the ring at a time. Returns the number copied.
+ */
+size_t log_read (log_record *records, size_t count);
+/* number of messages dropped because the ring was full */
+size_t log_dropped (void);
+
 #endif /* LOG_H */
@@ -32,6 +32,7 @@
 #include "sapi/tss2_mu.h"
 #include "sapi/tpm20.h"
 #include "tss2_endian.h"
+#include "sink.h"
 #include "log.h"
 
 #define BASE_MARSHAL(type) \
@@ -48,11 +49,31 @@ Tss2_MU_##type##_Marshal ( \
         LOG (INFO, "offset non-NULL, initial value: %zu", *offset); \
         local_offset = *offset; \
     } \
+\
+    switch (sizeof (type)) { \
+        case 1: \
+            break; \
+        case 2: \
+            src = HOST_TO_BE_16(src); \
+            break; \
+        case 4: \
+            src = HOST_TO_BE_32(src); \
+            break; \
+        case 8: \
+            src = HOST_TO_BE_64(src); \
+            break; \
+\
+    } \
 \
     if (buffer == NULL && offset == NULL) { \
         LOG (WARNING, "buffer and offset parameter are NULL"); \
         return TSS2_TYPES_RC_BAD_REFERENCE; \
     } else if (buffer == NULL && offset != NULL) { \
+        if (mu_sink != NULL) { \
+            TSS2_RC rc = mu_sink_write (&src, sizeof (src)); \
+            if (rc != TSS2_RC_SUCCESS) \
+                return rc; \
+        } \
         *offset += sizeof (src); \
         LOG (INFO, "buffer NULL and offset non-NULL, updating offset to %zu", \
              *offset); \
@@ -76,20 +97,6 @@ Tss2_MU_##type##_Marshal ( \
          (uintptr_t)buffer, \
          local_offset); \
 \
-    switch (sizeof (type)) { \
-        case 1: \
-            break; \
-        case 2: \
-            src = HOST_TO_BE_16(src); \
-            break; \
-        case 4: \
-            src = HOST_TO_BE_32(src); \
-            break; \
-        case 8: \
-            src = HOST_TO_BE_64(src); \
-            break; \
-\
-    } \
     memcpy (&buffer [local_offset], &src, sizeof (src)); \
     if (offset != NULL) { \
         *offset = local_offset + sizeof (src); \
@@ -169,6 +176,21 @@ Tss2_MU_##type##_Unmarshal ( \
     return TSS2_RC_SUCCESS; \
 }
 
+#define BASE_SIZE(type) \
+TSS2_RC \
+Tss2_MU_##type##_Size ( \
+    type           src, \
+    size_t        *size) \
+{ \
+    if (size == NULL) { \
+        LOG (WARNING, "size param is NULL"); \
+        return TSS2_TYPES_RC_BAD_REFERENCE; \
+    } \
+\
+    *size = sizeof (src); \
+    return TSS2_RC_SUCCESS; \
+}
+
 /*
  * These macros expand to (un)marshal functions for each of the base types
  * the specification part 2, table 3: Definition of Base Types.
@@ -193,3 +215,18 @@ BASE_MARSHAL  (TPM_CC);
 BASE_UNMARSHAL(TPM_CC);
 BASE_MARSHAL  (TPM_ST);
 BASE_UNMARSHAL(TPM_ST);
+
+/*
+ * These macros expand to size-only functions for each of the base types. They
+ * compute the wire size without writing to, or allocating, any buffer.
+ */
+BASE_SIZE(INT8);
+BASE_SIZE(INT16);
+BASE_SIZE(INT32);
+BASE_SIZE(INT64);
+BASE_SIZE(UINT8);
+BASE_SIZE(UINT16);
+BASE_SIZE(UINT32);
+BASE_SIZE(UINT64);
+BASE_SIZE(TPM_CC);
+BASE_SIZE(TPM_ST);
@@ -0,0 +1,187 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+
+#ifndef MARSHAL_BYTESWAP_H
+#define MARSHAL_BYTESWAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "tss2_endian.h"
+
+/*
+ * x86 kernels use pshufb (SSSE3). When the compiler targets SSSE3 (-mssse3
+ * or a -march that implies it) they are called unconditionally. Otherwise
+ * they are compiled for SSSE3 through the target attribute and picked at
+ * run time from cpuid, so a stock x86_64 build gets them on any CPU that
+ * has them. NEON is part of the aarch64 baseline, 32 bit ARM builds need
+ * -mfpu=neon.
+ */
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#define BSWAP_SSSE3
+#define BSWAP_SSSE3_TARGET
+#define bswap_have_ssse3() 1
+#elif (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <tmmintrin.h>
+#define BSWAP_SSSE3
+#define BSWAP_SSSE3_TARGET __attribute__((target("ssse3")))
+#define bswap_have_ssse3() __builtin_cpu_supports("ssse3")
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/*
+ * Copy count 16 / 32 bit words from src to dst, reversing the byte order of
+ * each one when the host is little endian. The same operation converts an
+ * array of host values to its big-endian wire form and back, so it serves
+ * both the marshal and unmarshal side of the homogeneous TPML types. src
+ * and dst may be unaligned but must not overlap.
+ *
+ * 16 bytes are swapped per instruction with SSSE3 or NEON, the tail and
+ * CPUs without either use a scalar loop.
+ */
+#if defined(WORDS_BIGENDIAN) || \
+    (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+
+static inline void bswap_copy_16(void *dst, const void *src, size_t count)
+{
+    memcpy(dst, src, count * sizeof(uint16_t));
+}
+
+static inline void bswap_copy_32(void *dst, const void *src, size_t count)
+{
+    memcpy(dst, src, count * sizeof(uint32_t));
+}
+
+#else
+
+/*
+ * The vector kernels swap as many whole 16 byte blocks as there are and
+ * return the number of words done.
+ */
+#if defined(BSWAP_SSSE3)
+
+static inline BSWAP_SSSE3_TARGET size_t
+bswap_vec_16(uint8_t *d, const uint8_t *s, size_t count)
+{
+    const __m128i mask = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6,
+                                       9, 8, 11, 10, 13, 12, 15, 14);
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(s + i * 2));
+        _mm_storeu_si128((__m128i *)(d + i * 2), _mm_shuffle_epi8(x, mask));
+    }
+    return i;
+}
+
+static inline BSWAP_SSSE3_TARGET size_t
+bswap_vec_32(uint8_t *d, const uint8_t *s, size_t count)
+{
+    const __m128i mask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4,
+                                       11, 10, 9, 8, 15, 14, 13, 12);
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(s + i * 4));
+        _mm_storeu_si128((__m128i *)(d + i * 4), _mm_shuffle_epi8(x, mask));
+    }
+    return i;
+}
+
+#define bswap_vec_ok() bswap_have_ssse3()
+
+#elif defined(__ARM_NEON)
+
+static inline size_t bswap_vec_16(uint8_t *d, const uint8_t *s, size_t count)
+{
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        vst1q_u8(d + i * 2, vrev16q_u8(vld1q_u8(s + i * 2)));
+    }
+    return i;
+}
+
+static inline size_t bswap_vec_32(uint8_t *d, const uint8_t *s, size_t count)
+{
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        vst1q_u8(d + i * 4, vrev32q_u8(vld1q_u8(s + i * 4)));
+    }
+    return i;
+}
+
+#define bswap_vec_ok() 1
+
+#else
+
+#define bswap_vec_16(d, s, count) ((size_t)0)
+#define bswap_vec_32(d, s, count) ((size_t)0)
+#define bswap_vec_ok() 0
+
+#endif
+
+static inline void bswap_copy_16(void *dst, const void *src, size_t count)
+{
+    uint8_t *d = dst;
+    const uint8_t *s = src;
+    size_t i = 0;
+    uint16_t v;
+
+    if (count >= 8 && bswap_vec_ok()) {
+        i = bswap_vec_16(d, s, count);
+    }
+    for (; i < count; i++) {
+        memcpy(&v, s + i * 2, sizeof(v));
+        v = HOST_TO_BE_16(v);
+        memcpy(d + i * 2, &v, sizeof(v));
+    }
+}
+
+static inline void bswap_copy_32(void *dst, const void *src, size_t count)
+{
+    uint8_t *d = dst;
+    const uint8_t *s = src;
+    size_t i = 0;
+    uint32_t v;
+
+    if (count >= 4 && bswap_vec_ok()) {
+        i = bswap_vec_32(d, s, count);
+    }
+    for (; i < count; i++) {
+        memcpy(&v, s + i * 4, sizeof(v));
+        v = HOST_TO_BE_32(v);
+        memcpy(d + i * 4, &v, sizeof(v));
+    }
+}
+
+#endif /* big endian */
+#endif /* MARSHAL_BYTESWAP_H */
@@ -0,0 +1,101 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+
+#ifndef MARSHAL_FIXED_LAYOUT_H
+#define MARSHAL_FIXED_LAYOUT_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "sapi/tpm20.h"
+#include "tss2_endian.h"
+
+/*
+ * Unchecked big-endian stores for the fixed layout marshal fast path. Each
+ * one writes value at ptr and returns the address of the next byte. There
+ * is no bounds checking: the caller checks once that the whole structure
+ * fits before the first store.
+ */
+static inline uint8_t *put_be8(uint8_t *ptr, UINT8 value)
+{
+    *ptr = value;
+    return ptr + sizeof(value);
+}
+
+static inline uint8_t *put_be16(uint8_t *ptr, UINT16 value)
+{
+    value = HOST_TO_BE_16(value);
+    memcpy(ptr, &value, sizeof(value));
+    return ptr + sizeof(value);
+}
+
+static inline uint8_t *put_be32(uint8_t *ptr, UINT32 value)
+{
+    value = HOST_TO_BE_32(value);
+    memcpy(ptr, &value, sizeof(value));
+    return ptr + sizeof(value);
+}
+
+static inline uint8_t *put_be64(uint8_t *ptr, UINT64 value)
+{
+    value = HOST_TO_BE_64(value);
+    memcpy(ptr, &value, sizeof(value));
+    return ptr + sizeof(value);
+}
+
+/*
+ * Unchecked big-endian loads, the counterpart of the stores above. Each one
+ * reads *value from ptr and returns the address of the next byte.
+ */
+static inline const uint8_t *get_be8(const uint8_t *ptr, UINT8 *value)
+{
+    *value = *ptr;
+    return ptr + sizeof(*value);
+}
+
+static inline const uint8_t *get_be16(const uint8_t *ptr, UINT16 *value)
+{
+    memcpy(value, ptr, sizeof(*value));
+    *value = BE_TO_HOST_16(*value);
+    return ptr + sizeof(*value);
+}
+
+static inline const uint8_t *get_be32(const uint8_t *ptr, UINT32 *value)
+{
+    memcpy(value, ptr, sizeof(*value));
+    *value = BE_TO_HOST_32(*value);
+    return ptr + sizeof(*value);
+}
+
+static inline const uint8_t *get_be64(const uint8_t *ptr, UINT64 *value)
+{
+    memcpy(value, ptr, sizeof(*value));
+    *value = BE_TO_HOST_64(*value);
+    return ptr + sizeof(*value);
+}
+
+#endif /* MARSHAL_FIXED_LAYOUT_H */
@@ -1,34 +1,70 @@
 #ifndef TSS2T_LOG_H
+#define TSS2T_LOG_H
 
 #include "log/log.h"
 
-#include <stdio.h>
-
+/*
+ * Messages below MARSHAL_LOG_LEVEL are compiled out of the marshal module
+ * entirely, leaving no branch or argument setup on the (un)marshal paths.
+ * Set it with ./configure --with-marshal-log-level.
+ */
 #ifndef MARSHAL_LOG_LEVEL
-#define MARSHAL_LOG_LEVEL WARNING
+#define MARSHAL_LOG_LEVEL LOG_LEVEL_WARNING
 #endif
 
 /*
  * This is a logging macro specific to the marshal module. The only thing
- * that makes it unique to this module though is the 'marshal' prefix. The
- * format for these messages is:
- * module:level:file:line:message
+ * that makes it unique to this module though is the 'marshal' prefix.
+ * Messages that are compiled in are filtered against the runtime level and
+ * then written to the log ring buffer (see log/log.c). The format for these
+ * messages is:
+ * level:module:file:line message
  * where:
- * - module : the name of the code module where the message originates
  * - level  : a string name for the logging level, see log.c
+ * - module : the name of the code module where the message originates
  * - file   : the name of the file where the message comes from
  * - line   : the line number where the LOG macro is invoked
  * - message: a textual message describing the event being logged
- * NOTE: this macro appends a newline to the message
  */
-#define LOG(level, fmt, ...) \
-    if (level >= MARSHAL_LOG_LEVEL) do { \
-        fprintf (stderr, \
-                 "%s:marshal:%s:%d " fmt "\n", \
-                 level_to_str (level), \
-                 __FILE__, \
-                 __LINE__, \
-                 ##__VA_ARGS__); \
+#define LOG(level, fmt, ...) LOG_##level (fmt, ##__VA_ARGS__)
+
+#define LOG_WRITE(level, fmt, ...) \
+    do { \
+        if (log_enabled (level)) \
+            log_write (level, "marshal", __FILE__, __LINE__, fmt, \
+                       ##__VA_ARGS__); \
+    } while (0)
+/*
+ * Compiled out messages still go through 'if (0)' so the arguments are
+ * type checked and don't trigger unused variable warnings, but no code is
+ * generated for them.
+ */
+#define LOG_ELIDE(level, fmt, ...) \
+    do { \
+        if (0) \
+            log_write (level, "marshal", __FILE__, __LINE__, fmt, \
+                       ##__VA_ARGS__); \
     } while (0)
 
+#if MARSHAL_LOG_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(fmt, ...) LOG_WRITE (DEBUG, fmt, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(fmt, ...) LOG_ELIDE (DEBUG, fmt, ##__VA_ARGS__)
+#endif
+#if MARSHAL_LOG_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(fmt, ...) LOG_WRITE (INFO, fmt, ##__VA_ARGS__)
+#else
+#define LOG_INFO(fmt, ...) LOG_ELIDE (INFO, fmt, ##__VA_ARGS__)
+#endif
+#if MARSHAL_LOG_LEVEL <= LOG_LEVEL_WARNING
+#define LOG_WARNING(fmt, ...) LOG_WRITE (WARNING, fmt, ##__VA_ARGS__)
+#else
+#define LOG_WARNING(fmt, ...) LOG_ELIDE (WARNING, fmt, ##__VA_ARGS__)
+#endif
+#if MARSHAL_LOG_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(fmt, ...) LOG_WRITE (ERROR, fmt, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(fmt, ...) LOG_ELIDE (ERROR, fmt, ##__VA_ARGS__)
+#endif
+
 #endif /* TSS2T_LOG_H */
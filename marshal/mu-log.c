@@ -0,0 +1,64 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+#include <string.h>
+
+#include "sapi/tss2_mu.h"
+#include "log.h"
+
+/* records are copied field by field, the message buffers must match */
+typedef char mu_log_message_size_check
+    [TSS2_MU_LOG_MESSAGE_SIZE == LOG_MESSAGE_SIZE ? 1 : -1];
+
+void
+Tss2_MU_SetLogLevel (
+    int level)
+{
+    if (level < TSS2_MU_LOG_DEBUG || level > TSS2_MU_LOG_OFF) {
+        return;
+    }
+    log_set_level ((log_level)level);
+}
+
+size_t
+Tss2_MU_ReadLog (
+    TSS2_MU_LOG_RECORD *records,
+    size_t              count)
+{
+    log_record record;
+    size_t i;
+
+    if (records == NULL) {
+        return 0;
+    }
+    for (i = 0; i < count && log_read (&record, 1) == 1; ++i) {
+        records [i].level = record.level;
+        memcpy (records [i].message, record.message,
+                sizeof (records [i].message));
+    }
+
+    return i;
+}
@@ -0,0 +1,99 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+
+#include <string.h>
+
+#include "sapi/tss2_mu.h"
+#include "sink.h"
+#include "log.h"
+
+__thread MU_SINK_STATE *mu_sink;
+
+/* called through a volatile pointer so the wipe isn't optimized away */
+static void *(*const volatile mu_sink_memset)(void *, int, size_t) = memset;
+
+/*
+ * The sink callback runs with mu_sink cleared, so that it can use the
+ * marshal functions (including their size mode) itself.
+ */
+TSS2_RC mu_sink_emit(MU_SINK_STATE *state, void const *bytes, size_t size)
+{
+    MU_SINK_STATE *saved = mu_sink;
+    TSS2_RC rc;
+
+    mu_sink = NULL;
+    rc = state->sink->write(state->sink->data, bytes, size);
+    mu_sink = saved;
+    return rc;
+}
+
+TSS2_RC mu_sink_flush(MU_SINK_STATE *state)
+{
+    TSS2_RC rc;
+
+    if (state->used == 0) {
+        return TSS2_RC_SUCCESS;
+    }
+    rc = mu_sink_emit(state, state->staging, state->used);
+    state->used = 0;
+    return rc;
+}
+
+TSS2_RC
+Tss2_MU_MarshalSink (
+    TSS2_MU_MARSHAL_FCN marshal,
+    void const         *src,
+    TSS2_MU_SINK const *sink,
+    size_t             *size)
+{
+    MU_SINK_STATE state, *saved;
+    size_t offset = 0;
+    TSS2_RC rc;
+
+    if (marshal == NULL || src == NULL || sink == NULL || sink->write == NULL) {
+        LOG (WARNING, "marshal, src or sink parameter is NULL");
+        return TSS2_TYPES_RC_BAD_REFERENCE;
+    }
+
+    state.sink = sink;
+    state.used = 0;
+    /* a sink callback may itself marshal into another sink */
+    saved = mu_sink;
+    mu_sink = &state;
+    rc = marshal(src, NULL, 0, &offset);
+    if (rc == TSS2_RC_SUCCESS) {
+        rc = mu_sink_flush(&state);
+    }
+    mu_sink = saved;
+    /* small TPM2B payloads, sensitive ones included, passed through here */
+    mu_sink_memset(state.staging, 0, sizeof(state.staging));
+
+    if (rc == TSS2_RC_SUCCESS && size != NULL) {
+        *size = offset;
+    }
+    return rc;
+}
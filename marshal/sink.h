@@ -0,0 +1,111 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+
+#ifndef MARSHAL_SINK_H
+#define MARSHAL_SINK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "sapi/tss2_mu.h"
+
+/*
+ * Output sink support for Tss2_MU_MarshalSink. While it runs, mu_sink
+ * points to the state of the current sink and the marshal functions are
+ * called with a NULL buffer (size mode). The functions that produce bytes
+ * (base types, TPMA, TPM2B, the fixed layout and array fast paths) then
+ * hand them to the sink in addition to advancing the offset. Composite
+ * types only call their members and need no change.
+ *
+ * Small writes are collected in the staging buffer and passed on when it is
+ * full, writes of at least MU_SINK_STAGING_SIZE bytes (TPM2B payloads) go to
+ * the sink directly. Tss2_MU_MarshalSink zeroes the staging buffer before it
+ * returns, smaller TPM2B payloads may hold secrets.
+ */
+#define MU_SINK_STAGING_SIZE 256
+
+typedef struct {
+    TSS2_MU_SINK const *sink;
+    size_t used;
+    uint8_t staging[MU_SINK_STAGING_SIZE];
+} MU_SINK_STATE;
+
+extern __thread MU_SINK_STATE *mu_sink;
+
+TSS2_RC mu_sink_emit(MU_SINK_STATE *state, void const *bytes, size_t size);
+TSS2_RC mu_sink_flush(MU_SINK_STATE *state);
+
+/*
+ * Return in *ptr size bytes of staging space for the caller to fill. size
+ * must not exceed MU_SINK_STAGING_SIZE.
+ */
+static inline TSS2_RC mu_sink_reserve(size_t size, uint8_t **ptr)
+{
+    TSS2_RC rc;
+
+    if (MU_SINK_STAGING_SIZE - mu_sink->used < size) {
+        rc = mu_sink_flush(mu_sink);
+        if (rc != TSS2_RC_SUCCESS)
+            return rc;
+    }
+    *ptr = &mu_sink->staging[mu_sink->used];
+    mu_sink->used += size;
+    return TSS2_RC_SUCCESS;
+}
+
+static inline TSS2_RC mu_sink_write(void const *bytes, size_t size)
+{
+    uint8_t *ptr;
+    TSS2_RC rc;
+
+    if (size >= MU_SINK_STAGING_SIZE) {
+        rc = mu_sink_flush(mu_sink);
+        if (rc != TSS2_RC_SUCCESS)
+            return rc;
+        return mu_sink_emit(mu_sink, bytes, size);
+    }
+    rc = mu_sink_reserve(size, &ptr);
+    if (rc == TSS2_RC_SUCCESS)
+        memcpy(ptr, bytes, size);
+    return rc;
+}
+
+/*
+ * Run fn with the sink disabled, so that it only computes a size. Used by
+ * TPM2B types that wrap a structure: the size prefix is written before the
+ * structure, so it has to be known first.
+ */
+#define MU_SINK_SUSPEND(fn) \
+    do { \
+        MU_SINK_STATE *mu_sink_saved = mu_sink; \
+        mu_sink = NULL; \
+        fn; \
+        mu_sink = mu_sink_saved; \
+    } while (0)
+
+#endif /* MARSHAL_SINK_H */
@@ -0,0 +1,156 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+
+#include <string.h>
+
+#include "sapi/tss2_mu.h"
+#include "log.h"
+
+TSS2_RC
+Tss2_MU_StreamInit (
+    TSS2_MU_STREAM *stream,
+    TSS2_MU_STREAM_STEP const *steps,
+    size_t          step_count,
+    uint8_t        *staging,
+    size_t          staging_size)
+{
+    if (stream == NULL || (steps == NULL && step_count > 0) ||
+        (staging == NULL && staging_size > 0)) {
+        LOG (WARNING, "stream, steps or staging parameter is NULL");
+        return TSS2_TYPES_RC_BAD_REFERENCE;
+    }
+
+    memset (stream, 0, sizeof (*stream));
+    stream->steps = steps;
+    stream->step_count = step_count;
+    stream->staging = staging;
+    stream->staging_size = staging_size;
+    return TSS2_RC_SUCCESS;
+}
+
+/*
+ * Try to decode the current step from the staged bytes plus the start of
+ * data. The number of bytes of data that were consumed, into the field or
+ * into the staging buffer, is returned in *taken, 0 on errors. On success
+ * the staging buffer is emptied.
+ */
+static TSS2_RC
+stream_feed_staged (
+    TSS2_MU_STREAM *stream,
+    uint8_t const   data[],
+    size_t          size,
+    size_t         *taken)
+{
+    TSS2_MU_STREAM_STEP const *step = &stream->steps [stream->step];
+    size_t count, offset = 0;
+    TSS2_RC rc;
+
+    *taken = 0;
+    count = stream->staging_size - stream->staged;
+    if (count > size) {
+        count = size;
+    }
+    memcpy (&stream->staging [stream->staged], data, count);
+
+    rc = step->unmarshal (stream->staging, stream->staged + count, &offset,
+                          step->dest);
+    if (rc == TSS2_TYPES_RC_INSUFFICIENT_BUFFER) {
+        if (stream->staged + count == stream->staging_size) {
+            LOG (WARNING, "step %zu doesn't fit in %zu bytes of staging",
+                 stream->step, stream->staging_size);
+            return TSS2_TYPES_RC_INSUFFICIENT_BUFFER;
+        }
+        stream->staged += count;
+        *taken = count;
+        return TSS2_TYPES_RC_TRY_AGAIN;
+    } else if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+
+    /* the staged bytes alone weren't enough, so offset > staged */
+    *taken = offset - stream->staged;
+    stream->staged = 0;
+    stream->consumed += offset;
+    stream->step++;
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+Tss2_MU_StreamFeed (
+    TSS2_MU_STREAM *stream,
+    uint8_t const   data[],
+    size_t          size,
+    size_t         *used)
+{
+    size_t pos = 0, taken = 0, offset;
+    TSS2_RC rc = TSS2_RC_SUCCESS;
+
+    if (stream == NULL || (data == NULL && size > 0)) {
+        LOG (WARNING, "stream or data parameter is NULL");
+        return TSS2_TYPES_RC_BAD_REFERENCE;
+    }
+
+    while (stream->step < stream->step_count) {
+        TSS2_MU_STREAM_STEP const *step = &stream->steps [stream->step];
+
+        if (stream->staged > 0) {
+            rc = stream_feed_staged (stream, &data [pos], size - pos, &taken);
+            pos += taken;
+            if (rc != TSS2_RC_SUCCESS) {
+                break;
+            }
+            continue;
+        }
+
+        /* nothing staged: decode straight from the chunk */
+        offset = 0;
+        rc = step->unmarshal (&data [pos], size - pos, &offset, step->dest);
+        if (rc == TSS2_RC_SUCCESS) {
+            pos += offset;
+            stream->consumed += offset;
+            stream->step++;
+            continue;
+        } else if (rc != TSS2_TYPES_RC_INSUFFICIENT_BUFFER) {
+            break;
+        }
+        if (size - pos > stream->staging_size) {
+            LOG (WARNING, "step %zu doesn't fit in %zu bytes of staging",
+                 stream->step, stream->staging_size);
+            break;
+        }
+        memcpy (stream->staging, &data [pos], size - pos);
+        stream->staged = size - pos;
+        pos = size;
+        rc = TSS2_TYPES_RC_TRY_AGAIN;
+        break;
+    }
+
+    if (used != NULL) {
+        *used = pos;
+    }
+    return rc;
+}
@@ -0,0 +1,197 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+
+#ifdef MARSHAL_TABLES
+
+#include <inttypes.h>
+#include <string.h>
+
+#include "sapi/tss2_mu.h"
+#include "fixed-layout.h"
+#include "table.h"
+#include "sink.h"
+#include "log.h"
+
+static uint32_t read_selector(const uint8_t *ptr, size_t size)
+{
+    uint8_t u8;
+    uint16_t u16;
+    uint32_t u32;
+
+    switch (size) {
+    case 1:
+        memcpy(&u8, ptr, sizeof(u8));
+        return u8;
+    case 2:
+        memcpy(&u16, ptr, sizeof(u16));
+        return u16;
+    default:
+        memcpy(&u32, ptr, sizeof(u32));
+        return u32;
+    }
+}
+
+static void put_scalar(uint8_t *dst, const uint8_t *src, size_t size)
+{
+    UINT8 u8;
+    UINT16 u16;
+    UINT32 u32;
+    UINT64 u64;
+
+    switch (size) {
+    case 1:
+        memcpy(&u8, src, sizeof(u8));
+        put_be8(dst, u8);
+        break;
+    case 2:
+        memcpy(&u16, src, sizeof(u16));
+        put_be16(dst, u16);
+        break;
+    case 4:
+        memcpy(&u32, src, sizeof(u32));
+        put_be32(dst, u32);
+        break;
+    case 8:
+        memcpy(&u64, src, sizeof(u64));
+        put_be64(dst, u64);
+        break;
+    }
+}
+
+TSS2_RC mu_table_marshal(const MU_FIELD *fields, size_t count,
+                         void const *src, uint8_t buffer[],
+                         size_t buffer_size, size_t *offset)
+{
+    const uint8_t *base = src;
+    size_t local_offset = 0;
+    size_t i;
+    TSS2_RC ret;
+
+    if (!src) {
+        LOG (WARNING, "src param is NULL");
+        return TSS2_TYPES_RC_BAD_REFERENCE;
+    }
+
+    if (offset) {
+        local_offset = *offset;
+    } else if (!buffer) {
+        return TSS2_TYPES_RC_BAD_REFERENCE;
+    }
+
+    for (i = 0; i < count; i++) {
+        const MU_FIELD *f = &fields[i];
+
+        switch (f->kind) {
+        case MU_FIELD_SCALAR:
+            if (buffer) {
+                if (buffer_size < local_offset ||
+                    buffer_size - local_offset < f->size) {
+                    LOG (WARNING, "buffer_size: %zu with offset: %zu are "
+                         "insufficient for object of size %zu", buffer_size,
+                         local_offset, (size_t)f->size);
+                    return TSS2_TYPES_RC_INSUFFICIENT_BUFFER;
+                }
+                put_scalar(&buffer[local_offset], base + f->offset, f->size);
+            } else if (mu_sink) {
+                uint8_t *ptr;
+
+                ret = mu_sink_reserve(f->size, &ptr);
+                if (ret != TSS2_RC_SUCCESS)
+                    return ret;
+                put_scalar(ptr, base + f->offset, f->size);
+            }
+            local_offset += f->size;
+            break;
+        case MU_FIELD_NESTED:
+            ret = ((MU_MARSHAL_FN)f->fn)(base + f->offset, buffer,
+                                         buffer_size, &local_offset);
+            if (ret != TSS2_RC_SUCCESS)
+                return ret;
+            break;
+        case MU_FIELD_UNION:
+            ret = ((MU_MARSHAL_SEL_FN)f->fn)(base + f->offset,
+                                             read_selector(base + f->sel_offset,
+                                                           f->sel_size),
+                                             buffer, buffer_size,
+                                             &local_offset);
+            if (ret != TSS2_RC_SUCCESS)
+                return ret;
+            break;
+        }
+    }
+
+    if (offset) {
+        *offset = local_offset;
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+/*
+ * Every member is unmarshalled by its own function, so NESTED and SCALAR
+ * entries are handled alike. A NULL dest skips over the structure; callers
+ * of tables holding a UNION entry pass a scratch structure instead so the
+ * selector can be read back.
+ */
+TSS2_RC mu_table_unmarshal(const MU_FIELD *fields, size_t count,
+                           uint8_t const buffer[], size_t buffer_size,
+                           size_t *offset, void *dest)
+{
+    uint8_t *base = dest;
+    size_t local_offset = 0;
+    size_t i;
+    TSS2_RC ret;
+
+    if (offset) {
+        local_offset = *offset;
+    } else if (!dest) {
+        return TSS2_TYPES_RC_BAD_REFERENCE;
+    }
+
+    for (i = 0; i < count; i++) {
+        const MU_FIELD *f = &fields[i];
+
+        if (f->kind == MU_FIELD_UNION) {
+            ret = ((MU_UNMARSHAL_SEL_FN)f->fn)(buffer, buffer_size,
+                                               &local_offset,
+                                               read_selector(base + f->sel_offset,
+                                                             f->sel_size),
+                                               base + f->offset);
+        } else {
+            ret = ((MU_UNMARSHAL_FN)f->fn)(buffer, buffer_size, &local_offset,
+                                           base ? base + f->offset : NULL);
+        }
+        if (ret != TSS2_RC_SUCCESS)
+            return ret;
+    }
+
+    if (offset) {
+        *offset = local_offset;
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+#endif /* MARSHAL_TABLES */
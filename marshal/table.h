@@ -0,0 +1,101 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+
+#ifndef MARSHAL_TABLE_H
+#define MARSHAL_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sapi/tpm20.h"
+
+/*
+ * Descriptor table engine, selected with
+ * ./configure --with-marshal-engine=table. Instead of one generated function
+ * body per structure, each structure is described by a const array of
+ * MU_FIELD entries and the public Tss2_MU_<TYPE>_(Un)marshal functions are
+ * thin shims that hand the table to mu_table_marshal / mu_table_unmarshal.
+ *
+ * Field kinds:
+ * - MU_FIELD_SCALAR: a base type or TPMA member passed by value. It is
+ *   encoded inline by the engine, size is its width in bytes.
+ * - MU_FIELD_NESTED: a member passed by address to fn, the (un)marshal
+ *   function of its type.
+ * - MU_FIELD_UNION: a TPMU member. fn additionally takes the value of the
+ *   selector member at sel_offset (sel_size bytes wide).
+ */
+typedef enum {
+    MU_FIELD_SCALAR,
+    MU_FIELD_NESTED,
+    MU_FIELD_UNION,
+} MU_FIELD_KIND;
+
+typedef TSS2_RC (*MU_MARSHAL_FN)(void const *src, uint8_t buffer[],
+                                 size_t buffer_size, size_t *offset);
+typedef TSS2_RC (*MU_MARSHAL_SEL_FN)(void const *src, uint32_t selector,
+                                     uint8_t buffer[], size_t buffer_size,
+                                     size_t *offset);
+typedef TSS2_RC (*MU_UNMARSHAL_FN)(uint8_t const buffer[], size_t buffer_size,
+                                   size_t *offset, void *dest);
+typedef TSS2_RC (*MU_UNMARSHAL_SEL_FN)(uint8_t const buffer[],
+                                       size_t buffer_size, size_t *offset,
+                                       uint32_t selector, void *dest);
+
+typedef struct {
+    uint16_t offset;
+    uint8_t  kind;
+    uint8_t  size;
+    uint16_t sel_offset;
+    uint8_t  sel_size;
+    void   (*fn)(void);
+} MU_FIELD;
+
+#define MU_MEMBER_SIZE(type, m) sizeof(((type *)0)->m)
+#define MU_FIELD_COUNT(fields) (sizeof(fields) / sizeof((fields)[0]))
+
+/*
+ * MU_FIELD_VAL / MU_FIELD_ADDR build a marshal table entry from the
+ * (member, VAL|ADDR, function) triples used by the TPMS_MARSHAL_* macros,
+ * so the same invocations expand to either engine.
+ */
+#define MU_FIELD_VAL(type, m, f) \
+    { offsetof(type, m), MU_FIELD_SCALAR, MU_MEMBER_SIZE(type, m), 0, 0, NULL }
+#define MU_FIELD_ADDR(type, m, f) \
+    { offsetof(type, m), MU_FIELD_NESTED, 0, 0, 0, (void (*)(void))f }
+#define MU_FIELD_UNMARSHAL(type, m, f) MU_FIELD_ADDR(type, m, f)
+#define MU_FIELD_SEL(type, m, sel, f) \
+    { offsetof(type, m), MU_FIELD_UNION, 0, offsetof(type, sel), \
+      MU_MEMBER_SIZE(type, sel), (void (*)(void))f }
+
+TSS2_RC mu_table_marshal(const MU_FIELD *fields, size_t count,
+                         void const *src, uint8_t buffer[],
+                         size_t buffer_size, size_t *offset);
+TSS2_RC mu_table_unmarshal(const MU_FIELD *fields, size_t count,
+                           uint8_t const buffer[], size_t buffer_size,
+                           size_t *offset, void *dest);
+
+#endif /* MARSHAL_TABLE_H */
@@ -32,6 +32,7 @@
 #include "sapi/tss2_mu.h"
 #include "sapi/tpm20.h"
 #include "tss2_endian.h"
+#include "sink.h"
 #include "log.h"
 
 #define TPM2B_MARSHAL(type) \
@@ -53,6 +54,15 @@ TSS2_RC Tss2_MU_##type##_Marshal(type const *src, uint8_t buffer[], \
         LOG (WARNING, "buffer and offset parameter are NULL"); \
         return TSS2_TYPES_RC_BAD_REFERENCE; \
     } else if (buffer == NULL && offset != NULL) { \
+        if (mu_sink != NULL) { \
+            UINT16 size = HOST_TO_BE_16(src->t.size); \
+            rc = mu_sink_write(&size, sizeof(size)); \
+            if (rc) \
+                return rc; \
+            rc = mu_sink_write(((TPM2B *)src)->buffer, src->t.size); \
+            if (rc) \
+                return rc; \
+        } \
         *offset += sizeof(src->t.size) + src->t.size; \
         LOG (INFO, "buffer NULL and offset non-NULL, updating offset to %zu", \
              *offset); \
@@ -140,6 +150,11 @@ TSS2_RC Tss2_MU_##type##_Unmarshal(uint8_t const buffer[], size_t buffer_size, \
              (size_t)size); \
         return TSS2_TYPES_RC_INSUFFICIENT_BUFFER; \
     } \
+    if (size > sizeof(type) - sizeof(size)) { \
+        LOG (WARNING, \
+             "size: %zu is larger than " #type " can hold", (size_t)size); \
+        return TSS2_SYS_RC_MALFORMED_RESPONSE; \
+    } \
     if (dest != NULL) { \
         dest->t.size = size; \
         memcpy(((TPM2B *)dest)->buffer, &buffer[local_offset], size); \
@@ -174,6 +189,20 @@ TSS2_RC Tss2_MU_##type##_Marshal(type const *src, uint8_t buffer[], \
     if (buffer == NULL && offset == NULL) { \
         LOG (WARNING, "buffer and offset parameter are NULL"); \
         return TSS2_TYPES_RC_BAD_REFERENCE; \
+    } else if (buffer == NULL && offset != NULL && mu_sink != NULL) { \
+        /* the sink gets the real size, as in the buffer case below */ \
+        size_t size = 0; \
+        UINT16 be_size; \
+\
+        MU_SINK_SUSPEND(rc = Tss2_MU_##subtype##_Size(&src->t.member, &size)); \
+        if (rc) \
+            return rc; \
+        be_size = HOST_TO_BE_16(size); \
+        rc = mu_sink_write(&be_size, sizeof(be_size)); \
+        if (rc) \
+            return rc; \
+        *offset += sizeof(be_size); \
+        return Tss2_MU_##subtype##_Marshal(&src->t.member, NULL, 0, offset); \
     } else if (buffer == NULL && offset != NULL) { \
         *offset += sizeof(src->t.size) + src->t.size; \
         LOG (INFO, "buffer NULL and offset non-NULL, updating offset to %zu", \
@@ -287,6 +316,42 @@ TSS2_RC Tss2_MU_##type##_Unmarshal(uint8_t const buffer[], size_t buffer_size, \
     return TSS2_RC_SUCCESS; \
 }
 
+#define TPM2B_SIZE(type) \
+TSS2_RC Tss2_MU_##type##_Size(type const *src, size_t *size) \
+{ \
+    if (src == NULL || size == NULL) { \
+        LOG (WARNING, "src or size param is NULL"); \
+        return TSS2_TYPES_RC_BAD_REFERENCE; \
+    } \
+\
+    *size = sizeof(src->t.size) + src->t.size; \
+    return TSS2_RC_SUCCESS; \
+}
+
+/*
+ * The size field of a TPM2B wrapping a structure is recomputed when it is
+ * marshalled, so the wire size comes from the inner structure and not from
+ * whatever the caller left in src->t.size.
+ */
+#define TPM2B_SIZE_SUBTYPE(type, subtype, member) \
+TSS2_RC Tss2_MU_##type##_Size(type const *src, size_t *size) \
+{ \
+    size_t local_size = 0; \
+    TSS2_RC rc; \
+\
+    if (src == NULL || size == NULL) { \
+        LOG (WARNING, "src or size param is NULL"); \
+        return TSS2_TYPES_RC_BAD_REFERENCE; \
+    } \
+\
+    rc = Tss2_MU_##subtype##_Size(&src->t.member, &local_size); \
+    if (rc) \
+        return rc; \
+\
+    *size = sizeof(src->t.size) + local_size; \
+    return TSS2_RC_SUCCESS; \
+}
+
 /*
  * These macros expand to (un)marshal functions for each of the TPMA types
  * the specification part 2.
@@ -351,3 +416,36 @@ TPM2B_MARSHAL_SUBTYPE(TPM2B_CREATION_DATA, TPMS_CREATION_DATA, creationData);
 TPM2B_UNMARSHAL_SUBTYPE(TPM2B_CREATION_DATA, TPMS_CREATION_DATA, creationData);
 TPM2B_MARSHAL_SUBTYPE(TPM2B_PUBLIC, TPMT_PUBLIC, publicArea);
 TPM2B_UNMARSHAL_SUBTYPE(TPM2B_PUBLIC, TPMT_PUBLIC, publicArea);
+
+/*
+ * These macros expand to size-only functions for each of the TPM2B types. They
+ * compute the wire size without writing to, or allocating, any buffer.
+ */
+TPM2B_SIZE(TPM2B_DIGEST);
+TPM2B_SIZE(TPM2B_ATTEST);
+TPM2B_SIZE(TPM2B_NAME);
+TPM2B_SIZE(TPM2B_MAX_NV_BUFFER);
+TPM2B_SIZE(TPM2B_SENSITIVE_DATA);
+TPM2B_SIZE(TPM2B_ECC_PARAMETER);
+TPM2B_SIZE(TPM2B_PUBLIC_KEY_RSA);
+TPM2B_SIZE(TPM2B_PRIVATE_KEY_RSA);
+TPM2B_SIZE(TPM2B_PRIVATE);
+TPM2B_SIZE(TPM2B_CONTEXT_SENSITIVE);
+TPM2B_SIZE(TPM2B_CONTEXT_DATA);
+TPM2B_SIZE(TPM2B_DATA);
+TPM2B_SIZE(TPM2B_SYM_KEY);
+TPM2B_SIZE_SUBTYPE(TPM2B_ECC_POINT, TPMS_ECC_POINT, point);
+TPM2B_SIZE_SUBTYPE(TPM2B_NV_PUBLIC, TPMS_NV_PUBLIC, nvPublic);
+TPM2B_SIZE_SUBTYPE(TPM2B_SENSITIVE, TPMT_SENSITIVE, sensitiveArea);
+TPM2B_SIZE_SUBTYPE(TPM2B_SENSITIVE_CREATE, TPMS_SENSITIVE_CREATE, sensitive);
+TPM2B_SIZE_SUBTYPE(TPM2B_CREATION_DATA, TPMS_CREATION_DATA, creationData);
+TPM2B_SIZE_SUBTYPE(TPM2B_PUBLIC, TPMT_PUBLIC, publicArea);
+TPM2B_SIZE(TPM2B_ENCRYPTED_SECRET);
+TPM2B_SIZE(TPM2B_ID_OBJECT);
+TPM2B_SIZE(TPM2B_IV);
+TPM2B_SIZE(TPM2B_AUTH);
+TPM2B_SIZE(TPM2B_EVENT);
+TPM2B_SIZE(TPM2B_MAX_BUFFER);
+TPM2B_SIZE(TPM2B_NONCE);
+TPM2B_SIZE(TPM2B_OPERAND);
+TPM2B_SIZE(TPM2B_TIMEOUT);
@@ -32,6 +32,7 @@
 #include "sapi/tss2_mu.h"
 #include "sapi/tpm20.h"
 #include "tss2_endian.h"
+#include "sink.h"
 #include "log.h"
 
 #define TPMA_MARSHAL(type) \
@@ -44,11 +45,31 @@ TSS2_RC Tss2_MU_##type##_Marshal(type src, uint8_t buffer[], \
         LOG (INFO, "offset non-NULL, initial value: %zu", *offset); \
         local_offset = *offset; \
     } \
+\
+    switch (sizeof(src.val)) { \
+        case 1: \
+            break; \
+        case 2: \
+            src.val = HOST_TO_BE_16(src.val); \
+            break; \
+        case 4: \
+            src.val = HOST_TO_BE_32(src.val); \
+            break; \
+        case 8: \
+            src.val = HOST_TO_BE_64(src.val); \
+            break; \
+\
+    } \
 \
     if (buffer == NULL && offset == NULL) { \
         LOG (WARNING, "buffer and offset parameter are NULL"); \
         return TSS2_TYPES_RC_BAD_REFERENCE; \
     } else if (buffer == NULL && offset != NULL) { \
+        if (mu_sink != NULL) { \
+            TSS2_RC rc = mu_sink_write (&src.val, sizeof (src.val)); \
+            if (rc != TSS2_RC_SUCCESS) \
+                return rc; \
+        } \
         *offset += sizeof (src); \
         LOG (INFO, "buffer NULL and offset non-NULL, updating offset to %zu", \
              *offset); \
@@ -72,20 +93,6 @@ TSS2_RC Tss2_MU_##type##_Marshal(type src, uint8_t buffer[], \
          (uintptr_t)buffer, \
          local_offset); \
 \
-    switch (sizeof(src.val)) { \
-        case 1: \
-            break; \
-        case 2: \
-            src.val = HOST_TO_BE_16(src.val); \
-            break; \
-        case 4: \
-            src.val = HOST_TO_BE_32(src.val); \
-            break; \
-        case 8: \
-            src.val = HOST_TO_BE_64(src.val); \
-            break; \
-\
-    } \
     memcpy (&buffer [local_offset], &src, sizeof(src.val)); \
     if (offset != NULL) { \
         *offset = local_offset + sizeof (src.val); \
@@ -160,6 +167,18 @@ TSS2_RC Tss2_MU_##type##_Unmarshal(uint8_t const buffer[], size_t buffer_size, \
     return TSS2_RC_SUCCESS; \
 }
 
+#define TPMA_SIZE(type) \
+TSS2_RC Tss2_MU_##type##_Size(type src, size_t *size) \
+{ \
+    if (size == NULL) { \
+        LOG (WARNING, "size param is NULL"); \
+        return TSS2_TYPES_RC_BAD_REFERENCE; \
+    } \
+\
+    *size = sizeof (src.val); \
+    return TSS2_RC_SUCCESS; \
+}
+
 /*
  * These macros expand to (un)marshal functions for each of the TPMA types
  * the specification part 2.
@@ -180,3 +199,16 @@ TPMA_MARSHAL  (TPMA_SESSION);
 TPMA_UNMARSHAL(TPMA_SESSION);
 TPMA_MARSHAL  (TPMA_STARTUP_CLEAR);
 TPMA_UNMARSHAL(TPMA_STARTUP_CLEAR);
+
+/*
+ * These macros expand to size-only functions for each of the TPMA types. They
+ * compute the wire size without writing to, or allocating, any buffer.
+ */
+TPMA_SIZE(TPMA_ALGORITHM);
+TPMA_SIZE(TPMA_CC);
+TPMA_SIZE(TPMA_LOCALITY);
+TPMA_SIZE(TPMA_NV);
+TPMA_SIZE(TPMA_OBJECT);
+TPMA_SIZE(TPMA_PERMANENT);
+TPMA_SIZE(TPMA_SESSION);
+TPMA_SIZE(TPMA_STARTUP_CLEAR);
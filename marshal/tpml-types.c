@@ -32,6 +32,8 @@
 #include "sapi/tss2_mu.h"
 #include "sapi/tpm20.h"
 #include "tss2_endian.h"
+#include "byteswap.h"
+#include "sink.h"
 #include "log.h"
 
 #define ADDR &
@@ -45,8 +47,6 @@ TSS2_RC Tss2_MU_##type##_Marshal(type const *src, uint8_t buffer[], \
     size_t  local_offset = 0; \
     UINT32 i, count = 0; \
     TSS2_RC ret = TSS2_RC_SUCCESS; \
-    uint8_t *buf_ptr = buffer; \
-    uint8_t local_buffer[buffer_size]; \
 \
     if (offset != NULL) { \
         LOG (INFO, "offset non-NULL, initial value: %zu", *offset); \
@@ -61,8 +61,9 @@ TSS2_RC Tss2_MU_##type##_Marshal(type const *src, uint8_t buffer[], \
     if (buffer == NULL && offset == NULL) { \
         LOG (WARNING, "buffer and offset parameter are NULL"); \
         return TSS2_TYPES_RC_BAD_REFERENCE; \
-    } else if (buffer_size < local_offset || \
-               buffer_size - local_offset < sizeof(count)) { \
+    } else if (buffer != NULL && \
+               (buffer_size < local_offset || \
+                buffer_size - local_offset < sizeof(count))) { \
         LOG (WARNING, \
              "buffer_size: %zu with offset: %zu are insufficient for object " \
              "of size %zu", \
@@ -76,24 +77,25 @@ TSS2_RC Tss2_MU_##type##_Marshal(type const *src, uint8_t buffer[], \
         LOG (WARNING, "count too big"); \
         return TSS2_SYS_RC_BAD_VALUE; \
     } \
-\
-    if (buf_ptr == NULL) \
-        buf_ptr = local_buffer; \
 \
     LOG (DEBUG, \
          "Marshalling " #type " from 0x%" PRIxPTR " to buffer 0x%" PRIxPTR \
          " at index 0x%zx", \
          (uintptr_t)&src, \
-         (uintptr_t)buf_ptr, \
+         (uintptr_t)buffer, \
          local_offset); \
 \
-    ret = Tss2_MU_UINT32_Marshal(src->count, buf_ptr, buffer_size, &local_offset); \
+    /* \
+     * With a NULL buffer every element marshal function below only adds \
+     * its wire size to local_offset, so no scratch buffer is needed. \
+     */ \
+    ret = Tss2_MU_UINT32_Marshal(src->count, buffer, buffer_size, &local_offset); \
     if (ret) \
         return ret; \
 \
     for (i = 0; i < src->count; i++) \
     { \
-        ret = marshal_func(op src->buf_name[i], buf_ptr, buffer_size, &local_offset); \
+        ret = marshal_func(op src->buf_name[i], buffer, buffer_size, &local_offset); \
         if (ret) \
             return ret; \
     } \
@@ -170,24 +172,186 @@ TSS2_RC Tss2_MU_##type##_Unmarshal(uint8_t const buffer[], size_t buffer_size, \
     return TSS2_RC_SUCCESS; \
 }
 
+/*
+ * Lists of plain 16 or 32 bit values (handles, command codes, algorithm IDs,
+ * ...) have the same layout in memory and on the wire apart from the byte
+ * order. They are checked once for the whole list and converted with a
+ * single bswap_copy_* call instead of one checked call per element.
+ */
+#define TPML_MARSHAL_ARRAY(type, buf_name, bits) \
+TSS2_RC Tss2_MU_##type##_Marshal(type const *src, uint8_t buffer[], \
+                                 size_t buffer_size, size_t *offset) \
+{ \
+    size_t  local_offset = 0; \
+    size_t  length; \
+    UINT32  i, n; \
+    TSS2_RC ret = TSS2_RC_SUCCESS; \
+\
+    if (offset != NULL) { \
+        LOG (INFO, "offset non-NULL, initial value: %zu", *offset); \
+        local_offset = *offset; \
+    } \
+\
+    if (src == NULL) { \
+        LOG (WARNING, "src is NULL"); \
+        return TSS2_TYPES_RC_BAD_REFERENCE; \
+    } \
+\
+    if (buffer == NULL && offset == NULL) { \
+        LOG (WARNING, "buffer and offset parameter are NULL"); \
+        return TSS2_TYPES_RC_BAD_REFERENCE; \
+    } \
+\
+    if (src->count > TAB_SIZE(src->buf_name)) { \
+        LOG (WARNING, "count too big"); \
+        return TSS2_SYS_RC_BAD_VALUE; \
+    } \
+\
+    length = sizeof(src->count) + src->count * sizeof(src->buf_name[0]); \
+    if (buffer == NULL && mu_sink != NULL) { \
+        uint8_t *ptr; \
+\
+        ret = Tss2_MU_UINT32_Marshal(src->count, NULL, 0, offset); \
+        for (i = 0; ret == TSS2_RC_SUCCESS && i < src->count; i += n) { \
+            n = src->count - i; \
+            if (n > MU_SINK_STAGING_SIZE / sizeof(src->buf_name[0])) \
+                n = MU_SINK_STAGING_SIZE / sizeof(src->buf_name[0]); \
+            ret = mu_sink_reserve(n * sizeof(src->buf_name[0]), &ptr); \
+            if (ret == TSS2_RC_SUCCESS) \
+                bswap_copy_##bits(ptr, &src->buf_name[i], n); \
+        } \
+        *offset += length - sizeof(src->count); \
+        return ret; \
+    } else if (buffer == NULL) { \
+        *offset += length; \
+        return TSS2_RC_SUCCESS; \
+    } else if (buffer_size < local_offset || \
+               buffer_size - local_offset < length) { \
+        LOG (WARNING, \
+             "buffer_size: %zu with offset: %zu are insufficient for object " \
+             "of size %zu", \
+             buffer_size, \
+             local_offset, \
+             length); \
+        return TSS2_TYPES_RC_INSUFFICIENT_BUFFER; \
+    } \
+\
+    LOG (DEBUG, \
+         "Marshalling " #type " from 0x%" PRIxPTR " to buffer 0x%" PRIxPTR \
+         " at index 0x%zx", \
+         (uintptr_t)src, \
+         (uintptr_t)buffer, \
+         local_offset); \
+\
+    ret = Tss2_MU_UINT32_Marshal(src->count, buffer, buffer_size, &local_offset); \
+    if (ret) \
+        return ret; \
+\
+    bswap_copy_##bits(&buffer[local_offset], src->buf_name, src->count); \
+    local_offset += src->count * sizeof(src->buf_name[0]); \
+\
+    if (offset != NULL) { \
+        *offset = local_offset; \
+        LOG (DEBUG, "offset parameter non-NULL updated to %zu", *offset); \
+    } \
+\
+    return TSS2_RC_SUCCESS; \
+}
+
+#define TPML_UNMARSHAL_ARRAY(type, buf_name, bits) \
+TSS2_RC Tss2_MU_##type##_Unmarshal(uint8_t const buffer[], size_t buffer_size, \
+                                   size_t *offset, type *dest) \
+{ \
+    size_t  local_offset = 0; \
+    UINT32 count = 0; \
+    TSS2_RC ret = TSS2_RC_SUCCESS; \
+\
+    if (offset != NULL) { \
+        LOG (INFO, "offset non-NULL, initial value: %zu", *offset); \
+        local_offset = *offset; \
+    } \
+\
+    if (buffer == NULL || (dest == NULL && offset == NULL)) { \
+        LOG (WARNING, "buffer or dest and offset parameter are NULL"); \
+        return TSS2_TYPES_RC_BAD_REFERENCE; \
+    } \
+\
+    ret = Tss2_MU_UINT32_Unmarshal(buffer, buffer_size, &local_offset, &count); \
+    if (ret) \
+        return ret; \
+\
+    if (count > TAB_SIZE(((type *)NULL)->buf_name)) { \
+        LOG (WARNING, "count too big"); \
+        return TSS2_SYS_RC_MALFORMED_RESPONSE; \
+    } \
+\
+    if (buffer_size - local_offset < count * sizeof(((type *)NULL)->buf_name[0])) { \
+        LOG (WARNING, \
+             "buffer_size: %zu with offset: %zu are insufficient for %" \
+             PRIu32 " elements", \
+             buffer_size, \
+             local_offset, \
+             count); \
+        return TSS2_TYPES_RC_INSUFFICIENT_BUFFER; \
+    } \
+\
+    LOG (DEBUG, \
+         "Unmarshalling " #type " from 0x%" PRIxPTR " to buffer 0x%" PRIxPTR \
+         " at index 0x%zx", \
+         (uintptr_t)buffer, \
+         (uintptr_t)dest, \
+         local_offset); \
+\
+    if (dest != NULL) { \
+        dest->count = count; \
+        bswap_copy_##bits(dest->buf_name, &buffer[local_offset], count); \
+    } \
+    local_offset += count * sizeof(((type *)NULL)->buf_name[0]); \
+\
+    if (offset != NULL) { \
+        *offset = local_offset; \
+        LOG (DEBUG, "offset parameter non-NULL, updated to %zu", *offset); \
+    } \
+\
+    return TSS2_RC_SUCCESS; \
+}
+
+#define TPML_SIZE(type) \
+TSS2_RC Tss2_MU_##type##_Size(type const *src, size_t *size) \
+{ \
+    size_t local_size = 0; \
+    TSS2_RC ret; \
+\
+    if (size == NULL) { \
+        LOG (WARNING, "size param is NULL"); \
+        return TSS2_TYPES_RC_BAD_REFERENCE; \
+    } \
+\
+    ret = Tss2_MU_##type##_Marshal(src, NULL, 0, &local_size); \
+    if (ret == TSS2_RC_SUCCESS) \
+        *size = local_size; \
+\
+    return ret; \
+}
+
 /*
  * These macros expand to (un)marshal functions for each of the TPML types
  * the specification part 2.
  */
-TPML_MARSHAL(TPML_CC, Tss2_MU_TPM_CC_Marshal, commandCodes, VAL)
-TPML_UNMARSHAL(TPML_CC, Tss2_MU_TPM_CC_Unmarshal, commandCodes)
-TPML_MARSHAL(TPML_CCA, Tss2_MU_TPMA_CC_Marshal, commandAttributes, VAL)
-TPML_UNMARSHAL(TPML_CCA, Tss2_MU_TPMA_CC_Unmarshal, commandAttributes)
-TPML_MARSHAL(TPML_ALG, Tss2_MU_UINT16_Marshal, algorithms, VAL)
-TPML_UNMARSHAL(TPML_ALG, Tss2_MU_UINT16_Unmarshal, algorithms)
-TPML_MARSHAL(TPML_HANDLE, Tss2_MU_UINT32_Marshal, handle, VAL)
-TPML_UNMARSHAL(TPML_HANDLE, Tss2_MU_UINT32_Unmarshal, handle)
+TPML_MARSHAL_ARRAY(TPML_CC, commandCodes, 32)
+TPML_UNMARSHAL_ARRAY(TPML_CC, commandCodes, 32)
+TPML_MARSHAL_ARRAY(TPML_CCA, commandAttributes, 32)
+TPML_UNMARSHAL_ARRAY(TPML_CCA, commandAttributes, 32)
+TPML_MARSHAL_ARRAY(TPML_ALG, algorithms, 16)
+TPML_UNMARSHAL_ARRAY(TPML_ALG, algorithms, 16)
+TPML_MARSHAL_ARRAY(TPML_HANDLE, handle, 32)
+TPML_UNMARSHAL_ARRAY(TPML_HANDLE, handle, 32)
 TPML_MARSHAL(TPML_DIGEST, Tss2_MU_TPM2B_DIGEST_Marshal, digests, ADDR)
 TPML_UNMARSHAL(TPML_DIGEST, Tss2_MU_TPM2B_DIGEST_Unmarshal, digests)
 TPML_MARSHAL(TPML_ALG_PROPERTY, Tss2_MU_TPMS_ALG_PROPERTY_Marshal, algProperties, ADDR)
 TPML_UNMARSHAL(TPML_ALG_PROPERTY, Tss2_MU_TPMS_ALG_PROPERTY_Unmarshal, algProperties)
-TPML_MARSHAL(TPML_ECC_CURVE, Tss2_MU_UINT16_Marshal, eccCurves, VAL)
-TPML_UNMARSHAL(TPML_ECC_CURVE, Tss2_MU_UINT16_Unmarshal, eccCurves)
+TPML_MARSHAL_ARRAY(TPML_ECC_CURVE, eccCurves, 16)
+TPML_UNMARSHAL_ARRAY(TPML_ECC_CURVE, eccCurves, 16)
 TPML_MARSHAL(TPML_TAGGED_TPM_PROPERTY, Tss2_MU_TPMS_TAGGED_PROPERTY_Marshal, tpmProperty, ADDR)
 TPML_UNMARSHAL(TPML_TAGGED_TPM_PROPERTY, Tss2_MU_TPMS_TAGGED_PROPERTY_Unmarshal, tpmProperty)
 TPML_MARSHAL(TPML_TAGGED_PCR_PROPERTY, Tss2_MU_TPMS_TAGGED_PCR_SELECT_Marshal, pcrProperty, ADDR)
@@ -196,5 +360,22 @@ TPML_MARSHAL(TPML_PCR_SELECTION, Tss2_MU_TPMS_PCR_SELECTION_Marshal, pcrSelectio
 TPML_UNMARSHAL(TPML_PCR_SELECTION, Tss2_MU_TPMS_PCR_SELECTION_Unmarshal, pcrSelections)
 TPML_MARSHAL(TPML_DIGEST_VALUES, Tss2_MU_TPMT_HA_Marshal, digests, ADDR)
 TPML_UNMARSHAL(TPML_DIGEST_VALUES, Tss2_MU_TPMT_HA_Unmarshal, digests)
-TPML_MARSHAL(TPML_INTEL_PTT_PROPERTY, Tss2_MU_UINT32_Marshal, property, VAL)
-TPML_UNMARSHAL(TPML_INTEL_PTT_PROPERTY, Tss2_MU_UINT32_Unmarshal, property)
+TPML_MARSHAL_ARRAY(TPML_INTEL_PTT_PROPERTY, property, 32)
+TPML_UNMARSHAL_ARRAY(TPML_INTEL_PTT_PROPERTY, property, 32)
+
+/*
+ * These macros expand to size-only functions for each of the TPML types. They
+ * compute the wire size without writing to, or allocating, any buffer.
+ */
+TPML_SIZE(TPML_CC)
+TPML_SIZE(TPML_CCA)
+TPML_SIZE(TPML_ALG)
+TPML_SIZE(TPML_HANDLE)
+TPML_SIZE(TPML_DIGEST)
+TPML_SIZE(TPML_DIGEST_VALUES)
+TPML_SIZE(TPML_PCR_SELECTION)
+TPML_SIZE(TPML_ALG_PROPERTY)
+TPML_SIZE(TPML_ECC_CURVE)
+TPML_SIZE(TPML_TAGGED_PCR_PROPERTY)
+TPML_SIZE(TPML_TAGGED_TPM_PROPERTY)
+TPML_SIZE(TPML_INTEL_PTT_PROPERTY)
@@ -32,17 +32,111 @@
 #include "sapi/tss2_mu.h"
 #include "sapi/tpm20.h"
 #include "tss2_endian.h"
+#include "fixed-layout.h"
+#include "table.h"
+#include "sink.h"
 #include "log.h"
 
 #define ADDR &
 #define VAL
 #define TAB_SIZE(tab) (sizeof(tab) / sizeof(tab[0]))
 
+/*
+ * The PCR selection structures are a small fixed header followed by
+ * sizeofSelect bytes of bitmap. Instead of a checked Tss2_MU_UINT8_Marshal
+ * call per bitmap byte, the whole structure is bounds checked once, the
+ * header is stored with put_be* / get_be* and the bitmap is copied with
+ * memcpy.
+ */
+
+/*
+ * Reserve length bytes at *offset in buffer for a marshal function. With a
+ * NULL buffer only *offset is advanced and *ptr is set to NULL, or to
+ * staging space of the output sink if one is active. Otherwise
+ * *ptr points to the reserved bytes and *offset (if non-NULL) is advanced
+ * past them.
+ */
+static TSS2_RC pcr_select_reserve(uint8_t buffer[], size_t buffer_size,
+                                  size_t *offset, size_t length, uint8_t **ptr)
+{
+    size_t local_offset = 0;
+
+    *ptr = NULL;
+    if (offset != NULL) {
+        local_offset = *offset;
+    }
+
+    if (buffer == NULL && offset == NULL) {
+        LOG (WARNING, "buffer and offset parameter are NULL");
+        return TSS2_TYPES_RC_BAD_REFERENCE;
+    } else if (buffer == NULL) {
+        *offset += length;
+        return mu_sink ? mu_sink_reserve(length, ptr) : TSS2_RC_SUCCESS;
+    } else if (buffer_size < local_offset ||
+               buffer_size - local_offset < length) {
+        LOG (WARNING, "buffer_size: %zu with offset: %zu are insufficient for "
+             "object of size %zu", buffer_size, local_offset, length);
+        return TSS2_TYPES_RC_INSUFFICIENT_BUFFER;
+    }
+
+    *ptr = &buffer[local_offset];
+    if (offset != NULL) {
+        *offset = local_offset + length;
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+/*
+ * Validate the wire form of a PCR selection at *offset in buffer: a header
+ * of header_size bytes whose last byte is sizeofSelect, followed by the
+ * bitmap. On success *ptr points to the header and *sizeof_select holds the
+ * bitmap length; *offset (if non-NULL) is advanced past the structure.
+ */
+static TSS2_RC pcr_select_fetch(uint8_t const buffer[], size_t buffer_size,
+                                size_t *offset, size_t header_size,
+                                const uint8_t **ptr, UINT8 *sizeof_select)
+{
+    size_t local_offset = 0;
+
+    if (offset != NULL) {
+        local_offset = *offset;
+    }
+
+    if (buffer == NULL) {
+        LOG (WARNING, "buffer param is NULL");
+        return TSS2_TYPES_RC_BAD_REFERENCE;
+    } else if (buffer_size < local_offset ||
+               buffer_size - local_offset < header_size) {
+        LOG (WARNING, "buffer_size: %zu with offset: %zu are insufficient for "
+             "object of size %zu", buffer_size, local_offset, header_size);
+        return TSS2_TYPES_RC_INSUFFICIENT_BUFFER;
+    }
+
+    *ptr = &buffer[local_offset];
+    *sizeof_select = (*ptr)[header_size - 1];
+    if (*sizeof_select > PCR_SELECT_MAX) {
+        LOG (ERROR, "sizeofSelect value too big");
+        return TSS2_SYS_RC_MALFORMED_RESPONSE;
+    }
+
+    if (buffer_size - local_offset - header_size < *sizeof_select) {
+        LOG (WARNING, "buffer_size: %zu with offset: %zu are insufficient for "
+             "object of size %zu", buffer_size, local_offset,
+             header_size + *sizeof_select);
+        return TSS2_TYPES_RC_INSUFFICIENT_BUFFER;
+    }
+
+    if (offset != NULL) {
+        *offset = local_offset + header_size + *sizeof_select;
+    }
+    return TSS2_RC_SUCCESS;
+}
+
 static TSS2_RC marshal_pcr_select(const UINT8 *ptr, uint8_t buffer[],
                                   size_t buffer_size, size_t *offset)
 {
     TPMS_PCR_SELECT *pcrSelect = (TPMS_PCR_SELECT *)ptr;
-    UINT32 i;
+    uint8_t *dst;
     TSS2_RC ret;
 
     if (!ptr) {
@@ -50,21 +144,18 @@ static TSS2_RC marshal_pcr_select(const UINT8 *ptr, uint8_t buffer[],
         return TSS2_TYPES_RC_BAD_REFERENCE;
     }
 
-    ret = Tss2_MU_UINT8_Marshal(pcrSelect->sizeofSelect, buffer, buffer_size, offset);
-    if (ret)
-        return ret;
-
     if (pcrSelect->sizeofSelect > TAB_SIZE(pcrSelect->pcrSelect)) {
         LOG (ERROR, "sizeofSelect value too big");
         return TSS2_SYS_RC_BAD_VALUE;
     }
 
-    for (i = 0; i < pcrSelect->sizeofSelect; i++)
-    {
-        ret = Tss2_MU_UINT8_Marshal(pcrSelect->pcrSelect[i], buffer, buffer_size, offset);
-        if (ret)
-            return ret;
-    }
+    ret = pcr_select_reserve(buffer, buffer_size, offset,
+                             1 + pcrSelect->sizeofSelect, &dst);
+    if (ret || dst == NULL)
+        return ret;
+
+    dst = put_be8(dst, pcrSelect->sizeofSelect);
+    memcpy(dst, pcrSelect->pcrSelect, pcrSelect->sizeofSelect);
 
     return TSS2_RC_SUCCESS;
 }
@@ -73,7 +164,8 @@ static TSS2_RC unmarshal_pcr_select(uint8_t const buffer[], size_t buffer_size,
                                     size_t *offset, UINT8 *ptr)
 {
     TPMS_PCR_SELECT *pcrSelect = (TPMS_PCR_SELECT *)ptr;
-    UINT32 i;
+    const uint8_t *src;
+    UINT8 sizeofSelect;
     TSS2_RC ret;
 
     if (!ptr) {
@@ -81,22 +173,12 @@ static TSS2_RC unmarshal_pcr_select(uint8_t const buffer[], size_t buffer_size,
         return TSS2_TYPES_RC_BAD_REFERENCE;
     }
 
-    ret = Tss2_MU_UINT8_Unmarshal(buffer, buffer_size, offset, &pcrSelect->sizeofSelect);
+    ret = pcr_select_fetch(buffer, buffer_size, offset, 1, &src, &sizeofSelect);
     if (ret)
         return ret;
 
-    if (pcrSelect->sizeofSelect > TAB_SIZE(pcrSelect->pcrSelect)) {
-        LOG (ERROR, "sizeofSelect value too big");
-        return TSS2_SYS_RC_MALFORMED_RESPONSE;
-    }
-
-    for (i = 0; i < pcrSelect->sizeofSelect; i++)
-    {
-        ret = Tss2_MU_UINT8_Unmarshal(buffer, buffer_size, offset, &pcrSelect->pcrSelect[i]);
-
-        if (ret)
-            return ret;
-    }
+    pcrSelect->sizeofSelect = sizeofSelect;
+    memcpy(pcrSelect->pcrSelect, src + 1, sizeofSelect);
 
     return TSS2_RC_SUCCESS;
 }
@@ -105,7 +187,7 @@ static TSS2_RC marshal_pcr_selection(const TPMI_ALG_HASH *ptr, uint8_t buffer[],
                                      size_t buffer_size, size_t *offset)
 {
     TPMS_PCR_SELECTION *pcrSelection = (TPMS_PCR_SELECTION *)ptr;
-    UINT32 i;
+    uint8_t *dst;
     TSS2_RC ret;
 
     if (!ptr) {
@@ -118,21 +200,14 @@ static TSS2_RC marshal_pcr_selection(const TPMI_ALG_HASH *ptr, uint8_t buffer[],
         return TSS2_SYS_RC_BAD_VALUE;
     }
 
-    ret = Tss2_MU_UINT16_Marshal(pcrSelection->hash, buffer, buffer_size, offset);
-    if (ret)
-        return ret;
-
-    ret = Tss2_MU_UINT8_Marshal(pcrSelection->sizeofSelect, buffer, buffer_size, offset);
-    if (ret)
+    ret = pcr_select_reserve(buffer, buffer_size, offset,
+                             2 + 1 + pcrSelection->sizeofSelect, &dst);
+    if (ret || dst == NULL)
         return ret;
 
-    for (i = 0; i < pcrSelection->sizeofSelect; i++)
-    {
-        ret = Tss2_MU_UINT8_Marshal(pcrSelection->pcrSelect[i], buffer, buffer_size, offset);
-
-        if (ret)
-            return ret;
-    }
+    dst = put_be16(dst, pcrSelection->hash);
+    dst = put_be8(dst, pcrSelection->sizeofSelect);
+    memcpy(dst, pcrSelection->pcrSelect, pcrSelection->sizeofSelect);
 
     return TSS2_RC_SUCCESS;
 }
@@ -141,7 +216,8 @@ static TSS2_RC unmarshal_pcr_selection(uint8_t const buffer[], size_t buffer_siz
                                        size_t *offset, TPMI_ALG_HASH *ptr)
 {
     TPMS_PCR_SELECTION *pcrSelection = (TPMS_PCR_SELECTION *)ptr;
-    UINT32 i;
+    const uint8_t *src;
+    UINT8 sizeofSelect;
     TSS2_RC ret;
 
     if (!ptr) {
@@ -149,26 +225,13 @@ static TSS2_RC unmarshal_pcr_selection(uint8_t const buffer[], size_t buffer_siz
         return TSS2_TYPES_RC_BAD_REFERENCE;
     }
 
-    ret = Tss2_MU_UINT16_Unmarshal(buffer, buffer_size, offset, &pcrSelection->hash);
+    ret = pcr_select_fetch(buffer, buffer_size, offset, 2 + 1, &src, &sizeofSelect);
     if (ret)
         return ret;
 
-    ret = Tss2_MU_UINT8_Unmarshal(buffer, buffer_size, offset, &pcrSelection->sizeofSelect);
-    if (ret)
-        return ret;
-
-    if (pcrSelection->sizeofSelect > TAB_SIZE(pcrSelection->pcrSelect)) {
-        LOG (ERROR, "sizeofSelect value too big");
-        return TSS2_SYS_RC_MALFORMED_RESPONSE;
-    }
-
-    for (i = 0; i < pcrSelection->sizeofSelect; i++)
-    {
-        ret = Tss2_MU_UINT8_Unmarshal(buffer, buffer_size, offset, &pcrSelection->pcrSelect[i]);
-
-        if (ret)
-            return ret;
-    }
+    src = get_be16(src, &pcrSelection->hash);
+    src = get_be8(src, &pcrSelection->sizeofSelect);
+    memcpy(pcrSelection->pcrSelect, src, sizeofSelect);
 
     return TSS2_RC_SUCCESS;
 }
@@ -177,7 +240,7 @@ static TSS2_RC marshal_tagged_pcr_selection(const TPM_PT_PCR *ptr, uint8_t buffe
                                             size_t buffer_size, size_t *offset)
 {
     TPMS_TAGGED_PCR_SELECT *taggedPcrSelect = (TPMS_TAGGED_PCR_SELECT *)ptr;
-    UINT32 i;
+    uint8_t *dst;
     TSS2_RC ret;
 
     if (!ptr) {
@@ -190,20 +253,14 @@ static TSS2_RC marshal_tagged_pcr_selection(const TPM_PT_PCR *ptr, uint8_t buffe
         return TSS2_SYS_RC_BAD_VALUE;
     }
 
-    ret = Tss2_MU_UINT32_Marshal(taggedPcrSelect->tag, buffer, buffer_size, offset);
-    if (ret)
+    ret = pcr_select_reserve(buffer, buffer_size, offset,
+                             4 + 1 + taggedPcrSelect->sizeofSelect, &dst);
+    if (ret || dst == NULL)
         return ret;
 
-    ret = Tss2_MU_UINT8_Marshal(taggedPcrSelect->sizeofSelect, buffer, buffer_size, offset);
-    if (ret)
-        return ret;
-
-    for (i = 0; i < taggedPcrSelect->sizeofSelect; i++)
-    {
-        ret = Tss2_MU_UINT8_Marshal(taggedPcrSelect->pcrSelect[i], buffer, buffer_size, offset);
-        if (ret)
-            return ret;
-    }
+    dst = put_be32(dst, taggedPcrSelect->tag);
+    dst = put_be8(dst, taggedPcrSelect->sizeofSelect);
+    memcpy(dst, taggedPcrSelect->pcrSelect, taggedPcrSelect->sizeofSelect);
 
     return TSS2_RC_SUCCESS;
 }
@@ -212,7 +269,8 @@ static TSS2_RC unmarshal_tagged_pcr_selection(uint8_t const buffer[], size_t buf
                                               size_t *offset, TPM_PT_PCR *ptr)
 {
     TPMS_TAGGED_PCR_SELECT *taggedPcrSelect = (TPMS_TAGGED_PCR_SELECT *)ptr;
-    UINT32 i;
+    const uint8_t *src;
+    UINT8 sizeofSelect;
     TSS2_RC ret;
 
     if (!ptr) {
@@ -220,25 +278,13 @@ static TSS2_RC unmarshal_tagged_pcr_selection(uint8_t const buffer[], size_t buf
         return TSS2_TYPES_RC_BAD_REFERENCE;
     }
 
-    ret = Tss2_MU_UINT32_Unmarshal(buffer, buffer_size, offset, &taggedPcrSelect->tag);
+    ret = pcr_select_fetch(buffer, buffer_size, offset, 4 + 1, &src, &sizeofSelect);
     if (ret)
         return ret;
 
-    ret = Tss2_MU_UINT8_Unmarshal(buffer, buffer_size, offset, &taggedPcrSelect->sizeofSelect);
-    if (ret)
-        return ret;
-
-    if (taggedPcrSelect->sizeofSelect > TAB_SIZE(taggedPcrSelect->pcrSelect)) {
-        LOG (ERROR, "sizeofSelect value too big");
-        return TSS2_SYS_RC_MALFORMED_RESPONSE;
-    }
-
-    for (i = 0; i < taggedPcrSelect->sizeofSelect; i++)
-    {
-        ret = Tss2_MU_UINT8_Unmarshal(buffer, buffer_size, offset, &taggedPcrSelect->pcrSelect[i]);
-        if (ret)
-            return ret;
-    }
+    src = get_be32(src, &taggedPcrSelect->tag);
+    src = get_be8(src, &taggedPcrSelect->sizeofSelect);
+    memcpy(taggedPcrSelect->pcrSelect, src, sizeofSelect);
 
     return TSS2_RC_SUCCESS;
 }
@@ -270,6 +316,7 @@ TSS2_RC Tss2_MU_##type##_Unmarshal(uint8_t const buffer[], size_t buffer_size, \
     return fn(buffer, buffer_size, offset, dest ? &dest->m : NULL); \
 }
 
+#ifndef MARSHAL_TABLES
 #define TPMS_MARSHAL_2_U(type, m1, op1, fn1, m2, op2, fn2) \
 TSS2_RC Tss2_MU_##type##_Marshal(type const *src, uint8_t buffer[], \
                                  size_t buffer_size, size_t *offset) \
@@ -285,6 +332,7 @@ TSS2_RC Tss2_MU_##type##_Marshal(type const *src, uint8_t buffer[], \
     if (offset) {\
         local_offset = *offset; \
     } else if (!buffer) { \
+        LOG (WARNING, "buffer and offset parameter are NULL"); \
         return TSS2_TYPES_RC_BAD_REFERENCE; \
     } \
 \
@@ -349,6 +397,7 @@ TSS2_RC Tss2_MU_##type##_Marshal(type const *src, uint8_t buffer[], \
     if (offset) { \
         local_offset = *offset; \
     } else if (!buffer) { \
+        LOG (WARNING, "buffer and offset parameter are NULL"); \
         return TSS2_TYPES_RC_BAD_REFERENCE; \
     } \
 \
@@ -412,6 +461,7 @@ TSS2_RC Tss2_MU_##type##_Marshal(type const *src, uint8_t buffer[], \
     if (offset) { \
         local_offset = *offset; \
     } else if (!buffer) { \
+        LOG (WARNING, "buffer and offset parameter are NULL"); \
         return TSS2_TYPES_RC_BAD_REFERENCE; \
     } \
 \
@@ -483,6 +533,7 @@ TSS2_RC Tss2_MU_##type##_Marshal(type const *src, uint8_t buffer[], \
     if (offset) { \
         local_offset = *offset; \
     } else if (!buffer) { \
+        LOG (WARNING, "buffer and offset parameter are NULL"); \
         return TSS2_TYPES_RC_BAD_REFERENCE; \
     } \
 \
@@ -563,6 +614,7 @@ TSS2_RC Tss2_MU_##type##_Marshal(type const *src, uint8_t buffer[], \
     if (offset) { \
         local_offset = *offset; \
     } else if (!buffer) { \
+        LOG (WARNING, "buffer and offset parameter are NULL"); \
         return TSS2_TYPES_RC_BAD_REFERENCE; \
     } \
 \
@@ -651,6 +703,7 @@ TSS2_RC Tss2_MU_##type##_Marshal(type const *src, uint8_t buffer[], \
     if (offset) { \
         local_offset = *offset; \
     } else if (!buffer) { \
+        LOG (WARNING, "buffer and offset parameter are NULL"); \
         return TSS2_TYPES_RC_BAD_REFERENCE; \
     } \
 \
@@ -755,6 +808,7 @@ TSS2_RC Tss2_MU_##type##_Marshal(type const *src, uint8_t buffer[], \
     if (offset) { \
         local_offset = *offset; \
     } else if (!buffer) { \
+        LOG (WARNING, "buffer and offset parameter are NULL"); \
         return TSS2_TYPES_RC_BAD_REFERENCE; \
     } \
 \
@@ -860,6 +914,7 @@ TSS2_RC Tss2_MU_##type##_Marshal(type const *src, uint8_t buffer[], \
     if (offset) { \
         local_offset = *offset; \
     } else if (!buffer) { \
+        LOG (WARNING, "buffer and offset parameter are NULL"); \
         return TSS2_TYPES_RC_BAD_REFERENCE; \
     } \
 \
@@ -981,39 +1036,373 @@ TSS2_RC Tss2_MU_##type##_Unmarshal(uint8_t const buffer[], size_t buffer_size, \
     return ret; \
 }
 
+#else /* MARSHAL_TABLES */
+
+/*
+ * Table engine: the TPMS_(UN)MARSHAL_n invocations below expand to a const
+ * field table and a shim handing it to mu_table_marshal/mu_table_unmarshal.
+ * Member order in the table is the wire order. For the _U variants the union
+ * member takes its selector from m1 (2_U) or m2 (7_U), as in the macro
+ * engine above.
+ */
+#define TPMS_TABLE_MARSHAL(type, ...) \
+static const MU_FIELD type##_marshal_fields[] = { __VA_ARGS__ }; \
+TSS2_RC Tss2_MU_##type##_Marshal(type const *src, uint8_t buffer[], \
+                                 size_t buffer_size, size_t *offset) \
+{ \
+    LOG (DEBUG, \
+         "Marshalling " #type " from 0x%" PRIxPTR " to buffer 0x%" PRIxPTR, \
+         (uintptr_t)src, (uintptr_t)buffer); \
+\
+    return mu_table_marshal(type##_marshal_fields, \
+                            MU_FIELD_COUNT(type##_marshal_fields), \
+                            src, buffer, buffer_size, offset); \
+}
+
+#define TPMS_TABLE_UNMARSHAL(type, ...) \
+static const MU_FIELD type##_unmarshal_fields[] = { __VA_ARGS__ }; \
+TSS2_RC Tss2_MU_##type##_Unmarshal(uint8_t const buffer[], size_t buffer_size, \
+                                   size_t *offset, type *dest) \
+{ \
+    LOG (DEBUG, \
+         "Unmarshalling " #type " from 0x%" PRIxPTR " to buffer 0x%" PRIxPTR, \
+         (uintptr_t)dest, (uintptr_t)buffer); \
+\
+    return mu_table_unmarshal(type##_unmarshal_fields, \
+                              MU_FIELD_COUNT(type##_unmarshal_fields), \
+                              buffer, buffer_size, offset, dest); \
+}
+
+/*
+ * The union member needs its selector even when the caller only skips over
+ * the structure, so these decode into a scratch copy when dest is NULL.
+ */
+#define TPMS_TABLE_UNMARSHAL_U(type, ...) \
+static const MU_FIELD type##_unmarshal_fields[] = { __VA_ARGS__ }; \
+TSS2_RC Tss2_MU_##type##_Unmarshal(uint8_t const buffer[], size_t buffer_size, \
+                                   size_t *offset, type *dest) \
+{ \
+    type tmp_dest; \
+\
+    LOG (DEBUG, \
+         "Unmarshalling " #type " from 0x%" PRIxPTR " to buffer 0x%" PRIxPTR, \
+         (uintptr_t)dest, (uintptr_t)buffer); \
+\
+    if (!offset && !dest) \
+        return TSS2_TYPES_RC_BAD_REFERENCE; \
+\
+    return mu_table_unmarshal(type##_unmarshal_fields, \
+                              MU_FIELD_COUNT(type##_unmarshal_fields), \
+                              buffer, buffer_size, offset, \
+                              dest ? dest : &tmp_dest); \
+}
+
+#define TPMS_MARSHAL_2_U(type, m1, op1, fn1, m2, op2, fn2) \
+    TPMS_TABLE_MARSHAL(type, \
+        MU_FIELD_##op1(type, m1, fn1), \
+        MU_FIELD_SEL(type, m2, m1, fn2))
+
+#define TPMS_UNMARSHAL_2_U(type, m1, fn1, m2, fn2) \
+    TPMS_TABLE_UNMARSHAL_U(type, \
+        MU_FIELD_UNMARSHAL(type, m1, fn1), \
+        MU_FIELD_SEL(type, m2, m1, fn2))
+
+#define TPMS_MARSHAL_2(type, m1, op1, fn1, m2, op2, fn2) \
+    TPMS_TABLE_MARSHAL(type, \
+        MU_FIELD_##op1(type, m1, fn1), \
+        MU_FIELD_##op2(type, m2, fn2))
+
+#define TPMS_UNMARSHAL_2(type, m1, fn1, m2, fn2) \
+    TPMS_TABLE_UNMARSHAL(type, \
+        MU_FIELD_UNMARSHAL(type, m1, fn1), \
+        MU_FIELD_UNMARSHAL(type, m2, fn2))
+
+#define TPMS_MARSHAL_3(type, m1, op1, fn1, m2, op2, fn2, m3, op3, fn3) \
+    TPMS_TABLE_MARSHAL(type, \
+        MU_FIELD_##op1(type, m1, fn1), \
+        MU_FIELD_##op2(type, m2, fn2), \
+        MU_FIELD_##op3(type, m3, fn3))
+
+#define TPMS_UNMARSHAL_3(type, m1, fn1, m2, fn2, m3, fn3) \
+    TPMS_TABLE_UNMARSHAL(type, \
+        MU_FIELD_UNMARSHAL(type, m1, fn1), \
+        MU_FIELD_UNMARSHAL(type, m2, fn2), \
+        MU_FIELD_UNMARSHAL(type, m3, fn3))
+
+#define TPMS_MARSHAL_4(type, m1, op1, fn1, m2, op2, fn2, m3, op3, fn3, m4, op4, fn4) \
+    TPMS_TABLE_MARSHAL(type, \
+        MU_FIELD_##op1(type, m1, fn1), \
+        MU_FIELD_##op2(type, m2, fn2), \
+        MU_FIELD_##op3(type, m3, fn3), \
+        MU_FIELD_##op4(type, m4, fn4))
+
+#define TPMS_UNMARSHAL_4(type, m1, fn1, m2, fn2, m3, fn3, m4, fn4) \
+    TPMS_TABLE_UNMARSHAL(type, \
+        MU_FIELD_UNMARSHAL(type, m1, fn1), \
+        MU_FIELD_UNMARSHAL(type, m2, fn2), \
+        MU_FIELD_UNMARSHAL(type, m3, fn3), \
+        MU_FIELD_UNMARSHAL(type, m4, fn4))
+
+#define TPMS_MARSHAL_5(type, m1, op1, fn1, m2, op2, fn2, m3, op3, fn3, \
+                       m4, op4, fn4, m5, op5, fn5) \
+    TPMS_TABLE_MARSHAL(type, \
+        MU_FIELD_##op1(type, m1, fn1), \
+        MU_FIELD_##op2(type, m2, fn2), \
+        MU_FIELD_##op3(type, m3, fn3), \
+        MU_FIELD_##op4(type, m4, fn4), \
+        MU_FIELD_##op5(type, m5, fn5))
+
+#define TPMS_UNMARSHAL_5(type, m1, fn1, m2, fn2, m3, fn3, m4, fn4, m5, fn5) \
+    TPMS_TABLE_UNMARSHAL(type, \
+        MU_FIELD_UNMARSHAL(type, m1, fn1), \
+        MU_FIELD_UNMARSHAL(type, m2, fn2), \
+        MU_FIELD_UNMARSHAL(type, m3, fn3), \
+        MU_FIELD_UNMARSHAL(type, m4, fn4), \
+        MU_FIELD_UNMARSHAL(type, m5, fn5))
+
+#define TPMS_MARSHAL_7(type, m1, op1, fn1, m2, op2, fn2, m3, op3, fn3, \
+                       m4, op4, fn4, m5, op5, fn5, m6, op6, fn6, m7, op7, fn7) \
+    TPMS_TABLE_MARSHAL(type, \
+        MU_FIELD_##op1(type, m1, fn1), \
+        MU_FIELD_##op2(type, m2, fn2), \
+        MU_FIELD_##op3(type, m3, fn3), \
+        MU_FIELD_##op4(type, m4, fn4), \
+        MU_FIELD_##op5(type, m5, fn5), \
+        MU_FIELD_##op6(type, m6, fn6), \
+        MU_FIELD_##op7(type, m7, fn7))
+
+#define TPMS_UNMARSHAL_7(type, m1, fn1, m2, fn2, m3, fn3, m4, fn4, m5, fn5, m6, fn6, m7, fn7) \
+    TPMS_TABLE_UNMARSHAL(type, \
+        MU_FIELD_UNMARSHAL(type, m1, fn1), \
+        MU_FIELD_UNMARSHAL(type, m2, fn2), \
+        MU_FIELD_UNMARSHAL(type, m3, fn3), \
+        MU_FIELD_UNMARSHAL(type, m4, fn4), \
+        MU_FIELD_UNMARSHAL(type, m5, fn5), \
+        MU_FIELD_UNMARSHAL(type, m6, fn6), \
+        MU_FIELD_UNMARSHAL(type, m7, fn7))
+
+#define TPMS_MARSHAL_7_U(type, m1, op1, fn1, m2, op2, fn2, m3, op3, fn3, \
+                       m4, op4, fn4, m5, op5, fn5, m6, op6, fn6, m7, op7, fn7) \
+    TPMS_TABLE_MARSHAL(type, \
+        MU_FIELD_##op1(type, m1, fn1), \
+        MU_FIELD_##op2(type, m2, fn2), \
+        MU_FIELD_##op3(type, m3, fn3), \
+        MU_FIELD_##op4(type, m4, fn4), \
+        MU_FIELD_##op5(type, m5, fn5), \
+        MU_FIELD_##op6(type, m6, fn6), \
+        MU_FIELD_SEL(type, m7, m2, fn7))
+
+#define TPMS_UNMARSHAL_7_U(type, m1, fn1, m2, fn2, m3, fn3, m4, fn4, m5, fn5, m6, fn6, m7, fn7) \
+    TPMS_TABLE_UNMARSHAL_U(type, \
+        MU_FIELD_UNMARSHAL(type, m1, fn1), \
+        MU_FIELD_UNMARSHAL(type, m2, fn2), \
+        MU_FIELD_UNMARSHAL(type, m3, fn3), \
+        MU_FIELD_UNMARSHAL(type, m4, fn4), \
+        MU_FIELD_UNMARSHAL(type, m5, fn5), \
+        MU_FIELD_UNMARSHAL(type, m6, fn6), \
+        MU_FIELD_SEL(type, m7, m2, fn7))
+
+#define TPMS_MARSHAL_11(type, m1, op1, fn1, m2, op2, fn2, m3, op3, fn3, \
+                        m4, op4, fn4, m5, op5, fn5, m6, op6, fn6, m7, op7, fn7, \
+                        m8, op8, fn8, m9, op9, fn9, m10, op10, fn10, m11, op11, fn11) \
+    TPMS_TABLE_MARSHAL(type, \
+        MU_FIELD_##op1(type, m1, fn1), \
+        MU_FIELD_##op2(type, m2, fn2), \
+        MU_FIELD_##op3(type, m3, fn3), \
+        MU_FIELD_##op4(type, m4, fn4), \
+        MU_FIELD_##op5(type, m5, fn5), \
+        MU_FIELD_##op6(type, m6, fn6), \
+        MU_FIELD_##op7(type, m7, fn7), \
+        MU_FIELD_##op8(type, m8, fn8), \
+        MU_FIELD_##op9(type, m9, fn9), \
+        MU_FIELD_##op10(type, m10, fn10), \
+        MU_FIELD_##op11(type, m11, fn11))
+
+#define TPMS_UNMARSHAL_11(type, m1, fn1, m2, fn2, m3, fn3, m4, fn4, m5, fn5, m6, fn6, m7, fn7, \
+                        m8, fn8, m9, fn9, m10, fn10, m11, fn11) \
+    TPMS_TABLE_UNMARSHAL(type, \
+        MU_FIELD_UNMARSHAL(type, m1, fn1), \
+        MU_FIELD_UNMARSHAL(type, m2, fn2), \
+        MU_FIELD_UNMARSHAL(type, m3, fn3), \
+        MU_FIELD_UNMARSHAL(type, m4, fn4), \
+        MU_FIELD_UNMARSHAL(type, m5, fn5), \
+        MU_FIELD_UNMARSHAL(type, m6, fn6), \
+        MU_FIELD_UNMARSHAL(type, m7, fn7), \
+        MU_FIELD_UNMARSHAL(type, m8, fn8), \
+        MU_FIELD_UNMARSHAL(type, m9, fn9), \
+        MU_FIELD_UNMARSHAL(type, m10, fn10), \
+        MU_FIELD_UNMARSHAL(type, m11, fn11))
+
+#endif /* MARSHAL_TABLES */
+
+/*
+ * Structures made only of fixed size members have a wire size known at
+ * compile time. Their marshal functions check once that the whole structure
+ * fits and then encode it with the unchecked put_be* stores, instead of
+ * calling a checked Tss2_MU_<base type>_Marshal function for every member.
+ * Each put_<type> function encodes src at ptr and returns the first byte
+ * after it, so structures embedding another one reuse its put function.
+ */
+#define TPMS_CLOCK_INFO_WIRE_SIZE (8 + 4 + 4 + 1)
+#define TPMS_TIME_INFO_WIRE_SIZE (8 + TPMS_CLOCK_INFO_WIRE_SIZE)
+#define TPMS_TIME_ATTEST_INFO_WIRE_SIZE (TPMS_TIME_INFO_WIRE_SIZE + 8)
+
+static uint8_t *put_TPMS_ALG_PROPERTY(TPMS_ALG_PROPERTY const *src, uint8_t *ptr)
+{
+    ptr = put_be16(ptr, src->alg);
+    return put_be32(ptr, src->algProperties.val);
+}
+
+static uint8_t *put_TPMS_ALGORITHM_DESCRIPTION(TPMS_ALGORITHM_DESCRIPTION const *src,
+                                               uint8_t *ptr)
+{
+    ptr = put_be16(ptr, src->alg);
+    return put_be32(ptr, src->attributes.val);
+}
+
+static uint8_t *put_TPMS_TAGGED_PROPERTY(TPMS_TAGGED_PROPERTY const *src, uint8_t *ptr)
+{
+    ptr = put_be32(ptr, src->property);
+    return put_be32(ptr, src->value);
+}
+
+static uint8_t *put_TPMS_CLOCK_INFO(TPMS_CLOCK_INFO const *src, uint8_t *ptr)
+{
+    ptr = put_be64(ptr, src->clock);
+    ptr = put_be32(ptr, src->resetCount);
+    ptr = put_be32(ptr, src->restartCount);
+    return put_be8(ptr, src->safe);
+}
+
+static uint8_t *put_TPMS_TIME_INFO(TPMS_TIME_INFO const *src, uint8_t *ptr)
+{
+    ptr = put_be64(ptr, src->time);
+    return put_TPMS_CLOCK_INFO(&src->clockInfo, ptr);
+}
+
+static uint8_t *put_TPMS_TIME_ATTEST_INFO(TPMS_TIME_ATTEST_INFO const *src, uint8_t *ptr)
+{
+    ptr = put_TPMS_TIME_INFO(&src->time, ptr);
+    return put_be64(ptr, src->firmwareVersion);
+}
+
+static uint8_t *put_TPMS_SCHEME_HASH(TPMS_SCHEME_HASH const *src, uint8_t *ptr)
+{
+    return put_be16(ptr, src->hashAlg);
+}
+
+static uint8_t *put_TPMS_SCHEME_ECDAA(TPMS_SCHEME_ECDAA const *src, uint8_t *ptr)
+{
+    ptr = put_be16(ptr, src->hashAlg);
+    return put_be16(ptr, src->count);
+}
+
+static uint8_t *put_TPMS_SCHEME_XOR(TPMS_SCHEME_XOR const *src, uint8_t *ptr)
+{
+    ptr = put_be16(ptr, src->hashAlg);
+    return put_be16(ptr, src->kdf);
+}
+
+static uint8_t *put_TPMS_NV_PIN_COUNTER_PARAMETERS(TPMS_NV_PIN_COUNTER_PARAMETERS const *src,
+                                                   uint8_t *ptr)
+{
+    ptr = put_be32(ptr, src->pinCount);
+    return put_be32(ptr, src->pinLimit);
+}
+
+#define TPMS_MARSHAL_FIXED(type, wire_size) \
+TSS2_RC Tss2_MU_##type##_Marshal(type const *src, uint8_t buffer[], \
+                                 size_t buffer_size, size_t *offset) \
+{ \
+    size_t local_offset = 0; \
+\
+    if (!src) { \
+        LOG (WARNING, "src param is NULL"); \
+        return TSS2_TYPES_RC_BAD_REFERENCE; \
+    } \
+\
+    if (offset) { \
+        local_offset = *offset; \
+    } else if (!buffer) { \
+        LOG (WARNING, "buffer and offset parameter are NULL"); \
+        return TSS2_TYPES_RC_BAD_REFERENCE; \
+    } \
+\
+    if (!buffer && mu_sink) { \
+        uint8_t *ptr; \
+        TSS2_RC ret = mu_sink_reserve(wire_size, &ptr); \
+        if (ret != TSS2_RC_SUCCESS) \
+            return ret; \
+        put_##type(src, ptr); \
+        *offset += wire_size; \
+        return TSS2_RC_SUCCESS; \
+    } else if (!buffer) { \
+        *offset += wire_size; \
+        return TSS2_RC_SUCCESS; \
+    } else if (buffer_size < local_offset || \
+               buffer_size - local_offset < wire_size) { \
+        LOG (WARNING, \
+             "buffer_size: %zu with offset: %zu are insufficient for object " \
+             "of size %zu", \
+             buffer_size, \
+             local_offset, \
+             (size_t)wire_size); \
+        return TSS2_TYPES_RC_INSUFFICIENT_BUFFER; \
+    } \
+\
+    LOG (DEBUG, \
+         "Marshalling " #type " from 0x%" PRIxPTR " to buffer 0x%" PRIxPTR \
+         " at index 0x%zx", (uintptr_t)src,  (uintptr_t)buffer, local_offset); \
+\
+    put_##type(src, &buffer[local_offset]); \
+\
+    if (offset) { \
+        *offset = local_offset + wire_size; \
+    } \
+    return TSS2_RC_SUCCESS; \
+}
+
+#define TPMS_SIZE(type) \
+TSS2_RC Tss2_MU_##type##_Size(type const *src, size_t *size) \
+{ \
+    size_t local_size = 0; \
+    TSS2_RC ret; \
+\
+    if (size == NULL) { \
+        LOG (WARNING, "size param is NULL"); \
+        return TSS2_TYPES_RC_BAD_REFERENCE; \
+    } \
+\
+    ret = Tss2_MU_##type##_Marshal(src, NULL, 0, &local_size); \
+    if (ret == TSS2_RC_SUCCESS) \
+        *size = local_size; \
+\
+    return ret; \
+}
+
 /*
  * These macros expand to (un)marshal functions for each of the TPMS types
  * the specification part 2.
  */
-TPMS_MARSHAL_2(TPMS_ALG_PROPERTY,
-               alg, VAL, Tss2_MU_UINT16_Marshal,
-               algProperties, VAL, Tss2_MU_TPMA_ALGORITHM_Marshal)
+TPMS_MARSHAL_FIXED(TPMS_ALG_PROPERTY, 2 + 4)
 
 TPMS_UNMARSHAL_2(TPMS_ALG_PROPERTY,
                  alg, Tss2_MU_UINT16_Unmarshal,
                  algProperties, Tss2_MU_TPMA_ALGORITHM_Unmarshal)
 
-TPMS_MARSHAL_2(TPMS_ALGORITHM_DESCRIPTION,
-               alg, VAL, Tss2_MU_UINT16_Marshal,
-               attributes, VAL, Tss2_MU_TPMA_ALGORITHM_Marshal)
+TPMS_MARSHAL_FIXED(TPMS_ALGORITHM_DESCRIPTION, 2 + 4)
 
 TPMS_UNMARSHAL_2(TPMS_ALGORITHM_DESCRIPTION,
                  alg, Tss2_MU_UINT16_Unmarshal,
                  attributes, Tss2_MU_TPMA_ALGORITHM_Unmarshal)
 
-TPMS_MARSHAL_2(TPMS_TAGGED_PROPERTY,
-               property, VAL, Tss2_MU_UINT32_Marshal,
-               value, VAL, Tss2_MU_UINT32_Marshal)
+TPMS_MARSHAL_FIXED(TPMS_TAGGED_PROPERTY, 4 + 4)
 
 TPMS_UNMARSHAL_2(TPMS_TAGGED_PROPERTY,
                  property, Tss2_MU_UINT32_Unmarshal,
                  value, Tss2_MU_UINT32_Unmarshal)
 
-TPMS_MARSHAL_4(TPMS_CLOCK_INFO,
-               clock, VAL, Tss2_MU_UINT64_Marshal,
-               resetCount, VAL, Tss2_MU_UINT32_Marshal,
-               restartCount, VAL, Tss2_MU_UINT32_Marshal,
-               safe, VAL, Tss2_MU_UINT8_Marshal)
+TPMS_MARSHAL_FIXED(TPMS_CLOCK_INFO, TPMS_CLOCK_INFO_WIRE_SIZE)
 
 TPMS_UNMARSHAL_4(TPMS_CLOCK_INFO,
                  clock, Tss2_MU_UINT64_Unmarshal,
@@ -1021,17 +1410,13 @@ TPMS_UNMARSHAL_4(TPMS_CLOCK_INFO,
                  restartCount, Tss2_MU_UINT32_Unmarshal,
                  safe, Tss2_MU_UINT8_Unmarshal)
 
-TPMS_MARSHAL_2(TPMS_TIME_INFO,
-               time, VAL, Tss2_MU_UINT64_Marshal,
-               clockInfo, ADDR, Tss2_MU_TPMS_CLOCK_INFO_Marshal)
+TPMS_MARSHAL_FIXED(TPMS_TIME_INFO, TPMS_TIME_INFO_WIRE_SIZE)
 
 TPMS_UNMARSHAL_2(TPMS_TIME_INFO,
                  time, Tss2_MU_UINT64_Unmarshal,
                  clockInfo, Tss2_MU_TPMS_CLOCK_INFO_Unmarshal)
 
-TPMS_MARSHAL_2(TPMS_TIME_ATTEST_INFO,
-               time, ADDR, Tss2_MU_TPMS_TIME_INFO_Marshal,
-               firmwareVersion, VAL, Tss2_MU_UINT64_Marshal)
+TPMS_MARSHAL_FIXED(TPMS_TIME_ATTEST_INFO, TPMS_TIME_ATTEST_INFO_WIRE_SIZE)
 
 TPMS_UNMARSHAL_2(TPMS_TIME_ATTEST_INFO,
                  time, Tss2_MU_TPMS_TIME_INFO_Unmarshal,
@@ -1113,23 +1498,18 @@ TPMS_UNMARSHAL_2(TPMS_SENSITIVE_CREATE,
                  userAuth, Tss2_MU_TPM2B_DIGEST_Unmarshal,
                  data, Tss2_MU_TPM2B_SENSITIVE_DATA_Unmarshal)
 
-TPMS_MARSHAL_1(TPMS_SCHEME_HASH,
-               hashAlg, VAL, Tss2_MU_UINT16_Marshal)
+TPMS_MARSHAL_FIXED(TPMS_SCHEME_HASH, 2)
 
 TPMS_UNMARSHAL_1(TPMS_SCHEME_HASH,
                  hashAlg, Tss2_MU_UINT16_Unmarshal)
 
-TPMS_MARSHAL_2(TPMS_SCHEME_ECDAA,
-               hashAlg, VAL, Tss2_MU_UINT16_Marshal,
-               count, VAL, Tss2_MU_UINT16_Marshal)
+TPMS_MARSHAL_FIXED(TPMS_SCHEME_ECDAA, 2 + 2)
 
 TPMS_UNMARSHAL_2(TPMS_SCHEME_ECDAA,
                  hashAlg, Tss2_MU_UINT16_Unmarshal,
                  count, Tss2_MU_UINT16_Unmarshal)
 
-TPMS_MARSHAL_2(TPMS_SCHEME_XOR,
-               hashAlg, VAL, Tss2_MU_UINT16_Marshal,
-               kdf, VAL, Tss2_MU_UINT16_Marshal)
+TPMS_MARSHAL_FIXED(TPMS_SCHEME_XOR, 2 + 2)
 
 TPMS_UNMARSHAL_2(TPMS_SCHEME_XOR,
                  hashAlg, Tss2_MU_UINT16_Unmarshal,
@@ -1161,9 +1541,7 @@ TPMS_UNMARSHAL_3(TPMS_SIGNATURE_ECC,
                  signatureR, Tss2_MU_TPM2B_ECC_PARAMETER_Unmarshal,
                  signatureS, Tss2_MU_TPM2B_ECC_PARAMETER_Unmarshal)
 
-TPMS_MARSHAL_2(TPMS_NV_PIN_COUNTER_PARAMETERS,
-               pinCount, VAL, Tss2_MU_UINT32_Marshal,
-               pinLimit, VAL, Tss2_MU_UINT32_Marshal)
+TPMS_MARSHAL_FIXED(TPMS_NV_PIN_COUNTER_PARAMETERS, 4 + 4)
 
 TPMS_UNMARSHAL_2(TPMS_NV_PIN_COUNTER_PARAMETERS,
                  pinCount, Tss2_MU_UINT32_Unmarshal,
@@ -1334,3 +1712,44 @@ TPMS_MARSHAL_1(TPMS_SYMCIPHER_PARMS,
 
 TPMS_UNMARSHAL_1(TPMS_SYMCIPHER_PARMS,
                  sym, Tss2_MU_TPMT_SYM_DEF_OBJECT_Unmarshal)
+
+/*
+ * These macros expand to size-only functions for each of the TPMS types. They
+ * compute the wire size without writing to, or allocating, any buffer.
+ */
+TPMS_SIZE(TPMS_CONTEXT)
+TPMS_SIZE(TPMS_TIME_INFO)
+TPMS_SIZE(TPMS_ECC_POINT)
+TPMS_SIZE(TPMS_NV_PUBLIC)
+TPMS_SIZE(TPMS_ALG_PROPERTY)
+TPMS_SIZE(TPMS_ALGORITHM_DESCRIPTION)
+TPMS_SIZE(TPMS_TAGGED_PROPERTY)
+TPMS_SIZE(TPMS_CLOCK_INFO)
+TPMS_SIZE(TPMS_TIME_ATTEST_INFO)
+TPMS_SIZE(TPMS_CERTIFY_INFO)
+TPMS_SIZE(TPMS_COMMAND_AUDIT_INFO)
+TPMS_SIZE(TPMS_SESSION_AUDIT_INFO)
+TPMS_SIZE(TPMS_CREATION_INFO)
+TPMS_SIZE(TPMS_NV_CERTIFY_INFO)
+TPMS_SIZE(TPMS_AUTH_COMMAND)
+TPMS_SIZE(TPMS_AUTH_RESPONSE)
+TPMS_SIZE(TPMS_SENSITIVE_CREATE)
+TPMS_SIZE(TPMS_SCHEME_HASH)
+TPMS_SIZE(TPMS_SCHEME_ECDAA)
+TPMS_SIZE(TPMS_SCHEME_XOR)
+TPMS_SIZE(TPMS_SIGNATURE_RSA)
+TPMS_SIZE(TPMS_SIGNATURE_ECC)
+TPMS_SIZE(TPMS_NV_PIN_COUNTER_PARAMETERS)
+TPMS_SIZE(TPMS_CONTEXT_DATA)
+TPMS_SIZE(TPMS_PCR_SELECT)
+TPMS_SIZE(TPMS_PCR_SELECTION)
+TPMS_SIZE(TPMS_TAGGED_PCR_SELECT)
+TPMS_SIZE(TPMS_QUOTE_INFO)
+TPMS_SIZE(TPMS_CREATION_DATA)
+TPMS_SIZE(TPMS_ECC_PARMS)
+TPMS_SIZE(TPMS_ATTEST)
+TPMS_SIZE(TPMS_ALGORITHM_DETAIL_ECC)
+TPMS_SIZE(TPMS_CAPABILITY_DATA)
+TPMS_SIZE(TPMS_KEYEDHASH_PARMS)
+TPMS_SIZE(TPMS_RSA_PARMS)
+TPMS_SIZE(TPMS_SYMCIPHER_PARMS)
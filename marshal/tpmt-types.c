@@ -498,6 +498,24 @@ TSS2_RC Tss2_MU_##type##_Unmarshal(uint8_t const buffer[], size_t buffer_size, \
     return ret; \
 }
 
+#define TPMT_SIZE(type) \
+TSS2_RC Tss2_MU_##type##_Size(type const *src, size_t *size) \
+{ \
+    size_t local_size = 0; \
+    TSS2_RC ret; \
+\
+    if (size == NULL) { \
+        LOG (WARNING, "size param is NULL"); \
+        return TSS2_TYPES_RC_BAD_REFERENCE; \
+    } \
+\
+    ret = Tss2_MU_##type##_Marshal(src, NULL, 0, &local_size); \
+    if (ret == TSS2_RC_SUCCESS) \
+        *size = local_size; \
+\
+    return ret; \
+}
+
 /*
  * These macros expand to (un)marshal functions for each of the TPMT types
  * the specification part 2.
@@ -625,3 +643,26 @@ TPMT_MARSHAL_TK(TPMT_TK_HASHCHECK, tag, Tss2_MU_UINT16_Marshal,
 
 TPMT_UNMARSHAL_TK(TPMT_TK_HASHCHECK, tag, Tss2_MU_UINT16_Unmarshal,
                   hierarchy, Tss2_MU_UINT32_Unmarshal, digest, Tss2_MU_TPM2B_DIGEST_Unmarshal)
+
+/*
+ * These macros expand to size-only functions for each of the TPMT types. They
+ * compute the wire size without writing to, or allocating, any buffer.
+ */
+TPMT_SIZE(TPMT_HA)
+TPMT_SIZE(TPMT_SYM_DEF)
+TPMT_SIZE(TPMT_SYM_DEF_OBJECT)
+TPMT_SIZE(TPMT_KEYEDHASH_SCHEME)
+TPMT_SIZE(TPMT_SIG_SCHEME)
+TPMT_SIZE(TPMT_KDF_SCHEME)
+TPMT_SIZE(TPMT_ASYM_SCHEME)
+TPMT_SIZE(TPMT_RSA_SCHEME)
+TPMT_SIZE(TPMT_RSA_DECRYPT)
+TPMT_SIZE(TPMT_ECC_SCHEME)
+TPMT_SIZE(TPMT_SIGNATURE)
+TPMT_SIZE(TPMT_SENSITIVE)
+TPMT_SIZE(TPMT_PUBLIC)
+TPMT_SIZE(TPMT_PUBLIC_PARMS)
+TPMT_SIZE(TPMT_TK_CREATION)
+TPMT_SIZE(TPMT_TK_VERIFIED)
+TPMT_SIZE(TPMT_TK_AUTH)
+TPMT_SIZE(TPMT_TK_HASHCHECK)
@@ -32,6 +32,7 @@
 #include "sapi/tss2_mu.h"
 #include "sapi/tpm20.h"
 #include "tss2_endian.h"
+#include "sink.h"
 #include "log.h"
 
 #define ADDR &
@@ -56,6 +57,11 @@ static TSS2_RC marshal_tab(BYTE const *src, uint8_t buffer[],
         LOG (WARNING, "buffer and offset parameter are NULL");
         return TSS2_TYPES_RC_BAD_REFERENCE;
     } else if (buffer == NULL && offset != NULL) {
+        if (mu_sink != NULL) {
+            TSS2_RC rc = mu_sink_write(src, size);
+            if (rc != TSS2_RC_SUCCESS)
+                return rc;
+        }
         *offset += size;
         LOG (INFO, "buffer NULL and offset non-NULL, updating offset to %zu",
              *offset);
@@ -366,6 +372,25 @@ TSS2_RC Tss2_MU_##type##_Unmarshal(uint8_t const buffer[], size_t buffer_size, \
                                             -6, na, unmashal_null, -7, na, unmashal_null, -8, na, unmashal_null, \
                                             -9, na, unmashal_null, -10, na, unmashal_null)
 
+#define TPMU_SIZE(type) \
+TSS2_RC Tss2_MU_##type##_Size(type const *src, uint32_t selector, \
+                              size_t *size) \
+{ \
+    size_t local_size = 0; \
+    TSS2_RC ret; \
+\
+    if (size == NULL) { \
+        LOG (WARNING, "size param is NULL"); \
+        return TSS2_TYPES_RC_BAD_REFERENCE; \
+    } \
+\
+    ret = Tss2_MU_##type##_Marshal(src, selector, NULL, 0, &local_size); \
+    if (ret == TSS2_RC_SUCCESS) \
+        *size = local_size; \
+\
+    return ret; \
+}
+
 TPMU_MARSHAL2(TPMU_HA, TPM_ALG_SHA1, ADDR, sha1[0], marshal_hash_sha,
               TPM_ALG_SHA256, ADDR, sha256[0], marshal_hash_sha256, TPM_ALG_SHA384, ADDR, sha384[0], marshal_hash_sha384,
               TPM_ALG_SHA512, ADDR, sha512[0], marshal_hash_sha512, TPM_ALG_SM3_256, ADDR, sm3_256[0], marshal_sm3_256)
@@ -517,3 +542,22 @@ TPMU_UNMARSHAL2(TPMU_PUBLIC_PARMS, TPM_ALG_KEYEDHASH, keyedHashDetail, Tss2_MU_T
                 TPM_ALG_SYMCIPHER, symDetail, Tss2_MU_TPMS_SYMCIPHER_PARMS_Unmarshal,
                 TPM_ALG_RSA, rsaDetail, Tss2_MU_TPMS_RSA_PARMS_Unmarshal,
                 TPM_ALG_ECC, eccDetail, Tss2_MU_TPMS_ECC_PARMS_Unmarshal)
+
+/*
+ * These macros expand to size-only functions for each of the TPMU types. They
+ * compute the wire size without writing to, or allocating, any buffer.
+ */
+TPMU_SIZE(TPMU_HA)
+TPMU_SIZE(TPMU_CAPABILITIES)
+TPMU_SIZE(TPMU_ATTEST)
+TPMU_SIZE(TPMU_SYM_KEY_BITS)
+TPMU_SIZE(TPMU_SYM_MODE)
+TPMU_SIZE(TPMU_SIG_SCHEME)
+TPMU_SIZE(TPMU_KDF_SCHEME)
+TPMU_SIZE(TPMU_ASYM_SCHEME)
+TPMU_SIZE(TPMU_SCHEME_KEYEDHASH)
+TPMU_SIZE(TPMU_SIGNATURE)
+TPMU_SIZE(TPMU_SENSITIVE_COMPOSITE)
+TPMU_SIZE(TPMU_ENCRYPTED_SECRET)
+TPMU_SIZE(TPMU_PUBLIC_PARMS)
+TPMU_SIZE(TPMU_PUBLIC_ID)
@@ -0,0 +1,397 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+
+#include <inttypes.h>
+#include <string.h>
+
+#include "sapi/tss2_mu.h"
+#include "sapi/tpm20.h"
+#include "fixed-layout.h"
+#include "log.h"
+
+/* magic and type */
+#define ATTEST_HEADER_SIZE (4 + 2)
+/* TPMS_CLOCK_INFO and firmwareVersion */
+#define ATTEST_CLOCK_SIZE (8 + 4 + 4 + 1 + 8)
+/* type, nameAlg and objectAttributes */
+#define PUBLIC_HEADER_SIZE (2 + 2 + 4)
+
+/*
+ * Common start of the View functions: check the references and that
+ * 'needed' bytes are available at the offset. The view records positions
+ * relative to the start of the structure in UINT16s, so the structure may
+ * not be larger than that.
+ */
+static TSS2_RC
+view_start (
+    uint8_t const  buffer[],
+    size_t         buffer_size,
+    size_t        *offset,
+    void const    *view,
+    size_t         needed,
+    size_t        *start)
+{
+    *start = offset ? *offset : 0;
+
+    if (buffer == NULL || view == NULL) {
+        LOG (WARNING, "buffer or view parameter is NULL");
+        return TSS2_TYPES_RC_BAD_REFERENCE;
+    }
+    if (buffer_size < *start || buffer_size - *start < needed) {
+        LOG (WARNING, "buffer_size: %zu with offset: %zu are insufficient "
+             "for object of size %zu", buffer_size, *start, needed);
+        return TSS2_TYPES_RC_INSUFFICIENT_BUFFER;
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+/*
+ * Return a pointer to the data of the TPM2B at 'pos' and its size. The TPM2B
+ * was bounds checked when the view was created.
+ */
+static void
+view_tpm2b (
+    uint8_t const  *buffer,
+    UINT16          pos,
+    uint8_t const **data,
+    size_t         *size)
+{
+    UINT16 data_size;
+
+    get_be16 (&buffer [pos], &data_size);
+    *data = &buffer [pos + sizeof (data_size)];
+    *size = data_size;
+}
+
+TSS2_RC
+Tss2_MU_TPMS_ATTEST_View (
+    uint8_t const  buffer[],
+    size_t         buffer_size,
+    size_t        *offset,
+    TSS2_MU_TPMS_ATTEST_VIEW *view)
+{
+    TSS2_MU_TPMS_ATTEST_VIEW tmp = { 0 };
+    size_t start, local_offset;
+    size_t extra_data, clock_info, attested, pcr_digest = 0;
+    TSS2_RC rc;
+
+    rc = view_start (buffer, buffer_size, offset, view, ATTEST_HEADER_SIZE,
+                     &start);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    get_be16 (&buffer [start + 4], &tmp.type);
+
+    local_offset = start + ATTEST_HEADER_SIZE;
+    rc = Tss2_MU_TPM2B_NAME_Unmarshal (buffer, buffer_size, &local_offset, NULL);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    extra_data = local_offset;
+    rc = Tss2_MU_TPM2B_DATA_Unmarshal (buffer, buffer_size, &local_offset, NULL);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    clock_info = local_offset;
+    if (buffer_size - local_offset < ATTEST_CLOCK_SIZE) {
+        LOG (WARNING, "buffer_size: %zu with offset: %zu are insufficient "
+             "for clockInfo and firmwareVersion", buffer_size, local_offset);
+        return TSS2_TYPES_RC_INSUFFICIENT_BUFFER;
+    }
+    local_offset += ATTEST_CLOCK_SIZE;
+    attested = local_offset;
+
+    switch (tmp.type) {
+    case TPM_ST_ATTEST_QUOTE:
+        rc = Tss2_MU_TPML_PCR_SELECTION_Unmarshal (buffer, buffer_size,
+                                                   &local_offset, NULL);
+        if (rc != TSS2_RC_SUCCESS) {
+            return rc;
+        }
+        pcr_digest = local_offset;
+        rc = Tss2_MU_TPM2B_DIGEST_Unmarshal (buffer, buffer_size,
+                                             &local_offset, NULL);
+        break;
+    case TPM_ST_ATTEST_CERTIFY:
+    case TPM_ST_ATTEST_CREATION:
+    case TPM_ST_ATTEST_COMMAND_AUDIT:
+    case TPM_ST_ATTEST_SESSION_AUDIT:
+    case TPM_ST_ATTEST_TIME:
+    case TPM_ST_ATTEST_NV:
+        rc = Tss2_MU_TPMU_ATTEST_Unmarshal (buffer, buffer_size, &local_offset,
+                                            tmp.type, NULL);
+        break;
+    default:
+        LOG (WARNING, "unknown attestation type: 0x%" PRIx16, tmp.type);
+        return TSS2_SYS_RC_MALFORMED_RESPONSE;
+    }
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    if (local_offset - start > UINT16_MAX) {
+        LOG (WARNING, "TPMS_ATTEST of %zu bytes is too large for a view",
+             local_offset - start);
+        return TSS2_SYS_RC_MALFORMED_RESPONSE;
+    }
+
+    tmp.buffer = &buffer [start];
+    tmp.size = local_offset - start;
+    tmp.extraData = extra_data - start;
+    tmp.clockInfo = clock_info - start;
+    tmp.attested = attested - start;
+    tmp.pcrDigest = pcr_digest ? pcr_digest - start : 0;
+    *view = tmp;
+    if (offset != NULL) {
+        *offset = local_offset;
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+Tss2_MU_TPMS_ATTEST_View_QualifiedSigner (
+    TSS2_MU_TPMS_ATTEST_VIEW const *view,
+    uint8_t const **name,
+    size_t         *size)
+{
+    if (view == NULL || name == NULL || size == NULL) {
+        return TSS2_TYPES_RC_BAD_REFERENCE;
+    }
+    view_tpm2b (view->buffer, ATTEST_HEADER_SIZE, name, size);
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+Tss2_MU_TPMS_ATTEST_View_ExtraData (
+    TSS2_MU_TPMS_ATTEST_VIEW const *view,
+    uint8_t const **data,
+    size_t         *size)
+{
+    if (view == NULL || data == NULL || size == NULL) {
+        return TSS2_TYPES_RC_BAD_REFERENCE;
+    }
+    view_tpm2b (view->buffer, view->extraData, data, size);
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+Tss2_MU_TPMS_ATTEST_View_ClockInfo (
+    TSS2_MU_TPMS_ATTEST_VIEW const *view,
+    TPMS_CLOCK_INFO *clockInfo)
+{
+    const uint8_t *ptr;
+
+    if (view == NULL || clockInfo == NULL) {
+        return TSS2_TYPES_RC_BAD_REFERENCE;
+    }
+    ptr = &view->buffer [view->clockInfo];
+    ptr = get_be64 (ptr, &clockInfo->clock);
+    ptr = get_be32 (ptr, &clockInfo->resetCount);
+    ptr = get_be32 (ptr, &clockInfo->restartCount);
+    get_be8 (ptr, &clockInfo->safe);
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+Tss2_MU_TPMS_ATTEST_View_FirmwareVersion (
+    TSS2_MU_TPMS_ATTEST_VIEW const *view,
+    UINT64         *firmwareVersion)
+{
+    if (view == NULL || firmwareVersion == NULL) {
+        return TSS2_TYPES_RC_BAD_REFERENCE;
+    }
+    get_be64 (&view->buffer [view->attested - 8], firmwareVersion);
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+Tss2_MU_TPMS_ATTEST_View_PcrDigest (
+    TSS2_MU_TPMS_ATTEST_VIEW const *view,
+    uint8_t const **digest,
+    size_t         *size)
+{
+    if (view == NULL || digest == NULL || size == NULL) {
+        return TSS2_TYPES_RC_BAD_REFERENCE;
+    }
+    if (view->type != TPM_ST_ATTEST_QUOTE) {
+        LOG (WARNING, "attestation type 0x%" PRIx16 " has no PCR digest",
+             view->type);
+        return TSS2_SYS_RC_BAD_VALUE;
+    }
+    view_tpm2b (view->buffer, view->pcrDigest, digest, size);
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+Tss2_MU_TPMS_ATTEST_View_Attested (
+    TSS2_MU_TPMS_ATTEST_VIEW const *view,
+    TPMU_ATTEST    *attested)
+{
+    size_t offset;
+
+    if (view == NULL || attested == NULL) {
+        return TSS2_TYPES_RC_BAD_REFERENCE;
+    }
+    offset = view->attested;
+    return Tss2_MU_TPMU_ATTEST_Unmarshal (view->buffer, view->size, &offset,
+                                          view->type, attested);
+}
+
+TSS2_RC
+Tss2_MU_TPM2B_PUBLIC_View (
+    uint8_t const  buffer[],
+    size_t         buffer_size,
+    size_t        *offset,
+    TSS2_MU_TPM2B_PUBLIC_VIEW *view)
+{
+    TSS2_MU_TPM2B_PUBLIC_VIEW tmp = { 0 };
+    size_t start, end, local_offset, parameters, unique;
+    UINT16 size;
+    TSS2_RC rc;
+
+    rc = view_start (buffer, buffer_size, offset, view, sizeof (size), &start);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    get_be16 (&buffer [start], &size);
+    if (buffer_size - start - sizeof (size) < size) {
+        LOG (WARNING, "buffer_size: %zu with offset: %zu are insufficient "
+             "for object of size %zu", buffer_size, start,
+             sizeof (size) + size);
+        return TSS2_TYPES_RC_INSUFFICIENT_BUFFER;
+    }
+    if (size < PUBLIC_HEADER_SIZE) {
+        LOG (WARNING, "TPM2B_PUBLIC size %" PRIu16 " is too small", size);
+        return TSS2_SYS_RC_MALFORMED_RESPONSE;
+    }
+    /* nothing in the public area may be read past the size field */
+    end = start + sizeof (size) + size;
+    local_offset = start + sizeof (size);
+    get_be16 (&buffer [local_offset], &tmp.type);
+    get_be16 (&buffer [local_offset + 2], &tmp.nameAlg);
+    local_offset += PUBLIC_HEADER_SIZE;
+
+    rc = Tss2_MU_TPM2B_DIGEST_Unmarshal (buffer, end, &local_offset, NULL);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    switch (tmp.type) {
+    case TPM_ALG_RSA:
+    case TPM_ALG_ECC:
+    case TPM_ALG_KEYEDHASH:
+    case TPM_ALG_SYMCIPHER:
+        break;
+    default:
+        LOG (WARNING, "unknown public key type: 0x%" PRIx16, tmp.type);
+        return TSS2_SYS_RC_MALFORMED_RESPONSE;
+    }
+    parameters = local_offset;
+    rc = Tss2_MU_TPMU_PUBLIC_PARMS_Unmarshal (buffer, end, &local_offset,
+                                              tmp.type, NULL);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    unique = local_offset;
+    rc = Tss2_MU_TPMU_PUBLIC_ID_Unmarshal (buffer, end, &local_offset,
+                                           tmp.type, NULL);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    if (local_offset != end) {
+        LOG (WARNING, "TPM2B_PUBLIC size %" PRIu16 " doesn't match the "
+             "%zu bytes of its public area", size,
+             local_offset - start - sizeof (size));
+        return TSS2_SYS_RC_MALFORMED_RESPONSE;
+    }
+
+    tmp.buffer = &buffer [start];
+    tmp.size = end - start;
+    tmp.parameters = parameters - start;
+    tmp.unique = unique - start;
+    *view = tmp;
+    if (offset != NULL) {
+        *offset = end;
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+Tss2_MU_TPM2B_PUBLIC_View_PublicArea (
+    TSS2_MU_TPM2B_PUBLIC_VIEW const *view,
+    uint8_t const **data,
+    size_t         *size)
+{
+    if (view == NULL || data == NULL || size == NULL) {
+        return TSS2_TYPES_RC_BAD_REFERENCE;
+    }
+    view_tpm2b (view->buffer, 0, data, size);
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+Tss2_MU_TPM2B_PUBLIC_View_ObjectAttributes (
+    TSS2_MU_TPM2B_PUBLIC_VIEW const *view,
+    TPMA_OBJECT    *objectAttributes)
+{
+    size_t offset = sizeof (UINT16) + 2 + 2;
+
+    if (view == NULL || objectAttributes == NULL) {
+        return TSS2_TYPES_RC_BAD_REFERENCE;
+    }
+    return Tss2_MU_TPMA_OBJECT_Unmarshal (view->buffer, view->size, &offset,
+                                          objectAttributes);
+}
+
+TSS2_RC
+Tss2_MU_TPM2B_PUBLIC_View_Parameters (
+    TSS2_MU_TPM2B_PUBLIC_VIEW const *view,
+    TPMU_PUBLIC_PARMS *parameters)
+{
+    size_t offset;
+
+    if (view == NULL || parameters == NULL) {
+        return TSS2_TYPES_RC_BAD_REFERENCE;
+    }
+    offset = view->parameters;
+    return Tss2_MU_TPMU_PUBLIC_PARMS_Unmarshal (view->buffer, view->size,
+                                                &offset, view->type,
+                                                parameters);
+}
+
+TSS2_RC
+Tss2_MU_TPM2B_PUBLIC_View_Unique (
+    TSS2_MU_TPM2B_PUBLIC_VIEW const *view,
+    TPMU_PUBLIC_ID *unique)
+{
+    size_t offset;
+
+    if (view == NULL || unique == NULL) {
+        return TSS2_TYPES_RC_BAD_REFERENCE;
+    }
+    offset = view->unique;
+    return Tss2_MU_TPMU_PUBLIC_ID_Unmarshal (view->buffer, view->size,
+                                             &offset, view->type, unique);
+}
@@ -0,0 +1,856 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+
+/*
+ * Resource manager daemon. Clients connect to an AF_UNIX socket with the
+ * socket TCTI (hostname set to the socket path) and speak the simulator
+ * wire protocol. Each connection gets its own tcti-swap instance layered on
+ * the one TCTI that owns the TPM, so transient objects get per-connection
+ * virtual handles and sessions / objects are swapped with ContextSave /
+ * ContextLoad. Before a command from another connection runs, everything
+ * the previous one had loaded is saved, so each client sees an otherwise
+ * empty TPM. Requests are read without blocking and queued, the scheduler
+ * (scheduler.h) picks the order in which they run. Responses are queued on
+ * the connection and sent as the client reads them, so a client that stops
+ * reading only holds up itself. Clients are given a
+ * priority and deadline by user id on the command line. With --cache a
+ * tcti-cache instance sits between the swap instances and the TPM, it sees
+ * every client's commands so its invalidation covers all of them. PCR_Read
+ * is only cached with --cache-pcrs, the kernel extends PCRs on its own.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sapi/tpm20.h"
+#include "sapi/tss2_mu.h"
+#include "tcti/tcti_cache.h"
+#include "tcti/tcti_device.h"
+#include "tcti/tcti_socket.h"
+#include "tcti/tcti_swap.h"
+#include "scheduler.h"
+
+#define RESOURCEMGR_SOCKET_DEFAULT "/var/run/tpm2-resourcemgr.sock"
+#define RESOURCEMGR_DEVICE_DEFAULT "/dev/tpm0"
+#define RESOURCEMGR_MAX_CONNECTIONS 32
+#define RESOURCEMGR_MAX_CLIENTS 16
+
+/* UINT32 command, UINT8 locality, UINT32 size */
+#define REQUEST_COMMAND_SIZE sizeof (UINT32)
+#define REQUEST_HEADER_SIZE (sizeof (UINT32) + sizeof (UINT8) + sizeof (UINT32))
+/* UINT32 size, response, UINT32 trailer */
+#define REPLY_MAX_SIZE (sizeof (UINT32) + MAX_RESPONSE_SIZE + sizeof (UINT32))
+#define TPM_HEADER_SIZE 10
+
+/* scheduling parameters for the connections of one user */
+typedef struct {
+    uid_t uid;
+    int priority;
+    UINT32 deadline_ms;
+} CLIENT_POLICY;
+
+typedef struct {
+    int fd;
+    TSS2_TCTI_CONTEXT *tcti;
+    int priority;
+    UINT32 deadline_ms;
+    /* a complete TPM command is waiting in the scheduler */
+    int queued;
+    size_t request_size;
+    UINT8 request[REQUEST_HEADER_SIZE + MAX_COMMAND_SIZE];
+    UINT8 response[MAX_RESPONSE_SIZE];
+    /* reply not yet taken by the client, no new request is read until it is */
+    size_t reply_size;
+    size_t reply_sent;
+    UINT8 reply[REPLY_MAX_SIZE];
+} CONNECTION;
+
+typedef struct {
+    TSS2_TCTI_CONTEXT *tpm;
+    /* response cache layered on tpm, NULL unless --cache */
+    TSS2_TCTI_CONTEXT *cache;
+    /* connection whose objects and sessions may be loaded in the TPM */
+    CONNECTION *active;
+    CONNECTION *connections[RESOURCEMGR_MAX_CONNECTIONS];
+    CLIENT_POLICY clients[RESOURCEMGR_MAX_CLIENTS];
+    size_t client_count;
+    SCHEDULER scheduler;
+    int listen_fd;
+    int verbose;
+} RESOURCEMGR;
+
+static volatile sig_atomic_t running = 1;
+static volatile sig_atomic_t print_stats = 0;
+
+static void
+signal_handler (int signum)
+{
+    if (signum == SIGUSR1) {
+        print_stats = 1;
+    } else {
+        running = 0;
+    }
+}
+
+static UINT64
+now_us (void)
+{
+    struct timespec now;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+}
+
+static int
+log_callback (void *data, printf_type type, const char *format, ...)
+{
+    RESOURCEMGR *rm = data;
+    va_list args;
+    int ret;
+
+    if (!rm->verbose) {
+        return 0;
+    }
+    if (type == RM_PREFIX) {
+        fputs ("RM: ", stderr);
+    }
+    va_start (args, format);
+    ret = vfprintf (stderr, format, args);
+    va_end (args);
+
+    return ret;
+}
+
+#define RM_LOG(rm, ...) log_callback (rm, RM_PREFIX, __VA_ARGS__)
+
+static TSS2_TCTI_CONTEXT*
+tpm_init_device (RESOURCEMGR *rm, const char *path)
+{
+    TCTI_DEVICE_CONF conf = {
+        .device_path = path,
+        .logCallback = log_callback,
+        .logData = rm,
+    };
+    TSS2_TCTI_CONTEXT *tcti;
+    size_t size;
+    TSS2_RC rc;
+
+    rc = InitDeviceTcti (NULL, &size, &conf);
+    if (rc != TSS2_RC_SUCCESS) {
+        return NULL;
+    }
+    tcti = calloc (1, size);
+    if (tcti == NULL) {
+        return NULL;
+    }
+    rc = InitDeviceTcti (tcti, &size, &conf);
+    if (rc != TSS2_RC_SUCCESS) {
+        fprintf (stderr, "failed to open TPM device %s: 0x%x\n", path, rc);
+        free (tcti);
+        return NULL;
+    }
+
+    return tcti;
+}
+
+static TSS2_TCTI_CONTEXT*
+tpm_init_simulator (RESOURCEMGR *rm, const char *hostname, uint16_t port)
+{
+    TCTI_SOCKET_CONF conf = {
+        .hostname = hostname,
+        .port = port,
+        .logCallback = log_callback,
+        .logData = rm,
+    };
+    TSS2_TCTI_CONTEXT *tcti;
+    size_t size;
+    TSS2_RC rc;
+
+    rc = InitSocketTcti (NULL, &size, &conf, 0);
+    if (rc != TSS2_RC_SUCCESS) {
+        return NULL;
+    }
+    tcti = calloc (1, size);
+    if (tcti == NULL) {
+        return NULL;
+    }
+    rc = InitSocketTcti (tcti, &size, &conf, 0);
+    if (rc != TSS2_RC_SUCCESS) {
+        fprintf (stderr, "failed to connect to simulator %s:%u: 0x%x\n",
+                 hostname, port, rc);
+        free (tcti);
+        return NULL;
+    }
+
+    return tcti;
+}
+
+static TSS2_TCTI_CONTEXT*
+cache_init (TSS2_TCTI_CONTEXT *tpm, int cache_pcrs)
+{
+    TCTI_CACHE_CONF conf = { .downstream = tpm, .cache_pcrs = cache_pcrs };
+    TSS2_TCTI_CONTEXT *tcti;
+    size_t size;
+
+    if (InitCacheTcti (NULL, &size, &conf) != TSS2_RC_SUCCESS) {
+        return NULL;
+    }
+    tcti = calloc (1, size);
+    if (tcti == NULL) {
+        return NULL;
+    }
+    if (InitCacheTcti (tcti, &size, &conf) != TSS2_RC_SUCCESS) {
+        free (tcti);
+        return NULL;
+    }
+
+    return tcti;
+}
+
+static void
+stats_print (RESOURCEMGR *rm)
+{
+    TCTI_CACHE_STATS stats;
+    UINT64 lookups;
+
+    scheduler_stats_print (&rm->scheduler, stderr);
+    if (rm->cache == NULL ||
+        TctiCacheGetStats (rm->cache, &stats) != TSS2_RC_SUCCESS) {
+        return;
+    }
+    lookups = stats.hits + stats.misses;
+    fprintf (stderr, "cache: %" PRIu64 " hits, %" PRIu64 " misses (%" PRIu64
+             "%% hit rate), %" PRIu64 " uncacheable, %" PRIu64
+             " invalidations, %" PRIu64 " evictions\n", stats.hits,
+             stats.misses, lookups ? stats.hits * 100 / lookups : 0,
+             stats.uncacheable, stats.invalidations, stats.evictions);
+}
+
+static int
+listen_init (const char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    int fd;
+
+    if (strlen (path) >= sizeof (addr.sun_path)) {
+        fprintf (stderr, "socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy (addr.sun_path, path);
+    fd = socket (AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror ("socket");
+        return -1;
+    }
+    unlink (path);
+    if (bind (fd, (struct sockaddr*)&addr, sizeof (addr)) != 0 ||
+        listen (fd, RESOURCEMGR_MAX_CONNECTIONS) != 0) {
+        perror (path);
+        close (fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/*
+ * Look up the scheduling parameters for the user on the other end.
+ */
+static void
+connection_policy (RESOURCEMGR *rm, CONNECTION *conn)
+{
+    struct ucred cred;
+    socklen_t len = sizeof (cred);
+    size_t i;
+
+    if (getsockopt (conn->fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0) {
+        return;
+    }
+    for (i = 0; i < rm->client_count; ++i) {
+        if (rm->clients[i].uid == cred.uid) {
+            conn->priority = rm->clients[i].priority;
+            conn->deadline_ms = rm->clients[i].deadline_ms;
+            return;
+        }
+    }
+}
+
+static void
+connection_accept (RESOURCEMGR *rm)
+{
+    TCTI_SWAP_CONF conf = { .downstream = rm->cache ? rm->cache : rm->tpm };
+    CONNECTION *conn;
+    size_t size, i;
+    int fd;
+
+    fd = accept4 (rm->listen_fd, NULL, NULL, SOCK_NONBLOCK);
+    if (fd < 0) {
+        return;
+    }
+    for (i = 0; i < RESOURCEMGR_MAX_CONNECTIONS; ++i) {
+        if (rm->connections[i] == NULL) {
+            break;
+        }
+    }
+    if (i == RESOURCEMGR_MAX_CONNECTIONS) {
+        RM_LOG (rm, "too many connections, rejecting fd %d\n", fd);
+        close (fd);
+        return;
+    }
+    InitSwapTcti (NULL, &size, &conf);
+    conn = calloc (1, sizeof (*conn));
+    if (conn != NULL) {
+        conn->tcti = calloc (1, size);
+    }
+    if (conn == NULL || conn->tcti == NULL ||
+        InitSwapTcti (conn->tcti, &size, &conf) != TSS2_RC_SUCCESS) {
+        if (conn != NULL) {
+            free (conn->tcti);
+        }
+        free (conn);
+        close (fd);
+        return;
+    }
+    conn->fd = fd;
+    connection_policy (rm, conn);
+    rm->connections[i] = conn;
+    RM_LOG (rm, "connection %d opened, priority %d, deadline %u ms\n", fd,
+            conn->priority, conn->deadline_ms);
+}
+
+static void
+connection_close (RESOURCEMGR *rm, size_t index)
+{
+    CONNECTION *conn = rm->connections[index];
+
+    RM_LOG (rm, "connection %d closed\n", conn->fd);
+    if (rm->active == conn) {
+        rm->active = NULL;
+    }
+    if (conn->queued) {
+        scheduler_remove (&rm->scheduler, conn);
+    }
+    /* flushes everything the client left behind */
+    tss2_tcti_finalize (conn->tcti);
+    free (conn->tcti);
+    close (conn->fd);
+    free (conn);
+    rm->connections[index] = NULL;
+}
+/*
+ * Number of bytes the request being received will have in total, as far as
+ * can be told from what's there so far. 0 means the request is invalid.
+ */
+static size_t
+request_expected (CONNECTION *conn)
+{
+    size_t offset = 0;
+    UINT32 command, size;
+
+    if (conn->request_size < REQUEST_COMMAND_SIZE) {
+        return REQUEST_COMMAND_SIZE;
+    }
+    Tss2_MU_UINT32_Unmarshal (conn->request, conn->request_size, &offset,
+                              &command);
+    if (command != MS_SIM_TPM_SEND_COMMAND) {
+        return REQUEST_COMMAND_SIZE;
+    }
+    if (conn->request_size < REQUEST_HEADER_SIZE) {
+        return REQUEST_HEADER_SIZE;
+    }
+    offset += sizeof (UINT8);
+    Tss2_MU_UINT32_Unmarshal (conn->request, conn->request_size, &offset,
+                              &size);
+    if (size < TPM_HEADER_SIZE || size > MAX_COMMAND_SIZE) {
+        return 0;
+    }
+
+    return REQUEST_HEADER_SIZE + size;
+}
+/*
+ * Run a TPM command for a connection. Errors from the resource manager
+ * itself are reported to the client as a response with the RM error level.
+ * The time spent in the TPM exchange alone, without saving the contexts of
+ * the previous connection, is returned in start_us / end_us.
+ */
+static size_t
+request_execute (RESOURCEMGR *rm, CONNECTION *conn, UINT8 locality,
+                 UINT8 *command, size_t command_size, UINT64 *start_us,
+                 UINT64 *end_us)
+{
+    size_t response_size = sizeof (conn->response), offset = 0;
+    TSS2_RC rc;
+
+    if (rm->active != conn && rm->active != NULL) {
+        rc = TctiSwapSaveAll (rm->active->tcti);
+        if (rc != TSS2_RC_SUCCESS) {
+            RM_LOG (rm, "failed to save contexts of connection %d: 0x%x\n",
+                    rm->active->fd, rc);
+        }
+    }
+    rm->active = conn;
+
+    /* the device TCTI can't set the locality, that's not worth failing */
+    tss2_tcti_set_locality (conn->tcti, locality);
+    *start_us = now_us ();
+    rc = tss2_tcti_transmit (conn->tcti, command_size, command);
+    if (rc == TSS2_RC_SUCCESS) {
+        rc = tss2_tcti_receive (conn->tcti, &response_size, conn->response,
+                                TSS2_TCTI_TIMEOUT_BLOCK);
+    }
+    *end_us = now_us ();
+    if (rc == TSS2_RC_SUCCESS) {
+        return response_size;
+    }
+
+    RM_LOG (rm, "command from connection %d failed: 0x%x\n", conn->fd, rc);
+    rc = (rc & ~TSS2_ERROR_LEVEL_MASK) | TSS2_RESMGR_ERROR_LEVEL;
+    Tss2_MU_TPM_ST_Marshal (TPM_ST_NO_SESSIONS, conn->response,
+                            sizeof (conn->response), &offset);
+    Tss2_MU_UINT32_Marshal (TPM_HEADER_SIZE, conn->response,
+                            sizeof (conn->response), &offset);
+    Tss2_MU_UINT32_Marshal (rc, conn->response, sizeof (conn->response),
+                            &offset);
+
+    return offset;
+}
+
+/*
+ * Send as much of the queued reply as the client takes without blocking.
+ * Returns -1 when the connection is to be closed.
+ */
+static int
+reply_flush (CONNECTION *conn)
+{
+    ssize_t ret;
+
+    while (conn->reply_sent < conn->reply_size) {
+        ret = send (conn->fd, &conn->reply[conn->reply_sent],
+                    conn->reply_size - conn->reply_sent, MSG_NOSIGNAL);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        } else if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return 0;
+        } else if (ret <= 0) {
+            return -1;
+        }
+        conn->reply_sent += ret;
+    }
+    conn->reply_size = 0;
+    conn->reply_sent = 0;
+
+    return 0;
+}
+/*
+ * Queue a reply (an optional size-prefixed response followed by the zero
+ * trailer) and start sending it.
+ */
+static int
+reply_queue (CONNECTION *conn, const UINT8 *response, size_t size)
+{
+    size_t offset = 0;
+
+    if (response != NULL) {
+        Tss2_MU_UINT32_Marshal (size, conn->reply, sizeof (conn->reply),
+                                &offset);
+        memcpy (&conn->reply[offset], response, size);
+        offset += size;
+    }
+    Tss2_MU_UINT32_Marshal (0, conn->reply, sizeof (conn->reply), &offset);
+    conn->reply_size = offset;
+    conn->reply_sent = 0;
+
+    return reply_flush (conn);
+}
+/*
+ * Queue a complete TPM command with the scheduler.
+ */
+static int
+request_enqueue (RESOURCEMGR *rm, CONNECTION *conn)
+{
+    size_t offset = REQUEST_HEADER_SIZE + sizeof (TPM_ST) + sizeof (UINT32);
+    TPM_CC command_code;
+
+    Tss2_MU_TPM_CC_Unmarshal (conn->request, conn->request_size, &offset,
+                              &command_code);
+    if (scheduler_enqueue (&rm->scheduler, conn, command_code, conn->priority,
+                           conn->deadline_ms, now_us ()) != 0) {
+        return -1;
+    }
+    conn->queued = 1;
+
+    return 0;
+}
+/*
+ * Run the queued TPM command of a connection and queue the response.
+ * Returns -1 when the connection is to be closed.
+ */
+static int
+connection_dispatch (RESOURCEMGR *rm, CONNECTION *conn, UINT64 *start_us,
+                     UINT64 *end_us)
+{
+    size_t size;
+
+    conn->queued = 0;
+    size = request_execute (rm, conn, conn->request[sizeof (UINT32)],
+                            &conn->request[REQUEST_HEADER_SIZE],
+                            conn->request_size - REQUEST_HEADER_SIZE,
+                            start_us, end_us);
+    conn->request_size = 0;
+
+    return reply_queue (conn, conn->response, size);
+}
+/*
+ * Handle a complete platform request. Returns -1 when the connection is to
+ * be closed.
+ */
+static int
+request_handle (RESOURCEMGR *rm, CONNECTION *conn)
+{
+    size_t offset = 0;
+    UINT32 command;
+
+    Tss2_MU_UINT32_Unmarshal (conn->request, conn->request_size, &offset,
+                              &command);
+    switch (command) {
+    case MS_SIM_POWER_ON:
+    case MS_SIM_POWER_OFF:
+    case MS_SIM_NV_ON:
+    case MS_SIM_CANCEL_ON:
+    case MS_SIM_CANCEL_OFF:
+        /* the platform belongs to the resource manager, just acknowledge */
+        return reply_queue (conn, NULL, 0);
+    case TPM_SESSION_END:
+        return -1;
+    default:
+        RM_LOG (rm, "unknown request 0x%x on connection %d\n", command,
+                conn->fd);
+        return -1;
+    }
+}
+/*
+ * Read what's available for the request in progress. Once it's complete a
+ * TPM command is queued, anything else is handled right away. Returns -1
+ * when the connection is to be closed.
+ */
+static int
+connection_read (RESOURCEMGR *rm, CONNECTION *conn)
+{
+    size_t expected = request_expected (conn);
+    ssize_t ret;
+
+    if (expected == 0) {
+        return -1;
+    }
+    ret = recv (conn->fd, &conn->request[conn->request_size],
+                expected - conn->request_size, 0);
+    if (ret < 0 && (errno == EINTR || errno == EAGAIN ||
+                    errno == EWOULDBLOCK)) {
+        return 0;
+    } else if (ret <= 0) {
+        return -1;
+    }
+    conn->request_size += ret;
+    /* the header may have revealed that more is to come */
+    expected = request_expected (conn);
+    if (expected == 0) {
+        return -1;
+    } else if (conn->request_size < expected) {
+        return 0;
+    } else if (expected > REQUEST_COMMAND_SIZE) {
+        return request_enqueue (rm, conn);
+    }
+    ret = request_handle (rm, conn);
+    conn->request_size = 0;
+
+    return ret;
+}
+
+/*
+ * Run the command the scheduler picks and feed the time the TPM took back.
+ */
+static void
+resourcemgr_dispatch (RESOURCEMGR *rm)
+{
+    SCHEDULER_ENTRY entry;
+    UINT64 start, end;
+    size_t i;
+    int ret;
+
+    if (!scheduler_next (&rm->scheduler, now_us (), &entry)) {
+        return;
+    }
+    ret = connection_dispatch (rm, entry.data, &start, &end);
+    scheduler_complete (&rm->scheduler, &entry, start, end);
+    if (ret == 0) {
+        return;
+    }
+    for (i = 0; i < RESOURCEMGR_MAX_CONNECTIONS; ++i) {
+        if (rm->connections[i] == entry.data) {
+            connection_close (rm, i);
+        }
+    }
+}
+
+static void
+resourcemgr_run (RESOURCEMGR *rm)
+{
+    struct pollfd fds[RESOURCEMGR_MAX_CONNECTIONS + 1];
+    size_t index[RESOURCEMGR_MAX_CONNECTIONS + 1];
+    size_t i, count;
+    int ret;
+
+    while (running) {
+        if (print_stats) {
+            print_stats = 0;
+            stats_print (rm);
+        }
+        fds[0].fd = rm->listen_fd;
+        fds[0].events = POLLIN;
+        for (i = 0, count = 1; i < RESOURCEMGR_MAX_CONNECTIONS; ++i) {
+            CONNECTION *conn = rm->connections[i];
+
+            /* connections with a queued command wait for its response */
+            if (conn == NULL || conn->queued) {
+                continue;
+            }
+            fds[count].fd = conn->fd;
+            fds[count].events = conn->reply_size > 0 ? POLLOUT : POLLIN;
+            index[count++] = i;
+        }
+        /* collect whatever else arrived, then run one queued command */
+        ret = poll (fds, count, rm->scheduler.count > 0 ? 0 : -1);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror ("poll");
+            return;
+        }
+        for (i = 1; i < count; ++i) {
+            CONNECTION *conn = rm->connections[index[i]];
+
+            if (fds[i].revents == 0) {
+                continue;
+            }
+            ret = fds[i].events == POLLOUT ? reply_flush (conn) :
+                                             connection_read (rm, conn);
+            if (ret != 0) {
+                connection_close (rm, index[i]);
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            connection_accept (rm);
+        }
+        resourcemgr_dispatch (rm);
+    }
+}
+/*
+ * Parse UID:PRIORITY[:DEADLINE_MS].
+ */
+static int
+client_policy_parse (RESOURCEMGR *rm, const char *arg)
+{
+    CLIENT_POLICY *policy;
+    unsigned long uid, deadline = 0;
+    int priority, consumed = 0;
+
+    if (rm->client_count == RESOURCEMGR_MAX_CLIENTS) {
+        fprintf (stderr, "too many --client options\n");
+        return -1;
+    }
+    if (sscanf (arg, "%lu:%d%n:%lu%n", &uid, &priority, &consumed, &deadline,
+                &consumed) < 2 || arg[consumed] != '\0') {
+        fprintf (stderr, "invalid --client argument: %s\n", arg);
+        return -1;
+    }
+    policy = &rm->clients[rm->client_count++];
+    policy->uid = uid;
+    policy->priority = priority;
+    policy->deadline_ms = deadline;
+
+    return 0;
+}
+
+static void
+usage (const char *name)
+{
+    fprintf (stderr,
+             "usage: %s [options]\n"
+             "  -s, --socket=PATH      listen on PATH (default %s)\n"
+             "  -d, --device=PATH      TPM device (default %s)\n"
+             "  -S, --simulator        use the TPM simulator instead\n"
+             "  -H, --sim-host=ADDR    simulator address (default %s)\n"
+             "  -p, --sim-port=PORT    simulator port (default %d)\n"
+             "  -c, --client=UID:PRIORITY[:DEADLINE_MS]\n"
+             "                         schedule commands of user UID with\n"
+             "                         PRIORITY (default 0, higher first)\n"
+             "                         and a deadline\n"
+             "  -w, --max-wait=MS      promote commands waiting longer\n"
+             "                         (default %llu)\n"
+             "  -C, --cache            answer repeated read-only commands\n"
+             "                         from a cache\n"
+             "  -P, --cache-pcrs       cache PCR values too, only if nothing\n"
+             "                         else extends PCRs (implies --cache)\n"
+             "  -v, --verbose          log connections and errors\n",
+             name, RESOURCEMGR_SOCKET_DEFAULT, RESOURCEMGR_DEVICE_DEFAULT,
+             DEFAULT_HOSTNAME, DEFAULT_SIMULATOR_TPM_PORT,
+             SCHEDULER_MAX_WAIT_DEFAULT_US / 1000);
+}
+
+int
+main (int argc, char *argv[])
+{
+    static const struct option options[] = {
+        { "socket", required_argument, NULL, 's' },
+        { "device", required_argument, NULL, 'd' },
+        { "simulator", no_argument, NULL, 'S' },
+        { "sim-host", required_argument, NULL, 'H' },
+        { "sim-port", required_argument, NULL, 'p' },
+        { "client", required_argument, NULL, 'c' },
+        { "max-wait", required_argument, NULL, 'w' },
+        { "cache", no_argument, NULL, 'C' },
+        { "cache-pcrs", no_argument, NULL, 'P' },
+        { "verbose", no_argument, NULL, 'v' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 },
+    };
+    const char *socket_path = RESOURCEMGR_SOCKET_DEFAULT;
+    const char *device = RESOURCEMGR_DEVICE_DEFAULT;
+    const char *sim_host = DEFAULT_HOSTNAME;
+    uint16_t sim_port = DEFAULT_SIMULATOR_TPM_PORT;
+    struct sigaction action = { .sa_handler = signal_handler };
+    static RESOURCEMGR rm = { .listen_fd = -1 };
+    UINT64 max_wait_us = 0;
+    int simulator = 0, cache = 0, cache_pcrs = 0, c;
+    size_t i;
+
+    while ((c = getopt_long (argc, argv, "s:d:SH:p:c:w:CPvh", options, NULL)) != -1) {
+        switch (c) {
+        case 's':
+            socket_path = optarg;
+            break;
+        case 'd':
+            device = optarg;
+            break;
+        case 'S':
+            simulator = 1;
+            break;
+        case 'H':
+            sim_host = optarg;
+            break;
+        case 'p':
+            sim_port = strtoul (optarg, NULL, 0);
+            break;
+        case 'c':
+            if (client_policy_parse (&rm, optarg) != 0) {
+                return 1;
+            }
+            break;
+        case 'w':
+            max_wait_us = strtoull (optarg, NULL, 0) * 1000;
+            break;
+        case 'C':
+            cache = 1;
+            break;
+        case 'P':
+            cache = 1;
+            cache_pcrs = 1;
+            break;
+        case 'v':
+            rm.verbose = 1;
+            break;
+        case 'h':
+            usage (argv[0]);
+            return 0;
+        default:
+            usage (argv[0]);
+            return 1;
+        }
+    }
+
+    scheduler_init (&rm.scheduler, max_wait_us);
+    rm.tpm = simulator ? tpm_init_simulator (&rm, sim_host, sim_port) :
+                         tpm_init_device (&rm, device);
+    if (rm.tpm == NULL) {
+        return 1;
+    }
+    if (cache) {
+        rm.cache = cache_init (rm.tpm, cache_pcrs);
+    }
+    if (cache && rm.cache == NULL) {
+        fprintf (stderr, "failed to initialize response cache\n");
+        tss2_tcti_finalize (rm.tpm);
+        free (rm.tpm);
+        return 1;
+    }
+    rm.listen_fd = listen_init (socket_path);
+    if (rm.listen_fd < 0) {
+        if (rm.cache != NULL) {
+            tss2_tcti_finalize (rm.cache);
+            free (rm.cache);
+        }
+        tss2_tcti_finalize (rm.tpm);
+        free (rm.tpm);
+        return 1;
+    }
+    sigaction (SIGINT, &action, NULL);
+    sigaction (SIGTERM, &action, NULL);
+    sigaction (SIGUSR1, &action, NULL);
+
+    resourcemgr_run (&rm);
+
+    for (i = 0; i < RESOURCEMGR_MAX_CONNECTIONS; ++i) {
+        if (rm.connections[i] != NULL) {
+            connection_close (&rm, i);
+        }
+    }
+    if (rm.verbose) {
+        stats_print (&rm);
+    }
+    close (rm.listen_fd);
+    unlink (socket_path);
+    if (rm.cache != NULL) {
+        tss2_tcti_finalize (rm.cache);
+        free (rm.cache);
+    }
+    tss2_tcti_finalize (rm.tpm);
+    free (rm.tpm);
+
+    return 0;
+}
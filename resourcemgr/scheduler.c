@@ -0,0 +1,250 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+
+#include <inttypes.h>
+#include <string.h>
+
+#include "scheduler.h"
+
+#define COST_LONG_US    500000
+#define COST_SHORT_US   1000
+#define COST_DEFAULT_US 20000
+/* weight of a new sample in the moving average, 1 / 2^COST_SHIFT */
+#define COST_SHIFT 3
+
+#define CC_INDEX(cc) ((cc) - TPM_CC_FIRST)
+#define CC_VALID(cc) ((cc) >= TPM_CC_FIRST && (cc) <= TPM_CC_LAST)
+
+/* key generation and commands regenerating or clearing hierarchies */
+static const TPM_CC commands_long[] = {
+    TPM_CC_CreatePrimary, TPM_CC_Create, TPM_CC_ChangeEPS, TPM_CC_ChangePPS,
+    TPM_CC_Clear, TPM_CC_SelfTest,
+};
+/* commands that don't touch keys or NV */
+static const TPM_CC commands_short[] = {
+    TPM_CC_GetRandom, TPM_CC_PCR_Read, TPM_CC_GetCapability,
+    TPM_CC_ReadPublic, TPM_CC_ReadClock, TPM_CC_FlushContext,
+    TPM_CC_ContextSave, TPM_CC_GetTestResult, TPM_CC_PolicyRestart,
+};
+
+static int
+cc_in (TPM_CC command_code, const TPM_CC *list, size_t count)
+{
+    size_t i;
+
+    for (i = 0; i < count; ++i) {
+        if (list[i] == command_code)
+            return 1;
+    }
+    return 0;
+}
+
+void
+scheduler_init (SCHEDULER *scheduler, UINT64 max_wait_us)
+{
+    memset (scheduler, 0, sizeof (*scheduler));
+    scheduler->max_wait_us = max_wait_us ? max_wait_us :
+                                           SCHEDULER_MAX_WAIT_DEFAULT_US;
+}
+
+UINT64
+scheduler_cost (SCHEDULER *scheduler, TPM_CC command_code)
+{
+    if (CC_VALID (command_code) &&
+        scheduler->cost_us[CC_INDEX (command_code)] != 0) {
+        return scheduler->cost_us[CC_INDEX (command_code)];
+    }
+    if (cc_in (command_code, commands_long,
+               sizeof (commands_long) / sizeof (commands_long[0]))) {
+        return COST_LONG_US;
+    }
+    if (cc_in (command_code, commands_short,
+               sizeof (commands_short) / sizeof (commands_short[0]))) {
+        return COST_SHORT_US;
+    }
+    return COST_DEFAULT_US;
+}
+
+int
+scheduler_enqueue (SCHEDULER *scheduler, void *data, TPM_CC command_code,
+                   int priority, UINT32 deadline_ms, UINT64 now_us)
+{
+    SCHEDULER_ENTRY *entry;
+
+    if (scheduler->count == SCHEDULER_MAX_ENTRIES) {
+        return -1;
+    }
+    entry = &scheduler->queue[scheduler->count++];
+    entry->data = data;
+    entry->command_code = command_code;
+    entry->priority = priority;
+    entry->arrival_us = now_us;
+    entry->deadline_us = deadline_ms ? now_us + deadline_ms * 1000ULL : 0;
+    entry->cost_us = scheduler_cost (scheduler, command_code);
+
+    scheduler->stats.enqueued++;
+    scheduler->stats.depth = scheduler->count;
+    if (scheduler->count > scheduler->stats.max_depth) {
+        scheduler->stats.max_depth = scheduler->count;
+    }
+    return 0;
+}
+
+static UINT64
+entry_latest_start (SCHEDULER_ENTRY const *entry)
+{
+    UINT64 deadline = entry->deadline_us;
+
+    if (deadline == 0) {
+        deadline = entry->arrival_us + SCHEDULER_STRETCH * entry->cost_us;
+    }
+    return deadline > entry->cost_us ? deadline - entry->cost_us : 0;
+}
+/*
+ * Does a order before b? 'promoted' is set for entries that waited longer
+ * than max_wait.
+ */
+static int
+entry_before (SCHEDULER_ENTRY const *a, int a_promoted,
+              SCHEDULER_ENTRY const *b, int b_promoted)
+{
+    UINT64 a_start, b_start;
+
+    if (a_promoted != b_promoted) {
+        return a_promoted;
+    }
+    if (!a_promoted && a->priority != b->priority) {
+        return a->priority > b->priority;
+    }
+    a_start = entry_latest_start (a);
+    b_start = entry_latest_start (b);
+    if (a_start != b_start) {
+        return a_start < b_start;
+    }
+    return a->arrival_us < b->arrival_us;
+}
+
+int
+scheduler_next (SCHEDULER *scheduler, UINT64 now_us, SCHEDULER_ENTRY *entry)
+{
+    size_t i, best = 0;
+    int promoted, best_promoted = 0;
+    UINT64 wait;
+
+    if (scheduler->count == 0) {
+        return 0;
+    }
+    for (i = 0; i < scheduler->count; ++i) {
+        promoted = now_us - scheduler->queue[i].arrival_us >=
+                   scheduler->max_wait_us;
+        if (i == 0 || entry_before (&scheduler->queue[i], promoted,
+                                    &scheduler->queue[best], best_promoted)) {
+            best = i;
+            best_promoted = promoted;
+        }
+    }
+    *entry = scheduler->queue[best];
+    scheduler->queue[best] = scheduler->queue[--scheduler->count];
+
+    wait = now_us - entry->arrival_us;
+    scheduler->stats.dispatched++;
+    scheduler->stats.depth = scheduler->count;
+    scheduler->stats.wait_total_us += wait;
+    if (wait > scheduler->stats.wait_max_us) {
+        scheduler->stats.wait_max_us = wait;
+    }
+    /* only count it if the priority order alone wouldn't have picked it */
+    if (best_promoted) {
+        for (i = 0; i < scheduler->count; ++i) {
+            if (entry_before (&scheduler->queue[i], 0, entry, 0)) {
+                scheduler->stats.promoted++;
+                break;
+            }
+        }
+    }
+    return 1;
+}
+
+void
+scheduler_complete (SCHEDULER *scheduler, SCHEDULER_ENTRY const *entry,
+                    UINT64 start_us, UINT64 end_us)
+{
+    UINT64 elapsed = end_us - start_us, *cost;
+
+    if (entry->deadline_us != 0 && end_us > entry->deadline_us) {
+        scheduler->stats.deadline_misses++;
+    }
+    if (!CC_VALID (entry->command_code)) {
+        return;
+    }
+    cost = &scheduler->cost_us[CC_INDEX (entry->command_code)];
+    if (elapsed == 0) {
+        elapsed = 1;
+    }
+    if (*cost == 0) {
+        *cost = elapsed;
+    } else {
+        *cost = *cost - (*cost >> COST_SHIFT) + (elapsed >> COST_SHIFT);
+    }
+}
+
+void
+scheduler_remove (SCHEDULER *scheduler, void *data)
+{
+    size_t i;
+
+    for (i = 0; i < scheduler->count; ++i) {
+        if (scheduler->queue[i].data == data) {
+            scheduler->queue[i] = scheduler->queue[--scheduler->count];
+            scheduler->stats.depth = scheduler->count;
+            return;
+        }
+    }
+}
+
+void
+scheduler_stats_print (SCHEDULER *scheduler, FILE *file)
+{
+    SCHEDULER_STATS *stats = &scheduler->stats;
+    size_t i;
+
+    fprintf (file, "queue depth: %zu (max %zu)\n", stats->depth,
+             stats->max_depth);
+    fprintf (file, "commands: %" PRIu64 " enqueued, %" PRIu64 " dispatched, "
+             "%" PRIu64 " promoted, %" PRIu64 " deadline misses\n",
+             stats->enqueued, stats->dispatched, stats->promoted,
+             stats->deadline_misses);
+    fprintf (file, "wait: %" PRIu64 " us mean, %" PRIu64 " us max\n",
+             stats->dispatched ? stats->wait_total_us / stats->dispatched : 0,
+             stats->wait_max_us);
+    for (i = 0; i < SCHEDULER_CC_COUNT; ++i) {
+        if (scheduler->cost_us[i] != 0) {
+            fprintf (file, "cost 0x%" PRIx32 ": %" PRIu64 " us\n",
+                     (UINT32)(i + TPM_CC_FIRST), scheduler->cost_us[i]);
+        }
+    }
+}
@@ -0,0 +1,100 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+#ifndef RESOURCEMGR_SCHEDULER_H
+#define RESOURCEMGR_SCHEDULER_H
+
+#include <stdio.h>
+
+#include "sapi/tpm20.h"
+
+/*
+ * Command scheduler for the resource manager. Every connection has at most
+ * one command waiting (the protocol is synchronous), the scheduler decides
+ * which of the waiting commands goes to the TPM next:
+ *
+ * - Higher priority first. A command that waited longer than max_wait is
+ *   promoted above all priorities so nothing starves.
+ * - Within a priority, the command with the earliest latest start time
+ *   (deadline - expected cost) first. Commands without a deadline get an
+ *   implicit one of SCHEDULER_STRETCH times their expected cost, so short
+ *   commands like GetRandom or PCR_Read overtake a waiting CreatePrimary.
+ * - Ties go to the earliest arrival.
+ *
+ * The expected cost of each command code starts from a static class (long,
+ * short or default) and is replaced by a moving average of the measured
+ * execution times once the command ran.
+ */
+#define SCHEDULER_MAX_ENTRIES 64
+#define SCHEDULER_STRETCH 4
+#define SCHEDULER_MAX_WAIT_DEFAULT_US 2000000ULL
+#define SCHEDULER_CC_COUNT (TPM_CC_LAST - TPM_CC_FIRST + 1)
+
+typedef struct {
+    void *data;             /* the connection */
+    TPM_CC command_code;
+    int priority;
+    UINT64 arrival_us;
+    UINT64 deadline_us;     /* absolute, 0 for none */
+    UINT64 cost_us;         /* expected cost when enqueued */
+} SCHEDULER_ENTRY;
+
+typedef struct {
+    UINT64 enqueued;
+    UINT64 dispatched;
+    UINT64 promoted;        /* dispatched because of max_wait */
+    UINT64 deadline_misses; /* completed after their deadline */
+    size_t depth;
+    size_t max_depth;
+    UINT64 wait_total_us;
+    UINT64 wait_max_us;
+} SCHEDULER_STATS;
+
+typedef struct {
+    SCHEDULER_ENTRY queue[SCHEDULER_MAX_ENTRIES];
+    size_t count;
+    UINT64 max_wait_us;
+    UINT64 cost_us[SCHEDULER_CC_COUNT];   /* 0 until measured */
+    SCHEDULER_STATS stats;
+} SCHEDULER;
+
+void scheduler_init (SCHEDULER *scheduler, UINT64 max_wait_us);
+/* Expected execution time of a command code. */
+UINT64 scheduler_cost (SCHEDULER *scheduler, TPM_CC command_code);
+/* Returns -1 when the queue is full. deadline_ms 0 means no deadline. */
+int scheduler_enqueue (SCHEDULER *scheduler, void *data, TPM_CC command_code,
+                       int priority, UINT32 deadline_ms, UINT64 now_us);
+/* Pick and dequeue the next command. Returns 0 when the queue is empty. */
+int scheduler_next (SCHEDULER *scheduler, UINT64 now_us,
+                    SCHEDULER_ENTRY *entry);
+/* Feed the measured execution time of a dispatched command back. */
+void scheduler_complete (SCHEDULER *scheduler, SCHEDULER_ENTRY const *entry,
+                         UINT64 start_us, UINT64 end_us);
+/* Drop the command of a connection that went away. */
+void scheduler_remove (SCHEDULER *scheduler, void *data);
+void scheduler_stats_print (SCHEDULER *scheduler, FILE *file);
+
+#endif /* RESOURCEMGR_SCHEDULER_H */
@@ -1,3 +1,4 @@
+#include <string.h>
 #include <unistd.h>
 #include <netinet/in.h>
 
@@ -64,6 +65,49 @@ TSS2_RC sendBytes( SOCKET tpmSock, const unsigned char *data, int len )
 }
 
 #define SAFE_CALL(func, ...) (func != NULL) ? func(__VA_ARGS__) : 0
+/*
+ * Connect both sockets to the AF_UNIX socket at 'path'. A server on the
+ * other end (like the resource manager) tells the TPM and platform
+ * connections apart by the commands sent on them.
+ */
+static int
+InitUnixSockets( const char *path,
+                 SOCKET *otherSock,
+                 SOCKET *tpmSock,
+                 TCTI_LOG_CALLBACK debugfunc,
+                 void* data )
+{
+    struct sockaddr_un service = { 0 };
+
+    if (strlen (path) >= sizeof (service.sun_path)) {
+        SAFE_CALL( debugfunc, data, NO_PREFIX, "socket path too long: %s\n", path );
+        return 1;
+    }
+    service.sun_family = AF_UNIX;
+    strcpy (service.sun_path, path);
+
+    *otherSock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (*otherSock == INVALID_SOCKET) {
+        SAFE_CALL( debugfunc, data, NO_PREFIX, "socket creation failed with error = %d\n", WSAGetLastError() );
+        return 1;
+    }
+    *tpmSock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (*tpmSock == INVALID_SOCKET) {
+        SAFE_CALL( debugfunc, data, NO_PREFIX, "socket creation failed with error = %d\n", WSAGetLastError() );
+        closesocket( *otherSock );
+        return 1;
+    }
+    if (connect(*otherSock, (SOCKADDR *) &service, sizeof (service)) == SOCKET_ERROR ||
+        connect(*tpmSock, (SOCKADDR *) &service, sizeof (service)) == SOCKET_ERROR) {
+        SAFE_CALL( debugfunc, data, NO_PREFIX, "connect function failed with error: %d\n", WSAGetLastError() );
+        CloseSockets( *otherSock, *tpmSock );
+        return 1;
+    }
+    SAFE_CALL( debugfunc, data, NO_PREFIX, "Client connected to server on path:  %s\n", path );
+
+    return 0;
+}
+
 int
 InitSockets( const char *hostName,
              UINT16 port,
@@ -76,6 +120,10 @@ InitSockets( const char *hostName,
     struct sockaddr_in tpmService = { 0 };
     int iResult = 0;            // used to return function results
 
+    if (hostName[0] == '/') {
+        return InitUnixSockets( hostName, otherSock, tpmSock, debugfunc, data );
+    }
+
     *otherSock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
     if (*otherSock == INVALID_SOCKET)
     {
@@ -0,0 +1,622 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+#include <string.h>
+
+#include "sapi/tpm20.h"
+#include "sapi/tss2_mu.h"
+#include "sysapi_util.h"
+#include "tcti/tcti_cache.h"
+
+#define TCTI_CACHE_MAGIC 0x5c3e8a17d2b04f91ULL
+
+#define TPM_HEADER_SIZE 10
+#define TPM_RC_OFFSET 6
+#define TPM_CC_OFFSET 6
+#define TPM_HANDLE_SIZE sizeof (TPM_HANDLE)
+
+#define HANDLE_TYPE(handle) ((handle) >> HR_SHIFT)
+
+enum { CACHE_STAGE_INITIALIZE, CACHE_STAGE_SEND, CACHE_STAGE_RECEIVE };
+
+/* what a cached response depends on, used to pick entries to invalidate */
+typedef enum {
+    CLASS_NONE = 0,
+    CLASS_CAPABILITY = 1 << 0,
+    CLASS_PUBLIC = 1 << 1,
+    CLASS_NV_PUBLIC = 1 << 2,
+    CLASS_PCR = 1 << 3,
+    CLASS_ALL = 0xf,
+} CACHE_CLASS;
+
+typedef struct {
+    UINT8 used;
+    CACHE_CLASS class;
+    /* object or NV index for CLASS_PUBLIC / CLASS_NV_PUBLIC */
+    TPM_HANDLE handle;
+    UINT64 last_used;
+    size_t key_size;
+    UINT8 key[TCTI_CACHE_KEY_MAX];
+    size_t response_size;
+    UINT8 response[MAX_RESPONSE_SIZE];
+} CACHE_ENTRY;
+
+typedef struct {
+    TSS2_TCTI_CONTEXT_COMMON_V1 common;
+    TSS2_TCTI_CONTEXT *downstream;
+    size_t max_entries;
+    UINT8 cache_pcrs;
+    UINT8 previousStage;
+    /* the command in flight, needed to handle its response */
+    TPM_CC command_code;
+    CACHE_CLASS command_class;
+    TPM_HANDLE command_handle;
+    size_t command_size;
+    UINT8 command[TCTI_CACHE_KEY_MAX];
+    CACHE_ENTRY *hit;
+    UINT64 tick;
+    TCTI_CACHE_STATS stats;
+    CACHE_ENTRY entries[TCTI_CACHE_MAX_ENTRIES];
+} TSS2_TCTI_CACHE_CONTEXT;
+
+static inline TSS2_TCTI_CACHE_CONTEXT*
+tcti_cache_context_cast (TSS2_TCTI_CONTEXT *ctx)
+{
+    return (TSS2_TCTI_CACHE_CONTEXT*)ctx;
+}
+
+static TSS2_RC
+tcti_cache_checks (TSS2_TCTI_CONTEXT *tctiContext)
+{
+    if (tctiContext == NULL) {
+        return TSS2_TCTI_RC_BAD_REFERENCE;
+    }
+    if (TSS2_TCTI_MAGIC (tctiContext) != TCTI_CACHE_MAGIC ||
+        TSS2_TCTI_VERSION (tctiContext) != 1) {
+        return TSS2_TCTI_RC_BAD_CONTEXT;
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+/*
+ * Drop the entries of the classes in 'class'. For CLASS_PUBLIC and
+ * CLASS_NV_PUBLIC only entries for 'handle' are dropped unless it is 0.
+ */
+static void
+cache_invalidate (TSS2_TCTI_CACHE_CONTEXT *ctx, CACHE_CLASS class,
+                  TPM_HANDLE handle)
+{
+    CACHE_ENTRY *entry;
+    size_t i;
+
+    for (i = 0; i < ctx->max_entries; ++i) {
+        entry = &ctx->entries[i];
+        if (!entry->used || !(entry->class & class)) {
+            continue;
+        }
+        if ((entry->class == CLASS_PUBLIC || entry->class == CLASS_NV_PUBLIC) &&
+            handle != 0 && entry->handle != handle) {
+            continue;
+        }
+        entry->used = 0;
+        ctx->stats.invalidations++;
+    }
+}
+
+static CACHE_ENTRY*
+cache_find (TSS2_TCTI_CACHE_CONTEXT *ctx, uint8_t *command, size_t size)
+{
+    size_t i;
+
+    for (i = 0; i < ctx->max_entries; ++i) {
+        if (ctx->entries[i].used && ctx->entries[i].key_size == size &&
+            memcmp (ctx->entries[i].key, command, size) == 0)
+            return &ctx->entries[i];
+    }
+
+    return NULL;
+}
+/*
+ * Take a free entry, evicting the least recently used one if there is none.
+ */
+static CACHE_ENTRY*
+cache_alloc (TSS2_TCTI_CACHE_CONTEXT *ctx)
+{
+    CACHE_ENTRY *lru = NULL;
+    size_t i;
+
+    for (i = 0; i < ctx->max_entries; ++i) {
+        if (!ctx->entries[i].used) {
+            return &ctx->entries[i];
+        }
+        if (lru == NULL || ctx->entries[i].last_used < lru->last_used) {
+            lru = &ctx->entries[i];
+        }
+    }
+    ctx->stats.evictions++;
+
+    return lru;
+}
+/*
+ * Capabilities that only change with firmware or on the commands treated as
+ * invalidating everything. Handles and variable TPM properties change all
+ * the time and are never cached.
+ */
+static int
+capability_cacheable (TPM_CAP capability)
+{
+    switch (capability) {
+    case TPM_CAP_ALGS:
+    case TPM_CAP_COMMANDS:
+    case TPM_CAP_PP_COMMANDS:
+    case TPM_CAP_AUDIT_COMMANDS:
+    case TPM_CAP_PCRS:
+    case TPM_CAP_TPM_PROPERTIES:
+    case TPM_CAP_PCR_PROPERTIES:
+    case TPM_CAP_ECC_CURVES:
+        return 1;
+    default:
+        return 0;
+    }
+}
+/*
+ * Work out whether the command may be answered from the cache and what
+ * its response depends on.
+ */
+static CACHE_CLASS
+command_classify (TSS2_TCTI_CACHE_CONTEXT *ctx, uint8_t *command, size_t size,
+                  TPM_HANDLE *handle)
+{
+    size_t offset = 0;
+    TPM_ST tag;
+    TPM_CC cc;
+    TPM_CAP capability;
+
+    if (size > TCTI_CACHE_KEY_MAX ||
+        Tss2_MU_TPM_ST_Unmarshal (command, size, &offset, &tag) !=
+        TSS2_RC_SUCCESS || tag != TPM_ST_NO_SESSIONS) {
+        return CLASS_NONE;
+    }
+    offset = TPM_CC_OFFSET;
+    if (Tss2_MU_TPM_CC_Unmarshal (command, size, &offset, &cc) !=
+        TSS2_RC_SUCCESS) {
+        return CLASS_NONE;
+    }
+    switch (cc) {
+    case TPM_CC_GetCapability:
+        if (Tss2_MU_UINT32_Unmarshal (command, size, &offset, &capability) !=
+            TSS2_RC_SUCCESS || !capability_cacheable (capability)) {
+            return CLASS_NONE;
+        }
+        return CLASS_CAPABILITY;
+    case TPM_CC_ReadPublic:
+    case TPM_CC_NV_ReadPublic:
+        if (Tss2_MU_UINT32_Unmarshal (command, size, &offset, handle) !=
+            TSS2_RC_SUCCESS) {
+            return CLASS_NONE;
+        }
+        return cc == TPM_CC_ReadPublic ? CLASS_PUBLIC : CLASS_NV_PUBLIC;
+    case TPM_CC_PCR_Read:
+        /* PCRs are extended behind our back unless told otherwise */
+        return ctx->cache_pcrs ? CLASS_PCR : CLASS_NONE;
+    default:
+        return CLASS_NONE;
+    }
+}
+/*
+ * A TPM property query starting in the fixed group may run on into the
+ * variable group, only keep responses holding fixed properties alone.
+ */
+static int
+response_cacheable (uint8_t *response, size_t size)
+{
+    size_t offset = TPM_HEADER_SIZE + sizeof (UINT8);
+    TPM_CAP capability;
+    UINT32 count, i;
+    TPM_PT property;
+    UINT32 value;
+
+    if (Tss2_MU_UINT32_Unmarshal (response, size, &offset, &capability) !=
+        TSS2_RC_SUCCESS) {
+        return 0;
+    }
+    if (capability != TPM_CAP_TPM_PROPERTIES) {
+        return 1;
+    }
+    if (Tss2_MU_UINT32_Unmarshal (response, size, &offset, &count) !=
+        TSS2_RC_SUCCESS) {
+        return 0;
+    }
+    for (i = 0; i < count; ++i) {
+        if (Tss2_MU_UINT32_Unmarshal (response, size, &offset, &property) !=
+            TSS2_RC_SUCCESS ||
+            Tss2_MU_UINT32_Unmarshal (response, size, &offset, &value) !=
+            TSS2_RC_SUCCESS ||
+            property >= PT_VAR) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+/*
+ * Drop the entries a successful command may have made stale. Commands that
+ * change the TPM configuration or its hierarchies drop everything.
+ */
+static void
+command_invalidate (TSS2_TCTI_CACHE_CONTEXT *ctx, uint8_t *command,
+                    size_t size)
+{
+    TPM_CC cc = ctx->command_code;
+    int count = GetNumCommandHandles (cc);
+    size_t offset;
+    TPM_HANDLE handle;
+    int i;
+
+    switch (cc) {
+    case TPM_CC_PCR_Extend:
+    case TPM_CC_PCR_Event:
+    case TPM_CC_PCR_Reset:
+    case TPM_CC_EventSequenceComplete:
+        cache_invalidate (ctx, CLASS_PCR, 0);
+        return;
+    case TPM_CC_NV_Write:
+    case TPM_CC_NV_Increment:
+    case TPM_CC_NV_Extend:
+    case TPM_CC_NV_SetBits:
+    case TPM_CC_NV_WriteLock:
+    case TPM_CC_NV_ReadLock:
+    case TPM_CC_NV_UndefineSpace:
+    case TPM_CC_NV_UndefineSpaceSpecial:
+        /* the written / locked index is in the handle area */
+        for (i = 0; i < count; ++i) {
+            offset = TPM_HEADER_SIZE + i * TPM_HANDLE_SIZE;
+            if (Tss2_MU_UINT32_Unmarshal (command, size, &offset, &handle) !=
+                TSS2_RC_SUCCESS) {
+                cache_invalidate (ctx, CLASS_NV_PUBLIC, 0);
+                return;
+            }
+            if (HANDLE_TYPE (handle) == TPM_HT_NV_INDEX) {
+                cache_invalidate (ctx, CLASS_NV_PUBLIC, handle);
+            }
+        }
+        return;
+    case TPM_CC_NV_DefineSpace:
+    case TPM_CC_NV_GlobalWriteLock:
+        cache_invalidate (ctx, CLASS_NV_PUBLIC, 0);
+        return;
+    case TPM_CC_FlushContext:
+    case TPM_CC_EvictControl:
+        offset = TPM_HEADER_SIZE + (cc == TPM_CC_EvictControl ?
+                                    TPM_HANDLE_SIZE : 0);
+        if (Tss2_MU_UINT32_Unmarshal (command, size, &offset, &handle) !=
+            TSS2_RC_SUCCESS) {
+            handle = 0;
+        }
+        cache_invalidate (ctx, CLASS_PUBLIC, handle);
+        /* the persistent handle is a parameter, drop all of them */
+        if (cc == TPM_CC_EvictControl) {
+            for (i = 0; i < (int)ctx->max_entries; ++i) {
+                if (ctx->entries[i].used &&
+                    ctx->entries[i].class == CLASS_PUBLIC &&
+                    HANDLE_TYPE (ctx->entries[i].handle) == TPM_HT_PERSISTENT) {
+                    ctx->entries[i].used = 0;
+                    ctx->stats.invalidations++;
+                }
+            }
+        }
+        return;
+    case TPM_CC_Startup:
+    case TPM_CC_Clear:
+    case TPM_CC_HierarchyControl:
+    case TPM_CC_ChangeEPS:
+    case TPM_CC_ChangePPS:
+    case TPM_CC_PCR_Allocate:
+    case TPM_CC_PP_Commands:
+    case TPM_CC_SetCommandCodeAuditStatus:
+    case TPM_CC_SetAlgorithmSet:
+    case TPM_CC_FieldUpgradeData:
+        cache_invalidate (ctx, CLASS_ALL, 0);
+        return;
+    default:
+        /* we can't know what vendor commands do */
+        if (cc & TPM_CC_Vendor_TCG_Test) {
+            cache_invalidate (ctx, CLASS_ALL, 0);
+        }
+        return;
+    }
+}
+
+TSS2_RC
+CacheTransmit (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    size_t size,
+    uint8_t *command)
+{
+    TSS2_TCTI_CACHE_CONTEXT *ctx = tcti_cache_context_cast (tctiContext);
+    size_t offset = TPM_CC_OFFSET;
+    TSS2_RC rc;
+
+    rc = tcti_cache_checks (tctiContext);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    if (command == NULL) {
+        return TSS2_TCTI_RC_BAD_REFERENCE;
+    }
+    if (ctx->previousStage == CACHE_STAGE_SEND) {
+        return TSS2_TCTI_RC_BAD_SEQUENCE;
+    }
+    rc = Tss2_MU_TPM_CC_Unmarshal (command, size, &offset, &ctx->command_code);
+    if (rc != TSS2_RC_SUCCESS) {
+        return TSS2_TCTI_RC_BAD_VALUE;
+    }
+    ctx->hit = NULL;
+    ctx->command_handle = 0;
+    ctx->command_class = command_classify (ctx, command, size,
+                                           &ctx->command_handle);
+    if (ctx->command_class == CLASS_NONE) {
+        ctx->stats.uncacheable++;
+    } else {
+        ctx->hit = cache_find (ctx, command, size);
+    }
+    if (ctx->hit != NULL) {
+        ctx->stats.hits++;
+        ctx->hit->last_used = ++ctx->tick;
+        ctx->previousStage = CACHE_STAGE_SEND;
+        return TSS2_RC_SUCCESS;
+    }
+    if (ctx->command_class != CLASS_NONE) {
+        ctx->stats.misses++;
+    }
+    /*
+     * Keep what we need to handle the response: the key of a cacheable
+     * command or the handle area of a mutating one.
+     */
+    ctx->command_size = size < sizeof (ctx->command) ?
+        size : sizeof (ctx->command);
+    memcpy (ctx->command, command, ctx->command_size);
+    rc = tss2_tcti_transmit (ctx->downstream, size, command);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    ctx->previousStage = CACHE_STAGE_SEND;
+
+    return TSS2_RC_SUCCESS;
+}
+/*
+ * Store the response to a cacheable command or drop the entries made stale
+ * by a mutating one.
+ */
+static void
+response_handle (TSS2_TCTI_CACHE_CONTEXT *ctx, size_t size, uint8_t *response)
+{
+    size_t offset = TPM_HEADER_SIZE;
+    TPM_HANDLE handle;
+    CACHE_ENTRY *entry;
+
+    if (ctx->command_class == CLASS_NONE) {
+        command_invalidate (ctx, ctx->command, ctx->command_size);
+        /* a new object may reuse the handle of one we have cached */
+        if (GetNumResponseHandles (ctx->command_code) > 0 &&
+            Tss2_MU_UINT32_Unmarshal (response, size, &offset, &handle) ==
+            TSS2_RC_SUCCESS) {
+            cache_invalidate (ctx, CLASS_PUBLIC, handle);
+        }
+        return;
+    }
+    if (size > sizeof (entry->response) ||
+        (ctx->command_class == CLASS_CAPABILITY &&
+         !response_cacheable (response, size))) {
+        return;
+    }
+    entry = cache_alloc (ctx);
+    entry->used = 1;
+    entry->class = ctx->command_class;
+    entry->handle = ctx->command_handle;
+    entry->last_used = ++ctx->tick;
+    entry->key_size = ctx->command_size;
+    memcpy (entry->key, ctx->command, ctx->command_size);
+    entry->response_size = size;
+    memcpy (entry->response, response, size);
+}
+
+TSS2_RC
+CacheReceive (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    size_t *response_size,
+    uint8_t *response,
+    int32_t timeout)
+{
+    TSS2_TCTI_CACHE_CONTEXT *ctx = tcti_cache_context_cast (tctiContext);
+    size_t offset = TPM_RC_OFFSET;
+    TPM_RC tpm_rc;
+    TSS2_RC rc;
+
+    rc = tcti_cache_checks (tctiContext);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    if (response_size == NULL || response == NULL) {
+        return TSS2_TCTI_RC_BAD_REFERENCE;
+    }
+    if (ctx->previousStage != CACHE_STAGE_SEND) {
+        return TSS2_TCTI_RC_BAD_SEQUENCE;
+    }
+    if (ctx->hit != NULL) {
+        if (*response_size < ctx->hit->response_size) {
+            *response_size = ctx->hit->response_size;
+            return TSS2_TCTI_RC_INSUFFICIENT_BUFFER;
+        }
+        memcpy (response, ctx->hit->response, ctx->hit->response_size);
+        *response_size = ctx->hit->response_size;
+        ctx->previousStage = CACHE_STAGE_RECEIVE;
+        return TSS2_RC_SUCCESS;
+    }
+    rc = tss2_tcti_receive (ctx->downstream, response_size, response, timeout);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    ctx->previousStage = CACHE_STAGE_RECEIVE;
+
+    rc = Tss2_MU_UINT32_Unmarshal (response, *response_size, &offset, &tpm_rc);
+    if (rc == TSS2_RC_SUCCESS && tpm_rc == TPM_RC_SUCCESS) {
+        response_handle (ctx, *response_size, response);
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
+void
+CacheFinalize (
+    TSS2_TCTI_CONTEXT *tctiContext)
+{
+    if (tcti_cache_checks (tctiContext) != TSS2_RC_SUCCESS) {
+        return;
+    }
+    /* the downstream TCTI belongs to the caller */
+    cache_invalidate (tcti_cache_context_cast (tctiContext), CLASS_ALL, 0);
+}
+
+TSS2_RC
+CacheCancel (
+    TSS2_TCTI_CONTEXT *tctiContext)
+{
+    TSS2_TCTI_CACHE_CONTEXT *ctx = tcti_cache_context_cast (tctiContext);
+    TSS2_RC rc = tcti_cache_checks (tctiContext);
+
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    if (ctx->hit != NULL) {
+        /* nothing to cancel, the response is already here */
+        return TSS2_RC_SUCCESS;
+    }
+    return tss2_tcti_cancel (ctx->downstream);
+}
+
+TSS2_RC
+CacheGetPollHandles (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    TSS2_TCTI_POLL_HANDLE *handles,
+    size_t *num_handles)
+{
+    TSS2_RC rc = tcti_cache_checks (tctiContext);
+
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    return tss2_tcti_get_poll_handles (
+        tcti_cache_context_cast (tctiContext)->downstream, handles, num_handles);
+}
+
+TSS2_RC
+CacheSetLocality (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    uint8_t locality)
+{
+    TSS2_RC rc = tcti_cache_checks (tctiContext);
+
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    return tss2_tcti_set_locality (
+        tcti_cache_context_cast (tctiContext)->downstream, locality);
+}
+
+TSS2_RC
+TctiCacheGetStats (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    TCTI_CACHE_STATS *stats)
+{
+    TSS2_RC rc;
+
+    rc = tcti_cache_checks (tctiContext);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    if (stats == NULL) {
+        return TSS2_TCTI_RC_BAD_REFERENCE;
+    }
+    *stats = tcti_cache_context_cast (tctiContext)->stats;
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+TctiCacheInvalidate (
+    TSS2_TCTI_CONTEXT *tctiContext)
+{
+    TSS2_RC rc;
+
+    rc = tcti_cache_checks (tctiContext);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    cache_invalidate (tcti_cache_context_cast (tctiContext), CLASS_ALL, 0);
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+InitCacheTcti (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    size_t *contextSize,
+    const TCTI_CACHE_CONF *config)
+{
+    TSS2_TCTI_CACHE_CONTEXT *ctx = tcti_cache_context_cast (tctiContext);
+
+    if (tctiContext == NULL && contextSize == NULL) {
+        return TSS2_TCTI_RC_BAD_VALUE;
+    } else if (tctiContext == NULL) {
+        *contextSize = sizeof (TSS2_TCTI_CACHE_CONTEXT);
+        return TSS2_RC_SUCCESS;
+    }
+    if (config == NULL || config->downstream == NULL ||
+        config->max_entries > TCTI_CACHE_MAX_ENTRIES) {
+        return TSS2_TCTI_RC_BAD_VALUE;
+    }
+    if (contextSize != NULL && *contextSize < sizeof (TSS2_TCTI_CACHE_CONTEXT)) {
+        return TSS2_TCTI_RC_INSUFFICIENT_BUFFER;
+    }
+
+    memset (ctx, 0, sizeof (*ctx));
+    TSS2_TCTI_MAGIC (tctiContext) = TCTI_CACHE_MAGIC;
+    TSS2_TCTI_VERSION (tctiContext) = 1;
+    TSS2_TCTI_TRANSMIT (tctiContext) = CacheTransmit;
+    TSS2_TCTI_RECEIVE (tctiContext) = CacheReceive;
+    TSS2_TCTI_FINALIZE (tctiContext) = CacheFinalize;
+    TSS2_TCTI_CANCEL (tctiContext) = CacheCancel;
+    TSS2_TCTI_GET_POLL_HANDLES (tctiContext) = CacheGetPollHandles;
+    TSS2_TCTI_SET_LOCALITY (tctiContext) = CacheSetLocality;
+    ctx->downstream = config->downstream;
+    ctx->max_entries = config->max_entries ?
+        config->max_entries : TCTI_CACHE_MAX_ENTRIES;
+    ctx->cache_pcrs = config->cache_pcrs ? 1 : 0;
+    ctx->previousStage = CACHE_STAGE_INITIALIZE;
+
+    return TSS2_RC_SUCCESS;
+}
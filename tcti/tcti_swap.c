@@ -0,0 +1,939 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+
+#include <string.h>
+
+#include "sapi/tpm20.h"
+#include "sapi/tss2_mu.h"
+#include "sysapi_util.h"
+#include "tcti/tcti_swap.h"
+
+#define TCTI_SWAP_MAGIC 0x2d5a7e2c4e9b1f63ULL
+#define TCTI_SWAP_VHANDLE_LAST (TCTI_SWAP_VHANDLE_FIRST | 0xffff)
+
+#define TPM_HEADER_SIZE 10
+#define TPM_RC_OFFSET 6
+#define TPM_CC_OFFSET 6
+#define TPM_HANDLE_SIZE sizeof (TPM_HANDLE)
+/* the only TPMA_SESSION bit we care about */
+#define SESSION_CONTINUE 0x01
+/* a command carries at most 3 handles and 3 authorization sessions */
+#define SWAP_MAX_CMD_HANDLES 3
+#define SWAP_MAX_CMD_SESSIONS 3
+
+#define HANDLE_TYPE(handle) ((handle) >> HR_SHIFT)
+#define HANDLE_IS_OBJECT(handle) (HANDLE_TYPE (handle) == TPM_HT_TRANSIENT)
+#define HANDLE_IS_SESSION(handle) \
+    (HANDLE_TYPE (handle) == TPM_HT_HMAC_SESSION || \
+     HANDLE_TYPE (handle) == TPM_HT_POLICY_SESSION)
+
+enum { SWAP_STAGE_INITIALIZE, SWAP_STAGE_SEND, SWAP_STAGE_RECEIVE };
+
+typedef enum {
+    ENTRY_FREE,
+    ENTRY_LOADED,
+    ENTRY_SAVED,
+} ENTRY_STATE;
+
+typedef struct {
+    ENTRY_STATE state;
+    UINT8 session;
+    UINT8 pinned;
+    /* referenced by the command in flight, must not be swapped out */
+    UINT8 locked;
+    /* a session the app saved itself, only the app holds its context */
+    UINT8 app_saved;
+    TPM_HANDLE vhandle;
+    TPM_HANDLE phandle;
+    UINT64 last_used;
+    TPMS_CONTEXT context;
+} SWAP_ENTRY;
+
+typedef struct {
+    TSS2_TCTI_CONTEXT_COMMON_V1 common;
+    TSS2_TCTI_CONTEXT *downstream;
+    size_t max_objects;
+    size_t max_sessions;
+    UINT8 previousStage;
+    /* bookkeeping for the command in flight, applied to its response */
+    TPM_CC command_code;
+    UINT8 response_local;
+    /* response code of a command answered without the TPM */
+    TPM_RC response_rc;
+    SWAP_ENTRY *dropped[SWAP_MAX_CMD_HANDLES + SWAP_MAX_CMD_SESSIONS];
+    size_t dropped_count;
+    /* session the app is saving with ContextSave */
+    SWAP_ENTRY *app_saving;
+    TPM_HANDLE next_vhandle;
+    UINT64 tick;
+    TCTI_SWAP_STATS stats;
+    UINT8 command[MAX_COMMAND_SIZE];
+    UINT8 scratch[MAX_RESPONSE_SIZE];
+    SWAP_ENTRY entries[TCTI_SWAP_MAX_ENTRIES];
+} TSS2_TCTI_SWAP_CONTEXT;
+
+static inline TSS2_TCTI_SWAP_CONTEXT*
+tcti_swap_context_cast (TSS2_TCTI_CONTEXT *ctx)
+{
+    return (TSS2_TCTI_SWAP_CONTEXT*)ctx;
+}
+
+static TSS2_RC
+tcti_swap_checks (TSS2_TCTI_CONTEXT *tctiContext)
+{
+    if (tctiContext == NULL) {
+        return TSS2_TCTI_RC_BAD_REFERENCE;
+    }
+    if (TSS2_TCTI_MAGIC (tctiContext) != TCTI_SWAP_MAGIC ||
+        TSS2_TCTI_VERSION (tctiContext) != 1) {
+        return TSS2_TCTI_RC_BAD_CONTEXT;
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
+static SWAP_ENTRY*
+entry_find (TSS2_TCTI_SWAP_CONTEXT *ctx, TPM_HANDLE vhandle)
+{
+    size_t i;
+
+    for (i = 0; i < TCTI_SWAP_MAX_ENTRIES; ++i) {
+        if (ctx->entries[i].state != ENTRY_FREE &&
+            ctx->entries[i].vhandle == vhandle)
+            return &ctx->entries[i];
+    }
+
+    return NULL;
+}
+
+static TPM_HANDLE
+vhandle_next (TSS2_TCTI_SWAP_CONTEXT *ctx)
+{
+    TPM_HANDLE vhandle;
+
+    do {
+        vhandle = ctx->next_vhandle;
+        if (ctx->next_vhandle == TCTI_SWAP_VHANDLE_LAST)
+            ctx->next_vhandle = TCTI_SWAP_VHANDLE_FIRST;
+        else
+            ctx->next_vhandle++;
+    } while (entry_find (ctx, vhandle) != NULL);
+
+    return vhandle;
+}
+
+static SWAP_ENTRY*
+entry_alloc (TSS2_TCTI_SWAP_CONTEXT *ctx, TPM_HANDLE phandle)
+{
+    SWAP_ENTRY *entry = NULL;
+    size_t i;
+
+    for (i = 0; i < TCTI_SWAP_MAX_ENTRIES; ++i) {
+        if (ctx->entries[i].state == ENTRY_FREE) {
+            entry = &ctx->entries[i];
+            break;
+        }
+    }
+    if (entry == NULL) {
+        return NULL;
+    }
+    memset (entry, 0, sizeof (*entry));
+    entry->state = ENTRY_LOADED;
+    entry->session = HANDLE_IS_SESSION (phandle);
+    entry->phandle = phandle;
+    /*
+     * session handles survive ContextSave / ContextLoad, no need to
+     * virtualize, handle_foreign keeps other users away from them
+     */
+    entry->vhandle = entry->session ? phandle : vhandle_next (ctx);
+    entry->last_used = ++ctx->tick;
+
+    return entry;
+}
+
+static size_t
+entry_count_loaded (TSS2_TCTI_SWAP_CONTEXT *ctx, UINT8 session)
+{
+    size_t i, count = 0;
+
+    for (i = 0; i < TCTI_SWAP_MAX_ENTRIES; ++i) {
+        if (ctx->entries[i].state == ENTRY_LOADED &&
+            ctx->entries[i].session == session)
+            ++count;
+    }
+
+    return count;
+}
+/*
+ * Send a command built in the scratch buffer to the downstream TCTI and
+ * wait for the response. The TPM response code is returned.
+ */
+static TSS2_RC
+swap_exchange (TSS2_TCTI_SWAP_CONTEXT *ctx, size_t size)
+{
+    size_t offset = sizeof (TPM_ST);
+    TPM_RC tpm_rc;
+    TSS2_RC rc;
+
+    rc = Tss2_MU_UINT32_Marshal (size, ctx->scratch, size, &offset);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    rc = tss2_tcti_transmit (ctx->downstream, size, ctx->scratch);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    size = sizeof (ctx->scratch);
+    rc = tss2_tcti_receive (ctx->downstream, &size, ctx->scratch,
+                            TSS2_TCTI_TIMEOUT_BLOCK);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    offset = TPM_RC_OFFSET;
+    rc = Tss2_MU_UINT32_Unmarshal (ctx->scratch, size, &offset, &tpm_rc);
+    if (rc != TSS2_RC_SUCCESS) {
+        return TSS2_TCTI_RC_MALFORMED_RESPONSE;
+    }
+
+    return tpm_rc;
+}
+
+static TSS2_RC
+swap_header (TSS2_TCTI_SWAP_CONTEXT *ctx, TPM_CC command_code, size_t *offset)
+{
+    TSS2_RC rc;
+
+    *offset = 0;
+    rc = Tss2_MU_TPM_ST_Marshal (TPM_ST_NO_SESSIONS, ctx->scratch,
+                                 sizeof (ctx->scratch), offset);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    *offset += sizeof (UINT32);
+    return Tss2_MU_TPM_CC_Marshal (command_code, ctx->scratch,
+                                   sizeof (ctx->scratch), offset);
+}
+
+static TSS2_RC
+swap_flush (TSS2_TCTI_SWAP_CONTEXT *ctx, TPM_HANDLE handle)
+{
+    size_t offset;
+    TSS2_RC rc;
+
+    rc = swap_header (ctx, TPM_CC_FlushContext, &offset);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    rc = Tss2_MU_UINT32_Marshal (handle, ctx->scratch, sizeof (ctx->scratch),
+                                 &offset);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+
+    return swap_exchange (ctx, offset);
+}
+/*
+ * Save an entry's context and, for objects, flush it from the TPM. Saving a
+ * session already evicts it from TPM memory.
+ */
+static TSS2_RC
+entry_save (TSS2_TCTI_SWAP_CONTEXT *ctx, SWAP_ENTRY *entry)
+{
+    size_t offset;
+    TSS2_RC rc;
+
+    rc = swap_header (ctx, TPM_CC_ContextSave, &offset);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    rc = Tss2_MU_UINT32_Marshal (entry->phandle, ctx->scratch,
+                                 sizeof (ctx->scratch), &offset);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    rc = swap_exchange (ctx, offset);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    offset = TPM_HEADER_SIZE;
+    rc = Tss2_MU_TPMS_CONTEXT_Unmarshal (ctx->scratch, sizeof (ctx->scratch),
+                                         &offset, &entry->context);
+    if (rc != TSS2_RC_SUCCESS) {
+        return TSS2_TCTI_RC_MALFORMED_RESPONSE;
+    }
+    if (!entry->session) {
+        rc = swap_flush (ctx, entry->phandle);
+        if (rc != TSS2_RC_SUCCESS) {
+            return rc;
+        }
+    }
+    entry->state = ENTRY_SAVED;
+    ctx->stats.saves++;
+
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+entry_load (TSS2_TCTI_SWAP_CONTEXT *ctx, SWAP_ENTRY *entry)
+{
+    size_t offset;
+    TSS2_RC rc;
+
+    rc = swap_header (ctx, TPM_CC_ContextLoad, &offset);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    rc = Tss2_MU_TPMS_CONTEXT_Marshal (&entry->context, ctx->scratch,
+                                       sizeof (ctx->scratch), &offset);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    rc = swap_exchange (ctx, offset);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    offset = TPM_HEADER_SIZE;
+    rc = Tss2_MU_UINT32_Unmarshal (ctx->scratch, sizeof (ctx->scratch),
+                                   &offset, &entry->phandle);
+    if (rc != TSS2_RC_SUCCESS) {
+        return TSS2_TCTI_RC_MALFORMED_RESPONSE;
+    }
+    entry->state = ENTRY_LOADED;
+    ctx->stats.loads++;
+
+    return TSS2_RC_SUCCESS;
+}
+/*
+ * Swap out the least recently used loaded entry of the given kind that
+ * isn't needed by the command in flight. Pinned entries go last.
+ */
+static TSS2_RC
+entry_evict (TSS2_TCTI_SWAP_CONTEXT *ctx, UINT8 session)
+{
+    SWAP_ENTRY *victim = NULL;
+    size_t i;
+
+    for (i = 0; i < TCTI_SWAP_MAX_ENTRIES; ++i) {
+        SWAP_ENTRY *entry = &ctx->entries[i];
+
+        if (entry->state != ENTRY_LOADED || entry->session != session ||
+            entry->locked)
+            continue;
+        if (victim == NULL ||
+            (victim->pinned && !entry->pinned) ||
+            (victim->pinned == entry->pinned &&
+             entry->last_used < victim->last_used))
+            victim = entry;
+    }
+    if (victim == NULL) {
+        return TSS2_TCTI_RC_INSUFFICIENT_BUFFER;
+    }
+
+    return entry_save (ctx, victim);
+}
+/*
+ * Make room for one more loaded entry of the given kind. If everything that
+ * is loaded is needed by the command in flight the TPM gets to decide.
+ */
+static TSS2_RC
+entry_make_room (TSS2_TCTI_SWAP_CONTEXT *ctx, UINT8 session)
+{
+    size_t max = session ? ctx->max_sessions : ctx->max_objects;
+    TSS2_RC rc;
+
+    while (entry_count_loaded (ctx, session) >= max) {
+        rc = entry_evict (ctx, session);
+        if (rc == TSS2_TCTI_RC_INSUFFICIENT_BUFFER) {
+            break;
+        } else if (rc != TSS2_RC_SUCCESS) {
+            return rc;
+        }
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+entry_use (TSS2_TCTI_SWAP_CONTEXT *ctx, SWAP_ENTRY *entry)
+{
+    TSS2_RC rc;
+
+    entry->locked = 1;
+    entry->last_used = ++ctx->tick;
+    if (entry->state == ENTRY_LOADED) {
+        ctx->stats.hits++;
+        return TSS2_RC_SUCCESS;
+    }
+    if (entry->app_saved) {
+        /* we have no context to load, the TPM tells the app off */
+        return TSS2_RC_SUCCESS;
+    }
+    ctx->stats.misses++;
+    rc = entry_make_room (ctx, entry->session);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+
+    return entry_load (ctx, entry);
+}
+/*
+ * Remember an entry that the TPM will have flushed if the command in flight
+ * succeeds. A command referencing more entries than a TPM command can hold
+ * is rejected rather than losing track of what the TPM flushed.
+ */
+static TSS2_RC
+entry_drop_pending (TSS2_TCTI_SWAP_CONTEXT *ctx, SWAP_ENTRY *entry)
+{
+    if (ctx->dropped_count >= sizeof (ctx->dropped) / sizeof (ctx->dropped[0])) {
+        return TSS2_TCTI_RC_BAD_VALUE;
+    }
+    ctx->dropped[ctx->dropped_count++] = entry;
+
+    return TSS2_RC_SUCCESS;
+}
+/*
+ * Objects and sessions that weren't created through this instance belong to
+ * another user of the TPM, commands referencing them are answered locally
+ * as if the handle didn't exist.
+ */
+static int
+handle_foreign (TSS2_TCTI_SWAP_CONTEXT *ctx, TPM_HANDLE handle, TPM_RC where,
+                size_t index)
+{
+    if (!HANDLE_IS_OBJECT (handle) && !HANDLE_IS_SESSION (handle)) {
+        return 0;
+    }
+    ctx->response_rc = TPM_RC_HANDLE + where + TPM_RC_1 * (index + 1);
+
+    return 1;
+}
+/*
+ * Translate / load the objects and sessions referenced in the handle area.
+ * Returns with *local set when the command can be answered without the TPM.
+ */
+static TSS2_RC
+command_handles (TSS2_TCTI_SWAP_CONTEXT *ctx, size_t size, int *local)
+{
+    TPM_CC cc = ctx->command_code;
+    int count = GetNumCommandHandles (cc);
+    size_t offset;
+    TPM_HANDLE handle;
+    SWAP_ENTRY *entry;
+    TSS2_RC rc;
+    int i;
+
+    for (i = 0; i < count; ++i) {
+        offset = TPM_HEADER_SIZE + i * TPM_HANDLE_SIZE;
+        rc = Tss2_MU_UINT32_Unmarshal (ctx->command, size, &offset, &handle);
+        if (rc != TSS2_RC_SUCCESS) {
+            return TSS2_TCTI_RC_BAD_VALUE;
+        }
+        entry = entry_find (ctx, handle);
+        if (entry == NULL) {
+            if (handle_foreign (ctx, handle, TPM_RC_H, i)) {
+                *local = 1;
+                return TSS2_RC_SUCCESS;
+            }
+            continue;
+        }
+        if (cc == TPM_CC_FlushContext) {
+            if (entry->state == ENTRY_SAVED && !entry->session) {
+                /* nothing in the TPM to flush */
+                entry->state = ENTRY_FREE;
+                *local = 1;
+                return TSS2_RC_SUCCESS;
+            }
+            /* saved sessions are flushed by handle, no need to load them */
+            rc = entry_drop_pending (ctx, entry);
+            if (rc != TSS2_RC_SUCCESS) {
+                return rc;
+            }
+        } else {
+            rc = entry_use (ctx, entry);
+            if (rc != TSS2_RC_SUCCESS) {
+                return rc;
+            }
+            if (cc == TPM_CC_ContextSave && entry->session) {
+                /* still ours to flush or load back, see SwapReceive */
+                ctx->app_saving = entry;
+            } else if ((cc == TPM_CC_SequenceComplete && i == 0) ||
+                       (cc == TPM_CC_EventSequenceComplete && i == 1)) {
+                rc = entry_drop_pending (ctx, entry);
+                if (rc != TSS2_RC_SUCCESS) {
+                    return rc;
+                }
+            }
+        }
+        offset -= TPM_HANDLE_SIZE;
+        rc = Tss2_MU_UINT32_Marshal (entry->phandle, ctx->command, size,
+                                     &offset);
+        if (rc != TSS2_RC_SUCCESS) {
+            return rc;
+        }
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+/*
+ * Load the sessions referenced in the authorization area. Sessions used
+ * without continueSession are gone once the command succeeds.
+ */
+static TSS2_RC
+command_sessions (TSS2_TCTI_SWAP_CONTEXT *ctx, size_t size, int *local)
+{
+    size_t offset = TPM_HEADER_SIZE +
+        GetNumCommandHandles (ctx->command_code) * TPM_HANDLE_SIZE;
+    UINT32 auth_size;
+    size_t end, index;
+    TSS2_RC rc;
+
+    rc = Tss2_MU_UINT32_Unmarshal (ctx->command, size, &offset, &auth_size);
+    if (rc != TSS2_RC_SUCCESS || auth_size > size - offset) {
+        return TSS2_TCTI_RC_BAD_VALUE;
+    }
+    end = offset + auth_size;
+    for (index = 0; offset < end; ++index) {
+        TPM_HANDLE handle;
+        UINT16 nonce_size, hmac_size;
+        UINT8 attributes;
+        SWAP_ENTRY *entry;
+
+        if (index >= SWAP_MAX_CMD_SESSIONS) {
+            return TSS2_TCTI_RC_BAD_VALUE;
+        }
+        rc = Tss2_MU_UINT32_Unmarshal (ctx->command, end, &offset, &handle);
+        if (rc == TSS2_RC_SUCCESS)
+            rc = Tss2_MU_UINT16_Unmarshal (ctx->command, end, &offset,
+                                           &nonce_size);
+        if (rc == TSS2_RC_SUCCESS && nonce_size > end - offset)
+            rc = TSS2_TCTI_RC_BAD_VALUE;
+        if (rc == TSS2_RC_SUCCESS) {
+            offset += nonce_size;
+            rc = Tss2_MU_UINT8_Unmarshal (ctx->command, end, &offset,
+                                          &attributes);
+        }
+        if (rc == TSS2_RC_SUCCESS)
+            rc = Tss2_MU_UINT16_Unmarshal (ctx->command, end, &offset,
+                                           &hmac_size);
+        if (rc != TSS2_RC_SUCCESS || hmac_size > end - offset) {
+            return TSS2_TCTI_RC_BAD_VALUE;
+        }
+        offset += hmac_size;
+
+        entry = entry_find (ctx, handle);
+        if (entry == NULL) {
+            if (handle_foreign (ctx, handle, TPM_RC_S, index)) {
+                *local = 1;
+                return TSS2_RC_SUCCESS;
+            }
+            continue;
+        }
+        rc = entry_use (ctx, entry);
+        if (rc != TSS2_RC_SUCCESS) {
+            return rc;
+        }
+        if (!(attributes & SESSION_CONTINUE)) {
+            rc = entry_drop_pending (ctx, entry);
+            if (rc != TSS2_RC_SUCCESS) {
+                return rc;
+            }
+        }
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+/*
+ * Commands that create a new object or session need a free slot for it.
+ */
+static TSS2_RC
+command_make_room (TSS2_TCTI_SWAP_CONTEXT *ctx, size_t size)
+{
+    /* TPMS_CONTEXT starts with the UINT64 sequence, then savedHandle */
+    size_t offset = TPM_HEADER_SIZE + sizeof (UINT64);
+    TPM_HANDLE handle;
+    TSS2_RC rc;
+
+    switch (ctx->command_code) {
+    case TPM_CC_StartAuthSession:
+        return entry_make_room (ctx, 1);
+    case TPM_CC_ContextLoad:
+        rc = Tss2_MU_UINT32_Unmarshal (ctx->command, size, &offset, &handle);
+        if (rc != TSS2_RC_SUCCESS) {
+            return TSS2_TCTI_RC_BAD_VALUE;
+        }
+        return entry_make_room (ctx, HANDLE_IS_SESSION (handle));
+    default:
+        if (GetNumResponseHandles (ctx->command_code) > 0)
+            return entry_make_room (ctx, 0);
+        return TSS2_RC_SUCCESS;
+    }
+}
+
+static void
+entries_unlock (TSS2_TCTI_SWAP_CONTEXT *ctx)
+{
+    size_t i;
+
+    for (i = 0; i < TCTI_SWAP_MAX_ENTRIES; ++i)
+        ctx->entries[i].locked = 0;
+}
+
+TSS2_RC
+SwapTransmit (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    size_t size,
+    uint8_t *command)
+{
+    TSS2_TCTI_SWAP_CONTEXT *ctx = tcti_swap_context_cast (tctiContext);
+    size_t offset = 0;
+    TPM_ST tag;
+    int local = 0;
+    TSS2_RC rc;
+
+    rc = tcti_swap_checks (tctiContext);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    if (command == NULL) {
+        return TSS2_TCTI_RC_BAD_REFERENCE;
+    }
+    if (ctx->previousStage == SWAP_STAGE_SEND) {
+        return TSS2_TCTI_RC_BAD_SEQUENCE;
+    }
+    if (size < TPM_HEADER_SIZE || size > sizeof (ctx->command)) {
+        return TSS2_TCTI_RC_BAD_VALUE;
+    }
+    /* handles are rewritten in a copy, the caller's buffer is left alone */
+    memcpy (ctx->command, command, size);
+    rc = Tss2_MU_TPM_ST_Unmarshal (ctx->command, size, &offset, &tag);
+    if (rc != TSS2_RC_SUCCESS) {
+        return TSS2_TCTI_RC_BAD_VALUE;
+    }
+    offset = TPM_CC_OFFSET;
+    rc = Tss2_MU_TPM_CC_Unmarshal (ctx->command, size, &offset,
+                                   &ctx->command_code);
+    if (rc != TSS2_RC_SUCCESS) {
+        return TSS2_TCTI_RC_BAD_VALUE;
+    }
+    ctx->dropped_count = 0;
+    ctx->app_saving = NULL;
+    ctx->response_local = 0;
+    ctx->response_rc = TPM_RC_SUCCESS;
+    entries_unlock (ctx);
+
+    rc = command_handles (ctx, size, &local);
+    if (rc == TSS2_RC_SUCCESS && !local && tag == TPM_ST_SESSIONS)
+        rc = command_sessions (ctx, size, &local);
+    if (rc == TSS2_RC_SUCCESS && !local)
+        rc = command_make_room (ctx, size);
+    if (rc == TSS2_RC_SUCCESS && !local)
+        rc = tss2_tcti_transmit (ctx->downstream, size, ctx->command);
+    if (rc != TSS2_RC_SUCCESS) {
+        entries_unlock (ctx);
+        return rc;
+    }
+    ctx->response_local = local;
+    ctx->previousStage = SWAP_STAGE_SEND;
+
+    return TSS2_RC_SUCCESS;
+}
+/*
+ * Track the object or session created by a successful command, replacing
+ * the physical handle in the response with its virtual handle.
+ */
+static TSS2_RC
+response_handle (TSS2_TCTI_SWAP_CONTEXT *ctx, size_t size, uint8_t *response)
+{
+    size_t offset = TPM_HEADER_SIZE;
+    TPM_HANDLE handle;
+    SWAP_ENTRY *entry;
+    TSS2_RC rc;
+
+    rc = Tss2_MU_UINT32_Unmarshal (response, size, &offset, &handle);
+    if (rc != TSS2_RC_SUCCESS) {
+        return TSS2_TCTI_RC_MALFORMED_RESPONSE;
+    }
+    if (!HANDLE_IS_OBJECT (handle) && !HANDLE_IS_SESSION (handle)) {
+        return TSS2_RC_SUCCESS;
+    }
+    /* a session the app saved itself is back under its old handle */
+    entry = entry_find (ctx, handle);
+    if (ctx->command_code == TPM_CC_ContextLoad && entry != NULL &&
+        entry->app_saved) {
+        entry->state = ENTRY_LOADED;
+        entry->app_saved = 0;
+        entry->last_used = ++ctx->tick;
+        return TSS2_RC_SUCCESS;
+    }
+    entry = entry_alloc (ctx, handle);
+    if (entry == NULL) {
+        /* we can't track it so don't leave it behind in the TPM */
+        swap_flush (ctx, handle);
+        return TSS2_TCTI_RC_GENERAL_FAILURE;
+    }
+    offset = TPM_HEADER_SIZE;
+
+    return Tss2_MU_UINT32_Marshal (entry->vhandle, response, size, &offset);
+}
+
+TSS2_RC
+SwapReceive (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    size_t *response_size,
+    uint8_t *response,
+    int32_t timeout)
+{
+    TSS2_TCTI_SWAP_CONTEXT *ctx = tcti_swap_context_cast (tctiContext);
+    size_t offset = 0, i;
+    TPM_RC tpm_rc;
+    TSS2_RC rc;
+
+    rc = tcti_swap_checks (tctiContext);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    if (response_size == NULL || response == NULL) {
+        return TSS2_TCTI_RC_BAD_REFERENCE;
+    }
+    if (ctx->previousStage != SWAP_STAGE_SEND) {
+        return TSS2_TCTI_RC_BAD_SEQUENCE;
+    }
+    if (ctx->response_local) {
+        if (*response_size < TPM_HEADER_SIZE) {
+            return TSS2_TCTI_RC_INSUFFICIENT_BUFFER;
+        }
+        Tss2_MU_TPM_ST_Marshal (TPM_ST_NO_SESSIONS, response, *response_size,
+                                &offset);
+        Tss2_MU_UINT32_Marshal (TPM_HEADER_SIZE, response, *response_size,
+                                &offset);
+        Tss2_MU_UINT32_Marshal (ctx->response_rc, response, *response_size,
+                                &offset);
+        *response_size = TPM_HEADER_SIZE;
+        ctx->previousStage = SWAP_STAGE_RECEIVE;
+        return TSS2_RC_SUCCESS;
+    }
+    rc = tss2_tcti_receive (ctx->downstream, response_size, response, timeout);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    ctx->previousStage = SWAP_STAGE_RECEIVE;
+    entries_unlock (ctx);
+
+    offset = TPM_RC_OFFSET;
+    rc = Tss2_MU_UINT32_Unmarshal (response, *response_size, &offset, &tpm_rc);
+    if (rc != TSS2_RC_SUCCESS || tpm_rc != TPM_RC_SUCCESS) {
+        return TSS2_RC_SUCCESS;
+    }
+    for (i = 0; i < ctx->dropped_count; ++i) {
+        ctx->dropped[i]->state = ENTRY_FREE;
+    }
+    if (ctx->app_saving != NULL) {
+        ctx->app_saving->state = ENTRY_SAVED;
+        ctx->app_saving->app_saved = 1;
+    }
+    if (GetNumResponseHandles (ctx->command_code) > 0) {
+        return response_handle (ctx, *response_size, response);
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
+void
+SwapFinalize (
+    TSS2_TCTI_CONTEXT *tctiContext)
+{
+    TSS2_TCTI_SWAP_CONTEXT *ctx = tcti_swap_context_cast (tctiContext);
+    size_t i;
+
+    if (tcti_swap_checks (tctiContext) != TSS2_RC_SUCCESS) {
+        return;
+    }
+    /*
+     * the downstream TCTI belongs to the caller, only clean up after us,
+     * sessions the app saved itself are the app's to flush
+     */
+    for (i = 0; i < TCTI_SWAP_MAX_ENTRIES; ++i) {
+        SWAP_ENTRY *entry = &ctx->entries[i];
+
+        if (entry->state == ENTRY_LOADED ||
+            (entry->state == ENTRY_SAVED && entry->session &&
+             !entry->app_saved))
+            swap_flush (ctx, entry->phandle);
+        entry->state = ENTRY_FREE;
+    }
+}
+
+TSS2_RC
+SwapCancel (
+    TSS2_TCTI_CONTEXT *tctiContext)
+{
+    TSS2_RC rc = tcti_swap_checks (tctiContext);
+
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    return tss2_tcti_cancel (tcti_swap_context_cast (tctiContext)->downstream);
+}
+
+TSS2_RC
+SwapGetPollHandles (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    TSS2_TCTI_POLL_HANDLE *handles,
+    size_t *num_handles)
+{
+    TSS2_RC rc = tcti_swap_checks (tctiContext);
+
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    return tss2_tcti_get_poll_handles (
+        tcti_swap_context_cast (tctiContext)->downstream, handles, num_handles);
+}
+
+TSS2_RC
+SwapSetLocality (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    uint8_t locality)
+{
+    TSS2_RC rc = tcti_swap_checks (tctiContext);
+
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    return tss2_tcti_set_locality (
+        tcti_swap_context_cast (tctiContext)->downstream, locality);
+}
+
+TSS2_RC
+TctiSwapPin (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    TPM_HANDLE handle,
+    int pinned)
+{
+    SWAP_ENTRY *entry;
+    TSS2_RC rc;
+
+    rc = tcti_swap_checks (tctiContext);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    entry = entry_find (tcti_swap_context_cast (tctiContext), handle);
+    if (entry == NULL) {
+        return TSS2_TCTI_RC_BAD_VALUE;
+    }
+    entry->pinned = pinned ? 1 : 0;
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+TctiSwapGetStats (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    TCTI_SWAP_STATS *stats)
+{
+    TSS2_RC rc;
+
+    rc = tcti_swap_checks (tctiContext);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    if (stats == NULL) {
+        return TSS2_TCTI_RC_BAD_REFERENCE;
+    }
+    *stats = tcti_swap_context_cast (tctiContext)->stats;
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+TctiSwapSaveAll (
+    TSS2_TCTI_CONTEXT *tctiContext)
+{
+    TSS2_TCTI_SWAP_CONTEXT *ctx = tcti_swap_context_cast (tctiContext);
+    size_t i;
+    TSS2_RC rc;
+
+    rc = tcti_swap_checks (tctiContext);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    if (ctx->previousStage == SWAP_STAGE_SEND) {
+        return TSS2_TCTI_RC_BAD_SEQUENCE;
+    }
+    for (i = 0; i < TCTI_SWAP_MAX_ENTRIES; ++i) {
+        if (ctx->entries[i].state != ENTRY_LOADED) {
+            continue;
+        }
+        rc = entry_save (ctx, &ctx->entries[i]);
+        if (rc != TSS2_RC_SUCCESS) {
+            return rc;
+        }
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+InitSwapTcti (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    size_t *contextSize,
+    const TCTI_SWAP_CONF *config)
+{
+    TSS2_TCTI_SWAP_CONTEXT *ctx = tcti_swap_context_cast (tctiContext);
+
+    if (tctiContext == NULL && contextSize == NULL) {
+        return TSS2_TCTI_RC_BAD_VALUE;
+    } else if (tctiContext == NULL) {
+        *contextSize = sizeof (TSS2_TCTI_SWAP_CONTEXT);
+        return TSS2_RC_SUCCESS;
+    }
+    if (config == NULL || config->downstream == NULL) {
+        return TSS2_TCTI_RC_BAD_VALUE;
+    }
+    if (contextSize != NULL && *contextSize < sizeof (TSS2_TCTI_SWAP_CONTEXT)) {
+        return TSS2_TCTI_RC_INSUFFICIENT_BUFFER;
+    }
+
+    memset (ctx, 0, sizeof (*ctx));
+    TSS2_TCTI_MAGIC (tctiContext) = TCTI_SWAP_MAGIC;
+    TSS2_TCTI_VERSION (tctiContext) = 1;
+    TSS2_TCTI_TRANSMIT (tctiContext) = SwapTransmit;
+    TSS2_TCTI_RECEIVE (tctiContext) = SwapReceive;
+    TSS2_TCTI_FINALIZE (tctiContext) = SwapFinalize;
+    TSS2_TCTI_CANCEL (tctiContext) = SwapCancel;
+    TSS2_TCTI_GET_POLL_HANDLES (tctiContext) = SwapGetPollHandles;
+    TSS2_TCTI_SET_LOCALITY (tctiContext) = SwapSetLocality;
+    ctx->downstream = config->downstream;
+    ctx->max_objects = config->max_loaded_objects ?
+        config->max_loaded_objects : MAX_LOADED_OBJECTS;
+    ctx->max_sessions = config->max_loaded_sessions ?
+        config->max_loaded_sessions : MAX_LOADED_SESSIONS;
+    ctx->next_vhandle = TCTI_SWAP_VHANDLE_FIRST;
+    ctx->previousStage = SWAP_STAGE_INITIALIZE;
+
+    return TSS2_RC_SUCCESS;
+}
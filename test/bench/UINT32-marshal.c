@@ -0,0 +1,44 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "sapi/tss2_mu.h"
+#include "log.h"
+
+/*
+ * Measure Tss2_MU_UINT32_Marshal throughput. This file is built once per
+ * marshal log level (MARSHAL_LOG_LEVEL) with the marshal code compiled in,
+ * so the numbers show what the compiled in log statements cost.
+ */
+#define ITERATIONS 50000000UL
+
+int
+main (int argc, char *argv[])
+{
+    struct timespec start, end;
+    uint8_t buffer[sizeof (UINT32)];
+    volatile uint8_t sink = 0;
+    size_t offset;
+    unsigned long i;
+    double ns;
+
+    clock_gettime (CLOCK_MONOTONIC, &start);
+    for (i = 0; i < ITERATIONS; ++i) {
+        offset = 0;
+        if (Tss2_MU_UINT32_Marshal ((UINT32)i, buffer, sizeof (buffer),
+                                    &offset) != TSS2_RC_SUCCESS) {
+            return 1;
+        }
+        sink ^= buffer[3];
+    }
+    clock_gettime (CLOCK_MONOTONIC, &end);
+
+    ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+    printf ("Tss2_MU_UINT32_Marshal MARSHAL_LOG_LEVEL=%s: %.2f ns/op, "
+            "%.1f MB/s\n",
+            level_to_str (MARSHAL_LOG_LEVEL),
+            ns / ITERATIONS,
+            ITERATIONS * sizeof (UINT32) / (ns / 1e9) / 1e6);
+
+    return 0;
+}
@@ -0,0 +1,526 @@
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sapi/tss2_mu.h"
+
+/*
+ * Measure Tss2_MU_*_Marshal / _Unmarshal for each type family with the
+ * payloads applications actually send: full RSA templates, max-count
+ * handle lists, multi-bank digest lists and so on. Every case is run until
+ * it took at least --min-time ms, the result is written to stdout as CSV
+ * (default) or JSON:
+ *
+ *   family,type,op,bytes,ns_per_op,mb_per_s
+ *
+ * With --baseline=FILE a previous CSV run is read back and every case that
+ * got more than --threshold percent slower is reported on stderr. The exit
+ * status is then 2, so CI can fail on regressions.
+ */
+#define MIN_TIME_MS_DEFAULT 200
+#define THRESHOLD_DEFAULT   10.0
+#define ITERATIONS_START    1000UL
+
+/* large enough and aligned for every type below */
+typedef union {
+    UINT64 u64;
+    TPM2B_MAX_BUFFER max_buffer;
+    TPM2B_PUBLIC pub;
+    TPMS_CONTEXT context;
+    TPMS_ATTEST attest;
+    TPML_HANDLE handles;
+    TPML_DIGEST_VALUES digests;
+    TPML_TAGGED_TPM_PROPERTY properties;
+    TPMT_SIGNATURE signature;
+} BENCH_STORAGE;
+#define BUFFER_SIZE sizeof (BENCH_STORAGE)
+
+typedef TSS2_RC (*BENCH_MARSHAL_FCN) (void const *src, UINT32 selector,
+    uint8_t buffer[], size_t buffer_size, size_t *offset);
+typedef TSS2_RC (*BENCH_UNMARSHAL_FCN) (uint8_t const buffer[],
+    size_t buffer_size, size_t *offset, UINT32 selector, void *dest);
+
+typedef struct {
+    char const *family;
+    char const *type;
+    BENCH_MARSHAL_FCN marshal;
+    BENCH_UNMARSHAL_FCN unmarshal;
+    void const *src;
+    UINT32 selector;
+} BENCH_CASE;
+
+typedef struct {
+    BENCH_CASE const *bcase;
+    char const *op;
+    size_t bytes;
+    double ns_per_op;
+} BENCH_RESULT;
+
+/*
+ * Adapters to a common signature: base and TPMA types are passed by value,
+ * TPMU types take a selector, everything else takes a pointer.
+ */
+#define BENCH_VALUE(type) \
+static TSS2_RC \
+type##_marshal (void const *src, UINT32 selector, uint8_t buffer[], \
+                size_t buffer_size, size_t *offset) \
+{ \
+    return Tss2_MU_##type##_Marshal (*(type const *)src, buffer, \
+                                     buffer_size, offset); \
+} \
+static TSS2_RC \
+type##_unmarshal (uint8_t const buffer[], size_t buffer_size, \
+                  size_t *offset, UINT32 selector, void *dest) \
+{ \
+    return Tss2_MU_##type##_Unmarshal (buffer, buffer_size, offset, dest); \
+}
+
+#define BENCH_POINTER(type) \
+static TSS2_RC \
+type##_marshal (void const *src, UINT32 selector, uint8_t buffer[], \
+                size_t buffer_size, size_t *offset) \
+{ \
+    return Tss2_MU_##type##_Marshal (src, buffer, buffer_size, offset); \
+} \
+static TSS2_RC \
+type##_unmarshal (uint8_t const buffer[], size_t buffer_size, \
+                  size_t *offset, UINT32 selector, void *dest) \
+{ \
+    return Tss2_MU_##type##_Unmarshal (buffer, buffer_size, offset, dest); \
+}
+
+#define BENCH_SELECTOR(type) \
+static TSS2_RC \
+type##_marshal (void const *src, UINT32 selector, uint8_t buffer[], \
+                size_t buffer_size, size_t *offset) \
+{ \
+    return Tss2_MU_##type##_Marshal (src, selector, buffer, buffer_size, \
+                                     offset); \
+} \
+static TSS2_RC \
+type##_unmarshal (uint8_t const buffer[], size_t buffer_size, \
+                  size_t *offset, UINT32 selector, void *dest) \
+{ \
+    return Tss2_MU_##type##_Unmarshal (buffer, buffer_size, offset, \
+                                       selector, dest); \
+}
+
+BENCH_VALUE (UINT8)
+BENCH_VALUE (UINT16)
+BENCH_VALUE (UINT32)
+BENCH_VALUE (UINT64)
+BENCH_VALUE (TPMA_OBJECT)
+BENCH_VALUE (TPMA_SESSION)
+BENCH_POINTER (TPM2B_DIGEST)
+BENCH_POINTER (TPM2B_MAX_BUFFER)
+BENCH_POINTER (TPMS_CLOCK_INFO)
+BENCH_POINTER (TPMS_CONTEXT)
+BENCH_POINTER (TPMS_ATTEST)
+BENCH_POINTER (TPML_HANDLE)
+BENCH_POINTER (TPML_DIGEST_VALUES)
+BENCH_POINTER (TPML_PCR_SELECTION)
+BENCH_POINTER (TPML_TAGGED_TPM_PROPERTY)
+BENCH_POINTER (TPMT_HA)
+BENCH_POINTER (TPMT_PUBLIC)
+BENCH_POINTER (TPMT_SIGNATURE)
+BENCH_SELECTOR (TPMU_HA)
+BENCH_SELECTOR (TPMU_PUBLIC_PARMS)
+
+/*
+ * TPM2B types wrapping a structure refuse to unmarshal into a dest with a
+ * non-zero size, reset it like a caller reusing the structure would.
+ */
+static TSS2_RC
+TPM2B_PUBLIC_marshal (void const *src, UINT32 selector, uint8_t buffer[],
+                      size_t buffer_size, size_t *offset)
+{
+    return Tss2_MU_TPM2B_PUBLIC_Marshal (src, buffer, buffer_size, offset);
+}
+static TSS2_RC
+TPM2B_PUBLIC_unmarshal (uint8_t const buffer[], size_t buffer_size,
+                        size_t *offset, UINT32 selector, void *dest)
+{
+    ((TPM2B_PUBLIC *)dest)->t.size = 0;
+    return Tss2_MU_TPM2B_PUBLIC_Unmarshal (buffer, buffer_size, offset, dest);
+}
+
+#define BENCH_CASE_INIT(family, type, src, selector) \
+    { family, #type, type##_marshal, type##_unmarshal, src, selector }
+
+static UINT8 u8 = 0x5a;
+static UINT16 u16 = 0x1234;
+static UINT32 u32 = 0x12345678;
+static UINT64 u64 = 0x123456789abcdef0ULL;
+static TPMA_OBJECT attr_object;
+static TPMA_SESSION attr_session;
+static TPM2B_DIGEST digest;
+static TPM2B_MAX_BUFFER max_buffer;
+static TPM2B_PUBLIC rsa_public;
+static TPMS_CLOCK_INFO clock_info;
+static TPMS_CONTEXT context;
+static TPMS_ATTEST quote;
+static TPML_HANDLE handles;
+static TPML_DIGEST_VALUES digests;
+static TPML_PCR_SELECTION pcr_selection;
+static TPML_TAGGED_TPM_PROPERTY properties;
+static TPMT_HA ha;
+static TPMT_SIGNATURE signature;
+
+static const TPMI_ALG_HASH banks[] = {
+    TPM_ALG_SHA1, TPM_ALG_SHA256, TPM_ALG_SHA384, TPM_ALG_SHA512,
+};
+static const UINT16 bank_sizes[] = {
+    SHA1_DIGEST_SIZE, SHA256_DIGEST_SIZE, SHA384_DIGEST_SIZE,
+    SHA512_DIGEST_SIZE,
+};
+#define BANK_COUNT (sizeof (banks) / sizeof (banks[0]))
+
+static const BENCH_CASE cases[] = {
+    BENCH_CASE_INIT ("base", UINT8, &u8, 0),
+    BENCH_CASE_INIT ("base", UINT16, &u16, 0),
+    BENCH_CASE_INIT ("base", UINT32, &u32, 0),
+    BENCH_CASE_INIT ("base", UINT64, &u64, 0),
+    BENCH_CASE_INIT ("TPMA", TPMA_OBJECT, &attr_object, 0),
+    BENCH_CASE_INIT ("TPMA", TPMA_SESSION, &attr_session, 0),
+    BENCH_CASE_INIT ("TPM2B", TPM2B_DIGEST, &digest, 0),
+    BENCH_CASE_INIT ("TPM2B", TPM2B_MAX_BUFFER, &max_buffer, 0),
+    BENCH_CASE_INIT ("TPM2B", TPM2B_PUBLIC, &rsa_public, 0),
+    BENCH_CASE_INIT ("TPMS", TPMS_CLOCK_INFO, &clock_info, 0),
+    BENCH_CASE_INIT ("TPMS", TPMS_CONTEXT, &context, 0),
+    BENCH_CASE_INIT ("TPMS", TPMS_ATTEST, &quote, 0),
+    BENCH_CASE_INIT ("TPML", TPML_HANDLE, &handles, 0),
+    BENCH_CASE_INIT ("TPML", TPML_DIGEST_VALUES, &digests, 0),
+    BENCH_CASE_INIT ("TPML", TPML_PCR_SELECTION, &pcr_selection, 0),
+    BENCH_CASE_INIT ("TPML", TPML_TAGGED_TPM_PROPERTY, &properties, 0),
+    BENCH_CASE_INIT ("TPMT", TPMT_HA, &ha, 0),
+    BENCH_CASE_INIT ("TPMT", TPMT_PUBLIC, &rsa_public.t.publicArea, 0),
+    BENCH_CASE_INIT ("TPMT", TPMT_SIGNATURE, &signature, 0),
+    BENCH_CASE_INIT ("TPMU", TPMU_HA, &digests.digests[3].digest,
+                     TPM_ALG_SHA512),
+    BENCH_CASE_INIT ("TPMU", TPMU_PUBLIC_PARMS,
+                     &rsa_public.t.publicArea.parameters, TPM_ALG_RSA),
+};
+#define CASE_COUNT (sizeof (cases) / sizeof (cases[0]))
+
+static void
+payloads_init (void)
+{
+    TPMT_PUBLIC *pub = &rsa_public.t.publicArea;
+    size_t i;
+
+    attr_object.fixedTPM = 1;
+    attr_object.fixedParent = 1;
+    attr_object.sensitiveDataOrigin = 1;
+    attr_object.userWithAuth = 1;
+    attr_object.restricted = 1;
+    attr_object.decrypt = 1;
+    attr_session.continueSession = 1;
+
+    digest.t.size = SHA256_DIGEST_SIZE;
+    memset (digest.t.buffer, 0xa5, digest.t.size);
+    max_buffer.t.size = MAX_DIGEST_BUFFER;
+    memset (max_buffer.t.buffer, 0x5a, max_buffer.t.size);
+
+    /* RSA 2048 storage key template as returned by ReadPublic */
+    pub->type = TPM_ALG_RSA;
+    pub->nameAlg = TPM_ALG_SHA256;
+    pub->objectAttributes = attr_object;
+    pub->authPolicy.t.size = SHA256_DIGEST_SIZE;
+    memset (pub->authPolicy.t.buffer, 0x11, SHA256_DIGEST_SIZE);
+    pub->parameters.rsaDetail.symmetric.algorithm = TPM_ALG_AES;
+    pub->parameters.rsaDetail.symmetric.keyBits.aes = 128;
+    pub->parameters.rsaDetail.symmetric.mode.aes = TPM_ALG_CFB;
+    pub->parameters.rsaDetail.scheme.scheme = TPM_ALG_NULL;
+    pub->parameters.rsaDetail.keyBits = 2048;
+    pub->unique.rsa.t.size = 256;
+    memset (pub->unique.rsa.t.buffer, 0x22, 256);
+
+    clock_info.clock = 0x0102030405060708ULL;
+    clock_info.resetCount = 3;
+    clock_info.restartCount = 7;
+    clock_info.safe = YES;
+
+    context.sequence = 0x1000;
+    context.savedHandle = 0x80000000;
+    context.hierarchy = TPM_RH_OWNER;
+    context.contextBlob.t.size = 900;
+    memset (context.contextBlob.t.buffer, 0x33, 900);
+
+    for (i = 0; i < BANK_COUNT; ++i) {
+        pcr_selection.pcrSelections[i].hash = banks[i];
+        pcr_selection.pcrSelections[i].sizeofSelect = 3;
+        memset (pcr_selection.pcrSelections[i].pcrSelect, 0xff, 3);
+        digests.digests[i].hashAlg = banks[i];
+        memset (&digests.digests[i].digest, 0x44, bank_sizes[i]);
+    }
+    pcr_selection.count = BANK_COUNT;
+    digests.count = BANK_COUNT;
+
+    handles.count = MAX_CAP_HANDLES;
+    for (i = 0; i < MAX_CAP_HANDLES; ++i) {
+        handles.handle[i] = 0x81000000 + i;
+    }
+
+    /* a full page of TPM_CAP_TPM_PROPERTIES from GetCapability */
+    properties.count = MAX_TPM_PROPERTIES;
+    for (i = 0; i < MAX_TPM_PROPERTIES; ++i) {
+        properties.tpmProperty[i].property = PT_FIXED + i;
+        properties.tpmProperty[i].value = 0x1000 + i;
+    }
+
+    quote.magic = TPM_GENERATED_VALUE;
+    quote.type = TPM_ST_ATTEST_QUOTE;
+    quote.qualifiedSigner.t.size = 2 + SHA256_DIGEST_SIZE;
+    quote.extraData.t.size = SHA256_DIGEST_SIZE;
+    quote.clockInfo = clock_info;
+    quote.firmwareVersion = 0x2000000000000ULL;
+    quote.attested.quote.pcrSelect = pcr_selection;
+    quote.attested.quote.pcrDigest.t.size = SHA256_DIGEST_SIZE;
+
+    ha.hashAlg = TPM_ALG_SHA256;
+
+    signature.sigAlg = TPM_ALG_RSASSA;
+    signature.signature.rsassa.hash = TPM_ALG_SHA256;
+    signature.signature.rsassa.sig.t.size = 256;
+}
+
+static double
+elapsed_ns (struct timespec *start, struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1e9 +
+           (end->tv_nsec - start->tv_nsec);
+}
+
+/*
+ * Run one case, doubling the iteration count until the loop took at least
+ * min_ns. Returns ns/op or a negative value if a marshal call failed.
+ */
+static double
+bench_marshal (BENCH_CASE const *bcase, uint8_t *buffer, size_t *bytes,
+               double min_ns)
+{
+    struct timespec start, end;
+    volatile uint8_t sink = 0;
+    unsigned long i, iterations;
+    size_t offset = 0;
+    double ns;
+
+    for (iterations = ITERATIONS_START; ; iterations *= 2) {
+        clock_gettime (CLOCK_MONOTONIC, &start);
+        for (i = 0; i < iterations; ++i) {
+            offset = 0;
+            if (bcase->marshal (bcase->src, bcase->selector, buffer,
+                                BUFFER_SIZE, &offset) != TSS2_RC_SUCCESS) {
+                return -1;
+            }
+            sink ^= buffer[offset - 1];
+        }
+        clock_gettime (CLOCK_MONOTONIC, &end);
+        ns = elapsed_ns (&start, &end);
+        if (ns >= min_ns) {
+            break;
+        }
+    }
+    *bytes = offset;
+    return ns / iterations;
+}
+
+static double
+bench_unmarshal (BENCH_CASE const *bcase, uint8_t const *buffer,
+                 size_t bytes, void *dest, double min_ns)
+{
+    struct timespec start, end;
+    volatile uint8_t sink = 0;
+    unsigned long i, iterations;
+    size_t offset;
+    double ns;
+
+    for (iterations = ITERATIONS_START; ; iterations *= 2) {
+        clock_gettime (CLOCK_MONOTONIC, &start);
+        for (i = 0; i < iterations; ++i) {
+            offset = 0;
+            if (bcase->unmarshal (buffer, bytes, &offset, bcase->selector,
+                                  dest) != TSS2_RC_SUCCESS) {
+                return -1;
+            }
+            sink ^= ((uint8_t *)dest)[0];
+        }
+        clock_gettime (CLOCK_MONOTONIC, &end);
+        ns = elapsed_ns (&start, &end);
+        if (ns >= min_ns) {
+            break;
+        }
+    }
+    return ns / iterations;
+}
+
+static double
+mb_per_s (BENCH_RESULT const *result)
+{
+    return result->bytes / result->ns_per_op * 1e9 / 1e6;
+}
+
+static void
+print_csv (BENCH_RESULT const *results, size_t count)
+{
+    size_t i;
+
+    printf ("family,type,op,bytes,ns_per_op,mb_per_s\n");
+    for (i = 0; i < count; ++i) {
+        printf ("%s,%s,%s,%zu,%.2f,%.1f\n", results[i].bcase->family,
+                results[i].bcase->type, results[i].op, results[i].bytes,
+                results[i].ns_per_op, mb_per_s (&results[i]));
+    }
+}
+
+static void
+print_json (BENCH_RESULT const *results, size_t count)
+{
+    size_t i;
+
+    printf ("[\n");
+    for (i = 0; i < count; ++i) {
+        printf ("  { \"family\": \"%s\", \"type\": \"%s\", \"op\": \"%s\", "
+                "\"bytes\": %zu, \"ns_per_op\": %.2f, \"mb_per_s\": %.1f }%s\n",
+                results[i].bcase->family, results[i].bcase->type,
+                results[i].op, results[i].bytes, results[i].ns_per_op,
+                mb_per_s (&results[i]), i + 1 < count ? "," : "");
+    }
+    printf ("]\n");
+}
+
+/*
+ * Compare against a CSV file written by a previous run. Cases missing from
+ * the baseline are skipped. Returns the number of regressions.
+ */
+static int
+compare_baseline (char const *path, BENCH_RESULT const *results,
+                  size_t count, double threshold)
+{
+    char line[256], type[64], op[16];
+    double base_ns, delta;
+    int regressions = 0;
+    FILE *file;
+    size_t i;
+
+    file = fopen (path, "r");
+    if (file == NULL) {
+        perror (path);
+        return -1;
+    }
+    while (fgets (line, sizeof (line), file) != NULL) {
+        if (sscanf (line, "%*[^,],%63[^,],%15[^,],%*u,%lf", type, op,
+                    &base_ns) != 3 || base_ns <= 0) {
+            continue;
+        }
+        for (i = 0; i < count; ++i) {
+            if (strcmp (results[i].bcase->type, type) != 0 ||
+                strcmp (results[i].op, op) != 0) {
+                continue;
+            }
+            delta = (results[i].ns_per_op - base_ns) / base_ns * 100;
+            if (delta > threshold) {
+                fprintf (stderr, "regression: %s %s %.2f ns/op -> %.2f "
+                         "ns/op (+%.1f%%)\n", type, op, base_ns,
+                         results[i].ns_per_op, delta);
+                ++regressions;
+            }
+        }
+    }
+    fclose (file);
+    return regressions;
+}
+
+static void
+usage (char const *name)
+{
+    fprintf (stderr, "usage: %s [--format=csv|json] [--min-time=MS] "
+             "[--baseline=FILE] [--threshold=PERCENT]\n", name);
+}
+
+int
+main (int argc, char *argv[])
+{
+    static const struct option options[] = {
+        { "format", required_argument, NULL, 'f' },
+        { "min-time", required_argument, NULL, 'm' },
+        { "baseline", required_argument, NULL, 'b' },
+        { "threshold", required_argument, NULL, 't' },
+        { NULL, 0, NULL, 0 },
+    };
+    static BENCH_RESULT results[CASE_COUNT * 2];
+    static uint8_t buffer[BUFFER_SIZE];
+    static BENCH_STORAGE dest;
+    char const *format = "csv", *baseline = NULL;
+    double min_ns = MIN_TIME_MS_DEFAULT * 1e6, threshold = THRESHOLD_DEFAULT;
+    size_t i, count = 0, bytes = 0;
+    int c, regressions;
+
+    while ((c = getopt_long (argc, argv, "f:m:b:t:", options, NULL)) != -1) {
+        switch (c) {
+        case 'f':
+            format = optarg;
+            break;
+        case 'm':
+            min_ns = strtod (optarg, NULL) * 1e6;
+            break;
+        case 'b':
+            baseline = optarg;
+            break;
+        case 't':
+            threshold = strtod (optarg, NULL);
+            break;
+        default:
+            usage (argv[0]);
+            return 1;
+        }
+    }
+    if (strcmp (format, "csv") != 0 && strcmp (format, "json") != 0) {
+        usage (argv[0]);
+        return 1;
+    }
+
+    payloads_init ();
+    for (i = 0; i < CASE_COUNT; ++i) {
+        results[count].bcase = &cases[i];
+        results[count].op = "marshal";
+        results[count].ns_per_op = bench_marshal (&cases[i], buffer, &bytes,
+                                                  min_ns);
+        if (results[count].ns_per_op < 0) {
+            fprintf (stderr, "%s marshal failed\n", cases[i].type);
+            return 1;
+        }
+        results[count].bytes = bytes;
+        ++count;
+
+        results[count].bcase = &cases[i];
+        results[count].op = "unmarshal";
+        results[count].bytes = bytes;
+        results[count].ns_per_op = bench_unmarshal (&cases[i], buffer, bytes,
+                                                    &dest, min_ns);
+        if (results[count].ns_per_op < 0) {
+            fprintf (stderr, "%s unmarshal failed\n", cases[i].type);
+            return 1;
+        }
+        ++count;
+    }
+
+    if (strcmp (format, "json") == 0) {
+        print_json (results, count);
+    } else {
+        print_csv (results, count);
+    }
+
+    if (baseline != NULL) {
+        regressions = compare_baseline (baseline, results, count, threshold);
+        if (regressions < 0) {
+            return 1;
+        } else if (regressions > 0) {
+            return 2;
+        }
+    }
+    return 0;
+}
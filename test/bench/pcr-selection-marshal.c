@@ -0,0 +1,77 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "sapi/tss2_mu.h"
+
+/*
+ * Measure Tss2_MU_TPML_PCR_SELECTION_Marshal / _Unmarshal for a selection
+ * of all 24 PCRs in the SHA1, SHA256, SHA384 and SHA512 banks, as sent with
+ * PCR_Read, Quote, PolicyPCR and CreatePrimary's creationPCR.
+ */
+#define ITERATIONS 5000000UL
+
+static const TPMI_ALG_HASH banks[] = {
+    TPM_ALG_SHA1, TPM_ALG_SHA256, TPM_ALG_SHA384, TPM_ALG_SHA512,
+};
+
+static double
+elapsed_ns (struct timespec *start, struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1e9 +
+           (end->tv_nsec - start->tv_nsec);
+}
+
+int
+main (int argc, char *argv[])
+{
+    TPML_PCR_SELECTION sel = { 0 }, out = { 0 };
+    struct timespec start, end;
+    uint8_t buffer[sizeof (sel)];
+    volatile uint8_t sink = 0;
+    size_t offset, size;
+    unsigned long i;
+    double ns;
+
+    sel.count = sizeof (banks) / sizeof (banks[0]);
+    for (i = 0; i < sel.count; ++i) {
+        sel.pcrSelections[i].hash = banks[i];
+        sel.pcrSelections[i].sizeofSelect = 3;
+        sel.pcrSelections[i].pcrSelect[0] = 0xff;
+        sel.pcrSelections[i].pcrSelect[1] = 0xff;
+        sel.pcrSelections[i].pcrSelect[2] = 0xff;
+    }
+
+    clock_gettime (CLOCK_MONOTONIC, &start);
+    for (i = 0; i < ITERATIONS; ++i) {
+        offset = 0;
+        if (Tss2_MU_TPML_PCR_SELECTION_Marshal (&sel, buffer, sizeof (buffer),
+                                                &offset) != TSS2_RC_SUCCESS) {
+            return 1;
+        }
+        sink ^= buffer[offset - 1];
+    }
+    clock_gettime (CLOCK_MONOTONIC, &end);
+    size = offset;
+    ns = elapsed_ns (&start, &end);
+    printf ("Tss2_MU_TPML_PCR_SELECTION_Marshal (%zu bytes): %.2f ns/op, "
+            "%.1f MB/s\n", size, ns / ITERATIONS,
+            ITERATIONS * size / (ns / 1e9) / 1e6);
+
+    clock_gettime (CLOCK_MONOTONIC, &start);
+    for (i = 0; i < ITERATIONS; ++i) {
+        offset = 0;
+        if (Tss2_MU_TPML_PCR_SELECTION_Unmarshal (buffer, size, &offset,
+                                                  &out) != TSS2_RC_SUCCESS) {
+            return 1;
+        }
+        sink ^= out.pcrSelections[3].pcrSelect[2];
+    }
+    clock_gettime (CLOCK_MONOTONIC, &end);
+    ns = elapsed_ns (&start, &end);
+    printf ("Tss2_MU_TPML_PCR_SELECTION_Unmarshal (%zu bytes): %.2f ns/op, "
+            "%.1f MB/s\n", size, ns / ITERATIONS,
+            ITERATIONS * size / (ns / 1e9) / 1e6);
+
+    return 0;
+}
@@ -66,6 +66,7 @@
 
 #include "tcti/tcti_device.h"
 #include "tcti/tcti_socket.h"
+#include "util/tpm_info.h"
 #include "syscontext.h"
 #include "common/debug.h"
 
@@ -323,20 +324,41 @@ TSS2_RC TpmReset()
     return rval;
 }
 
+/*
+ * The TPM properties are fetched once into a Tss2_TpmInfo snapshot, the
+ * helpers below look them up without further round trips.
+ */
+static TPM_INFO *GetTpmInfo()
+{
+    static TPM_INFO *tpmInfo = 0;
+    TPM_INFO_CONF conf = { .sys_context = sysContext };
+    TSS2_RC rval;
+    size_t size;
+
+    if( tpmInfo == 0 )
+    {
+        rval = Tss2_TpmInfo_Init( 0, &size, &conf );
+        CheckPassed( rval );
+        tpmInfo = malloc( size );
+        if( tpmInfo == 0 )
+        {
+            DebugPrintf( NO_PREFIX, "Failed to allocate TPM info!!\n" );
+            Cleanup();
+        }
+        rval = Tss2_TpmInfo_Init( tpmInfo, &size, &conf );
+        CheckPassed( rval );
+    }
+    return tpmInfo;
+}
+
 void GetTpmVersion()
 {
     TSS2_RC rval = TSS2_RC_SUCCESS;
-    TPMS_CAPABILITY_DATA capabilityData;
 
-    rval = Tss2_Sys_GetCapability( sysContext, 0,
-            TPM_CAP_TPM_PROPERTIES, TPM_PT_REVISION,
-            1, 0, &capabilityData, 0 );
-    CheckPassed( rval );
-
-    if( capabilityData.data.tpmProperties.count == 1 &&
-            (capabilityData.data.tpmProperties.tpmProperty[0].property == TPM_PT_REVISION) )
+    rval = Tss2_TpmInfo_GetProperty( GetTpmInfo(), TPM_PT_REVISION,
+            &tpmSpecVersion );
+    if( rval == TSS2_RC_SUCCESS )
     {
-        tpmSpecVersion = capabilityData.data.tpmProperties.tpmProperty[0].value;
         DebugPrintf( NO_PREFIX, "TPM spec version:  %d\n", tpmSpecVersion );
     }
     else
@@ -349,19 +371,10 @@ void GetTpmVersion()
 void GetTpmManufacturer()
 {
     TSS2_RC rval = TSS2_RC_SUCCESS;
-    TPMS_CAPABILITY_DATA capabilityData;
-
-    rval = Tss2_Sys_GetCapability( sysContext, 0,
-            TPM_CAP_TPM_PROPERTIES, TPM_PT_MANUFACTURER,
-            1, 0, &capabilityData, 0 );
-    CheckPassed( rval );
 
-    if( capabilityData.data.tpmProperties.count == 1 &&
-            (capabilityData.data.tpmProperties.tpmProperty[0].property == TPM_PT_MANUFACTURER ) )
-    {
-        tpmManufacturer = capabilityData.data.tpmProperties.tpmProperty[0].value;
-    }
-    else
+    rval = Tss2_TpmInfo_GetProperty( GetTpmInfo(), TPM_PT_MANUFACTURER,
+            &tpmManufacturer );
+    if( rval != TSS2_RC_SUCCESS )
     {
         DebugPrintf( NO_PREFIX, "Failed to get TPM manufacturer!!\n" );
         Cleanup();
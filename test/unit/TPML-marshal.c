@@ -3,6 +3,7 @@
 #include <setjmp.h>
 #include <cmocka.h>
 #include <stdio.h>
+#include <string.h>
 #include <sapi/tss2_mu.h>
 #include <marshal/tss2_endian.h>
 
@@ -458,6 +459,98 @@ tpml_unmarshal_invalid_count(void **state)
     assert_int_equal (rc, TSS2_SYS_RC_MALFORMED_RESPONSE);
 }
 
+/*
+ * Long lists of plain values round trip through the bulk byte swap path,
+ * including the elements left over after the last full vector.
+ */
+static void
+tpml_marshal_unmarshal_array(void **state)
+{
+    TPML_HANDLE hndl = {0}, hndl_out = {0};
+    TPML_ALG alg = {0}, alg_out = {0};
+    uint8_t buffer[sizeof(hndl) + sizeof(alg)] = { 0 };
+    size_t offset = 0, offset_out = 0;
+    UINT32 i, value;
+    UINT16 value16;
+    TSS2_RC rc;
+
+    hndl.count = 37;
+    for (i = 0; i < hndl.count; i++)
+        hndl.handle[i] = 0x81000000 + i;
+    alg.count = 13;
+    for (i = 0; i < alg.count; i++)
+        alg.algorithms[i] = 0x0100 + i;
+
+    rc = Tss2_MU_TPML_HANDLE_Marshal(&hndl, buffer, sizeof(buffer), &offset);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (offset, 4 + 37 * 4);
+    rc = Tss2_MU_TPML_ALG_Marshal(&alg, buffer, sizeof(buffer), &offset);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (offset, 4 + 37 * 4 + 4 + 13 * 2);
+
+    memcpy(&value, &buffer[4 + 36 * 4], sizeof(value));
+    assert_int_equal (value, HOST_TO_BE_32(0x81000024));
+    memcpy(&value16, &buffer[4 + 37 * 4 + 4], sizeof(value16));
+    assert_int_equal (value16, HOST_TO_BE_16(0x0100));
+
+    rc = Tss2_MU_TPML_HANDLE_Unmarshal(buffer, offset, &offset_out, &hndl_out);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = Tss2_MU_TPML_ALG_Unmarshal(buffer, offset, &offset_out, &alg_out);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (offset_out, offset);
+    assert_int_equal (hndl_out.count, hndl.count);
+    assert_memory_equal (hndl_out.handle, hndl.handle, hndl.count * sizeof(hndl.handle[0]));
+    assert_int_equal (alg_out.count, alg.count);
+    assert_memory_equal (alg_out.algorithms, alg.algorithms, alg.count * sizeof(alg.algorithms[0]));
+
+    /* One element short */
+    offset_out = 0;
+    rc = Tss2_MU_TPML_HANDLE_Unmarshal(buffer, 4 + 36 * 4, &offset_out, &hndl_out);
+    assert_int_equal (rc, TSS2_TYPES_RC_INSUFFICIENT_BUFFER);
+    assert_int_equal (offset_out, 0);
+}
+
+/*
+ * PCR selections are validated as a whole: a bitmap cut short by the end
+ * of the buffer is rejected without consuming anything.
+ */
+static void
+tpml_pcr_selection_truncated(void **state)
+{
+    TPML_PCR_SELECTION sel = {0}, sel_out = {0};
+    uint8_t buffer[4 + 2 * (2 + 1 + 3)] = { 0 };
+    size_t offset = 0;
+    TSS2_RC rc;
+
+    sel.count = 2;
+    sel.pcrSelections[0].hash = TPM_ALG_SHA1;
+    sel.pcrSelections[0].sizeofSelect = 3;
+    sel.pcrSelections[0].pcrSelect[2] = 0x80;
+    sel.pcrSelections[1].hash = TPM_ALG_SHA256;
+    sel.pcrSelections[1].sizeofSelect = 3;
+    sel.pcrSelections[1].pcrSelect[0] = 0x01;
+
+    rc = Tss2_MU_TPML_PCR_SELECTION_Marshal(&sel, buffer, sizeof(buffer) - 1, &offset);
+    assert_int_equal (rc, TSS2_TYPES_RC_INSUFFICIENT_BUFFER);
+    assert_int_equal (offset, 0);
+
+    rc = Tss2_MU_TPML_PCR_SELECTION_Marshal(&sel, buffer, sizeof(buffer), &offset);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (offset, sizeof(buffer));
+
+    offset = 0;
+    rc = Tss2_MU_TPML_PCR_SELECTION_Unmarshal(buffer, sizeof(buffer) - 1, &offset, &sel_out);
+    assert_int_equal (rc, TSS2_TYPES_RC_INSUFFICIENT_BUFFER);
+    assert_int_equal (offset, 0);
+
+    rc = Tss2_MU_TPML_PCR_SELECTION_Unmarshal(buffer, sizeof(buffer), &offset, &sel_out);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (offset, sizeof(buffer));
+    assert_int_equal (sel_out.pcrSelections[0].pcrSelect[2], 0x80);
+    assert_int_equal (sel_out.pcrSelections[1].hash, TPM_ALG_SHA256);
+    assert_int_equal (sel_out.pcrSelections[1].pcrSelect[0], 0x01);
+}
+
 int main(void) {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test (tpml_marshal_success),
@@ -472,6 +565,8 @@ int main(void) {
         cmocka_unit_test (tpml_unmarshal_dest_null_offset_valid),
         cmocka_unit_test (tpml_unmarshal_buffer_size_lt_data_nad_lt_offset),
         cmocka_unit_test (tpml_unmarshal_invalid_count),
+        cmocka_unit_test (tpml_marshal_unmarshal_array),
+        cmocka_unit_test (tpml_pcr_selection_truncated),
     };
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
@@ -180,6 +180,50 @@ tpms_marshal_buffer_size_lt_data_nad_lt_offset(void **state)
     assert_int_equal (offset, 2);
 }
 
+/*
+ * Fixed layout structures are encoded in one go after a single bounds check
+ */
+static void
+tpms_marshal_fixed_layout(void **state)
+{
+    TPMS_TIME_ATTEST_INFO info = {0};
+    uint8_t buffer[8 + 8 + 4 + 4 + 1 + 8 + 2] = { 0 };
+    uint8_t expected[sizeof(buffer)] = {
+        0x00, 0x00,
+        0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+        0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18,
+        0x21, 0x22, 0x23, 0x24,
+        0x31, 0x32, 0x33, 0x34,
+        0x01,
+        0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    };
+    uint8_t untouched[sizeof(buffer)] = { 0 };
+    size_t offset = 2;
+    TSS2_RC rc;
+
+    info.time.time = 0x0102030405060708ULL;
+    info.time.clockInfo.clock = 0x1112131415161718ULL;
+    info.time.clockInfo.resetCount = 0x21222324;
+    info.time.clockInfo.restartCount = 0x31323334;
+    info.time.clockInfo.safe = 1;
+    info.firmwareVersion = 0x4142434445464748ULL;
+
+    rc = Tss2_MU_TPMS_TIME_ATTEST_INFO_Marshal(&info, buffer, sizeof(buffer) - 1, &offset);
+    assert_int_equal (rc, TSS2_TYPES_RC_INSUFFICIENT_BUFFER);
+    assert_int_equal (offset, 2);
+    assert_memory_equal (buffer, untouched, sizeof(buffer));
+
+    rc = Tss2_MU_TPMS_TIME_ATTEST_INFO_Marshal(&info, buffer, sizeof(buffer), &offset);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (offset, sizeof(buffer));
+    assert_memory_equal (buffer, expected, sizeof(buffer));
+
+    offset = 2;
+    rc = Tss2_MU_TPMS_TIME_ATTEST_INFO_Marshal(&info, NULL, 0, &offset);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (offset, sizeof(buffer));
+}
+
 /*
  * Success case
  */
@@ -343,6 +387,7 @@ int main(void) {
         cmocka_unit_test (tpms_marshal_buffer_null_with_offset),
         cmocka_unit_test (tpms_marshal_buffer_null_offset_null),
         cmocka_unit_test (tpms_marshal_buffer_size_lt_data_nad_lt_offset),
+        cmocka_unit_test (tpms_marshal_fixed_layout),
         cmocka_unit_test (tpms_unmarshal_success),
         cmocka_unit_test (tpms_unmarshal_dest_null_buff_null),
         cmocka_unit_test (tpms_unmarshal_buffer_null_offset_null),
@@ -0,0 +1,240 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <openssl/evp.h>
+
+#include "sapi/tpm20.h"
+#include "sapi/tss2_mu.h"
+#include "util/audit_digest.h"
+
+#define SYS_CONTEXT ((TSS2_SYS_CONTEXT*)0x1)
+
+/*
+ * Fake SAPI state: the wrapped functions hand out whatever command code and
+ * parameter buffers the test sets up here.
+ */
+static struct {
+    UINT8 command_code[4];
+    UINT8 cp_buffer[8];
+    UINT8 rp_buffer[8];
+    TSS2_RC rp_rc;
+} sapi;
+
+TSS2_RC
+__wrap_Tss2_Sys_GetCommandCode (TSS2_SYS_CONTEXT *sysContext,
+                                UINT8 (*commandCode)[4])
+{
+    memcpy (*commandCode, sapi.command_code, 4);
+    return TSS2_RC_SUCCESS;
+}
+TPM_RC
+__wrap_Tss2_Sys_GetCpBuffer (TSS2_SYS_CONTEXT *sysContext,
+                             size_t *cpBufferUsedSize,
+                             const uint8_t **cpBuffer)
+{
+    *cpBuffer = sapi.cp_buffer;
+    *cpBufferUsedSize = sizeof (sapi.cp_buffer);
+    return TSS2_RC_SUCCESS;
+}
+TPM_RC
+__wrap_Tss2_Sys_GetRpBuffer (TSS2_SYS_CONTEXT *sysContext,
+                             size_t *rpBufferUsedSize,
+                             const uint8_t **rpBuffer)
+{
+    if (sapi.rp_rc != TSS2_RC_SUCCESS)
+        return sapi.rp_rc;
+    *rpBuffer = sapi.rp_buffer;
+    *rpBufferUsedSize = sizeof (sapi.rp_buffer);
+    return TSS2_RC_SUCCESS;
+}
+
+static void
+sha256 (const UINT8 *a, size_t a_size,
+        const UINT8 *b, size_t b_size,
+        const UINT8 *c, size_t c_size,
+        UINT8 *digest)
+{
+    EVP_MD_CTX *ctx = EVP_MD_CTX_create ();
+
+    assert_non_null (ctx);
+    EVP_DigestInit_ex (ctx, EVP_sha256 (), NULL);
+    EVP_DigestUpdate (ctx, a, a_size);
+    EVP_DigestUpdate (ctx, b, b_size);
+    EVP_DigestUpdate (ctx, c, c_size);
+    EVP_DigestFinal_ex (ctx, digest, NULL);
+    EVP_MD_CTX_destroy (ctx);
+}
+/* Expected digest after one audited command, computed independently. */
+static void
+expected_extend (UINT8 *digest, size_t digest_size, const TPM2B_NAME *name)
+{
+    UINT8 buf[2 * SHA256_DIGEST_SIZE];
+    UINT8 cp_hash[SHA256_DIGEST_SIZE], rp_hash[SHA256_DIGEST_SIZE];
+    UINT8 header[4 + 4 + sizeof (name->t.name)];
+    UINT8 zero[4] = { 0 };
+    size_t header_size;
+
+    memcpy (header, sapi.command_code, 4);
+    memcpy (&header[4], name->t.name, name->t.size);
+    header_size = 4 + name->t.size;
+    sha256 (header, header_size, sapi.cp_buffer, sizeof (sapi.cp_buffer),
+            NULL, 0, cp_hash);
+    sha256 (zero, 4, sapi.command_code, 4, sapi.rp_buffer,
+            sizeof (sapi.rp_buffer), rp_hash);
+    memcpy (buf, cp_hash, SHA256_DIGEST_SIZE);
+    memcpy (&buf[SHA256_DIGEST_SIZE], rp_hash, SHA256_DIGEST_SIZE);
+    sha256 (digest, digest_size, buf, sizeof (buf), NULL, 0, digest);
+}
+
+static int
+audit_digest_setup (void **state)
+{
+    UINT8 cc[4] = { 0x00, 0x00, 0x01, 0x5d };
+
+    memset (&sapi, 0, sizeof (sapi));
+    memcpy (sapi.command_code, cc, sizeof (cc));
+    memset (sapi.cp_buffer, 0xc1, sizeof (sapi.cp_buffer));
+    memset (sapi.rp_buffer, 0x5e, sizeof (sapi.rp_buffer));
+    return 0;
+}
+/*
+ * Session audit digests start as zeros, the command audit digest empty.
+ */
+static void
+audit_digest_init_test (void **state)
+{
+    UINT8 zero[SHA256_DIGEST_SIZE] = { 0 };
+    AUDIT_DIGEST audit;
+    TSS2_RC rc;
+
+    rc = Tss2_AuditDigest_Init (&audit, AUDIT_DIGEST_SESSION, TPM_ALG_SHA256);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (audit.digest.t.size, SHA256_DIGEST_SIZE);
+    assert_memory_equal (audit.digest.t.buffer, zero, sizeof (zero));
+    rc = Tss2_AuditDigest_Init (&audit, AUDIT_DIGEST_COMMAND, TPM_ALG_SHA256);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (audit.digest.t.size, 0);
+    rc = Tss2_AuditDigest_Init (&audit, AUDIT_DIGEST_COMMAND, TPM_ALG_NULL);
+    assert_int_equal (rc, TSS2_UTIL_RC_BAD_VALUE);
+}
+/*
+ * Two audited commands give H(H(0 || cp || rp) || cp || rp).
+ */
+static void
+audit_digest_extend_test (void **state)
+{
+    TPM2B_NAME name = { .t.size = 4, .t.name = { 0x40, 0x00, 0x00, 0x01 } };
+    UINT8 expected[SHA256_DIGEST_SIZE] = { 0 };
+    AUDIT_DIGEST audit;
+    TPM2B_DIGEST digest;
+    int i;
+    TSS2_RC rc;
+
+    Tss2_AuditDigest_Init (&audit, AUDIT_DIGEST_SESSION, TPM_ALG_SHA256);
+    for (i = 0; i < 2; ++i) {
+        rc = Tss2_AuditDigest_Command (&audit, SYS_CONTEXT, &name, 1);
+        assert_int_equal (rc, TSS2_RC_SUCCESS);
+        rc = Tss2_AuditDigest_Response (&audit, SYS_CONTEXT);
+        assert_int_equal (rc, TSS2_RC_SUCCESS);
+        expected_extend (expected, sizeof (expected), &name);
+    }
+    rc = Tss2_AuditDigest_Get (&audit, &digest);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (digest.t.size, SHA256_DIGEST_SIZE);
+    assert_memory_equal (digest.t.buffer, expected, sizeof (expected));
+    assert_int_equal (audit.count, 2);
+}
+/*
+ * A response without a command is a sequence error, failed commands
+ * don't change the digest.
+ */
+static void
+audit_digest_sequence_test (void **state)
+{
+    AUDIT_DIGEST audit;
+    TPM2B_DIGEST before, after;
+    TSS2_RC rc;
+
+    Tss2_AuditDigest_Init (&audit, AUDIT_DIGEST_SESSION, TPM_ALG_SHA256);
+    rc = Tss2_AuditDigest_Response (&audit, SYS_CONTEXT);
+    assert_int_equal (rc, TSS2_UTIL_RC_BAD_SEQUENCE);
+
+    Tss2_AuditDigest_Get (&audit, &before);
+    rc = Tss2_AuditDigest_Command (&audit, SYS_CONTEXT, NULL, 0);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    sapi.rp_rc = TSS2_SYS_RC_BAD_SEQUENCE;
+    rc = Tss2_AuditDigest_Response (&audit, SYS_CONTEXT);
+    assert_int_equal (rc, TSS2_SYS_RC_BAD_SEQUENCE);
+    Tss2_AuditDigest_Get (&audit, &after);
+    assert_memory_equal (&after, &before, sizeof (before));
+    rc = Tss2_AuditDigest_Response (&audit, SYS_CONTEXT);
+    assert_int_equal (rc, TSS2_UTIL_RC_BAD_SEQUENCE);
+}
+
+static void
+attest_marshal (TPMS_ATTEST *attest, TPM2B_ATTEST *audit_info)
+{
+    size_t offset = 0;
+    TSS2_RC rc;
+
+    rc = Tss2_MU_TPMS_ATTEST_Marshal (attest,
+                                      audit_info->t.attestationData,
+                                      sizeof (audit_info->t.attestationData),
+                                      &offset);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    audit_info->t.size = offset;
+}
+/*
+ * The local digest matches the one in the TPM's attestation structure
+ * only if the digests and the attestation type agree.
+ */
+static void
+audit_digest_verify_test (void **state)
+{
+    TPMS_ATTEST attest = {
+        .magic = TPM_GENERATED_VALUE,
+        .type = TPM_ST_ATTEST_SESSION_AUDIT,
+    };
+    TPM2B_ATTEST audit_info;
+    AUDIT_DIGEST audit;
+    TSS2_RC rc;
+
+    Tss2_AuditDigest_Init (&audit, AUDIT_DIGEST_SESSION, TPM_ALG_SHA256);
+    Tss2_AuditDigest_Command (&audit, SYS_CONTEXT, NULL, 0);
+    Tss2_AuditDigest_Response (&audit, SYS_CONTEXT);
+
+    attest.attested.sessionAudit.sessionDigest = audit.digest;
+    attest_marshal (&attest, &audit_info);
+    rc = Tss2_AuditDigest_Verify (&audit, &audit_info);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+    attest.attested.sessionAudit.sessionDigest.t.buffer[0] ^= 0xff;
+    attest_marshal (&attest, &audit_info);
+    rc = Tss2_AuditDigest_Verify (&audit, &audit_info);
+    assert_int_equal (rc, TSS2_UTIL_RC_BAD_VALUE);
+
+    attest.type = TPM_ST_ATTEST_COMMAND_AUDIT;
+    attest.attested.commandAudit.digestAlg = TPM_ALG_SHA256;
+    attest.attested.commandAudit.auditDigest = audit.digest;
+    attest_marshal (&attest, &audit_info);
+    rc = Tss2_AuditDigest_Verify (&audit, &audit_info);
+    assert_int_equal (rc, TSS2_UTIL_RC_BAD_VALUE);
+}
+
+int
+main (int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test (audit_digest_init_test),
+        cmocka_unit_test_setup (audit_digest_extend_test,
+                                audit_digest_setup),
+        cmocka_unit_test_setup (audit_digest_sequence_test,
+                                audit_digest_setup),
+        cmocka_unit_test_setup (audit_digest_verify_test,
+                                audit_digest_setup),
+    };
+    return cmocka_run_group_tests (tests, NULL, NULL);
+}
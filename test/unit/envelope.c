@@ -0,0 +1,445 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "sapi/tpm20.h"
+#include "util/envelope.h"
+
+#define PARENT_HANDLE 0x81000001
+#define OBJECT_HANDLE 0x80000001
+#define SYS_CONTEXT   ((TSS2_SYS_CONTEXT*)0x1)
+#define RECORDS       1000
+
+static const TPM2B_AUTH parent_auth = { .t.size = 4, .t.buffer = "ppwd" };
+static const TPM2B_AUTH key_auth = { .t.size = 3, .t.buffer = "pwd" };
+
+/*
+ * Fake TPM: the 'private' blob of a sealed object is its plain
+ * TPMS_SENSITIVE_CREATE. Only one object is ever loaded.
+ */
+static struct {
+    unsigned int creates;
+    unsigned int loads;
+    unsigned int unseals;
+    unsigned int flushes;
+    int loaded;
+    TPMS_SENSITIVE_CREATE object;
+    time_t clock;
+    /* make mlock fail as it does past RLIMIT_MEMLOCK */
+    int mlock_fails;
+} tpm;
+
+int
+__wrap_clock_gettime (clockid_t clk_id, struct timespec *tp)
+{
+    tp->tv_sec = tpm.clock;
+    tp->tv_nsec = 0;
+    return 0;
+}
+
+int __real_mlock (const void *addr, size_t len);
+int
+__wrap_mlock (const void *addr, size_t len)
+{
+    if (tpm.mlock_fails) {
+        return -1;
+    }
+    return __real_mlock (addr, len);
+}
+
+static void
+check_password (TSS2_SYS_CMD_AUTHS const *auths, const TPM2B_AUTH *password)
+{
+    assert_non_null (auths);
+    assert_int_equal (auths->cmdAuthsCount, 1);
+    assert_int_equal (auths->cmdAuths[0]->sessionHandle, TPM_RS_PW);
+    assert_int_equal (auths->cmdAuths[0]->hmac.t.size, password->t.size);
+    assert_memory_equal (auths->cmdAuths[0]->hmac.t.buffer,
+                         password->t.buffer, password->t.size);
+}
+
+TPM_RC
+__wrap_Tss2_Sys_Create (TSS2_SYS_CONTEXT *sysContext,
+                        TPMI_DH_OBJECT parentHandle,
+                        TSS2_SYS_CMD_AUTHS const *cmdAuthsArray,
+                        TPM2B_SENSITIVE_CREATE *inSensitive,
+                        TPM2B_PUBLIC *inPublic,
+                        TPM2B_DATA *outsideInfo,
+                        TPML_PCR_SELECTION *creationPCR,
+                        TPM2B_PRIVATE *outPrivate,
+                        TPM2B_PUBLIC *outPublic,
+                        TPM2B_CREATION_DATA *creationData,
+                        TPM2B_DIGEST *creationHash,
+                        TPMT_TK_CREATION *creationTicket,
+                        TSS2_SYS_RSP_AUTHS *rspAuthsArray)
+{
+    ++tpm.creates;
+    assert_int_equal (parentHandle, PARENT_HANDLE);
+    check_password (cmdAuthsArray, &parent_auth);
+    assert_int_equal (inPublic->t.publicArea.type, TPM_ALG_KEYEDHASH);
+    assert_true (inPublic->t.publicArea.objectAttributes.fixedTPM);
+    assert_int_equal (inSensitive->t.sensitive.data.t.size,
+                      ENVELOPE_KEY_SIZE);
+    assert_true (sizeof (inSensitive->t.sensitive) <=
+                 sizeof (outPrivate->t.buffer));
+    outPrivate->t.size = sizeof (inSensitive->t.sensitive);
+    memcpy (outPrivate->t.buffer, &inSensitive->t.sensitive,
+            sizeof (inSensitive->t.sensitive));
+    *outPublic = *inPublic;
+    return TPM_RC_SUCCESS;
+}
+
+TPM_RC
+__wrap_Tss2_Sys_Load (TSS2_SYS_CONTEXT *sysContext,
+                      TPMI_DH_OBJECT parentHandle,
+                      TSS2_SYS_CMD_AUTHS const *cmdAuthsArray,
+                      TPM2B_PRIVATE *inPrivate,
+                      TPM2B_PUBLIC *inPublic,
+                      TPM_HANDLE *objectHandle,
+                      TPM2B_NAME *name,
+                      TSS2_SYS_RSP_AUTHS *rspAuthsArray)
+{
+    ++tpm.loads;
+    assert_int_equal (parentHandle, PARENT_HANDLE);
+    check_password (cmdAuthsArray, &parent_auth);
+    assert_false (tpm.loaded);
+    assert_int_equal (inPrivate->t.size, sizeof (tpm.object));
+    memcpy (&tpm.object, inPrivate->t.buffer, sizeof (tpm.object));
+    tpm.loaded = 1;
+    *objectHandle = OBJECT_HANDLE;
+    return TPM_RC_SUCCESS;
+}
+
+TPM_RC
+__wrap_Tss2_Sys_Unseal (TSS2_SYS_CONTEXT *sysContext,
+                        TPMI_DH_OBJECT itemHandle,
+                        TSS2_SYS_CMD_AUTHS const *cmdAuthsArray,
+                        TPM2B_SENSITIVE_DATA *outData,
+                        TSS2_SYS_RSP_AUTHS *rspAuthsArray)
+{
+    const TPM2B_AUTH *hmac = &cmdAuthsArray->cmdAuths[0]->hmac;
+
+    ++tpm.unseals;
+    assert_int_equal (itemHandle, OBJECT_HANDLE);
+    assert_true (tpm.loaded);
+    if (hmac->t.size != tpm.object.userAuth.t.size ||
+        memcmp (hmac->t.buffer, tpm.object.userAuth.t.buffer,
+                hmac->t.size) != 0) {
+        return TPM_RC_AUTH_FAIL | TPM_RC_S | TPM_RC_1;
+    }
+    *outData = tpm.object.data;
+    return TPM_RC_SUCCESS;
+}
+
+TPM_RC
+__wrap_Tss2_Sys_FlushContext (TSS2_SYS_CONTEXT *sysContext,
+                              TPMI_DH_CONTEXT flushHandle)
+{
+    ++tpm.flushes;
+    assert_int_equal (flushHandle, OBJECT_HANDLE);
+    tpm.loaded = 0;
+    return TPM_RC_SUCCESS;
+}
+
+static int
+envelope_setup (void **state)
+{
+    memset (&tpm, 0, sizeof (tpm));
+    tpm.clock = 1000;
+    return 0;
+}
+
+static ENVELOPE*
+envelope_new (UINT32 ttl)
+{
+    ENVELOPE_CONF conf = {
+        .sys_context = SYS_CONTEXT,
+        .parent = PARENT_HANDLE,
+        .parent_auth = &parent_auth,
+        .ttl = ttl,
+    };
+    ENVELOPE *envelope;
+    size_t size = 0;
+
+    assert_int_equal (Tss2_Envelope_Init (NULL, &size, &conf),
+                      TSS2_RC_SUCCESS);
+    envelope = calloc (1, size);
+    assert_non_null (envelope);
+    assert_int_equal (Tss2_Envelope_Init (envelope, &size, &conf),
+                      TSS2_RC_SUCCESS);
+    return envelope;
+}
+
+static void
+record_seal (ENVELOPE *envelope, unsigned int i, uint8_t *record,
+             size_t *record_size)
+{
+    uint8_t data[64];
+
+    memset (data, 0, sizeof (data));
+    snprintf ((char*)data, sizeof (data), "secret number %u", i);
+    *record_size = sizeof (data) + ENVELOPE_OVERHEAD;
+    assert_int_equal (Tss2_Envelope_Seal (envelope, (uint8_t*)&i, sizeof (i),
+                                          data, i % sizeof (data), record,
+                                          record_size),
+                      TSS2_RC_SUCCESS);
+    assert_int_equal (*record_size, i % sizeof (data) + ENVELOPE_OVERHEAD);
+}
+
+static void
+record_check (ENVELOPE *envelope, unsigned int i, const uint8_t *record,
+              size_t record_size)
+{
+    uint8_t data[64], expected[64];
+    size_t size = sizeof (data);
+
+    memset (expected, 0, sizeof (expected));
+    snprintf ((char*)expected, sizeof (expected), "secret number %u", i);
+    assert_int_equal (Tss2_Envelope_Unseal (envelope, (uint8_t*)&i,
+                                            sizeof (i), record, record_size,
+                                            data, &size),
+                      TSS2_RC_SUCCESS);
+    assert_int_equal (size, i % sizeof (data));
+    assert_memory_equal (data, expected, size);
+}
+/*
+ * Records sealed with a new DEK open again in another context that only
+ * has the blobs, and all of them together cost one Unseal.
+ */
+static void
+envelope_bulk (void **state)
+{
+    static uint8_t records[RECORDS][64 + ENVELOPE_OVERHEAD];
+    static size_t sizes[RECORDS];
+    ENVELOPE *writer = envelope_new (0), *reader = envelope_new (0);
+    TPM2B_PRIVATE private;
+    TPM2B_PUBLIC public;
+    ENVELOPE_STATS stats;
+    unsigned int i;
+
+    assert_int_equal (Tss2_Envelope_CreateKey (writer, &key_auth, &private,
+                                               &public),
+                      TSS2_RC_SUCCESS);
+    for (i = 0; i < RECORDS; ++i) {
+        record_seal (writer, i, records[i], &sizes[i]);
+    }
+    assert_int_equal (tpm.creates, 1);
+    assert_int_equal (tpm.unseals, 0);
+
+    assert_int_equal (Tss2_Envelope_SetKey (reader, &key_auth, &private,
+                                            &public),
+                      TSS2_RC_SUCCESS);
+    assert_int_equal (tpm.loads, 0);
+    for (i = 0; i < RECORDS; ++i) {
+        record_check (reader, i, records[i], sizes[i]);
+    }
+    assert_int_equal (tpm.unseals, 1);
+    assert_int_equal (tpm.flushes, 1);
+    assert_false (tpm.loaded);
+
+    Tss2_Envelope_GetStats (reader, &stats);
+    assert_int_equal (stats.unseals, 1);
+    assert_int_equal (stats.opened, RECORDS);
+    assert_int_equal (stats.rejected, 0);
+
+    Tss2_Envelope_Finalize (writer);
+    Tss2_Envelope_Finalize (reader);
+    free (writer);
+    free (reader);
+}
+/*
+ * Modified records, a different 'aad' and truncated records are refused,
+ * short buffers report the size needed.
+ */
+static void
+envelope_tamper (void **state)
+{
+    ENVELOPE *envelope = envelope_new (0);
+    uint8_t record[64 + ENVELOPE_OVERHEAD], data[64];
+    TPM2B_PRIVATE private;
+    TPM2B_PUBLIC public;
+    ENVELOPE_STATS stats;
+    size_t record_size, size;
+    unsigned int i = 40, other = 41;
+
+    assert_int_equal (Tss2_Envelope_CreateKey (envelope, NULL, &private,
+                                               &public),
+                      TSS2_RC_SUCCESS);
+    record_seal (envelope, i, record, &record_size);
+
+    size = 3;
+    assert_int_equal (Tss2_Envelope_Unseal (envelope, (uint8_t*)&i,
+                                            sizeof (i), record, record_size,
+                                            data, &size),
+                      TSS2_UTIL_RC_INSUFFICIENT_BUFFER);
+    assert_int_equal (size, i);
+    size = sizeof (data);
+    assert_int_equal (Tss2_Envelope_Unseal (envelope, (uint8_t*)&other,
+                                            sizeof (other), record,
+                                            record_size, data, &size),
+                      TSS2_UTIL_RC_BAD_VALUE);
+    record[1 + ENVELOPE_IV_SIZE + 5] ^= 0x01;
+    memset (data, 0xa5, sizeof (data));
+    assert_int_equal (Tss2_Envelope_Unseal (envelope, (uint8_t*)&i,
+                                            sizeof (i), record, record_size,
+                                            data, &size),
+                      TSS2_UTIL_RC_BAD_VALUE);
+    /* the unauthenticated plaintext is gone */
+    for (size = 0; size < i; ++size) {
+        assert_int_equal (data[size], 0);
+    }
+    size = sizeof (data);
+    record[1 + ENVELOPE_IV_SIZE + 5] ^= 0x01;
+    assert_int_equal (Tss2_Envelope_Unseal (envelope, (uint8_t*)&i,
+                                            sizeof (i), record,
+                                            ENVELOPE_OVERHEAD - 1, data,
+                                            &size),
+                      TSS2_UTIL_RC_BAD_VALUE);
+    record_check (envelope, i, record, record_size);
+
+    size = 10;
+    assert_int_equal (Tss2_Envelope_Seal (envelope, NULL, 0, data, 20,
+                                          record, &size),
+                      TSS2_UTIL_RC_INSUFFICIENT_BUFFER);
+    assert_int_equal (size, 20 + ENVELOPE_OVERHEAD);
+
+    Tss2_Envelope_GetStats (envelope, &stats);
+    assert_int_equal (stats.rejected, 2);
+    Tss2_Envelope_Finalize (envelope);
+    free (envelope);
+}
+/*
+ * The DEK is wiped when its TTL runs out or on Forget and unsealed again
+ * on the next record. Without a key nothing can be sealed.
+ */
+static void
+envelope_ttl (void **state)
+{
+    ENVELOPE *envelope = envelope_new (60);
+    uint8_t record[64 + ENVELOPE_OVERHEAD];
+    TPM2B_PRIVATE private;
+    TPM2B_PUBLIC public;
+    ENVELOPE_STATS stats;
+    size_t record_size = sizeof (record);
+
+    assert_int_equal (Tss2_Envelope_Seal (envelope, NULL, 0, record, 1,
+                                          record, &record_size),
+                      TSS2_UTIL_RC_BAD_SEQUENCE);
+    assert_int_equal (Tss2_Envelope_CreateKey (envelope, &key_auth, &private,
+                                               &public),
+                      TSS2_RC_SUCCESS);
+    record_seal (envelope, 7, record, &record_size);
+
+    tpm.clock += 59;
+    record_check (envelope, 7, record, record_size);
+    assert_int_equal (tpm.unseals, 0);
+    tpm.clock += 1;
+    record_check (envelope, 7, record, record_size);
+    assert_int_equal (tpm.unseals, 1);
+
+    Tss2_Envelope_Forget (envelope);
+    record_check (envelope, 7, record, record_size);
+    assert_int_equal (tpm.unseals, 2);
+
+    /* an idle process wipes the DEK without touching a record */
+    assert_int_equal (Tss2_Envelope_Expire (envelope), 0);
+    tpm.clock += 60;
+    assert_int_equal (Tss2_Envelope_Expire (envelope), 1);
+    assert_int_equal (Tss2_Envelope_Expire (envelope), 1);
+    record_check (envelope, 7, record, record_size);
+    assert_int_equal (tpm.unseals, 3);
+
+    Tss2_Envelope_GetStats (envelope, &stats);
+    assert_int_equal (stats.expired, 2);
+    Tss2_Envelope_Finalize (envelope);
+    free (envelope);
+}
+/*
+ * A wrong key password is passed through from Unseal and the object is
+ * still flushed.
+ */
+static void
+envelope_bad_auth (void **state)
+{
+    static const TPM2B_AUTH wrong = { .t.size = 5, .t.buffer = "wrong" };
+    ENVELOPE *writer = envelope_new (0), *reader = envelope_new (0);
+    uint8_t record[64 + ENVELOPE_OVERHEAD], data[64];
+    TPM2B_PRIVATE private;
+    TPM2B_PUBLIC public;
+    size_t record_size, size = sizeof (data);
+
+    assert_int_equal (Tss2_Envelope_CreateKey (writer, &key_auth, &private,
+                                               &public),
+                      TSS2_RC_SUCCESS);
+    record_seal (writer, 9, record, &record_size);
+    assert_int_equal (Tss2_Envelope_SetKey (reader, &wrong, &private,
+                                            &public),
+                      TSS2_RC_SUCCESS);
+    assert_int_equal (Tss2_Envelope_Unseal (reader, NULL, 0, record,
+                                            record_size, data, &size),
+                      TPM_RC_AUTH_FAIL | TPM_RC_S | TPM_RC_1);
+    assert_false (tpm.loaded);
+
+    Tss2_Envelope_Finalize (writer);
+    Tss2_Envelope_Finalize (reader);
+    free (writer);
+    free (reader);
+}
+
+/*
+ * A DEK page that can't be locked is refused unless the caller allows it.
+ */
+static void
+envelope_unlocked (void **state)
+{
+    ENVELOPE_CONF conf = {
+        .sys_context = SYS_CONTEXT,
+        .parent = PARENT_HANDLE,
+        .parent_auth = &parent_auth,
+    };
+    ENVELOPE *envelope;
+    ENVELOPE_STATS stats;
+    uint8_t record[64 + ENVELOPE_OVERHEAD];
+    TPM2B_PRIVATE private;
+    TPM2B_PUBLIC public;
+    size_t size = 0, record_size;
+
+    tpm.mlock_fails = 1;
+    assert_int_equal (Tss2_Envelope_Init (NULL, &size, &conf),
+                      TSS2_RC_SUCCESS);
+    envelope = calloc (1, size);
+    assert_non_null (envelope);
+    assert_int_equal (Tss2_Envelope_Init (envelope, &size, &conf),
+                      TSS2_UTIL_RC_GENERAL_FAILURE);
+
+    conf.allow_unlocked = 1;
+    assert_int_equal (Tss2_Envelope_Init (envelope, &size, &conf),
+                      TSS2_RC_SUCCESS);
+    Tss2_Envelope_GetStats (envelope, &stats);
+    assert_int_equal (stats.locked, 0);
+    assert_int_equal (Tss2_Envelope_CreateKey (envelope, NULL, &private,
+                                               &public),
+                      TSS2_RC_SUCCESS);
+    record_seal (envelope, 3, record, &record_size);
+    record_check (envelope, 3, record, record_size);
+
+    Tss2_Envelope_Finalize (envelope);
+    free (envelope);
+}
+
+int
+main (void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup (envelope_bulk, envelope_setup),
+        cmocka_unit_test_setup (envelope_tamper, envelope_setup),
+        cmocka_unit_test_setup (envelope_ttl, envelope_setup),
+        cmocka_unit_test_setup (envelope_bad_auth, envelope_setup),
+        cmocka_unit_test_setup (envelope_unlocked, envelope_setup),
+    };
+    return cmocka_run_group_tests (tests, NULL, NULL);
+}
@@ -0,0 +1,373 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <openssl/sha.h>
+
+#include "sapi/tpm20.h"
+#include "sapi/tss2_mu.h"
+#include "util/event_log.h"
+
+#define ALG_UNKNOWN      0x7777
+#define ALG_UNKNOWN_SIZE 100
+#define EV_POST_CODE     0x00000001
+
+/*
+ * A crypto agile log with SHA1, SHA256 and an algorithm too large for
+ * TPMU_HA is built in memory. Every event carries the hashes of its data.
+ */
+static struct {
+    uint8_t buffer[8192];
+    size_t size;
+    const char *signature;
+} log_data;
+
+static void
+put (const void *data, size_t size)
+{
+    assert_true (log_data.size + size <= sizeof (log_data.buffer));
+    memcpy (log_data.buffer + log_data.size, data, size);
+    log_data.size += size;
+}
+
+static void
+put16 (UINT16 value)
+{
+    uint8_t le[2] = { value, value >> 8 };
+    put (le, sizeof (le));
+}
+
+static void
+put32 (UINT32 value)
+{
+    uint8_t le[4] = { value, value >> 8, value >> 16, value >> 24 };
+    put (le, sizeof (le));
+}
+
+static void
+log_header (void)
+{
+    const uint8_t zero[20] = { 0 };
+    const uint8_t version[4] = { 0, 2, 0, 2 };
+
+    log_data.size = 0;
+    put32 (0);
+    put32 (EV_NO_ACTION);
+    put (zero, sizeof (zero));
+    put32 (16 + 4 + 4 + 4 + 3 * 4 + 1);
+    put (log_data.signature, 16);
+    put32 (0);
+    put (version, sizeof (version));
+    put32 (3);
+    put16 (TPM_ALG_SHA1);
+    put16 (SHA1_DIGEST_SIZE);
+    put16 (TPM_ALG_SHA256);
+    put16 (SHA256_DIGEST_SIZE);
+    put16 (ALG_UNKNOWN);
+    put16 (ALG_UNKNOWN_SIZE);
+    put (zero, 1);
+}
+
+static void
+log_event (UINT32 pcr, UINT32 type, const void *data, UINT32 size)
+{
+    uint8_t sha1[SHA1_DIGEST_SIZE], sha256[SHA256_DIGEST_SIZE];
+    uint8_t unknown[ALG_UNKNOWN_SIZE];
+
+    SHA1 (data, size, sha1);
+    SHA256 (data, size, sha256);
+    memset (unknown, 0xaa, sizeof (unknown));
+    put32 (pcr);
+    put32 (type);
+    put32 (3);
+    put16 (ALG_UNKNOWN);
+    put (unknown, sizeof (unknown));
+    put16 (TPM_ALG_SHA1);
+    put (sha1, sizeof (sha1));
+    put16 (TPM_ALG_SHA256);
+    put (sha256, sizeof (sha256));
+    put32 (size);
+    put (data, size);
+}
+/* expected SHA256 bank value: value = SHA256 (value || SHA256 (data)) */
+static void
+sha256_extend (uint8_t *value, const void *data, size_t size)
+{
+    uint8_t buffer[2 * SHA256_DIGEST_SIZE];
+
+    memcpy (buffer, value, SHA256_DIGEST_SIZE);
+    SHA256 (data, size, buffer + SHA256_DIGEST_SIZE);
+    SHA256 (buffer, sizeof (buffer), value);
+}
+
+static void
+log_boot (void)
+{
+    const uint8_t locality[] = "StartupLocality\0\3";
+
+    log_header ();
+    log_event (0, EV_NO_ACTION, locality, sizeof (locality) - 1);
+    log_event (0, EV_POST_CODE, "bios", 4);
+    log_event (7, EV_POST_CODE, "secureboot", 10);
+    log_event (7, EV_NO_ACTION, "ignored", 7);
+    log_event (7, EV_POST_CODE, "db", 2);
+    log_event (17, EV_POST_CODE, "drtm", 4);
+}
+
+static int
+event_log_setup (void **state)
+{
+    memset (&log_data, 0, sizeof (log_data));
+    log_data.signature = "Spec ID Event03";
+    return 0;
+}
+
+static EVENT_LOG*
+event_log_open (const char *path)
+{
+    EVENT_LOG_CONF conf = {
+        .path = path,
+        .buffer = log_data.buffer,
+        .size = log_data.size,
+    };
+    EVENT_LOG *log;
+    size_t size = 0;
+    TSS2_RC rc;
+
+    rc = Tss2_EventLog_Init (NULL, &size, &conf);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    log = calloc (1, size);
+    assert_non_null (log);
+    rc = Tss2_EventLog_Init (log, &size, &conf);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    return log;
+}
+
+static void
+event_log_close (EVENT_LOG *log)
+{
+    assert_int_equal (Tss2_EventLog_Finalize (log), TSS2_RC_SUCCESS);
+    free (log);
+}
+/*
+ * Events come out in order with their data in place. The digest of the
+ * unknown algorithm doesn't fit TPMU_HA and is stepped over.
+ */
+static void
+event_log_iterate (void **state)
+{
+    EVENT_LOG_EVENT event;
+    uint8_t sha256[SHA256_DIGEST_SIZE];
+    EVENT_LOG *log;
+    int end = 0, count = 0;
+    TSS2_RC rc;
+
+    log_boot ();
+    log = event_log_open (NULL);
+
+    rc = Tss2_EventLog_Next (log, &event, &end);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (end, 0);
+    assert_int_equal (event.type, EV_NO_ACTION);
+    rc = Tss2_EventLog_Next (log, &event, &end);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (event.pcr, 0);
+    assert_int_equal (event.type, EV_POST_CODE);
+    assert_int_equal (event.size, 4);
+    assert_memory_equal (event.data, "bios", 4);
+    assert_int_equal (event.digests.count, 2);
+    assert_int_equal (event.digests.digests[0].hashAlg, TPM_ALG_SHA1);
+    assert_int_equal (event.digests.digests[1].hashAlg, TPM_ALG_SHA256);
+    SHA256 ((const uint8_t*)"bios", 4, sha256);
+    assert_memory_equal (&event.digests.digests[1].digest, sha256,
+                         sizeof (sha256));
+
+    rc = Tss2_EventLog_Rewind (log);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    for (;;) {
+        rc = Tss2_EventLog_Next (log, &event, &end);
+        assert_int_equal (rc, TSS2_RC_SUCCESS);
+        if (end) {
+            break;
+        }
+        ++count;
+    }
+    assert_int_equal (count, 6);
+    assert_int_equal (event.pcr, 17);
+
+    event_log_close (log);
+}
+/*
+ * Replay starts from the startup locality in PCR 0 and all ones in the
+ * DRTM PCRs, skips EV_NO_ACTION and matches a quote over the result. A
+ * quote over other PCRs than the required ones doesn't.
+ */
+static void
+event_log_replay (void **state)
+{
+    uint8_t pcr0[SHA256_DIGEST_SIZE] = { 0 }, pcr7[SHA256_DIGEST_SIZE] = { 0 };
+    uint8_t pcr17[SHA256_DIGEST_SIZE], composite[3 * SHA256_DIGEST_SIZE];
+    const TPM2B_DIGEST *value;
+    TPMS_ATTEST attest = { 0 };
+    TPM2B_ATTEST quoted = { .t.size = 0 };
+    TPML_PCR_SELECTION *select = &attest.attested.quote.pcrSelect;
+    TPML_PCR_SELECTION required;
+    PCR_MATRIX matrix;
+    EVENT_LOG *log;
+    size_t offset = 0;
+    TSS2_RC rc;
+
+    log_boot ();
+    log = event_log_open (NULL);
+    rc = Tss2_EventLog_Replay (log, &matrix);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    event_log_close (log);
+    assert_int_equal (matrix.count, 2);
+
+    pcr0[SHA256_DIGEST_SIZE - 1] = 3;
+    sha256_extend (pcr0, "bios", 4);
+    sha256_extend (pcr7, "secureboot", 10);
+    sha256_extend (pcr7, "db", 2);
+    memset (pcr17, 0xff, sizeof (pcr17));
+    sha256_extend (pcr17, "drtm", 4);
+
+    value = Tss2_Pcr_MatrixGet (&matrix, TPM_ALG_SHA256, 0);
+    assert_non_null (value);
+    assert_int_equal (value->t.size, SHA256_DIGEST_SIZE);
+    assert_memory_equal (value->t.buffer, pcr0, SHA256_DIGEST_SIZE);
+    value = Tss2_Pcr_MatrixGet (&matrix, TPM_ALG_SHA256, 7);
+    assert_memory_equal (value->t.buffer, pcr7, SHA256_DIGEST_SIZE);
+    value = Tss2_Pcr_MatrixGet (&matrix, TPM_ALG_SHA256, 17);
+    assert_memory_equal (value->t.buffer, pcr17, SHA256_DIGEST_SIZE);
+    value = Tss2_Pcr_MatrixGet (&matrix, TPM_ALG_SHA1, 18);
+    assert_int_equal (value->t.size, SHA1_DIGEST_SIZE);
+    assert_int_equal (value->t.buffer[0], 0xff);
+
+    attest.magic = TPM_GENERATED_VALUE;
+    attest.type = TPM_ST_ATTEST_QUOTE;
+    select->count = 1;
+    select->pcrSelections[0].hash = TPM_ALG_SHA256;
+    select->pcrSelections[0].sizeofSelect = 3;
+    select->pcrSelections[0].pcrSelect[0] = 0x81;
+    select->pcrSelections[0].pcrSelect[2] = 0x02;
+    memcpy (composite, pcr0, SHA256_DIGEST_SIZE);
+    memcpy (composite + SHA256_DIGEST_SIZE, pcr7, SHA256_DIGEST_SIZE);
+    memcpy (composite + 2 * SHA256_DIGEST_SIZE, pcr17, SHA256_DIGEST_SIZE);
+    attest.attested.quote.pcrDigest.t.size = SHA256_DIGEST_SIZE;
+    SHA256 (composite, sizeof (composite),
+            attest.attested.quote.pcrDigest.t.buffer);
+    rc = Tss2_MU_TPMS_ATTEST_Marshal (&attest, quoted.t.attestationData,
+                                      sizeof (quoted.t.attestationData),
+                                      &offset);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    quoted.t.size = offset;
+
+    /* selections compare equal with a different sizeofSelect */
+    required = *select;
+    required.pcrSelections[0].sizeofSelect = PCR_SELECT_MAX;
+    rc = Tss2_Pcr_VerifyQuote (&matrix, &required, &quoted, TPM_ALG_SHA256);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    matrix.banks[1].digests[7].t.buffer[0] ^= 1;
+    rc = Tss2_Pcr_VerifyQuote (&matrix, &required, &quoted, TPM_ALG_SHA256);
+    assert_int_equal (rc, TSS2_UTIL_RC_BAD_VALUE);
+    matrix.banks[1].digests[7].t.buffer[0] ^= 1;
+
+    /* a quote over no PCRs matches its own digest, but not 'required' */
+    select->count = 0;
+    SHA256 (composite, 0, attest.attested.quote.pcrDigest.t.buffer);
+    offset = 0;
+    rc = Tss2_MU_TPMS_ATTEST_Marshal (&attest, quoted.t.attestationData,
+                                      sizeof (quoted.t.attestationData),
+                                      &offset);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    quoted.t.size = offset;
+    rc = Tss2_Pcr_VerifyQuote (&matrix, select, &quoted, TPM_ALG_SHA256);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = Tss2_Pcr_VerifyQuote (&matrix, &required, &quoted, TPM_ALG_SHA256);
+    assert_int_equal (rc, TSS2_UTIL_RC_BAD_VALUE);
+}
+/*
+ * A log in a file is mapped and gives the same result as one in memory.
+ */
+static void
+event_log_file (void **state)
+{
+    char path[] = "/tmp/event-log-XXXXXX";
+    PCR_MATRIX from_memory, from_file;
+    EVENT_LOG *log;
+    TSS2_RC rc;
+    int fd;
+
+    log_boot ();
+    fd = mkstemp (path);
+    assert_true (fd >= 0);
+    assert_int_equal (write (fd, log_data.buffer, log_data.size),
+                      log_data.size);
+    close (fd);
+
+    log = event_log_open (NULL);
+    rc = Tss2_EventLog_Replay (log, &from_memory);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    event_log_close (log);
+
+    log = event_log_open (path);
+    rc = Tss2_EventLog_Replay (log, &from_file);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    event_log_close (log);
+    unlink (path);
+
+    assert_memory_equal (&from_memory, &from_file, sizeof (from_file));
+}
+/*
+ * SHA1 only logs aren't supported, a truncated record stops the iterator
+ * and the replay.
+ */
+static void
+event_log_malformed (void **state)
+{
+    EVENT_LOG_CONF conf = { .buffer = log_data.buffer };
+    EVENT_LOG_EVENT event;
+    PCR_MATRIX matrix;
+    EVENT_LOG *log;
+    size_t size = 0;
+    int end = 0;
+    TSS2_RC rc;
+
+    log_data.signature = "Spec ID Event00";
+    log_boot ();
+    conf.size = log_data.size;
+    Tss2_EventLog_Init (NULL, &size, &conf);
+    log = calloc (1, size);
+    assert_non_null (log);
+    rc = Tss2_EventLog_Init (log, &size, &conf);
+    assert_int_equal (rc, TSS2_UTIL_RC_NOT_SUPPORTED);
+    free (log);
+
+    log_data.signature = "Spec ID Event03";
+    log_boot ();
+    log_data.size -= 3;
+    log = event_log_open (NULL);
+    do {
+        rc = Tss2_EventLog_Next (log, &event, &end);
+    } while (rc == TSS2_RC_SUCCESS && !end);
+    assert_int_equal (rc, TSS2_UTIL_RC_BAD_VALUE);
+    rc = Tss2_EventLog_Replay (log, &matrix);
+    assert_int_equal (rc, TSS2_UTIL_RC_BAD_VALUE);
+    event_log_close (log);
+}
+
+int
+main (void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup (event_log_iterate, event_log_setup),
+        cmocka_unit_test_setup (event_log_replay, event_log_setup),
+        cmocka_unit_test_setup (event_log_file, event_log_setup),
+        cmocka_unit_test_setup (event_log_malformed, event_log_setup),
+    };
+    return cmocka_run_group_tests (tests, NULL, NULL);
+}
@@ -0,0 +1,349 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "sapi/tpm20.h"
+#include "util/key_cache.h"
+
+#define ROOT_HANDLE 0x81000001
+#define SYS_CONTEXT ((TSS2_SYS_CONTEXT*)0x1)
+#define TPM_SLOTS   8
+
+/*
+ * Fake TPM with a fixed number of object slots. Keys are identified by the
+ * first byte of their public key, a loaded key remembers that id. Load
+ * requires the parent to be loaded (or to be the root), contexts carry the
+ * id in their sequence number and are refused after a 'reset'.
+ */
+static struct {
+    unsigned int commands;
+    unsigned int loads;
+    unsigned int context_saves;
+    unsigned int context_loads;
+    unsigned int flushes;
+    size_t capacity;
+    int reset;
+    struct {
+        int used;
+        BYTE id;
+    } slots[TPM_SLOTS];
+} tpm;
+
+static int
+slot_of (TPM_HANDLE handle)
+{
+    size_t i = handle - TRANSIENT_FIRST;
+
+    return handle >= TRANSIENT_FIRST && i < TPM_SLOTS && tpm.slots[i].used;
+}
+
+static TPM_RC
+slot_new (BYTE id, TPM_HANDLE *handle)
+{
+    size_t i, used = 0;
+
+    for (i = 0; i < TPM_SLOTS; ++i) {
+        used += tpm.slots[i].used;
+    }
+    if (used >= tpm.capacity) {
+        return TPM_RC_OBJECT_MEMORY;
+    }
+    for (i = 0; tpm.slots[i].used; ++i);
+    tpm.slots[i].used = 1;
+    tpm.slots[i].id = id;
+    *handle = TRANSIENT_FIRST + i;
+    return TPM_RC_SUCCESS;
+}
+
+TPM_RC
+__wrap_Tss2_Sys_ReadPublic (TSS2_SYS_CONTEXT *sysContext,
+                            TPMI_DH_OBJECT objectHandle,
+                            TSS2_SYS_CMD_AUTHS const *cmdAuthsArray,
+                            TPM2B_PUBLIC *outPublic,
+                            TPM2B_NAME *name,
+                            TPM2B_NAME *qualifiedName,
+                            TSS2_SYS_RSP_AUTHS *rspAuthsArray)
+{
+    ++tpm.commands;
+    name->t.size = 6;
+    memset (name->t.name, 0, 6);
+    name->t.name[1] = TPM_ALG_SHA256;
+    memcpy (name->t.name + 2, &objectHandle, sizeof (objectHandle));
+    return TPM_RC_SUCCESS;
+}
+
+TPM_RC
+__wrap_Tss2_Sys_Load (TSS2_SYS_CONTEXT *sysContext,
+                      TPMI_DH_OBJECT parentHandle,
+                      TSS2_SYS_CMD_AUTHS const *cmdAuthsArray,
+                      TPM2B_PRIVATE *inPrivate,
+                      TPM2B_PUBLIC *inPublic,
+                      TPM_HANDLE *objectHandle,
+                      TPM2B_NAME *name,
+                      TSS2_SYS_RSP_AUTHS *rspAuthsArray)
+{
+    ++tpm.commands;
+    assert_non_null (cmdAuthsArray);
+    assert_int_equal (cmdAuthsArray->cmdAuthsCount, 1);
+    assert_int_equal (cmdAuthsArray->cmdAuths[0]->sessionHandle, TPM_RS_PW);
+    if (parentHandle != ROOT_HANDLE && !slot_of (parentHandle)) {
+        return TPM_RC_HANDLE | TPM_RC_1;
+    }
+    /* the child's private blob names its parent's id */
+    if (parentHandle != ROOT_HANDLE) {
+        assert_int_equal (inPrivate->t.buffer[0],
+                          tpm.slots[parentHandle - TRANSIENT_FIRST].id);
+    }
+    ++tpm.loads;
+    return slot_new (inPublic->t.publicArea.unique.rsa.t.buffer[0],
+                     objectHandle);
+}
+
+TPM_RC
+__wrap_Tss2_Sys_ContextSave (TSS2_SYS_CONTEXT *sysContext,
+                             TPMI_DH_CONTEXT saveHandle,
+                             TPMS_CONTEXT *context)
+{
+    ++tpm.commands;
+    assert_true (slot_of (saveHandle));
+    ++tpm.context_saves;
+    memset (context, 0, sizeof (*context));
+    context->sequence = tpm.slots[saveHandle - TRANSIENT_FIRST].id;
+    context->savedHandle = 0x80000000;
+    return TPM_RC_SUCCESS;
+}
+
+TPM_RC
+__wrap_Tss2_Sys_ContextLoad (TSS2_SYS_CONTEXT *sysContext,
+                             TPMS_CONTEXT *context,
+                             TPMI_DH_CONTEXT *loadedHandle)
+{
+    ++tpm.commands;
+    if (tpm.reset) {
+        return TPM_RC_INTEGRITY | TPM_RC_P | TPM_RC_1;
+    }
+    ++tpm.context_loads;
+    return slot_new ((BYTE)context->sequence, loadedHandle);
+}
+
+TPM_RC
+__wrap_Tss2_Sys_FlushContext (TSS2_SYS_CONTEXT *sysContext,
+                              TPMI_DH_CONTEXT flushHandle)
+{
+    ++tpm.commands;
+    assert_true (slot_of (flushHandle));
+    ++tpm.flushes;
+    tpm.slots[flushHandle - TRANSIENT_FIRST].used = 0;
+    return TPM_RC_SUCCESS;
+}
+
+static int
+key_cache_setup (void **state)
+{
+    memset (&tpm, 0, sizeof (tpm));
+    tpm.capacity = TPM_SLOTS;
+    return 0;
+}
+
+static KEY_CACHE*
+cache_new (size_t max_loaded)
+{
+    KEY_CACHE_CONF conf = {
+        .sys_context = SYS_CONTEXT,
+        .key_count = 8,
+        .max_loaded = max_loaded,
+    };
+    KEY_CACHE *cache;
+    size_t size = 0;
+
+    assert_int_equal (Tss2_KeyCache_Init (NULL, &size, &conf), TSS2_RC_SUCCESS);
+    cache = calloc (1, size);
+    assert_non_null (cache);
+    assert_int_equal (Tss2_KeyCache_Init (cache, &size, &conf),
+                      TSS2_RC_SUCCESS);
+    return cache;
+}
+/*
+ * Register key 'id' under 'parent'. The public key's first byte is the id
+ * and the private blob's first byte the parent's id, for the fake TPM.
+ */
+static void
+key_add (KEY_CACHE *cache, const TPM2B_NAME *parent, BYTE parent_id, BYTE id,
+         TPM2B_NAME *name)
+{
+    TPM2B_PRIVATE private = { .t.size = 1 };
+    TPM2B_PUBLIC public = { .t.size = 0 };
+    TPMT_PUBLIC *area = &public.t.publicArea;
+
+    private.t.buffer[0] = parent_id;
+    area->type = TPM_ALG_RSA;
+    area->nameAlg = TPM_ALG_SHA256;
+    area->parameters.rsaDetail.symmetric.algorithm = TPM_ALG_NULL;
+    area->parameters.rsaDetail.scheme.scheme = TPM_ALG_NULL;
+    area->parameters.rsaDetail.keyBits = 2048;
+    area->unique.rsa.t.size = 1;
+    area->unique.rsa.t.buffer[0] = id;
+    assert_int_equal (Tss2_KeyCache_AddKey (cache, parent, &private, &public,
+                                            NULL, name),
+                      TSS2_RC_SUCCESS);
+}
+/* root - 1 - 2 - 3 - 4, and 5 next to 4 under 3 */
+static void
+chain_add (KEY_CACHE *cache, TPM2B_NAME *names)
+{
+    assert_int_equal (Tss2_KeyCache_AddRoot (cache, ROOT_HANDLE, NULL,
+                                             &names[0]),
+                      TSS2_RC_SUCCESS);
+    key_add (cache, &names[0], 0, 1, &names[1]);
+    key_add (cache, &names[1], 1, 2, &names[2]);
+    key_add (cache, &names[2], 2, 3, &names[3]);
+    key_add (cache, &names[3], 3, 4, &names[4]);
+    key_add (cache, &names[3], 3, 5, &names[5]);
+}
+
+static BYTE
+handle_id (TPMI_DH_OBJECT handle)
+{
+    assert_true (slot_of (handle));
+    return tpm.slots[handle - TRANSIENT_FIRST].id;
+}
+/*
+ * The first Load of a deep key loads the whole chain within two slots,
+ * the second costs nothing.
+ */
+static void
+key_cache_chain (void **state)
+{
+    KEY_CACHE *cache = cache_new (2);
+    TPM2B_NAME names[6];
+    KEY_CACHE_STATS stats;
+    TPMI_DH_OBJECT handle;
+    unsigned int commands;
+
+    chain_add (cache, names);
+    assert_int_equal (Tss2_KeyCache_Load (cache, &names[4], &handle),
+                      TSS2_RC_SUCCESS);
+    assert_int_equal (handle_id (handle), 4);
+    assert_int_equal (tpm.loads, 4);
+    assert_int_equal (tpm.context_saves, 2);
+
+    commands = tpm.commands;
+    assert_int_equal (Tss2_KeyCache_Load (cache, &names[4], &handle),
+                      TSS2_RC_SUCCESS);
+    assert_int_equal (handle_id (handle), 4);
+    assert_int_equal (tpm.commands, commands);
+
+    Tss2_KeyCache_GetStats (cache, &stats);
+    assert_int_equal (stats.hits, 1);
+    assert_int_equal (stats.loads, 4);
+    assert_int_equal (stats.loaded, 2);
+
+    Tss2_KeyCache_Finalize (cache);
+    assert_int_equal (tpm.flushes, tpm.context_saves + 2);
+    free (cache);
+}
+/*
+ * An evicted key comes back with one ContextLoad, its ancestors stay out.
+ * After a TPM Reset the saved context is refused and the chain is loaded
+ * from the blobs again.
+ */
+static void
+key_cache_saved (void **state)
+{
+    KEY_CACHE *cache = cache_new (2);
+    TPM2B_NAME names[6];
+    KEY_CACHE_STATS stats;
+    TPMI_DH_OBJECT handle;
+    unsigned int loads;
+
+    chain_add (cache, names);
+    assert_int_equal (Tss2_KeyCache_Load (cache, &names[4], &handle),
+                      TSS2_RC_SUCCESS);
+    /* 5 needs 3 (saved) back, which evicts 4 */
+    assert_int_equal (Tss2_KeyCache_Load (cache, &names[5], &handle),
+                      TSS2_RC_SUCCESS);
+    assert_int_equal (handle_id (handle), 5);
+    loads = tpm.loads;
+    assert_int_equal (Tss2_KeyCache_Load (cache, &names[4], &handle),
+                      TSS2_RC_SUCCESS);
+    assert_int_equal (handle_id (handle), 4);
+    assert_int_equal (tpm.loads, loads);
+    assert_int_equal (tpm.context_loads, 1);
+
+    tpm.reset = 1;
+    assert_int_equal (Tss2_KeyCache_Load (cache, &names[3], &handle),
+                      TSS2_RC_SUCCESS);
+    assert_int_equal (handle_id (handle), 3);
+    Tss2_KeyCache_GetStats (cache, &stats);
+    assert_true (stats.stale >= 1);
+
+    Tss2_KeyCache_Finalize (cache);
+    free (cache);
+}
+/*
+ * Objects loaded by somebody else leave the TPM out of memory before the
+ * cache's own limit, the cache evicts and retries.
+ */
+static void
+key_cache_object_memory (void **state)
+{
+    KEY_CACHE *cache = cache_new (3);
+    TPM2B_NAME names[6];
+    TPMI_DH_OBJECT handle;
+
+    tpm.capacity = 2;
+    chain_add (cache, names);
+    assert_int_equal (Tss2_KeyCache_Load (cache, &names[4], &handle),
+                      TSS2_RC_SUCCESS);
+    assert_int_equal (handle_id (handle), 4);
+
+    tpm.capacity = 1;
+    assert_int_equal (Tss2_KeyCache_Load (cache, &names[5], &handle),
+                      TPM_RC_OBJECT_MEMORY);
+    Tss2_KeyCache_Finalize (cache);
+    free (cache);
+}
+/*
+ * Removing a key forgets its subtree and flushes what was loaded.
+ */
+static void
+key_cache_remove (void **state)
+{
+    KEY_CACHE *cache = cache_new (0);
+    TPM2B_NAME names[6];
+    KEY_CACHE_STATS stats;
+    TPMI_DH_OBJECT handle;
+    unsigned int flushes;
+
+    chain_add (cache, names);
+    assert_int_equal (Tss2_KeyCache_Load (cache, &names[5], &handle),
+                      TSS2_RC_SUCCESS);
+    flushes = tpm.flushes;
+    assert_int_equal (Tss2_KeyCache_Remove (cache, &names[2]), TSS2_RC_SUCCESS);
+    Tss2_KeyCache_GetStats (cache, &stats);
+    assert_int_equal (stats.loaded, 0);
+    assert_int_equal (tpm.flushes, flushes + 3);
+    assert_int_equal (Tss2_KeyCache_Load (cache, &names[4], &handle),
+                      TSS2_UTIL_RC_BAD_VALUE);
+    assert_int_equal (Tss2_KeyCache_Load (cache, &names[1], &handle),
+                      TSS2_RC_SUCCESS);
+    assert_int_equal (handle_id (handle), 1);
+
+    Tss2_KeyCache_Finalize (cache);
+    free (cache);
+}
+
+int
+main (void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup (key_cache_chain, key_cache_setup),
+        cmocka_unit_test_setup (key_cache_saved, key_cache_setup),
+        cmocka_unit_test_setup (key_cache_object_memory, key_cache_setup),
+        cmocka_unit_test_setup (key_cache_remove, key_cache_setup),
+    };
+    return cmocka_run_group_tests (tests, NULL, NULL);
+}
@@ -0,0 +1,354 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "sapi/tpm20.h"
+#include "util/key_pool.h"
+
+#define POOL_SYS_CONTEXT ((TSS2_SYS_CONTEXT*)0x1)
+#define APP_SYS_CONTEXT  ((TSS2_SYS_CONTEXT*)0x2)
+#define PARENT_HANDLE    0x81000001
+#define KEY_HANDLE(serial) ((TPM_HANDLE)(TRANSIENT_FIRST + (serial)))
+
+/*
+ * Fake TPM state: the wrapped SAPI functions below count calls, Create
+ * stamps the created key with a serial number in its private blob and Load
+ * returns that serial as the object handle. ExecuteFinish reports
+ * TSS2_TCTI_RC_TRY_AGAIN 'busy' times before a Create completes.
+ */
+static struct {
+    unsigned int prepare;
+    unsigned int finish;
+    unsigned int create;
+    unsigned int load;
+    unsigned int serial;
+    unsigned int busy;
+    TSS2_RC load_rc;
+} tpm;
+
+static void
+fake_key (TPM2B_PRIVATE *private, TPM2B_PUBLIC *public)
+{
+    tpm.serial++;
+    private->t.size = sizeof (tpm.serial);
+    memcpy (private->t.buffer, &tpm.serial, sizeof (tpm.serial));
+    public->t.publicArea.type = TPM_ALG_RSA;
+}
+
+TPM_RC
+__wrap_Tss2_Sys_Create_Prepare (TSS2_SYS_CONTEXT *sysContext,
+                                TPMI_DH_OBJECT parentHandle,
+                                TPM2B_SENSITIVE_CREATE *inSensitive,
+                                TPM2B_PUBLIC *inPublic,
+                                TPM2B_DATA *outsideInfo,
+                                TPML_PCR_SELECTION *creationPCR)
+{
+    assert_true (sysContext == POOL_SYS_CONTEXT);
+    assert_int_equal (parentHandle, PARENT_HANDLE);
+    tpm.prepare++;
+    return TSS2_RC_SUCCESS;
+}
+TPM_RC
+__wrap_Tss2_Sys_SetCmdAuths (TSS2_SYS_CONTEXT *sysContext,
+                             const TSS2_SYS_CMD_AUTHS *cmdAuthsArray)
+{
+    return TSS2_RC_SUCCESS;
+}
+TSS2_RC
+__wrap_Tss2_Sys_ExecuteAsync (TSS2_SYS_CONTEXT *sysContext)
+{
+    return TSS2_RC_SUCCESS;
+}
+TSS2_RC
+__wrap_Tss2_Sys_ExecuteFinish (TSS2_SYS_CONTEXT *sysContext,
+                               int32_t timeout)
+{
+    tpm.finish++;
+    if (tpm.busy > 0 && timeout != TSS2_TCTI_TIMEOUT_BLOCK) {
+        tpm.busy--;
+        return TSS2_TCTI_RC_TRY_AGAIN;
+    }
+    return TSS2_RC_SUCCESS;
+}
+TPM_RC
+__wrap_Tss2_Sys_Create_Complete (TSS2_SYS_CONTEXT *sysContext,
+                                 TPM2B_PRIVATE *outPrivate,
+                                 TPM2B_PUBLIC *outPublic,
+                                 TPM2B_CREATION_DATA *creationData,
+                                 TPM2B_DIGEST *creationHash,
+                                 TPMT_TK_CREATION *creationTicket)
+{
+    fake_key (outPrivate, outPublic);
+    return TSS2_RC_SUCCESS;
+}
+TPM_RC
+__wrap_Tss2_Sys_Create (TSS2_SYS_CONTEXT *sysContext,
+                        TPMI_DH_OBJECT parentHandle,
+                        TSS2_SYS_CMD_AUTHS const *cmdAuthsArray,
+                        TPM2B_SENSITIVE_CREATE *inSensitive,
+                        TPM2B_PUBLIC *inPublic,
+                        TPM2B_DATA *outsideInfo,
+                        TPML_PCR_SELECTION *creationPCR,
+                        TPM2B_PRIVATE *outPrivate,
+                        TPM2B_PUBLIC *outPublic,
+                        TPM2B_CREATION_DATA *creationData,
+                        TPM2B_DIGEST *creationHash,
+                        TPMT_TK_CREATION *creationTicket,
+                        TSS2_SYS_RSP_AUTHS *rspAuthsArray)
+{
+    tpm.create++;
+    fake_key (outPrivate, outPublic);
+    return TSS2_RC_SUCCESS;
+}
+TPM_RC
+__wrap_Tss2_Sys_Load (TSS2_SYS_CONTEXT *sysContext,
+                      TPMI_DH_OBJECT parentHandle,
+                      TSS2_SYS_CMD_AUTHS const *cmdAuthsArray,
+                      TPM2B_PRIVATE *inPrivate,
+                      TPM2B_PUBLIC *inPublic,
+                      TPM_HANDLE *objectHandle,
+                      TPM2B_NAME *name,
+                      TSS2_SYS_RSP_AUTHS *rspAuthsArray)
+{
+    unsigned int serial;
+
+    tpm.load++;
+    if (tpm.load_rc != TSS2_RC_SUCCESS) {
+        TSS2_RC rc = tpm.load_rc;
+        tpm.load_rc = TSS2_RC_SUCCESS;
+        return rc;
+    }
+    assert_int_equal (inPrivate->t.size, sizeof (serial));
+    memcpy (&serial, inPrivate->t.buffer, sizeof (serial));
+    *objectHandle = KEY_HANDLE (serial);
+    name->t.size = 0;
+    return TSS2_RC_SUCCESS;
+}
+
+static KEY_POOL*
+key_pool_new (size_t depth, UINT32 refill_interval)
+{
+    KEY_POOL_TEMPLATE tmpl = {
+        .parent = PARENT_HANDLE,
+        .depth = depth,
+    };
+    KEY_POOL_CONF conf = {
+        .sys_context = POOL_SYS_CONTEXT,
+        .templates = &tmpl,
+        .template_count = 1,
+        .refill_interval = refill_interval,
+    };
+    KEY_POOL *pool;
+    size_t size = 0;
+    TSS2_RC rc;
+
+    tmpl.template.t.publicArea.type = TPM_ALG_RSA;
+    rc = Tss2_KeyPool_Init (NULL, &size, &conf);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    pool = calloc (1, size);
+    assert_non_null (pool);
+    rc = Tss2_KeyPool_Init (pool, &size, &conf);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+    return pool;
+}
+
+static int
+key_pool_setup (void **state)
+{
+    memset (&tpm, 0, sizeof (tpm));
+    *state = key_pool_new (2, 0);
+    return 0;
+}
+static int
+key_pool_teardown (void **state)
+{
+    Tss2_KeyPool_Finalize (*state);
+    free (*state);
+    return 0;
+}
+/* Run Service until the pool is full, returns the number of calls. */
+static unsigned int
+key_pool_fill (KEY_POOL *pool)
+{
+    unsigned int calls = 0;
+    TSS2_RC rc;
+
+    do {
+        rc = Tss2_KeyPool_Service (pool, 0);
+        calls++;
+    } while (rc == TSS2_UTIL_RC_TRY_AGAIN && calls < 100);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+    return calls;
+}
+/*
+ * Depths beyond KEY_POOL_MAX_DEPTH and empty template lists are rejected.
+ */
+static void
+key_pool_init_bad_value_test (void **state)
+{
+    KEY_POOL_TEMPLATE tmpl = { .depth = KEY_POOL_MAX_DEPTH + 1 };
+    KEY_POOL_CONF conf = {
+        .sys_context = POOL_SYS_CONTEXT,
+        .templates = &tmpl,
+        .template_count = 0,
+    };
+    size_t size = 0;
+    TSS2_RC rc;
+
+    rc = Tss2_KeyPool_Init (NULL, &size, &conf);
+    assert_int_equal (rc, TSS2_UTIL_RC_BAD_VALUE);
+    conf.template_count = 1;
+    rc = Tss2_KeyPool_Init (NULL, &size, &conf);
+    assert_int_equal (rc, TSS2_UTIL_RC_BAD_VALUE);
+    tmpl.depth = KEY_POOL_MAX_DEPTH;
+    rc = Tss2_KeyPool_Init (NULL, &size, &conf);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+}
+/*
+ * Service sends one Create at a time and doesn't block while the TPM is
+ * busy with it, the pool is full after 'depth' Creates.
+ */
+static void
+key_pool_service_test (void **state)
+{
+    KEY_POOL *pool = *state;
+    KEY_POOL_STATS stats;
+    TSS2_RC rc;
+
+    tpm.busy = 3;
+    key_pool_fill (pool);
+    assert_int_equal (tpm.prepare, 2);
+    assert_int_equal (tpm.finish, 5);
+    assert_int_equal (tpm.create, 0);
+
+    rc = Tss2_KeyPool_GetStats (pool, 0, &stats);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (stats.created, 2);
+    assert_int_equal (stats.available, 2);
+    rc = Tss2_KeyPool_GetStats (pool, 1, &stats);
+    assert_int_equal (rc, TSS2_UTIL_RC_BAD_VALUE);
+}
+/*
+ * Pre-created keys cost a single Load, once they're gone Acquire creates
+ * the key itself.
+ */
+static void
+key_pool_acquire_test (void **state)
+{
+    KEY_POOL *pool = *state;
+    KEY_POOL_STATS stats;
+    TPM2B_PUBLIC public;
+    TPM_HANDLE a, b, c;
+    TSS2_RC rc;
+
+    key_pool_fill (pool);
+    rc = Tss2_KeyPool_Acquire (pool, APP_SYS_CONTEXT, 0, &a, &public, NULL);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (public.t.publicArea.type, TPM_ALG_RSA);
+    rc = Tss2_KeyPool_Acquire (pool, APP_SYS_CONTEXT, 0, &b, NULL, NULL);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_not_equal (a, b);
+    assert_int_equal (tpm.create, 0);
+    assert_int_equal (tpm.load, 2);
+
+    rc = Tss2_KeyPool_Acquire (pool, APP_SYS_CONTEXT, 0, &c, NULL, NULL);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (c, KEY_HANDLE (3));
+    assert_int_equal (tpm.create, 1);
+    assert_int_equal (tpm.load, 3);
+
+    rc = Tss2_KeyPool_GetStats (pool, 0, &stats);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (stats.hits, 2);
+    assert_int_equal (stats.misses, 1);
+    assert_int_equal (stats.available, 0);
+}
+/*
+ * Acquiring on the pool's own context completes the outstanding Create
+ * first, and the key it produced is used.
+ */
+static void
+key_pool_pending_test (void **state)
+{
+    KEY_POOL *pool = *state;
+    TPM_HANDLE handle;
+    TSS2_RC rc;
+
+    tpm.busy = 10;
+    rc = Tss2_KeyPool_Service (pool, 0);
+    assert_int_equal (rc, TSS2_UTIL_RC_TRY_AGAIN);
+    rc = Tss2_KeyPool_Acquire (pool, POOL_SYS_CONTEXT, 0, &handle, NULL, NULL);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (handle, KEY_HANDLE (1));
+    assert_int_equal (tpm.finish, 1);
+    assert_int_equal (tpm.create, 0);
+}
+/*
+ * A key that no longer loads is dropped and replaced by a new one.
+ */
+static void
+key_pool_stale_test (void **state)
+{
+    KEY_POOL *pool = *state;
+    KEY_POOL_STATS stats;
+    TPM_HANDLE handle;
+    TSS2_RC rc;
+
+    key_pool_fill (pool);
+    tpm.load_rc = TPM_RC_INTEGRITY;
+    rc = Tss2_KeyPool_Acquire (pool, APP_SYS_CONTEXT, 0, &handle, NULL, NULL);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (handle, KEY_HANDLE (3));
+    Tss2_KeyPool_GetStats (pool, 0, &stats);
+    assert_int_equal (stats.available, 1);
+    assert_int_equal (stats.misses, 1);
+}
+/*
+ * With a refill interval the next Create waits, even if the pool isn't
+ * full.
+ */
+static void
+key_pool_interval_test (void **state)
+{
+    KEY_POOL *pool = key_pool_new (2, 60000);
+    TSS2_RC rc;
+
+    rc = Tss2_KeyPool_Service (pool, 0);
+    assert_int_equal (rc, TSS2_UTIL_RC_TRY_AGAIN);
+    rc = Tss2_KeyPool_Service (pool, 0);
+    assert_int_equal (rc, TSS2_UTIL_RC_TRY_AGAIN);
+    rc = Tss2_KeyPool_Service (pool, 0);
+    assert_int_equal (rc, TSS2_UTIL_RC_TRY_AGAIN);
+    assert_int_equal (tpm.prepare, 1);
+    assert_int_equal (tpm.finish, 1);
+    Tss2_KeyPool_Finalize (pool);
+    free (pool);
+}
+
+int
+main (int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test (key_pool_init_bad_value_test),
+        cmocka_unit_test_setup_teardown (key_pool_service_test,
+                                         key_pool_setup,
+                                         key_pool_teardown),
+        cmocka_unit_test_setup_teardown (key_pool_acquire_test,
+                                         key_pool_setup,
+                                         key_pool_teardown),
+        cmocka_unit_test_setup_teardown (key_pool_pending_test,
+                                         key_pool_setup,
+                                         key_pool_teardown),
+        cmocka_unit_test_setup_teardown (key_pool_stale_test,
+                                         key_pool_setup,
+                                         key_pool_teardown),
+        cmocka_unit_test_setup_teardown (key_pool_interval_test,
+                                         key_pool_setup,
+                                         key_pool_teardown),
+    };
+    return cmocka_run_group_tests (tests, NULL, NULL);
+}
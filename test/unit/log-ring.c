@@ -0,0 +1,95 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "log/log.h"
+
+static int
+log_ring_setup (void **state)
+{
+    log_record record;
+
+    log_set_level (WARNING);
+    while (log_read (&record, 1) == 1)
+        ;
+    return 0;
+}
+/*
+ * Messages are formatted with the level, module, file and line, and come
+ * out of the ring in the order they went in.
+ */
+static void
+log_ring_order_test (void **state)
+{
+    log_record records[4];
+    size_t count;
+
+    log_write (WARNING, "test", "file.c", 1, "first %d", 1);
+    log_write (ERROR, "test", "file.c", 2, "second %s", "2");
+    count = log_read (records, 4);
+    assert_int_equal (count, 2);
+    assert_int_equal (records[0].level, WARNING);
+    assert_string_equal (records[0].message, "WARNING:test:file.c:1 first 1");
+    assert_int_equal (records[1].level, ERROR);
+    assert_string_equal (records[1].message, "ERROR:test:file.c:2 second 2");
+    assert_int_equal (log_read (records, 4), 0);
+}
+/*
+ * Messages below the runtime level never reach the ring.
+ */
+static void
+log_ring_filter_test (void **state)
+{
+    log_record record;
+
+    log_write (DEBUG, "test", "file.c", 1, "dropped");
+    log_write (INFO, "test", "file.c", 1, "dropped");
+    assert_int_equal (log_read (&record, 1), 0);
+    log_set_level (DEBUG);
+    log_write (DEBUG, "test", "file.c", 1, "kept");
+    assert_int_equal (log_read (&record, 1), 1);
+    log_set_level (OFF);
+    log_write (ERROR, "test", "file.c", 1, "dropped");
+    assert_int_equal (log_read (&record, 1), 0);
+}
+/*
+ * A full ring drops new messages and counts them, draining it makes room
+ * again. Long messages are truncated.
+ */
+static void
+log_ring_full_test (void **state)
+{
+    log_record record;
+    char long_message[LOG_MESSAGE_SIZE * 2];
+    size_t dropped = log_dropped ();
+    int i;
+
+    for (i = 0; i < LOG_RING_SIZE + 3; ++i) {
+        log_write (ERROR, "test", "file.c", i, "message");
+    }
+    assert_int_equal (log_dropped () - dropped, 3);
+    for (i = 0; i < LOG_RING_SIZE; ++i) {
+        assert_int_equal (log_read (&record, 1), 1);
+    }
+    assert_string_equal (record.message, "ERROR:test:file.c:63 message");
+    assert_int_equal (log_read (&record, 1), 0);
+
+    memset (long_message, 'x', sizeof (long_message) - 1);
+    long_message[sizeof (long_message) - 1] = '\0';
+    log_write (ERROR, "test", "file.c", 1, "%s", long_message);
+    assert_int_equal (log_read (&record, 1), 1);
+    assert_int_equal (strlen (record.message), LOG_MESSAGE_SIZE - 1);
+}
+
+int
+main (int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup (log_ring_order_test, log_ring_setup),
+        cmocka_unit_test_setup (log_ring_filter_test, log_ring_setup),
+        cmocka_unit_test_setup (log_ring_full_test, log_ring_setup),
+    };
+    return cmocka_run_group_tests (tests, NULL, NULL);
+}
@@ -0,0 +1,161 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <string.h>
+#include <sapi/tss2_mu.h>
+
+typedef struct {
+    uint8_t data[8192];
+    size_t size;
+    size_t calls;
+    size_t fail_at;
+} SINK_DATA;
+
+static TSS2_RC
+sink_write(void *data, uint8_t const *bytes, size_t size)
+{
+    SINK_DATA *out = data;
+
+    if (++out->calls == out->fail_at)
+        return TSS2_TYPES_RC_INSUFFICIENT_BUFFER;
+    assert_true (out->size + size <= sizeof(out->data));
+    memcpy(&out->data[out->size], bytes, size);
+    out->size += size;
+    return TSS2_RC_SUCCESS;
+}
+
+/*
+ * Marshal src into a buffer and through a sink and check that both produce
+ * the same bytes.
+ */
+#define CHECK_SINK(type, src) \
+    do { \
+        uint8_t buffer[sizeof(SINK_DATA)]; \
+        SINK_DATA out = {{0}}; \
+        TSS2_MU_SINK sink = { sink_write, &out }; \
+        size_t offset = 0, size = 0; \
+        TSS2_RC rc; \
+\
+        rc = Tss2_MU_##type##_Marshal(src, buffer, sizeof(buffer), &offset); \
+        assert_int_equal (rc, TSS2_RC_SUCCESS); \
+        rc = TSS2_MU_MARSHAL_SINK(type, src, &sink, &size); \
+        assert_int_equal (rc, TSS2_RC_SUCCESS); \
+        assert_int_equal (size, offset); \
+        assert_int_equal (out.size, offset); \
+        assert_memory_equal (out.data, buffer, offset); \
+    } while (0)
+
+/*
+ * A public key with a payload larger than the staging buffer and a TPM2B
+ * whose size field is recomputed.
+ */
+static void
+sink_public(void **state)
+{
+    TPM2B_PUBLIC pub = {0};
+
+    pub.t.size = 1; /* stale, must be recomputed */
+    pub.t.publicArea.type = TPM_ALG_RSA;
+    pub.t.publicArea.nameAlg = TPM_ALG_SHA256;
+    pub.t.publicArea.objectAttributes.decrypt = 1;
+    pub.t.publicArea.objectAttributes.restricted = 1;
+    pub.t.publicArea.authPolicy.t.size = 32;
+    memset(pub.t.publicArea.authPolicy.t.buffer, 0xaa, 32);
+    pub.t.publicArea.parameters.rsaDetail.symmetric.algorithm = TPM_ALG_AES;
+    pub.t.publicArea.parameters.rsaDetail.symmetric.keyBits.aes = 128;
+    pub.t.publicArea.parameters.rsaDetail.symmetric.mode.aes = TPM_ALG_CFB;
+    pub.t.publicArea.parameters.rsaDetail.scheme.scheme = TPM_ALG_NULL;
+    pub.t.publicArea.parameters.rsaDetail.keyBits = 2048;
+    pub.t.publicArea.unique.rsa.t.size = 256;
+    memset(pub.t.publicArea.unique.rsa.t.buffer, 0x5c, 256);
+
+    CHECK_SINK(TPM2B_PUBLIC, &pub);
+    CHECK_SINK(TPMT_PUBLIC, &pub.t.publicArea);
+}
+
+/*
+ * Structures going through the fixed layout, PCR selection and array fast
+ * paths.
+ */
+static void
+sink_fast_paths(void **state)
+{
+    TPMS_ATTEST attest = {0};
+    TPML_CC cc = {0};
+    UINT32 i;
+
+    attest.magic = TPM_GENERATED_VALUE;
+    attest.type = TPM_ST_ATTEST_QUOTE;
+    attest.extraData.t.size = 16;
+    attest.clockInfo.clock = 12345;
+    attest.clockInfo.safe = 1;
+    attest.firmwareVersion = 0x1122334455667788;
+    attest.attested.quote.pcrSelect.count = 2;
+    attest.attested.quote.pcrSelect.pcrSelections[0].hash = TPM_ALG_SHA1;
+    attest.attested.quote.pcrSelect.pcrSelections[0].sizeofSelect = 3;
+    attest.attested.quote.pcrSelect.pcrSelections[0].pcrSelect[1] = 0xf0;
+    attest.attested.quote.pcrSelect.pcrSelections[1].hash = TPM_ALG_SHA256;
+    attest.attested.quote.pcrSelect.pcrSelections[1].sizeofSelect = 3;
+    attest.attested.quote.pcrDigest.t.size = 32;
+    CHECK_SINK(TPMS_ATTEST, &attest);
+    CHECK_SINK(TPMS_CLOCK_INFO, &attest.clockInfo);
+
+    /* more elements than fit in the staging buffer at once */
+    cc.count = MAX_CAP_CC;
+    for (i = 0; i < cc.count; i++)
+        cc.commandCodes[i] = TPM_CC_FIRST + i;
+    CHECK_SINK(TPML_CC, &cc);
+}
+
+/*
+ * Errors from the sink stop marshalling and are returned
+ */
+static void
+sink_error(void **state)
+{
+    TPMT_PUBLIC pub = {0};
+    SINK_DATA out = {{0}};
+    TSS2_MU_SINK sink = { sink_write, &out };
+    TSS2_RC rc;
+
+    pub.type = TPM_ALG_KEYEDHASH;
+    pub.nameAlg = TPM_ALG_SHA256;
+    pub.parameters.keyedHashDetail.scheme.scheme = TPM_ALG_NULL;
+    pub.unique.keyedHash.t.size = 32;
+    out.fail_at = 1;
+
+    rc = TSS2_MU_MARSHAL_SINK(TPMT_PUBLIC, &pub, &sink, NULL);
+    assert_int_equal (rc, TSS2_TYPES_RC_INSUFFICIENT_BUFFER);
+
+    rc = TSS2_MU_MARSHAL_SINK(TPMT_PUBLIC, NULL, &sink, NULL);
+    assert_int_equal (rc, TSS2_TYPES_RC_BAD_REFERENCE);
+    rc = TSS2_MU_MARSHAL_SINK(TPMT_PUBLIC, &pub, NULL, NULL);
+    assert_int_equal (rc, TSS2_TYPES_RC_BAD_REFERENCE);
+}
+
+/*
+ * The size mode of the marshal functions is unaffected outside of a sink
+ */
+static void
+sink_size_mode(void **state)
+{
+    TPMS_CLOCK_INFO info = {0};
+    size_t offset = 0;
+    TSS2_RC rc;
+
+    rc = Tss2_MU_TPMS_CLOCK_INFO_Marshal(&info, NULL, 0, &offset);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (offset, 17);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test (sink_public),
+        cmocka_unit_test (sink_fast_paths),
+        cmocka_unit_test (sink_error),
+        cmocka_unit_test (sink_size_mode),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,162 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <string.h>
+#include <sapi/tss2_mu.h>
+
+/*
+ * Base and attribute types have a fixed wire size.
+ */
+static void
+size_fixed_types(void **state)
+{
+    TPMA_OBJECT attrs = {0};
+    TPMA_NV nv_attrs = {0};
+    size_t size = 0;
+    TSS2_RC rc;
+
+    rc = Tss2_MU_UINT8_Size(0x12, &size);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (size, 1);
+
+    rc = Tss2_MU_UINT64_Size(0x12, &size);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (size, 8);
+
+    rc = Tss2_MU_TPM_CC_Size(TPM_CC_Startup, &size);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (size, 4);
+
+    rc = Tss2_MU_TPMA_OBJECT_Size(attrs, &size);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (size, 4);
+
+    rc = Tss2_MU_TPMA_NV_Size(nv_attrs, &size);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (size, 4);
+}
+
+/*
+ * The size of a TPM2B wrapping a structure is computed from the structure,
+ * the size field, which Marshal recomputes, is ignored.
+ */
+static void
+size_tpm2b_subtype(void **state)
+{
+    TPM2B_PUBLIC pub = {0};
+    uint8_t buffer[sizeof(pub)] = {0};
+    size_t offset = 0, size = 0;
+    TSS2_RC rc;
+
+    pub.t.size = 0;
+    pub.t.publicArea.type = TPM_ALG_RSA;
+    pub.t.publicArea.nameAlg = TPM_ALG_SHA256;
+    pub.t.publicArea.authPolicy.t.size = 32;
+    pub.t.publicArea.parameters.rsaDetail.symmetric.algorithm = TPM_ALG_AES;
+    pub.t.publicArea.parameters.rsaDetail.symmetric.keyBits.aes = 128;
+    pub.t.publicArea.parameters.rsaDetail.symmetric.mode.aes = TPM_ALG_CFB;
+    pub.t.publicArea.parameters.rsaDetail.scheme.scheme = TPM_ALG_NULL;
+    pub.t.publicArea.parameters.rsaDetail.keyBits = 2048;
+    pub.t.publicArea.unique.rsa.t.size = 256;
+
+    rc = Tss2_MU_TPM2B_PUBLIC_Size(&pub, &size);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+    rc = Tss2_MU_TPM2B_PUBLIC_Marshal(&pub, buffer, sizeof(buffer), &offset);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (size, offset);
+}
+
+/*
+ * TPML sizes don't need a buffer_size large enough for the list.
+ */
+static void
+size_tpml(void **state)
+{
+    TPML_PCR_SELECTION sel = {0};
+    uint8_t buffer[sizeof(sel)] = {0};
+    size_t offset = 0, size = 0;
+    TSS2_RC rc;
+
+    sel.count = 2;
+    sel.pcrSelections[0].hash = TPM_ALG_SHA1;
+    sel.pcrSelections[0].sizeofSelect = 3;
+    sel.pcrSelections[1].hash = TPM_ALG_SHA256;
+    sel.pcrSelections[1].sizeofSelect = 2;
+
+    rc = Tss2_MU_TPML_PCR_SELECTION_Size(&sel, &size);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (size, 4 + 2 + 1 + 3 + 2 + 1 + 2);
+
+    rc = Tss2_MU_TPML_PCR_SELECTION_Marshal(&sel, buffer, sizeof(buffer), &offset);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (size, offset);
+
+    offset = 0;
+    rc = Tss2_MU_TPML_PCR_SELECTION_Marshal(&sel, NULL, 0, &offset);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (size, offset);
+
+    sel.count = HASH_COUNT + 1;
+    rc = Tss2_MU_TPML_PCR_SELECTION_Size(&sel, &size);
+    assert_int_equal (rc, TSS2_SYS_RC_BAD_VALUE);
+}
+
+/*
+ * Union sizes depend on the selector.
+ */
+static void
+size_tpmu(void **state)
+{
+    TPMU_HA ha = {0};
+    size_t size = 0;
+    TSS2_RC rc;
+
+    rc = Tss2_MU_TPMU_HA_Size(&ha, TPM_ALG_SHA1, &size);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (size, SHA1_DIGEST_SIZE);
+
+    rc = Tss2_MU_TPMU_HA_Size(&ha, TPM_ALG_SHA512, &size);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (size, SHA512_DIGEST_SIZE);
+}
+
+/*
+ * Invalid case with NULL src or size
+ */
+static void
+size_null(void **state)
+{
+    TPM2B_DIGEST dgst = {0};
+    TPMS_CLOCK_INFO info = {0};
+    size_t size = 0;
+    TSS2_RC rc;
+
+    rc = Tss2_MU_UINT32_Size(0, NULL);
+    assert_int_equal (rc, TSS2_TYPES_RC_BAD_REFERENCE);
+
+    rc = Tss2_MU_TPM2B_DIGEST_Size(NULL, &size);
+    assert_int_equal (rc, TSS2_TYPES_RC_BAD_REFERENCE);
+
+    rc = Tss2_MU_TPM2B_DIGEST_Size(&dgst, NULL);
+    assert_int_equal (rc, TSS2_TYPES_RC_BAD_REFERENCE);
+
+    rc = Tss2_MU_TPMS_CLOCK_INFO_Size(NULL, &size);
+    assert_int_equal (rc, TSS2_TYPES_RC_BAD_REFERENCE);
+
+    rc = Tss2_MU_TPMS_CLOCK_INFO_Size(&info, NULL);
+    assert_int_equal (rc, TSS2_TYPES_RC_BAD_REFERENCE);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test (size_fixed_types),
+        cmocka_unit_test (size_tpm2b_subtype),
+        cmocka_unit_test (size_tpml),
+        cmocka_unit_test (size_tpmu),
+        cmocka_unit_test (size_null),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
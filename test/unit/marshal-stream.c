@@ -0,0 +1,244 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <string.h>
+#include <sapi/tss2_mu.h>
+
+#define STAGING_SIZE 1024
+
+typedef struct {
+    TPM_ST tag;
+    UINT32 size;
+    TPM_RC rc;
+    TPMI_YES_NO more;
+    TPMS_CAPABILITY_DATA data;
+} CAP_RESPONSE;
+
+/*
+ * Build a GetCapability like response holding a list of handles.
+ */
+static size_t
+cap_response_build(uint8_t *buffer, size_t buffer_size)
+{
+    TPMS_CAPABILITY_DATA data = {0};
+    size_t offset = 10, size, hdr = 0;
+    UINT32 i;
+    TSS2_RC rc;
+
+    data.capability = TPM_CAP_HANDLES;
+    data.data.handles.count = MAX_CAP_HANDLES;
+    for (i = 0; i < MAX_CAP_HANDLES; i++)
+        data.data.handles.handle[i] = 0x81000000 + i;
+
+    rc = Tss2_MU_UINT8_Marshal(YES, buffer, buffer_size, &offset);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = Tss2_MU_TPMS_CAPABILITY_DATA_Marshal(&data, buffer, buffer_size, &offset);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    size = offset;
+
+    rc = Tss2_MU_TPM_ST_Marshal(TPM_ST_NO_SESSIONS, buffer, buffer_size, &hdr);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = Tss2_MU_UINT32_Marshal(size, buffer, buffer_size, &hdr);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = Tss2_MU_UINT32_Marshal(TPM_RC_SUCCESS, buffer, buffer_size, &hdr);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    return size;
+}
+
+static void
+cap_response_steps(TSS2_MU_STREAM_STEP *steps, CAP_RESPONSE *resp)
+{
+    TSS2_MU_STREAM_STEP const init[] = {
+        TSS2_MU_STREAM_STEP_INIT(TPM_ST, &resp->tag),
+        TSS2_MU_STREAM_STEP_INIT(UINT32, &resp->size),
+        TSS2_MU_STREAM_STEP_INIT(UINT32, &resp->rc),
+        TSS2_MU_STREAM_STEP_INIT(UINT8, &resp->more),
+        TSS2_MU_STREAM_STEP_INIT(TPMS_CAPABILITY_DATA, &resp->data),
+    };
+    memcpy(steps, init, sizeof(init));
+}
+
+/*
+ * Feed the response in chunks of every size from 1 byte up, the decoded
+ * fields must match a plain unmarshal of the whole buffer.
+ */
+static void
+stream_chunks(void **state)
+{
+    uint8_t buffer[sizeof(CAP_RESPONSE)] = {0};
+    uint8_t staging[STAGING_SIZE];
+    TSS2_MU_STREAM_STEP steps[5];
+    TSS2_MU_STREAM stream;
+    TPMS_CAPABILITY_DATA expected = {0};
+    CAP_RESPONSE resp;
+    size_t size, chunk, pos, used, offset = 11;
+    TSS2_RC rc;
+
+    size = cap_response_build(buffer, sizeof(buffer));
+    rc = Tss2_MU_TPMS_CAPABILITY_DATA_Unmarshal(buffer, size, &offset, &expected);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (offset, size);
+
+    for (chunk = 1; chunk <= size; chunk += (chunk < 16) ? 1 : 61) {
+        memset(&resp, 0, sizeof(resp));
+        cap_response_steps(steps, &resp);
+        rc = Tss2_MU_StreamInit(&stream, steps, 5, staging, sizeof(staging));
+        assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+        for (pos = 0; pos < size; pos += used) {
+            size_t n = (size - pos < chunk) ? size - pos : chunk;
+            rc = Tss2_MU_StreamFeed(&stream, &buffer[pos], n, &used);
+            if (pos + n < size) {
+                assert_int_equal (rc, TSS2_TYPES_RC_TRY_AGAIN);
+                assert_int_equal (used, n);
+            }
+        }
+        assert_int_equal (rc, TSS2_RC_SUCCESS);
+        assert_int_equal (stream.step, 5);
+        assert_int_equal (stream.consumed, size);
+        assert_int_equal (resp.tag, TPM_ST_NO_SESSIONS);
+        assert_int_equal (resp.size, size);
+        assert_int_equal (resp.rc, TPM_RC_SUCCESS);
+        assert_int_equal (resp.more, YES);
+        assert_memory_equal (&resp.data, &expected, sizeof(expected));
+    }
+}
+
+/*
+ * Fields complete as soon as their bytes arrive, trailing data after the
+ * last step is left to the caller.
+ */
+static void
+stream_progress(void **state)
+{
+    uint8_t buffer[64] = {0};
+    uint8_t staging[STAGING_SIZE];
+    TPMS_CONTEXT ctx = {0}, out;
+    TSS2_MU_STREAM_STEP steps[] = {
+        TSS2_MU_STREAM_STEP_INIT(TPMS_CONTEXT, &out),
+    };
+    TSS2_MU_STREAM stream;
+    uint8_t blob[sizeof(TPMS_CONTEXT)];
+    size_t size = 0, used;
+    TSS2_RC rc;
+
+    ctx.sequence = 0x1122334455667788ULL;
+    ctx.savedHandle = 0x80000001;
+    ctx.hierarchy = TPM_RH_OWNER;
+    ctx.contextBlob.t.size = 12;
+    memset(ctx.contextBlob.t.buffer, 0xa5, 12);
+    rc = Tss2_MU_TPMS_CONTEXT_Marshal(&ctx, blob, sizeof(blob), &size);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_true (size + 4 <= sizeof(buffer));
+    memcpy(buffer, blob, size);
+
+    rc = Tss2_MU_StreamInit(&stream, steps, 1, staging, sizeof(staging));
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+    rc = Tss2_MU_StreamFeed(&stream, buffer, size - 1, &used);
+    assert_int_equal (rc, TSS2_TYPES_RC_TRY_AGAIN);
+    assert_int_equal (stream.step, 0);
+    assert_int_equal (stream.staged, size - 1);
+
+    rc = Tss2_MU_StreamFeed(&stream, &buffer[size - 1], 5, &used);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (used, 1);
+    assert_int_equal (stream.step, 1);
+    assert_int_equal (stream.consumed, size);
+    assert_true (out.sequence == ctx.sequence);
+    assert_int_equal (out.savedHandle, ctx.savedHandle);
+    assert_int_equal (out.hierarchy, ctx.hierarchy);
+    assert_int_equal (out.contextBlob.t.size, 12);
+    assert_memory_equal (out.contextBlob.t.buffer, ctx.contextBlob.t.buffer, 12);
+
+    /* a finished stream takes nothing */
+    rc = Tss2_MU_StreamFeed(&stream, buffer, 4, &used);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (used, 0);
+}
+
+/*
+ * A field that doesn't fit the staging buffer can't be resumed, malformed
+ * fields are reported as is.
+ */
+static void
+stream_errors(void **state)
+{
+    uint8_t buffer[128] = {0};
+    uint8_t staging[8];
+    TPM2B_DIGEST dgst;
+    TSS2_MU_STREAM_STEP steps[] = {
+        TSS2_MU_STREAM_STEP_INIT(TPM2B_DIGEST, &dgst),
+    };
+    TSS2_MU_STREAM stream;
+    size_t used;
+    TSS2_RC rc;
+
+    rc = Tss2_MU_StreamInit(NULL, steps, 1, staging, sizeof(staging));
+    assert_int_equal (rc, TSS2_TYPES_RC_BAD_REFERENCE);
+
+    /* 32 byte digest, 8 bytes of staging */
+    buffer[1] = 32;
+    rc = Tss2_MU_StreamInit(&stream, steps, 1, staging, sizeof(staging));
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = Tss2_MU_StreamFeed(&stream, buffer, 4, &used);
+    assert_int_equal (rc, TSS2_TYPES_RC_TRY_AGAIN);
+    rc = Tss2_MU_StreamFeed(&stream, &buffer[4], 20, &used);
+    assert_int_equal (rc, TSS2_TYPES_RC_INSUFFICIENT_BUFFER);
+
+    rc = Tss2_MU_StreamInit(&stream, steps, 1, staging, sizeof(staging));
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = Tss2_MU_StreamFeed(&stream, buffer, 20, &used);
+    assert_int_equal (rc, TSS2_TYPES_RC_INSUFFICIENT_BUFFER);
+
+    /* size larger than TPM2B_DIGEST can hold */
+    buffer[1] = sizeof(TPMU_HA) + 1;
+    rc = Tss2_MU_StreamInit(&stream, steps, 1, staging, sizeof(staging));
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = Tss2_MU_StreamFeed(&stream, buffer, sizeof(buffer), &used);
+    assert_int_equal (rc, TSS2_SYS_RC_MALFORMED_RESPONSE);
+
+    rc = Tss2_MU_StreamFeed(NULL, buffer, 2, &used);
+    assert_int_equal (rc, TSS2_TYPES_RC_BAD_REFERENCE);
+}
+
+/*
+ * A field larger than the staging buffer, split across two chunks, fails
+ * on the second chunk without consuming any of it.
+ */
+static void
+stream_oversized(void **state)
+{
+    uint8_t buffer[64] = {0};
+    uint8_t staging[8];
+    TPM2B_DIGEST dgst;
+    TSS2_MU_STREAM_STEP steps[] = {
+        TSS2_MU_STREAM_STEP_INIT(TPM2B_DIGEST, &dgst),
+    };
+    TSS2_MU_STREAM stream;
+    size_t used;
+    TSS2_RC rc;
+
+    buffer[1] = 32;
+    rc = Tss2_MU_StreamInit(&stream, steps, 1, staging, sizeof(staging));
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = Tss2_MU_StreamFeed(&stream, buffer, 6, &used);
+    assert_int_equal (rc, TSS2_TYPES_RC_TRY_AGAIN);
+    assert_int_equal (used, 6);
+    used = 0xff;
+    rc = Tss2_MU_StreamFeed(&stream, &buffer[6], 34 - 6, &used);
+    assert_int_equal (rc, TSS2_TYPES_RC_INSUFFICIENT_BUFFER);
+    assert_int_equal (used, 0);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test (stream_chunks),
+        cmocka_unit_test (stream_progress),
+        cmocka_unit_test (stream_errors),
+        cmocka_unit_test (stream_oversized),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,253 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <string.h>
+#include <sapi/tss2_mu.h>
+
+static size_t
+marshal_quote(uint8_t *buffer, size_t buffer_size)
+{
+    TPMS_ATTEST attest = {0};
+    size_t offset = 0;
+    TSS2_RC rc;
+
+    attest.magic = TPM_GENERATED_VALUE;
+    attest.type = TPM_ST_ATTEST_QUOTE;
+    attest.qualifiedSigner.t.size = 4;
+    memset(attest.qualifiedSigner.t.name, 0x11, 4);
+    attest.extraData.t.size = 20;
+    memset(attest.extraData.t.buffer, 0x22, 20);
+    attest.clockInfo.clock = 0x0102030405060708;
+    attest.clockInfo.resetCount = 3;
+    attest.clockInfo.restartCount = 4;
+    attest.clockInfo.safe = 1;
+    attest.firmwareVersion = 0xa0b0c0d0e0f00010;
+    attest.attested.quote.pcrSelect.count = 1;
+    attest.attested.quote.pcrSelect.pcrSelections[0].hash = TPM_ALG_SHA256;
+    attest.attested.quote.pcrSelect.pcrSelections[0].sizeofSelect = 3;
+    attest.attested.quote.pcrSelect.pcrSelections[0].pcrSelect[0] = 0x81;
+    attest.attested.quote.pcrDigest.t.size = 32;
+    memset(attest.attested.quote.pcrDigest.t.buffer, 0x33, 32);
+
+    rc = Tss2_MU_TPMS_ATTEST_Marshal(&attest, buffer, buffer_size, &offset);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    return offset;
+}
+
+/*
+ * A view over a quote gives the same values as a full unmarshal, TPM2B
+ * fields point into the buffer.
+ */
+static void
+attest_view_quote(void **state)
+{
+    TSS2_MU_TPMS_ATTEST_VIEW view;
+    TPMS_ATTEST attest = {0};
+    TPMS_CLOCK_INFO clock_info;
+    TPMU_ATTEST attested;
+    uint8_t buffer[256] = {0};
+    uint8_t const *data;
+    size_t size, len, offset = 0, unmarshal_offset = 0;
+    UINT64 fw;
+    TSS2_RC rc;
+
+    len = marshal_quote(buffer, sizeof(buffer));
+    rc = Tss2_MU_TPMS_ATTEST_Unmarshal(buffer, len, &unmarshal_offset, &attest);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+    rc = Tss2_MU_TPMS_ATTEST_View(buffer, len, &offset, &view);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (offset, len);
+    assert_int_equal (view.size, len);
+    assert_int_equal (view.type, TPM_ST_ATTEST_QUOTE);
+    assert_true (sizeof(view) <= 32);
+
+    rc = Tss2_MU_TPMS_ATTEST_View_QualifiedSigner(&view, &data, &size);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (size, 4);
+    assert_memory_equal (data, attest.qualifiedSigner.t.name, 4);
+
+    rc = Tss2_MU_TPMS_ATTEST_View_ExtraData(&view, &data, &size);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (size, 20);
+    assert_true (data > buffer && data < buffer + len);
+    assert_memory_equal (data, attest.extraData.t.buffer, 20);
+
+    rc = Tss2_MU_TPMS_ATTEST_View_ClockInfo(&view, &clock_info);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_memory_equal (&clock_info.clock, &attest.clockInfo.clock, 8);
+    assert_int_equal (clock_info.resetCount, 3);
+    assert_int_equal (clock_info.restartCount, 4);
+    assert_int_equal (clock_info.safe, 1);
+
+    rc = Tss2_MU_TPMS_ATTEST_View_FirmwareVersion(&view, &fw);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_memory_equal (&fw, &attest.firmwareVersion, sizeof(fw));
+
+    rc = Tss2_MU_TPMS_ATTEST_View_PcrDigest(&view, &data, &size);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (size, 32);
+    assert_memory_equal (data, attest.attested.quote.pcrDigest.t.buffer, 32);
+
+    memset(&attested, 0, sizeof(attested));
+    rc = Tss2_MU_TPMS_ATTEST_View_Attested(&view, &attested);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (attested.quote.pcrSelect.count, 1);
+    assert_int_equal (attested.quote.pcrSelect.pcrSelections[0].pcrSelect[0], 0x81);
+}
+
+/*
+ * Every truncation of the structure is rejected, non-quote types have no
+ * PCR digest and unknown types are rejected.
+ */
+static void
+attest_view_invalid(void **state)
+{
+    TSS2_MU_TPMS_ATTEST_VIEW view;
+    TPMS_ATTEST attest = {0};
+    uint8_t buffer[256] = {0};
+    uint8_t const *data;
+    size_t size, len, i, offset;
+    TSS2_RC rc;
+
+    len = marshal_quote(buffer, sizeof(buffer));
+    for (i = 0; i < len; i++) {
+        rc = Tss2_MU_TPMS_ATTEST_View(buffer, i, NULL, &view);
+        assert_int_not_equal (rc, TSS2_RC_SUCCESS);
+    }
+
+    attest.type = TPM_ST_ATTEST_CERTIFY;
+    offset = 0;
+    rc = Tss2_MU_TPMS_ATTEST_Marshal(&attest, buffer, sizeof(buffer), &offset);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = Tss2_MU_TPMS_ATTEST_View(buffer, offset, NULL, &view);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = Tss2_MU_TPMS_ATTEST_View_PcrDigest(&view, &data, &size);
+    assert_int_equal (rc, TSS2_SYS_RC_BAD_VALUE);
+
+    /* type field */
+    buffer[4] = 0x80;
+    buffer[5] = 0x00;
+    rc = Tss2_MU_TPMS_ATTEST_View(buffer, offset, NULL, &view);
+    assert_int_equal (rc, TSS2_SYS_RC_MALFORMED_RESPONSE);
+
+    /* qualifiedSigner larger than a TPM2B_NAME */
+    memset(buffer, 0, sizeof(buffer));
+    buffer[7] = sizeof(TPMU_NAME) + 1;
+    rc = Tss2_MU_TPMS_ATTEST_View(buffer, sizeof(buffer), NULL, &view);
+    assert_int_equal (rc, TSS2_SYS_RC_MALFORMED_RESPONSE);
+
+    rc = Tss2_MU_TPMS_ATTEST_View(NULL, len, NULL, &view);
+    assert_int_equal (rc, TSS2_TYPES_RC_BAD_REFERENCE);
+    rc = Tss2_MU_TPMS_ATTEST_View(buffer, len, NULL, NULL);
+    assert_int_equal (rc, TSS2_TYPES_RC_BAD_REFERENCE);
+}
+
+/*
+ * A view over an ECC public key
+ */
+static void
+public_view_ecc(void **state)
+{
+    TSS2_MU_TPM2B_PUBLIC_VIEW view;
+    TPM2B_PUBLIC pub = {0};
+    TPMU_PUBLIC_ID unique;
+    TPMU_PUBLIC_PARMS parms;
+    TPMA_OBJECT attrs;
+    uint8_t buffer[sizeof(pub)] = {0};
+    uint8_t const *data;
+    size_t size, len = 0, offset = 3;
+    TSS2_RC rc;
+
+    pub.t.publicArea.type = TPM_ALG_ECC;
+    pub.t.publicArea.nameAlg = TPM_ALG_SHA256;
+    pub.t.publicArea.objectAttributes.sign = 1;
+    pub.t.publicArea.objectAttributes.fixedTPM = 1;
+    pub.t.publicArea.parameters.eccDetail.symmetric.algorithm = TPM_ALG_NULL;
+    pub.t.publicArea.parameters.eccDetail.scheme.scheme = TPM_ALG_ECDSA;
+    pub.t.publicArea.parameters.eccDetail.scheme.details.ecdsa.hashAlg = TPM_ALG_SHA256;
+    pub.t.publicArea.parameters.eccDetail.curveID = TPM_ECC_NIST_P256;
+    pub.t.publicArea.parameters.eccDetail.kdf.scheme = TPM_ALG_NULL;
+    pub.t.publicArea.unique.ecc.x.t.size = 32;
+    memset(pub.t.publicArea.unique.ecc.x.t.buffer, 0x44, 32);
+    pub.t.publicArea.unique.ecc.y.t.size = 32;
+    memset(pub.t.publicArea.unique.ecc.y.t.buffer, 0x55, 32);
+
+    len = 3;
+    rc = Tss2_MU_TPM2B_PUBLIC_Marshal(&pub, buffer, sizeof(buffer), &len);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+    rc = Tss2_MU_TPM2B_PUBLIC_View(buffer, len, &offset, &view);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (offset, len);
+    assert_int_equal (view.size, len - 3);
+    assert_int_equal (view.type, TPM_ALG_ECC);
+    assert_int_equal (view.nameAlg, TPM_ALG_SHA256);
+
+    rc = Tss2_MU_TPM2B_PUBLIC_View_PublicArea(&view, &data, &size);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_true (data == buffer + 3 + 2);
+    assert_int_equal (size, len - 3 - 2);
+
+    rc = Tss2_MU_TPM2B_PUBLIC_View_ObjectAttributes(&view, &attrs);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (attrs.val, pub.t.publicArea.objectAttributes.val);
+
+    rc = Tss2_MU_TPM2B_PUBLIC_View_Parameters(&view, &parms);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (parms.eccDetail.curveID, TPM_ECC_NIST_P256);
+
+    rc = Tss2_MU_TPM2B_PUBLIC_View_Unique(&view, &unique);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (unique.ecc.x.t.size, 32);
+    assert_memory_equal (unique.ecc.y.t.buffer,
+                         pub.t.publicArea.unique.ecc.y.t.buffer, 32);
+}
+
+/*
+ * The size field has to match the public area exactly
+ */
+static void
+public_view_size_mismatch(void **state)
+{
+    TSS2_MU_TPM2B_PUBLIC_VIEW view;
+    TPM2B_PUBLIC pub = {0};
+    uint8_t buffer[sizeof(pub) + 1] = {0};
+    size_t len = 0;
+    TSS2_RC rc;
+
+    pub.t.publicArea.type = TPM_ALG_KEYEDHASH;
+    pub.t.publicArea.nameAlg = TPM_ALG_SHA1;
+    pub.t.publicArea.parameters.keyedHashDetail.scheme.scheme = TPM_ALG_NULL;
+    pub.t.publicArea.unique.keyedHash.t.size = 20;
+
+    rc = Tss2_MU_TPM2B_PUBLIC_Marshal(&pub, buffer, sizeof(buffer), &len);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = Tss2_MU_TPM2B_PUBLIC_View(buffer, len, NULL, &view);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (view.type, TPM_ALG_KEYEDHASH);
+
+    buffer[1] += 1;
+    rc = Tss2_MU_TPM2B_PUBLIC_View(buffer, len + 1, NULL, &view);
+    assert_int_equal (rc, TSS2_SYS_RC_MALFORMED_RESPONSE);
+
+    buffer[1] -= 2;
+    rc = Tss2_MU_TPM2B_PUBLIC_View(buffer, len, NULL, &view);
+    assert_int_not_equal (rc, TSS2_RC_SUCCESS);
+
+    buffer[1] += 1;
+    rc = Tss2_MU_TPM2B_PUBLIC_View(buffer, len - 1, NULL, &view);
+    assert_int_equal (rc, TSS2_TYPES_RC_INSUFFICIENT_BUFFER);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test (attest_view_quote),
+        cmocka_unit_test (attest_view_invalid),
+        cmocka_unit_test (public_view_ecc),
+        cmocka_unit_test (public_view_size_mismatch),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
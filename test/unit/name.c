@@ -0,0 +1,102 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+
+#include <cmocka.h>
+#include <openssl/sha.h>
+
+#include "sapi/tpm20.h"
+#include "sapi/tss2_mu.h"
+#include "util/name.h"
+
+static void
+name_public_test (void **state)
+{
+    TPMT_PUBLIC pub = { 0 };
+    TPM2B_NAME name = { .t.size = 0 };
+    uint8_t buffer[sizeof (pub)];
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+    size_t offset = 0;
+    TSS2_RC rc;
+
+    pub.type = TPM_ALG_ECC;
+    pub.nameAlg = TPM_ALG_SHA256;
+    pub.objectAttributes.sign = 1;
+    pub.parameters.eccDetail.symmetric.algorithm = TPM_ALG_NULL;
+    pub.parameters.eccDetail.scheme.scheme = TPM_ALG_NULL;
+    pub.parameters.eccDetail.curveID = TPM_ECC_NIST_P256;
+    pub.parameters.eccDetail.kdf.scheme = TPM_ALG_NULL;
+    pub.unique.ecc.x.t.size = 32;
+    memset (pub.unique.ecc.x.t.buffer, 0x01, 32);
+    pub.unique.ecc.y.t.size = 32;
+    memset (pub.unique.ecc.y.t.buffer, 0x02, 32);
+
+    rc = Tss2_MU_TPMT_PUBLIC_Marshal (&pub, buffer, sizeof (buffer), &offset);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    SHA256 (buffer, offset, digest);
+
+    rc = Tss2_Name_FromPublic (&pub, &name);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (name.t.size, 2 + SHA256_DIGEST_LENGTH);
+    assert_int_equal (name.t.name [0], 0x00);
+    assert_int_equal (name.t.name [1], 0x0b);
+    assert_memory_equal (&name.t.name [2], digest, sizeof (digest));
+}
+
+static void
+name_nv_public_test (void **state)
+{
+    TPMS_NV_PUBLIC nv = { 0 };
+    TPM2B_NAME name = { .t.size = 0 };
+    uint8_t buffer[sizeof (nv)];
+    uint8_t digest[SHA_DIGEST_LENGTH];
+    size_t offset = 0;
+    TSS2_RC rc;
+
+    nv.nvIndex = 0x01500000;
+    nv.nameAlg = TPM_ALG_SHA1;
+    nv.attributes.TPMA_NV_AUTHREAD = 1;
+    nv.dataSize = 32;
+
+    rc = Tss2_MU_TPMS_NV_PUBLIC_Marshal (&nv, buffer, sizeof (buffer), &offset);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    SHA1 (buffer, offset, digest);
+
+    rc = Tss2_Name_FromNvPublic (&nv, &name);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (name.t.size, 2 + SHA_DIGEST_LENGTH);
+    assert_memory_equal (&name.t.name [2], digest, sizeof (digest));
+}
+
+static void
+name_invalid_test (void **state)
+{
+    TPMT_PUBLIC pub = { 0 };
+    TPM2B_NAME name;
+    TSS2_RC rc;
+
+    rc = Tss2_Name_FromPublic (NULL, &name);
+    assert_int_equal (rc, TSS2_UTIL_RC_BAD_REFERENCE);
+    rc = Tss2_Name_FromPublic (&pub, NULL);
+    assert_int_equal (rc, TSS2_UTIL_RC_BAD_REFERENCE);
+
+    pub.nameAlg = TPM_ALG_NULL;
+    rc = Tss2_Name_FromPublic (&pub, &name);
+    assert_int_equal (rc, TSS2_UTIL_RC_BAD_VALUE);
+
+    pub.nameAlg = TPM_ALG_SM3_256;
+    rc = Tss2_Name_FromPublic (&pub, &name);
+    assert_int_equal (rc, TSS2_UTIL_RC_NOT_SUPPORTED);
+}
+
+int
+main (void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test (name_public_test),
+        cmocka_unit_test (name_nv_public_test),
+        cmocka_unit_test (name_invalid_test),
+    };
+    return cmocka_run_group_tests (tests, NULL, NULL);
+}
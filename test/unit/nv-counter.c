@@ -0,0 +1,314 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "sapi/tpm20.h"
+#include "util/nv_counter.h"
+
+#define NV_INDEX    0x01500020
+#define SYS_CONTEXT ((TSS2_SYS_CONTEXT*)0x1)
+#define LEASE       100
+
+static const TPM2B_AUTH nv_auth = { .t.size = 3, .t.buffer = "pwd" };
+
+/*
+ * Fake NV counter index. A new index is initialized by its first
+ * NV_Increment to 'first', as a TPM does with the highest value any
+ * counter ever had.
+ */
+static struct {
+    int written;
+    UINT64 value;
+    UINT64 first;
+    unsigned int increments;
+    unsigned int reads;
+} nv;
+
+static void
+check_password (TSS2_SYS_CMD_AUTHS const *auths)
+{
+    assert_non_null (auths);
+    assert_int_equal (auths->cmdAuthsCount, 1);
+    assert_int_equal (auths->cmdAuths[0]->sessionHandle, TPM_RS_PW);
+    assert_int_equal (auths->cmdAuths[0]->hmac.t.size, nv_auth.t.size);
+}
+
+TPM_RC
+__wrap_Tss2_Sys_NV_Read (TSS2_SYS_CONTEXT *sysContext,
+                         TPMI_RH_NV_AUTH authHandle,
+                         TPMI_RH_NV_INDEX nvIndex,
+                         TSS2_SYS_CMD_AUTHS const *cmdAuthsArray,
+                         UINT16 size,
+                         UINT16 offset,
+                         TPM2B_MAX_NV_BUFFER *data,
+                         TSS2_SYS_RSP_AUTHS *rspAuthsArray)
+{
+    size_t i;
+
+    ++nv.reads;
+    assert_int_equal (authHandle, NV_INDEX);
+    assert_int_equal (nvIndex, NV_INDEX);
+    check_password (cmdAuthsArray);
+    assert_int_equal (size, 8);
+    assert_int_equal (offset, 0);
+    if (!nv.written) {
+        return TPM_RC_NV_UNINITIALIZED;
+    }
+    data->t.size = 8;
+    for (i = 0; i < 8; ++i) {
+        data->t.buffer[i] = nv.value >> (56 - 8 * i);
+    }
+    return TPM_RC_SUCCESS;
+}
+
+TPM_RC
+__wrap_Tss2_Sys_NV_Increment (TSS2_SYS_CONTEXT *sysContext,
+                              TPMI_RH_NV_AUTH authHandle,
+                              TPMI_RH_NV_INDEX nvIndex,
+                              TSS2_SYS_CMD_AUTHS const *cmdAuthsArray,
+                              TSS2_SYS_RSP_AUTHS *rspAuthsArray)
+{
+    ++nv.increments;
+    assert_int_equal (nvIndex, NV_INDEX);
+    check_password (cmdAuthsArray);
+    if (!nv.written) {
+        nv.written = 1;
+        nv.value = nv.first;
+    } else {
+        nv.value++;
+    }
+    return TPM_RC_SUCCESS;
+}
+
+static int
+nv_counter_setup (void **state)
+{
+    memset (&nv, 0, sizeof (nv));
+    nv.written = 1;
+    return 0;
+}
+
+static NV_COUNTER*
+counter_new (const char *journal, UINT64 lease)
+{
+    NV_COUNTER_CONF conf = {
+        .sys_context = SYS_CONTEXT,
+        .nv_index = NV_INDEX,
+        .auth = &nv_auth,
+        .lease = lease,
+        .journal = journal,
+    };
+    NV_COUNTER *counter;
+    size_t size = 0;
+
+    assert_int_equal (Tss2_NvCounter_Init (NULL, &size, &conf),
+                      TSS2_RC_SUCCESS);
+    counter = calloc (1, size);
+    assert_non_null (counter);
+    assert_int_equal (Tss2_NvCounter_Init (counter, &size, &conf),
+                      TSS2_RC_SUCCESS);
+    return counter;
+}
+
+static void
+journal_path (char *path, size_t size)
+{
+    int fd;
+
+    snprintf (path, size, "/tmp/nv-counter-XXXXXX");
+    fd = mkstemp (path);
+    assert_true (fd >= 0);
+    close (fd);
+}
+
+static UINT64
+increment (NV_COUNTER *counter, UINT64 count)
+{
+    UINT64 value = 0;
+
+    assert_int_equal (Tss2_NvCounter_Increment (counter, count, &value),
+                      TSS2_RC_SUCCESS);
+    return value;
+}
+/*
+ * Ten thousand increments cost one NV_Increment per lease and hand out
+ * every value once, in order.
+ */
+static void
+nv_counter_coalesce (void **state)
+{
+    NV_COUNTER *counter = counter_new (NULL, LEASE);
+    NV_COUNTER_STATS stats;
+    UINT64 i, value;
+
+    for (i = 1; i <= 10000; ++i) {
+        assert_int_equal (increment (counter, 1), i);
+    }
+    assert_int_equal (nv.increments, 10000 / LEASE);
+    assert_int_equal (nv.value, 10000 / LEASE);
+    assert_int_equal (increment (counter, 250), 10250);
+    assert_int_equal (nv.value, 103);
+    assert_int_equal (Tss2_NvCounter_Read (counter, &value),
+                      TSS2_RC_SUCCESS);
+    assert_int_equal (value, 10250);
+    assert_int_equal (Tss2_NvCounter_Increment (counter, 0, &value),
+                      TSS2_UTIL_RC_BAD_VALUE);
+
+    Tss2_NvCounter_GetStats (counter, &stats);
+    assert_int_equal (stats.increments, 10001);
+    assert_int_equal (stats.values, 10250);
+    assert_int_equal (stats.nv_increments, 103);
+    assert_int_equal (stats.skipped, 0);
+    Tss2_NvCounter_Finalize (counter);
+    free (counter);
+}
+/*
+ * Contexts sharing a journal share the lease, also across a restart.
+ */
+static void
+nv_counter_journal (void **state)
+{
+    NV_COUNTER *first, *second;
+    char path[64];
+    UINT64 i;
+
+    journal_path (path, sizeof (path));
+    first = counter_new (path, LEASE);
+    assert_int_equal (increment (first, 150), 150);
+    Tss2_NvCounter_Finalize (first);
+
+    first = counter_new (path, LEASE);
+    second = counter_new (path, LEASE);
+    for (i = 0; i < 20; ++i) {
+        assert_int_equal (increment (i % 2 ? first : second, 1), 151 + i);
+    }
+    assert_int_equal (nv.increments, 2);
+
+    Tss2_NvCounter_Finalize (first);
+    Tss2_NvCounter_Finalize (second);
+    free (first);
+    free (second);
+    unlink (path);
+}
+/*
+ * A journal from another boot may be older than the values handed out,
+ * its lease is given up.
+ */
+static void
+nv_counter_reboot (void **state)
+{
+    NV_COUNTER *counter;
+    char path[64];
+    FILE *file;
+
+    journal_path (path, sizeof (path));
+    counter = counter_new (path, LEASE);
+    assert_int_equal (increment (counter, 150), 150);
+    Tss2_NvCounter_Finalize (counter);
+    free (counter);
+
+    /* the boot id follows magic, version and index */
+    file = fopen (path, "r+");
+    assert_non_null (file);
+    assert_int_equal (fseek (file, 16, SEEK_SET), 0);
+    assert_int_equal (fputc ('-', file), '-');
+    fclose (file);
+
+    counter = counter_new (path, LEASE);
+    assert_int_equal (increment (counter, 1), 201);
+    assert_int_equal (nv.value, 3);
+    Tss2_NvCounter_Finalize (counter);
+    free (counter);
+    unlink (path);
+}
+/*
+ * Without the journal a restart gives up the rest of the lease, values
+ * are skipped but never handed out twice.
+ */
+static void
+nv_counter_lost_lease (void **state)
+{
+    NV_COUNTER *counter = counter_new (NULL, LEASE);
+
+    assert_int_equal (increment (counter, 150), 150);
+    Tss2_NvCounter_Finalize (counter);
+    free (counter);
+
+    counter = counter_new (NULL, LEASE);
+    assert_int_equal (increment (counter, 1), 201);
+    assert_int_equal (nv.value, 3);
+    Tss2_NvCounter_Finalize (counter);
+    free (counter);
+}
+/*
+ * Somebody else incrementing the index takes the values of their leases.
+ */
+static void
+nv_counter_foreign (void **state)
+{
+    NV_COUNTER *counter = counter_new (NULL, LEASE);
+    NV_COUNTER_STATS stats;
+
+    assert_int_equal (increment (counter, 95), 95);
+    nv.value += 2;
+    assert_int_equal (increment (counter, 10), 310);
+    assert_int_equal (nv.value, 4);
+    Tss2_NvCounter_GetStats (counter, &stats);
+    assert_int_equal (stats.skipped, 205);
+    Tss2_NvCounter_Finalize (counter);
+    free (counter);
+}
+/*
+ * A new index reads as 0 and gets its value from the first NV_Increment.
+ * A journal for another lease size is refused.
+ */
+static void
+nv_counter_uninitialized (void **state)
+{
+    NV_COUNTER_CONF conf = {
+        .sys_context = SYS_CONTEXT,
+        .nv_index = NV_INDEX,
+        .auth = &nv_auth,
+        .lease = LEASE + 1,
+    };
+    NV_COUNTER *counter, *other;
+    char path[64];
+    size_t size = 0;
+
+    nv.written = 0;
+    nv.first = 7;
+    journal_path (path, sizeof (path));
+    counter = counter_new (path, LEASE);
+    assert_int_equal (increment (counter, 1), 6 * LEASE + 1);
+    assert_int_equal (nv.value, 7);
+
+    conf.journal = path;
+    Tss2_NvCounter_Init (NULL, &size, &conf);
+    other = calloc (1, size);
+    assert_non_null (other);
+    assert_int_equal (Tss2_NvCounter_Init (other, &size, &conf),
+                      TSS2_UTIL_RC_BAD_VALUE);
+
+    free (other);
+    Tss2_NvCounter_Finalize (counter);
+    free (counter);
+    unlink (path);
+}
+
+int
+main (void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup (nv_counter_coalesce, nv_counter_setup),
+        cmocka_unit_test_setup (nv_counter_journal, nv_counter_setup),
+        cmocka_unit_test_setup (nv_counter_reboot, nv_counter_setup),
+        cmocka_unit_test_setup (nv_counter_lost_lease, nv_counter_setup),
+        cmocka_unit_test_setup (nv_counter_foreign, nv_counter_setup),
+        cmocka_unit_test_setup (nv_counter_uninitialized, nv_counter_setup),
+    };
+    return cmocka_run_group_tests (tests, NULL, NULL);
+}
@@ -0,0 +1,333 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <openssl/sha.h>
+
+#include "sapi/tpm20.h"
+#include "util/pcr.h"
+
+#define SYS_CONTEXT ((TSS2_SYS_CONTEXT*)0x1)
+
+/*
+ * Fake TPM: the SHA1 and SHA256 banks are allocated, SHA384 isn't. Each
+ * PCR reads as a digest made of its bank, its index and the update
+ * counter. 'max_digests' limits how many PCRs a response carries and the
+ * update counter is bumped before read number 'bump_at', or before every
+ * read with 'bump_always'.
+ */
+static struct {
+    unsigned int reads;
+    unsigned int extends;
+    UINT32 max_digests;
+    UINT32 update_counter;
+    unsigned int bump_at;
+    int bump_always;
+    TPMI_DH_PCR extend_pcr;
+    TPML_DIGEST_VALUES extend_digests;
+} tpm;
+
+static int
+bank_allocated (TPMI_ALG_HASH hash)
+{
+    return hash == TPM_ALG_SHA1 || hash == TPM_ALG_SHA256;
+}
+
+static void
+pcr_value (TPMI_ALG_HASH hash, UINT32 pcr, UINT32 counter, TPM2B_DIGEST *value)
+{
+    memset (value, 0, sizeof (*value));
+    value->t.size = hash == TPM_ALG_SHA1 ? SHA1_DIGEST_SIZE : SHA256_DIGEST_SIZE;
+    value->t.buffer[0] = (BYTE)hash;
+    value->t.buffer[1] = (BYTE)pcr;
+    value->t.buffer[2] = (BYTE)counter;
+}
+
+TPM_RC
+__wrap_Tss2_Sys_PCR_Read (TSS2_SYS_CONTEXT *sysContext,
+                          TSS2_SYS_CMD_AUTHS const *cmdAuthsArray,
+                          TPML_PCR_SELECTION *pcrSelectionIn,
+                          UINT32 *pcrUpdateCounter,
+                          TPML_PCR_SELECTION *pcrSelectionOut,
+                          TPML_DIGEST *pcrValues,
+                          TSS2_SYS_RSP_AUTHS *rspAuthsArray)
+{
+    UINT32 i, pcr;
+
+    ++tpm.reads;
+    if (tpm.bump_always || tpm.reads == tpm.bump_at) {
+        ++tpm.update_counter;
+    }
+    memset (pcrSelectionOut, 0, sizeof (*pcrSelectionOut));
+    memset (pcrValues, 0, sizeof (*pcrValues));
+    *pcrUpdateCounter = tpm.update_counter;
+
+    for (i = 0; i < pcrSelectionIn->count; ++i) {
+        TPMS_PCR_SELECTION *in = &pcrSelectionIn->pcrSelections[i];
+        TPMS_PCR_SELECTION *out = &pcrSelectionOut->pcrSelections[i];
+
+        out->hash = in->hash;
+        out->sizeofSelect = in->sizeofSelect;
+        for (pcr = 0; pcr < in->sizeofSelect * 8u; ++pcr) {
+            if (!(in->pcrSelect[pcr / 8] & (1 << (pcr % 8))) ||
+                !bank_allocated (in->hash) ||
+                pcrValues->count >= tpm.max_digests) {
+                continue;
+            }
+            out->pcrSelect[pcr / 8] |= 1 << (pcr % 8);
+            pcr_value (in->hash, pcr, tpm.update_counter,
+                       &pcrValues->digests[pcrValues->count++]);
+        }
+    }
+    pcrSelectionOut->count = pcrSelectionIn->count;
+
+    return TSS2_RC_SUCCESS;
+}
+
+TPM_RC
+__wrap_Tss2_Sys_PCR_Extend (TSS2_SYS_CONTEXT *sysContext,
+                            TPMI_DH_PCR pcrHandle,
+                            TSS2_SYS_CMD_AUTHS const *cmdAuthsArray,
+                            TPML_DIGEST_VALUES *digests,
+                            TSS2_SYS_RSP_AUTHS *rspAuthsArray)
+{
+    ++tpm.extends;
+    tpm.extend_pcr = pcrHandle;
+    tpm.extend_digests = *digests;
+    return TSS2_RC_SUCCESS;
+}
+
+static int
+pcr_setup (void **state)
+{
+    memset (&tpm, 0, sizeof (tpm));
+    tpm.max_digests = PCR_READ_MAX_DIGESTS;
+    return 0;
+}
+
+static void
+select_all (TPML_PCR_SELECTION *selection, const TPMI_ALG_HASH *hashes,
+            UINT32 count)
+{
+    UINT32 i;
+
+    memset (selection, 0, sizeof (*selection));
+    for (i = 0; i < count; ++i) {
+        selection->pcrSelections[i].hash = hashes[i];
+        selection->pcrSelections[i].sizeofSelect = 3;
+        memset (selection->pcrSelections[i].pcrSelect, 0xff, 3);
+    }
+    selection->count = count;
+}
+
+static void
+matrix_check (const PCR_MATRIX *matrix, TPMI_ALG_HASH hash, UINT32 counter)
+{
+    TPM2B_DIGEST expected;
+    const TPM2B_DIGEST *value;
+    UINT32 pcr;
+
+    for (pcr = 0; pcr < IMPLEMENTATION_PCR; ++pcr) {
+        value = Tss2_Pcr_MatrixGet (matrix, hash, pcr);
+        assert_non_null (value);
+        pcr_value (hash, pcr, counter, &expected);
+        assert_int_equal (value->t.size, expected.t.size);
+        assert_memory_equal (value->t.buffer, expected.t.buffer,
+                             expected.t.size);
+    }
+}
+/*
+ * Three full banks of 24 PCRs need ceil(72 / 8) = 9 reads. Chunks may span
+ * two banks when a bank's PCR count isn't a multiple of eight.
+ */
+static void
+pcr_partition (void **state)
+{
+    const TPMI_ALG_HASH hashes[] = {
+        TPM_ALG_SHA1, TPM_ALG_SHA256, TPM_ALG_SHA384
+    };
+    TPML_PCR_SELECTION selection, chunks[9];
+    size_t count = 0;
+    TSS2_RC rc;
+
+    select_all (&selection, hashes, 3);
+    rc = Tss2_Pcr_Partition (&selection, NULL, &count);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (count, 9);
+
+    count = 8;
+    rc = Tss2_Pcr_Partition (&selection, chunks, &count);
+    assert_int_equal (rc, TSS2_UTIL_RC_INSUFFICIENT_BUFFER);
+
+    count = 9;
+    rc = Tss2_Pcr_Partition (&selection, chunks, &count);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (chunks[2].count, 1);
+    assert_int_equal (chunks[2].pcrSelections[0].hash, TPM_ALG_SHA1);
+    assert_int_equal (chunks[2].pcrSelections[0].pcrSelect[0], 0);
+    assert_int_equal (chunks[2].pcrSelections[0].pcrSelect[2], 0xff);
+    assert_int_equal (chunks[8].pcrSelections[0].hash, TPM_ALG_SHA384);
+
+    /* 4 + 6 PCRs: the first chunk takes all of SHA1 and half of SHA256 */
+    memset (selection.pcrSelections[0].pcrSelect, 0, 3);
+    memset (selection.pcrSelections[1].pcrSelect, 0, 3);
+    selection.pcrSelections[0].pcrSelect[0] = 0x0f;
+    selection.pcrSelections[1].pcrSelect[0] = 0x3f;
+    selection.count = 2;
+    rc = Tss2_Pcr_Partition (&selection, chunks, &count);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (count, 2);
+    assert_int_equal (chunks[0].count, 2);
+    assert_int_equal (chunks[0].pcrSelections[0].pcrSelect[0], 0x0f);
+    assert_int_equal (chunks[0].pcrSelections[1].pcrSelect[0], 0x0f);
+    assert_int_equal (chunks[1].count, 1);
+    assert_int_equal (chunks[1].pcrSelections[0].hash, TPM_ALG_SHA256);
+    assert_int_equal (chunks[1].pcrSelections[0].pcrSelect[0], 0x30);
+}
+/*
+ * SHA1 and SHA256 are read in six calls. The unallocated SHA384 bank costs
+ * one call per chunk and stays empty in the matrix.
+ */
+static void
+pcr_read_all (void **state)
+{
+    const TPMI_ALG_HASH hashes[] = {
+        TPM_ALG_SHA1, TPM_ALG_SHA256, TPM_ALG_SHA384
+    };
+    TPML_PCR_SELECTION selection;
+    PCR_MATRIX matrix;
+    TSS2_RC rc;
+
+    select_all (&selection, hashes, 2);
+    rc = Tss2_Pcr_ReadAll (SYS_CONTEXT, &selection, &matrix);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (tpm.reads, 6);
+    assert_int_equal (matrix.count, 2);
+    matrix_check (&matrix, TPM_ALG_SHA1, 0);
+    matrix_check (&matrix, TPM_ALG_SHA256, 0);
+
+    tpm.reads = 0;
+    select_all (&selection, hashes, 3);
+    rc = Tss2_Pcr_ReadAll (SYS_CONTEXT, &selection, &matrix);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (tpm.reads, 9);
+    assert_int_equal (matrix.count, 3);
+    matrix_check (&matrix, TPM_ALG_SHA256, 0);
+    assert_null (Tss2_Pcr_MatrixGet (&matrix, TPM_ALG_SHA384, 0));
+    assert_null (Tss2_Pcr_MatrixGet (&matrix, TPM_ALG_SHA512, 0));
+}
+/*
+ * A TPM returning fewer digests than asked for gets asked again for the
+ * rest only.
+ */
+static void
+pcr_read_short (void **state)
+{
+    const TPMI_ALG_HASH hashes[] = { TPM_ALG_SHA1, TPM_ALG_SHA256 };
+    TPML_PCR_SELECTION selection;
+    PCR_MATRIX matrix;
+    TSS2_RC rc;
+
+    tpm.max_digests = 5;
+    select_all (&selection, hashes, 2);
+    rc = Tss2_Pcr_ReadAll (SYS_CONTEXT, &selection, &matrix);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (tpm.reads, 10);
+    matrix_check (&matrix, TPM_ALG_SHA1, 0);
+    matrix_check (&matrix, TPM_ALG_SHA256, 0);
+}
+/*
+ * A PCR change between two reads starts the read over, a TPM that never
+ * stops changing gets TRY_AGAIN.
+ */
+static void
+pcr_read_torn (void **state)
+{
+    const TPMI_ALG_HASH hashes[] = { TPM_ALG_SHA1, TPM_ALG_SHA256 };
+    TPML_PCR_SELECTION selection;
+    PCR_MATRIX matrix;
+    TSS2_RC rc;
+
+    tpm.bump_at = 3;
+    select_all (&selection, hashes, 2);
+    rc = Tss2_Pcr_ReadAll (SYS_CONTEXT, &selection, &matrix);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (tpm.reads, 3 + 6);
+    assert_int_equal (matrix.update_counter, 1);
+    matrix_check (&matrix, TPM_ALG_SHA1, 1);
+    matrix_check (&matrix, TPM_ALG_SHA256, 1);
+
+    tpm.reads = 0;
+    tpm.bump_always = 1;
+    rc = Tss2_Pcr_ReadAll (SYS_CONTEXT, &selection, &matrix);
+    assert_int_equal (rc, TSS2_UTIL_RC_TRY_AGAIN);
+    assert_int_equal (tpm.reads, 2 * (PCR_READ_RETRIES + 1));
+}
+/*
+ * The event is hashed once for every bank that has the PCR allocated and
+ * the host side matrix follows the extend.
+ */
+static void
+pcr_extend (void **state)
+{
+    const TPMI_ALG_HASH hashes[] = {
+        TPM_ALG_SHA1, TPM_ALG_SHA256, TPM_ALG_SHA384
+    };
+    const uint8_t event[] = "abc";
+    uint8_t expected[SHA256_DIGEST_SIZE];
+    uint8_t buffer[2 * SHA256_DIGEST_SIZE];
+    TPML_PCR_SELECTION banks;
+    TPML_DIGEST_VALUES digests;
+    PCR_MATRIX matrix;
+    const TPM2B_DIGEST *value;
+    TSS2_RC rc;
+
+    select_all (&banks, hashes, 3);
+    banks.pcrSelections[2].pcrSelect[2] = 0;
+    rc = Tss2_Pcr_Extend (SYS_CONTEXT, 16, NULL, &banks, event, 3, &digests);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (tpm.extends, 1);
+    assert_int_equal (tpm.extend_pcr, 16);
+    assert_int_equal (tpm.extend_digests.count, 2);
+    assert_int_equal (tpm.extend_digests.digests[0].hashAlg, TPM_ALG_SHA1);
+    assert_int_equal (tpm.extend_digests.digests[1].hashAlg, TPM_ALG_SHA256);
+    SHA256 (event, 3, expected);
+    assert_memory_equal (&tpm.extend_digests.digests[1].digest, expected,
+                         SHA256_DIGEST_SIZE);
+    assert_memory_equal (&digests, &tpm.extend_digests, sizeof (digests));
+
+    select_all (&banks, hashes, 2);
+    rc = Tss2_Pcr_ReadAll (SYS_CONTEXT, &banks, &matrix);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    value = Tss2_Pcr_MatrixGet (&matrix, TPM_ALG_SHA256, 16);
+    memcpy (buffer, value->t.buffer, SHA256_DIGEST_SIZE);
+    memcpy (buffer + SHA256_DIGEST_SIZE, expected, SHA256_DIGEST_SIZE);
+    SHA256 (buffer, sizeof (buffer), expected);
+    rc = Tss2_Pcr_MatrixExtend (&matrix, 16, &digests);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (value->t.size, SHA256_DIGEST_SIZE);
+    assert_memory_equal (value->t.buffer, expected, SHA256_DIGEST_SIZE);
+
+    /* no bank has PCR 23 allocated */
+    memset (banks.pcrSelections[0].pcrSelect, 0, 3);
+    memset (banks.pcrSelections[1].pcrSelect, 0, 3);
+    rc = Tss2_Pcr_Extend (SYS_CONTEXT, 23, NULL, &banks, event, 3, NULL);
+    assert_int_equal (rc, TSS2_UTIL_RC_BAD_VALUE);
+    assert_int_equal (tpm.extends, 1);
+}
+
+int
+main (void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup (pcr_partition, pcr_setup),
+        cmocka_unit_test_setup (pcr_read_all, pcr_setup),
+        cmocka_unit_test_setup (pcr_read_short, pcr_setup),
+        cmocka_unit_test_setup (pcr_read_torn, pcr_setup),
+        cmocka_unit_test_setup (pcr_extend, pcr_setup),
+    };
+    return cmocka_run_group_tests (tests, NULL, NULL);
+}
@@ -0,0 +1,365 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "sapi/tpm20.h"
+#include "util/policy_pool.h"
+
+/*
+ * Fake TPM state: the wrapped SAPI functions below count calls and hand out
+ * session handles. No TPM commands are actually sent.
+ */
+static struct {
+    unsigned int start;
+    unsigned int restart;
+    unsigned int command_code;
+    unsigned int save;
+    unsigned int load;
+    unsigned int flush;
+    TPMI_SH_AUTH_SESSION next_handle;
+    TSS2_RC load_rc;
+    TPM2B_NONCE nonce_caller;
+} tpm;
+
+TPM_RC
+__wrap_Tss2_Sys_StartAuthSession (TSS2_SYS_CONTEXT *sysContext,
+                                  TPMI_DH_OBJECT tpmKey,
+                                  TPMI_DH_ENTITY bind,
+                                  TSS2_SYS_CMD_AUTHS const *cmdAuthsArray,
+                                  TPM2B_NONCE *nonceCaller,
+                                  TPM2B_ENCRYPTED_SECRET *encryptedSalt,
+                                  TPM_SE sessionType,
+                                  TPMT_SYM_DEF *symmetric,
+                                  TPMI_ALG_HASH authHash,
+                                  TPMI_SH_AUTH_SESSION *sessionHandle,
+                                  TPM2B_NONCE *nonceTPM,
+                                  TSS2_SYS_RSP_AUTHS *rspAuthsArray)
+{
+    assert_int_equal (sessionType, TPM_SE_POLICY);
+    assert_int_equal (nonceCaller->t.size, SHA256_DIGEST_SIZE);
+    /* no two sessions share a nonceCaller */
+    assert_true (memcmp (&tpm.nonce_caller, nonceCaller,
+                         sizeof (*nonceCaller)) != 0);
+    tpm.nonce_caller = *nonceCaller;
+    tpm.start++;
+    nonceTPM->t.size = SHA256_DIGEST_SIZE;
+    memset (nonceTPM->t.buffer, tpm.start, SHA256_DIGEST_SIZE);
+    *sessionHandle = tpm.next_handle++;
+    return TSS2_RC_SUCCESS;
+}
+TPM_RC
+__wrap_Tss2_Sys_PolicyRestart (TSS2_SYS_CONTEXT *sysContext,
+                               TPMI_SH_POLICY sessionHandle,
+                               TSS2_SYS_CMD_AUTHS const *cmdAuthsArray,
+                               TSS2_SYS_RSP_AUTHS *rspAuthsArray)
+{
+    tpm.restart++;
+    return TSS2_RC_SUCCESS;
+}
+TPM_RC
+__wrap_Tss2_Sys_PolicyCommandCode (TSS2_SYS_CONTEXT *sysContext,
+                                   TPMI_SH_POLICY policySession,
+                                   TSS2_SYS_CMD_AUTHS const *cmdAuthsArray,
+                                   TPM_CC code,
+                                   TSS2_SYS_RSP_AUTHS *rspAuthsArray)
+{
+    assert_int_equal (code, TPM_CC_Unseal);
+    tpm.command_code++;
+    return TSS2_RC_SUCCESS;
+}
+TPM_RC
+__wrap_Tss2_Sys_ContextSave (TSS2_SYS_CONTEXT *sysContext,
+                             TPMI_DH_CONTEXT saveHandle,
+                             TPMS_CONTEXT *context)
+{
+    tpm.save++;
+    context->savedHandle = saveHandle;
+    return TSS2_RC_SUCCESS;
+}
+TPM_RC
+__wrap_Tss2_Sys_ContextLoad (TSS2_SYS_CONTEXT *sysContext,
+                             TPMS_CONTEXT *context,
+                             TPMI_DH_CONTEXT *loadedHandle)
+{
+    tpm.load++;
+    if (tpm.load_rc != TSS2_RC_SUCCESS)
+        return tpm.load_rc;
+    *loadedHandle = context->savedHandle;
+    return TSS2_RC_SUCCESS;
+}
+TPM_RC
+__wrap_Tss2_Sys_FlushContext (TSS2_SYS_CONTEXT *sysContext,
+                              TPMI_DH_CONTEXT flushHandle)
+{
+    tpm.flush++;
+    return TSS2_RC_SUCCESS;
+}
+
+static const POLICY_ASSERTION assertions[] = {
+    { .type = POLICY_ASSERT_COMMAND_CODE, .u.command_code = TPM_CC_Unseal },
+};
+
+static int
+policy_pool_setup (void **state)
+{
+    POLICY_POOL_CONF conf = {
+        .sys_context = (TSS2_SYS_CONTEXT*)0x1,
+        .slot_count = 3,
+        .max_loaded = 1,
+        .tpm_key = TPM_RH_NULL,
+        .bind = TPM_RH_NULL,
+        .symmetric = { .algorithm = TPM_ALG_NULL },
+        .auth_hash = TPM_ALG_SHA256,
+        .assertions = assertions,
+        .assertion_count = 1,
+    };
+    POLICY_POOL *pool;
+    size_t size = 0;
+    TSS2_RC rc;
+
+    memset (&tpm, 0, sizeof (tpm));
+    tpm.next_handle = POLICY_SESSION_FIRST;
+    rc = Tss2_PolicyPool_Init (NULL, &size, &conf);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    pool = calloc (1, size);
+    assert_non_null (pool);
+    rc = Tss2_PolicyPool_Init (pool, &size, &conf);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+    *state = pool;
+    return 0;
+}
+static int
+policy_pool_teardown (void **state)
+{
+    Tss2_PolicyPool_Finalize (*state);
+    free (*state);
+    return 0;
+}
+/*
+ * Slot counts beyond what the TPM supports must be rejected.
+ */
+static void
+policy_pool_init_bad_value_test (void **state)
+{
+    POLICY_POOL_CONF conf = {
+        .slot_count = MAX_ACTIVE_SESSIONS + 1,
+        .auth_hash = TPM_ALG_SHA256,
+    };
+    size_t size;
+    TSS2_RC rc;
+
+    rc = Tss2_PolicyPool_Init (NULL, &size, &conf);
+    assert_int_equal (rc, TSS2_UTIL_RC_BAD_VALUE);
+    conf.slot_count = 1;
+    conf.max_loaded = MAX_LOADED_SESSIONS + 1;
+    rc = Tss2_PolicyPool_Init (NULL, &size, &conf);
+    assert_int_equal (rc, TSS2_UTIL_RC_BAD_VALUE);
+    rc = Tss2_PolicyPool_Init (NULL, NULL, &conf);
+    assert_int_equal (rc, TSS2_UTIL_RC_BAD_REFERENCE);
+}
+/*
+ * A released session is reset with PolicyRestart and the assertions are
+ * replayed, StartAuthSession is only sent the first time.
+ */
+static void
+policy_pool_reuse_test (void **state)
+{
+    POLICY_POOL *pool = *state;
+    POLICY_POOL_STATS stats;
+    TPMI_SH_POLICY first, second;
+    TSS2_RC rc;
+
+    rc = Tss2_PolicyPool_Acquire (pool, &first);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (tpm.start, 1);
+    assert_int_equal (tpm.restart, 0);
+    rc = Tss2_PolicyPool_Release (pool, first, 0);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+    rc = Tss2_PolicyPool_Acquire (pool, &second);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (second, first);
+    assert_int_equal (tpm.start, 1);
+    assert_int_equal (tpm.restart, 1);
+    assert_int_equal (tpm.command_code, 2);
+
+    rc = Tss2_PolicyPool_GetStats (pool, &stats);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (stats.acquired, 2);
+    assert_int_equal (stats.started, 1);
+    assert_int_equal (stats.restarted, 1);
+}
+/*
+ * With max_loaded = 1 releasing a second session saves the least recently
+ * used idle one, handing that one out again loads it back in.
+ */
+static void
+policy_pool_swap_test (void **state)
+{
+    POLICY_POOL *pool = *state;
+    TPMI_SH_POLICY a, b, s;
+    TSS2_RC rc;
+
+    rc = Tss2_PolicyPool_Acquire (pool, &a);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = Tss2_PolicyPool_Acquire (pool, &b);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_not_equal (a, b);
+    rc = Tss2_PolicyPool_Release (pool, a, 0);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (tpm.save, 0);
+    rc = Tss2_PolicyPool_Release (pool, b, 0);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (tpm.save, 1);
+
+    /* the loaded session is preferred */
+    rc = Tss2_PolicyPool_Acquire (pool, &s);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (s, b);
+    assert_int_equal (tpm.load, 0);
+    /* then the saved one */
+    rc = Tss2_PolicyPool_Acquire (pool, &s);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (s, a);
+    assert_int_equal (tpm.load, 1);
+    assert_int_equal (tpm.start, 2);
+    /* and finally a new one */
+    rc = Tss2_PolicyPool_Acquire (pool, &s);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (tpm.start, 3);
+    rc = Tss2_PolicyPool_Acquire (pool, &s);
+    assert_int_equal (rc, TSS2_UTIL_RC_TRY_AGAIN);
+}
+/*
+ * If loading a saved session fails because the TPM was reset, a new
+ * session is started in its slot. A session flushed by the TPM is also
+ * replaced.
+ */
+static void
+policy_pool_reset_test (void **state)
+{
+    POLICY_POOL *pool = *state;
+    TPMI_SH_POLICY a, b, s;
+    TSS2_RC rc;
+
+    rc = Tss2_PolicyPool_Acquire (pool, &a);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = Tss2_PolicyPool_Acquire (pool, &b);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    Tss2_PolicyPool_Release (pool, a, 0);
+    Tss2_PolicyPool_Release (pool, b, 0);
+    rc = Tss2_PolicyPool_Acquire (pool, &s);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (s, b);
+
+    tpm.load_rc = TPM_RC_HANDLE;
+    rc = Tss2_PolicyPool_Acquire (pool, &s);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (tpm.load, 1);
+    assert_int_equal (tpm.start, 3);
+    assert_int_not_equal (s, a);
+
+    /* anything but a stale context is passed on, the slot stays saved */
+    Tss2_PolicyPool_Release (pool, s, 0);
+    Tss2_PolicyPool_Release (pool, b, 0);
+    rc = Tss2_PolicyPool_Acquire (pool, &b);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    tpm.load_rc = TPM_RC_CONTEXT_GAP;
+    rc = Tss2_PolicyPool_Acquire (pool, &s);
+    assert_int_equal (rc, TPM_RC_CONTEXT_GAP);
+    assert_int_equal (tpm.start, 3);
+    tpm.load_rc = TPM_RC_INTEGRITY + TPM_RC_P + TPM_RC_1;
+    rc = Tss2_PolicyPool_Acquire (pool, &s);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (tpm.start, 4);
+
+    rc = Tss2_PolicyPool_Release (pool, b, POLICY_POOL_RELEASE_FLUSHED);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = Tss2_PolicyPool_Acquire (pool, &s);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (tpm.start, 5);
+}
+/*
+ * The StartAuthSession nonces are kept with the session, the latest
+ * nonceTPM handed back by the caller survives Release / Acquire.
+ */
+static void
+policy_pool_nonces_test (void **state)
+{
+    POLICY_POOL *pool = *state;
+    POLICY_POOL_NONCES nonces;
+    TPM2B_NONCE nonce = { .t.size = SHA256_DIGEST_SIZE };
+    TPMI_SH_POLICY s;
+    TSS2_RC rc;
+
+    rc = Tss2_PolicyPool_Acquire (pool, &s);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = Tss2_PolicyPool_GetNonces (pool, s, &nonces);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_memory_equal (&nonces.nonce_caller, &tpm.nonce_caller,
+                         sizeof (nonces.nonce_caller));
+    assert_int_equal (nonces.nonce_tpm_start.t.size, SHA256_DIGEST_SIZE);
+    assert_int_equal (nonces.nonce_tpm_start.t.buffer[0], 1);
+    assert_memory_equal (&nonces.nonce_tpm, &nonces.nonce_tpm_start,
+                         sizeof (nonces.nonce_tpm));
+
+    memset (nonce.t.buffer, 0xaa, SHA256_DIGEST_SIZE);
+    rc = Tss2_PolicyPool_SetNonceTpm (pool, s, &nonce);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    Tss2_PolicyPool_Release (pool, s, 0);
+    rc = Tss2_PolicyPool_GetNonces (pool, s, &nonces);
+    assert_int_equal (rc, TSS2_UTIL_RC_BAD_VALUE);
+
+    rc = Tss2_PolicyPool_Acquire (pool, &s);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = Tss2_PolicyPool_GetNonces (pool, s, &nonces);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_memory_equal (&nonces.nonce_tpm, &nonce, sizeof (nonce));
+    assert_int_equal (nonces.nonce_tpm_start.t.buffer[0], 1);
+}
+/*
+ * Finalize flushes loaded and saved sessions alike.
+ */
+static void
+policy_pool_finalize_test (void **state)
+{
+    POLICY_POOL *pool = *state;
+    TPMI_SH_POLICY s[2];
+    TSS2_RC rc;
+
+    rc = Tss2_PolicyPool_Acquire (pool, &s[0]);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = Tss2_PolicyPool_Acquire (pool, &s[1]);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    Tss2_PolicyPool_Finalize (pool);
+    assert_int_equal (tpm.flush, 2);
+    rc = Tss2_PolicyPool_Release (pool, s[0], 0);
+    assert_int_equal (rc, TSS2_UTIL_RC_BAD_VALUE);
+}
+
+int
+main (int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test (policy_pool_init_bad_value_test),
+        cmocka_unit_test_setup_teardown (policy_pool_reuse_test,
+                                         policy_pool_setup,
+                                         policy_pool_teardown),
+        cmocka_unit_test_setup_teardown (policy_pool_swap_test,
+                                         policy_pool_setup,
+                                         policy_pool_teardown),
+        cmocka_unit_test_setup_teardown (policy_pool_reset_test,
+                                         policy_pool_setup,
+                                         policy_pool_teardown),
+        cmocka_unit_test_setup_teardown (policy_pool_nonces_test,
+                                         policy_pool_setup,
+                                         policy_pool_teardown),
+        cmocka_unit_test_setup_teardown (policy_pool_finalize_test,
+                                         policy_pool_setup,
+                                         policy_pool_teardown),
+    };
+    return cmocka_run_group_tests (tests, NULL, NULL);
+}
@@ -0,0 +1,377 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "sapi/tpm20.h"
+#include "util/primary_cache.h"
+
+/*
+ * Fake TPM state: CreatePrimary hands out handles and encodes the template
+ * in the public area, ContextSave / ContextLoad round trip the handle
+ * through the context sequence number. No TPM commands are actually sent.
+ */
+static struct {
+    unsigned int create;
+    unsigned int save;
+    unsigned int load;
+    TPM_HANDLE next_handle;
+    TSS2_RC load_rc;
+} tpm;
+
+TPM_RC
+__wrap_Tss2_Sys_CreatePrimary (TSS2_SYS_CONTEXT *sysContext,
+                               TPMI_RH_HIERARCHY primaryHandle,
+                               TSS2_SYS_CMD_AUTHS const *cmdAuthsArray,
+                               TPM2B_SENSITIVE_CREATE *inSensitive,
+                               TPM2B_PUBLIC *inPublic,
+                               TPM2B_DATA *outsideInfo,
+                               TPML_PCR_SELECTION *creationPCR,
+                               TPM_HANDLE *objectHandle,
+                               TPM2B_PUBLIC *outPublic,
+                               TPM2B_CREATION_DATA *creationData,
+                               TPM2B_DIGEST *creationHash,
+                               TPMT_TK_CREATION *creationTicket,
+                               TPM2B_NAME *name,
+                               TSS2_SYS_RSP_AUTHS *rspAuthsArray)
+{
+    tpm.create++;
+    *objectHandle = tpm.next_handle++;
+    *outPublic = *inPublic;
+    name->t.size = 2;
+    name->t.name[0] = 0x80;
+    name->t.name[1] = tpm.create;
+    return TSS2_RC_SUCCESS;
+}
+TPM_RC
+__wrap_Tss2_Sys_ContextSave (TSS2_SYS_CONTEXT *sysContext,
+                             TPMI_DH_CONTEXT saveHandle,
+                             TPMS_CONTEXT *context)
+{
+    memset (context, 0, sizeof (*context));
+    tpm.save++;
+    context->sequence = saveHandle;
+    context->savedHandle = 0x80000000;
+    context->hierarchy = TPM_RH_OWNER;
+    context->contextBlob.t.size = 16;
+    return TSS2_RC_SUCCESS;
+}
+TPM_RC
+__wrap_Tss2_Sys_ContextLoad (TSS2_SYS_CONTEXT *sysContext,
+                             TPMS_CONTEXT *context,
+                             TPMI_DH_CONTEXT *loadedHandle)
+{
+    tpm.load++;
+    if (tpm.load_rc != TSS2_RC_SUCCESS)
+        return tpm.load_rc;
+    *loadedHandle = context->sequence;
+    return TSS2_RC_SUCCESS;
+}
+
+typedef struct {
+    char path[64];
+    PRIMARY_CACHE *cache;
+} TEST_STATE;
+
+static PRIMARY_CACHE*
+cache_open (const char *path, size_t entry_count, TSS2_RC expected)
+{
+    PRIMARY_CACHE_CONF conf = {
+        .sys_context = (TSS2_SYS_CONTEXT*)0x1,
+        .path = path,
+        .entry_count = entry_count,
+    };
+    PRIMARY_CACHE *cache;
+    size_t size = 0;
+    TSS2_RC rc;
+
+    rc = Tss2_PrimaryCache_Init (NULL, &size, &conf);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    cache = calloc (1, size);
+    assert_non_null (cache);
+    rc = Tss2_PrimaryCache_Init (cache, &size, &conf);
+    assert_int_equal (rc, expected);
+
+    return cache;
+}
+
+static int
+primary_cache_setup (void **state)
+{
+    TEST_STATE *test;
+    int fd;
+
+    memset (&tpm, 0, sizeof (tpm));
+    tpm.next_handle = TRANSIENT_FIRST;
+    test = calloc (1, sizeof (TEST_STATE));
+    assert_non_null (test);
+    snprintf (test->path, sizeof (test->path), "/tmp/primary-cache-XXXXXX");
+    fd = mkstemp (test->path);
+    assert_true (fd >= 0);
+    close (fd);
+    test->cache = cache_open (test->path, 2, TSS2_RC_SUCCESS);
+
+    *state = test;
+    return 0;
+}
+static int
+primary_cache_teardown (void **state)
+{
+    TEST_STATE *test = *state;
+
+    Tss2_PrimaryCache_Finalize (test->cache);
+    free (test->cache);
+    unlink (test->path);
+    free (test);
+    return 0;
+}
+
+static TSS2_RC
+create_primary (PRIMARY_CACHE     *cache,
+                TPMI_RH_HIERARCHY  hierarchy,
+                TPM_ALG_ID         type,
+                TPM_HANDLE        *handle,
+                TPM2B_PUBLIC      *out_public,
+                TPM2B_NAME        *name)
+{
+    TPM2B_SENSITIVE_CREATE in_sensitive = { .t.size = 0 };
+    TPM2B_PUBLIC in_public = { .t.size = 0 };
+
+    in_public.t.publicArea.type = type;
+    in_public.t.publicArea.nameAlg = TPM_ALG_SHA256;
+    if (type == TPM_ALG_RSA) {
+        in_public.t.publicArea.parameters.rsaDetail.symmetric.algorithm = TPM_ALG_AES;
+        in_public.t.publicArea.parameters.rsaDetail.symmetric.keyBits.aes = 128;
+        in_public.t.publicArea.parameters.rsaDetail.symmetric.mode.aes = TPM_ALG_CFB;
+        in_public.t.publicArea.parameters.rsaDetail.scheme.scheme = TPM_ALG_NULL;
+        in_public.t.publicArea.parameters.rsaDetail.keyBits = 2048;
+    } else {
+        in_public.t.publicArea.parameters.keyedHashDetail.scheme.scheme = TPM_ALG_NULL;
+    }
+    return Tss2_PrimaryCache_CreatePrimary (cache,
+                                            hierarchy,
+                                            NULL,
+                                            &in_sensitive,
+                                            &in_public,
+                                            handle,
+                                            out_public,
+                                            name);
+}
+/*
+ * Missing references are rejected, a NULL context returns the size.
+ */
+static void
+primary_cache_init_null_test (void **state)
+{
+    PRIMARY_CACHE_CONF conf = { .path = "/nonexistent" };
+    size_t size = 0;
+    TSS2_RC rc;
+
+    rc = Tss2_PrimaryCache_Init (NULL, NULL, &conf);
+    assert_int_equal (rc, TSS2_UTIL_RC_BAD_REFERENCE);
+    rc = Tss2_PrimaryCache_Init (NULL, &size, NULL);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_true (size > 0);
+}
+/*
+ * The first request creates the key and saves it, a second cache on the
+ * same store (ie another process) loads it instead of creating it again.
+ */
+static void
+primary_cache_hit_test (void **state)
+{
+    TEST_STATE *test = *state;
+    PRIMARY_CACHE *other;
+    PRIMARY_CACHE_STATS stats;
+    TPM2B_PUBLIC public_first, public_second;
+    TPM2B_NAME name_first, name_second;
+    TPM_HANDLE first, second;
+    TSS2_RC rc;
+
+    rc = create_primary (test->cache, TPM_RH_OWNER, TPM_ALG_RSA,
+                         &first, &public_first, &name_first);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (tpm.create, 1);
+    assert_int_equal (tpm.save, 1);
+    assert_int_equal (tpm.load, 0);
+
+    other = cache_open (test->path, 0, TSS2_RC_SUCCESS);
+    rc = create_primary (other, TPM_RH_OWNER, TPM_ALG_RSA,
+                         &second, &public_second, &name_second);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (tpm.create, 1);
+    assert_int_equal (tpm.load, 1);
+    assert_int_equal (second, first);
+    assert_int_equal (public_second.t.publicArea.type, TPM_ALG_RSA);
+    assert_int_equal (public_second.t.publicArea.nameAlg,
+                      public_first.t.publicArea.nameAlg);
+    assert_int_equal (public_second.t.publicArea.parameters.rsaDetail.keyBits,
+                      2048);
+    assert_int_equal (name_second.t.size, name_first.t.size);
+    assert_memory_equal (name_second.t.name, name_first.t.name,
+                         name_first.t.size);
+
+    rc = Tss2_PrimaryCache_GetStats (other, &stats);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (stats.hits, 1);
+    assert_int_equal (stats.misses, 0);
+    Tss2_PrimaryCache_Finalize (other);
+    free (other);
+}
+/*
+ * After a TPM Reset the saved context no longer loads, the key is created
+ * again and the entry replaced.
+ */
+static void
+primary_cache_reset_test (void **state)
+{
+    TEST_STATE *test = *state;
+    PRIMARY_CACHE_STATS stats;
+    TPM_HANDLE first, second, third;
+    TSS2_RC rc;
+
+    rc = create_primary (test->cache, TPM_RH_OWNER, TPM_ALG_RSA,
+                         &first, NULL, NULL);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    tpm.load_rc = TPM_RC_INTEGRITY;
+    rc = create_primary (test->cache, TPM_RH_OWNER, TPM_ALG_RSA,
+                         &second, NULL, NULL);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_not_equal (second, first);
+    assert_int_equal (tpm.create, 2);
+    assert_int_equal (tpm.save, 2);
+
+    tpm.load_rc = TSS2_RC_SUCCESS;
+    rc = create_primary (test->cache, TPM_RH_OWNER, TPM_ALG_RSA,
+                         &third, NULL, NULL);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (third, second);
+    assert_int_equal (tpm.create, 2);
+
+    rc = Tss2_PrimaryCache_GetStats (test->cache, &stats);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (stats.hits, 1);
+    assert_int_equal (stats.misses, 2);
+    assert_int_equal (stats.stale, 1);
+
+    /* running out of object memory says nothing about the saved context */
+    tpm.load_rc = TPM_RC_OBJECT_MEMORY;
+    rc = create_primary (test->cache, TPM_RH_OWNER, TPM_ALG_RSA,
+                         &third, NULL, NULL);
+    assert_int_equal (rc, TPM_RC_OBJECT_MEMORY);
+    assert_int_equal (tpm.create, 2);
+    tpm.load_rc = TSS2_RC_SUCCESS;
+    rc = create_primary (test->cache, TPM_RH_OWNER, TPM_ALG_RSA,
+                         &third, NULL, NULL);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (third, second);
+    assert_int_equal (tpm.create, 2);
+}
+/*
+ * Keys with a userAuth are created every time and never stored.
+ */
+static void
+primary_cache_sensitive_test (void **state)
+{
+    TEST_STATE *test = *state;
+    TPM2B_SENSITIVE_CREATE in_sensitive = { .t.size = 0 };
+    TPM2B_PUBLIC in_public = { .t.size = 0 };
+    PRIMARY_CACHE_STATS stats;
+    TPM_HANDLE handle;
+    TSS2_RC rc;
+    int i;
+
+    in_sensitive.t.sensitive.userAuth.t.size = 4;
+    memcpy (in_sensitive.t.sensitive.userAuth.t.buffer, "pass", 4);
+    in_public.t.publicArea.type = TPM_ALG_KEYEDHASH;
+    in_public.t.publicArea.nameAlg = TPM_ALG_SHA256;
+    in_public.t.publicArea.parameters.keyedHashDetail.scheme.scheme = TPM_ALG_NULL;
+    for (i = 0; i < 2; ++i) {
+        rc = Tss2_PrimaryCache_CreatePrimary (test->cache, TPM_RH_OWNER, NULL,
+                                              &in_sensitive, &in_public,
+                                              &handle, NULL, NULL);
+        assert_int_equal (rc, TSS2_RC_SUCCESS);
+    }
+    assert_int_equal (tpm.create, 2);
+    assert_int_equal (tpm.save, 0);
+    rc = Tss2_PrimaryCache_GetStats (test->cache, &stats);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (stats.uncacheable, 2);
+    assert_int_equal (stats.misses, 0);
+}
+/*
+ * Templates and hierarchies get separate entries. With a full store the
+ * oldest entry is replaced.
+ */
+static void
+primary_cache_replace_test (void **state)
+{
+    TEST_STATE *test = *state;
+    TPM_HANDLE handle;
+    TSS2_RC rc;
+
+    rc = create_primary (test->cache, TPM_RH_OWNER, TPM_ALG_RSA,
+                         &handle, NULL, NULL);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = create_primary (test->cache, TPM_RH_ENDORSEMENT, TPM_ALG_RSA,
+                         &handle, NULL, NULL);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (tpm.create, 2);
+    rc = create_primary (test->cache, TPM_RH_OWNER, TPM_ALG_KEYEDHASH,
+                         &handle, NULL, NULL);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (tpm.create, 3);
+
+    /* the endorsement key is still cached, the first owner key is gone */
+    rc = create_primary (test->cache, TPM_RH_ENDORSEMENT, TPM_ALG_RSA,
+                         &handle, NULL, NULL);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (tpm.create, 3);
+    rc = create_primary (test->cache, TPM_RH_OWNER, TPM_ALG_RSA,
+                         &handle, NULL, NULL);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (tpm.create, 4);
+}
+/*
+ * A file that isn't a store is left alone.
+ */
+static void
+primary_cache_bad_store_test (void **state)
+{
+    char path[] = "/tmp/primary-cache-XXXXXX";
+    PRIMARY_CACHE *cache;
+    int fd;
+
+    fd = mkstemp (path);
+    assert_true (fd >= 0);
+    assert_int_equal (write (fd, "not a primary cache store", 25), 25);
+    close (fd);
+    cache = cache_open (path, 0, TSS2_UTIL_RC_BAD_VALUE);
+    free (cache);
+    unlink (path);
+}
+
+int
+main (int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test (primary_cache_init_null_test),
+        cmocka_unit_test_setup_teardown (primary_cache_hit_test,
+                                         primary_cache_setup,
+                                         primary_cache_teardown),
+        cmocka_unit_test_setup_teardown (primary_cache_reset_test,
+                                         primary_cache_setup,
+                                         primary_cache_teardown),
+        cmocka_unit_test_setup_teardown (primary_cache_sensitive_test,
+                                         primary_cache_setup,
+                                         primary_cache_teardown),
+        cmocka_unit_test_setup_teardown (primary_cache_replace_test,
+                                         primary_cache_setup,
+                                         primary_cache_teardown),
+        cmocka_unit_test (primary_cache_bad_store_test),
+    };
+    return cmocka_run_group_tests (tests, NULL, NULL);
+}
@@ -0,0 +1,465 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/obj_mac.h>
+#include <openssl/rsa.h>
+#include <openssl/sha.h>
+#include <openssl/x509.h>
+
+#include "sapi/tpm20.h"
+#include "sapi/tss2_mu.h"
+#include "util/quote_verifier.h"
+
+/*
+ * Quotes are produced on the host: a TPMS_ATTEST is marshalled and signed
+ * with OpenSSL keys standing in for an RSA 2048 and an ECC P-256 AK.
+ */
+typedef struct {
+    EVP_PKEY *key;
+    TPM2B_PUBLIC public;
+} AK;
+
+typedef struct {
+    TPM2B_ATTEST quoted;
+    TPMT_SIGNATURE signature;
+    TPM2B_DATA nonce;
+    PCR_MATRIX expected;
+    TPML_PCR_SELECTION select;
+} QUOTE;
+
+static AK rsa_ak, ecc_ak;
+
+static EVP_PKEY*
+key_generate (int type)
+{
+    EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new_id (type, NULL);
+    EVP_PKEY *key = NULL;
+
+    assert_non_null (ctx);
+    assert_int_equal (EVP_PKEY_keygen_init (ctx), 1);
+    if (type == EVP_PKEY_RSA) {
+        assert_int_equal (EVP_PKEY_CTX_set_rsa_keygen_bits (ctx, 2048), 1);
+    } else {
+        assert_int_equal (EVP_PKEY_CTX_set_ec_paramgen_curve_nid (ctx,
+                              NID_X9_62_prime256v1), 1);
+    }
+    assert_int_equal (EVP_PKEY_keygen (ctx, &key), 1);
+    EVP_PKEY_CTX_free (ctx);
+    return key;
+}
+/*
+ * The TPM2B_PUBLIC is filled from the SubjectPublicKeyInfo, whose layout is
+ * fixed for RSA 2048 with exponent 65537 and for P-256.
+ */
+static const AK*
+ak_get (int type)
+{
+    AK *ak = type == EVP_PKEY_RSA ? &rsa_ak : &ecc_ak;
+    TPMT_PUBLIC *public_area = &ak->public.t.publicArea;
+    uint8_t *der = NULL;
+    int size;
+
+    if (ak->key != NULL) {
+        return ak;
+    }
+    ak->key = key_generate (type);
+    size = i2d_PUBKEY (ak->key, &der);
+    public_area->nameAlg = TPM_ALG_SHA256;
+    public_area->objectAttributes.sign = 1;
+    public_area->objectAttributes.restricted = 1;
+    public_area->objectAttributes.fixedTPM = 1;
+    public_area->objectAttributes.fixedParent = 1;
+    if (type == EVP_PKEY_RSA) {
+        assert_int_equal (size, 294);
+        public_area->type = TPM_ALG_RSA;
+        public_area->parameters.rsaDetail.symmetric.algorithm = TPM_ALG_NULL;
+        public_area->parameters.rsaDetail.scheme.scheme = TPM_ALG_NULL;
+        public_area->parameters.rsaDetail.keyBits = 2048;
+        public_area->unique.rsa.t.size = 256;
+        memcpy (public_area->unique.rsa.t.buffer, der + 33, 256);
+    } else {
+        assert_int_equal (size, 91);
+        public_area->type = TPM_ALG_ECC;
+        public_area->parameters.eccDetail.symmetric.algorithm = TPM_ALG_NULL;
+        public_area->parameters.eccDetail.scheme.scheme = TPM_ALG_NULL;
+        public_area->parameters.eccDetail.curveID = TPM_ECC_NIST_P256;
+        public_area->parameters.eccDetail.kdf.scheme = TPM_ALG_NULL;
+        public_area->unique.ecc.x.t.size = 32;
+        memcpy (public_area->unique.ecc.x.t.buffer, der + 27, 32);
+        public_area->unique.ecc.y.t.size = 32;
+        memcpy (public_area->unique.ecc.y.t.buffer, der + 59, 32);
+    }
+    OPENSSL_free (der);
+    return ak;
+}
+
+static void
+quote_sign (const AK *ak, TPM_ALG_ID scheme, QUOTE *quote)
+{
+    uint8_t digest[SHA256_DIGEST_SIZE], sig[512];
+    size_t sig_size = sizeof (sig);
+    EVP_PKEY_CTX *ctx;
+
+    SHA256 (quote->quoted.t.attestationData, quote->quoted.t.size, digest);
+    ctx = EVP_PKEY_CTX_new (ak->key, NULL);
+    assert_non_null (ctx);
+    assert_int_equal (EVP_PKEY_sign_init (ctx), 1);
+    assert_int_equal (EVP_PKEY_CTX_set_signature_md (ctx, EVP_sha256 ()), 1);
+    if (scheme == TPM_ALG_RSAPSS) {
+        assert_int_equal (EVP_PKEY_CTX_set_rsa_padding (ctx,
+                              RSA_PKCS1_PSS_PADDING), 1);
+    } else if (scheme == TPM_ALG_RSASSA) {
+        assert_int_equal (EVP_PKEY_CTX_set_rsa_padding (ctx,
+                              RSA_PKCS1_PADDING), 1);
+    }
+    assert_int_equal (EVP_PKEY_sign (ctx, sig, &sig_size, digest,
+                                     sizeof (digest)), 1);
+    EVP_PKEY_CTX_free (ctx);
+
+    quote->signature.sigAlg = scheme;
+    if (scheme == TPM_ALG_ECDSA) {
+        const uint8_t *p = sig;
+        ECDSA_SIG *ecdsa = d2i_ECDSA_SIG (NULL, &p, sig_size);
+        TPMS_SIGNATURE_ECC *ecc = &quote->signature.signature.ecdsa;
+        const BIGNUM *r, *s;
+
+        assert_non_null (ecdsa);
+        ECDSA_SIG_get0 (ecdsa, &r, &s);
+        ecc->hash = TPM_ALG_SHA256;
+        ecc->signatureR.t.size = BN_bn2binpad (r, ecc->signatureR.t.buffer, 32);
+        ecc->signatureS.t.size = BN_bn2binpad (s, ecc->signatureS.t.buffer, 32);
+        ECDSA_SIG_free (ecdsa);
+    } else {
+        TPMS_SIGNATURE_RSA *rsa = &quote->signature.signature.rsassa;
+
+        rsa->hash = TPM_ALG_SHA256;
+        rsa->sig.t.size = sig_size;
+        memcpy (rsa->sig.t.buffer, sig, sig_size);
+    }
+}
+/*
+ * A quote with the nonce "nonce" over those of SHA256 PCRs 0 and 7 that
+ * are in 'mask' (pcrSelect[0]). The expected values and selection are
+ * always both PCRs.
+ */
+static void
+quote_make_pcrs (const AK *ak, TPM_ALG_ID scheme, BYTE mask, QUOTE *quote)
+{
+    TPMS_ATTEST attest = { 0 };
+    TPMS_QUOTE_INFO *info = &attest.attested.quote;
+    PCR_BANK *bank = &quote->expected.banks[0];
+    uint8_t composite[2 * SHA256_DIGEST_SIZE];
+    size_t offset = 0, composite_size = 0;
+
+    memset (quote, 0, sizeof (*quote));
+    quote->nonce.t.size = 5;
+    memcpy (quote->nonce.t.buffer, "nonce", 5);
+
+    quote->expected.count = 1;
+    bank->hash = TPM_ALG_SHA256;
+    bank->pcrSelect[0] = 0x81;
+    bank->digests[0].t.size = SHA256_DIGEST_SIZE;
+    memset (bank->digests[0].t.buffer, 0x11, SHA256_DIGEST_SIZE);
+    bank->digests[7].t.size = SHA256_DIGEST_SIZE;
+    memset (bank->digests[7].t.buffer, 0x77, SHA256_DIGEST_SIZE);
+    quote->select.count = 1;
+    quote->select.pcrSelections[0].hash = TPM_ALG_SHA256;
+    quote->select.pcrSelections[0].sizeofSelect = 3;
+    quote->select.pcrSelections[0].pcrSelect[0] = 0x81;
+
+    attest.magic = TPM_GENERATED_VALUE;
+    attest.type = TPM_ST_ATTEST_QUOTE;
+    attest.extraData.t.size = quote->nonce.t.size;
+    memcpy (attest.extraData.t.buffer, quote->nonce.t.buffer,
+            quote->nonce.t.size);
+    attest.clockInfo.clock = 1234;
+    if (mask != 0) {
+        info->pcrSelect.count = 1;
+        info->pcrSelect.pcrSelections[0].hash = TPM_ALG_SHA256;
+        info->pcrSelect.pcrSelections[0].sizeofSelect = 3;
+        info->pcrSelect.pcrSelections[0].pcrSelect[0] = mask;
+    }
+    if (mask & 0x01) {
+        memcpy (composite, bank->digests[0].t.buffer, SHA256_DIGEST_SIZE);
+        composite_size += SHA256_DIGEST_SIZE;
+    }
+    if (mask & 0x80) {
+        memcpy (composite + composite_size, bank->digests[7].t.buffer,
+                SHA256_DIGEST_SIZE);
+        composite_size += SHA256_DIGEST_SIZE;
+    }
+    info->pcrDigest.t.size = SHA256_DIGEST_SIZE;
+    SHA256 (composite, composite_size, info->pcrDigest.t.buffer);
+
+    assert_int_equal (Tss2_MU_TPMS_ATTEST_Marshal (&attest,
+                          quote->quoted.t.attestationData,
+                          sizeof (quote->quoted.t.attestationData), &offset),
+                      TSS2_RC_SUCCESS);
+    quote->quoted.t.size = offset;
+    quote_sign (ak, scheme, quote);
+}
+
+static void
+quote_make (const AK *ak, TPM_ALG_ID scheme, QUOTE *quote)
+{
+    quote_make_pcrs (ak, scheme, 0x81, quote);
+}
+
+static void
+item_set (QUOTE_VERIFY_ITEM *item, const QUOTE *quote, const AK *ak)
+{
+    item->quoted = &quote->quoted;
+    item->signature = &quote->signature;
+    item->ak_public = &ak->public;
+    item->expected = &quote->expected;
+    item->pcr_select = &quote->select;
+    item->qualifying_data = &quote->nonce;
+    item->result = QUOTE_VERIFY_ERROR;
+}
+
+static QUOTE_VERIFIER*
+verifier_new (unsigned int threads, size_t key_count)
+{
+    QUOTE_VERIFIER_CONF conf = {
+        .threads = threads,
+        .key_count = key_count,
+    };
+    QUOTE_VERIFIER *verifier;
+    size_t size = 0;
+
+    assert_int_equal (Tss2_QuoteVerifier_Init (NULL, &size, &conf),
+                      TSS2_RC_SUCCESS);
+    verifier = calloc (1, size);
+    assert_non_null (verifier);
+    assert_int_equal (Tss2_QuoteVerifier_Init (verifier, &size, &conf),
+                      TSS2_RC_SUCCESS);
+    return verifier;
+}
+
+static void
+verifier_free (QUOTE_VERIFIER *verifier)
+{
+    assert_int_equal (Tss2_QuoteVerifier_Finalize (verifier), TSS2_RC_SUCCESS);
+    free (verifier);
+}
+
+static QUOTE_VERIFY_RESULT
+verify_one (QUOTE_VERIFIER *verifier, QUOTE_VERIFY_ITEM *item)
+{
+    Tss2_QuoteVerifier_Batch (verifier, item, 1);
+    return item->result;
+}
+/*
+ * A good RSASSA / RSAPSS quote passes, each kind of tampering is reported
+ * as such.
+ */
+static void
+quote_verify_rsa (void **state)
+{
+    const AK *ak = ak_get (EVP_PKEY_RSA);
+    QUOTE_VERIFIER *verifier = verifier_new (0, 0);
+    QUOTE_VERIFY_ITEM item;
+    TPM2B_DATA other = { .t.size = 5 };
+    QUOTE quote;
+
+    quote_make (ak, TPM_ALG_RSASSA, &quote);
+    item_set (&item, &quote, ak);
+    assert_int_equal (verify_one (verifier, &item), QUOTE_VERIFY_OK);
+
+    memcpy (other.t.buffer, "other", 5);
+    item.qualifying_data = &other;
+    assert_int_equal (verify_one (verifier, &item), QUOTE_VERIFY_BAD_NONCE);
+    item.qualifying_data = NULL;
+    assert_int_equal (verify_one (verifier, &item), QUOTE_VERIFY_OK);
+
+    quote.expected.banks[0].digests[7].t.buffer[0] ^= 1;
+    assert_int_equal (verify_one (verifier, &item), QUOTE_VERIFY_BAD_PCRS);
+    item.expected = NULL;
+    assert_int_equal (verify_one (verifier, &item), QUOTE_VERIFY_OK);
+
+    /* clockInfo.clock, right after magic, type, an empty name and the nonce */
+    quote.quoted.t.attestationData[4 + 2 + 2 + 2 + 5 + 7] ^= 1;
+    assert_int_equal (verify_one (verifier, &item), QUOTE_VERIFY_BAD_SIGNATURE);
+
+    quote_make (ak, TPM_ALG_RSAPSS, &quote);
+    item_set (&item, &quote, ak);
+    assert_int_equal (verify_one (verifier, &item), QUOTE_VERIFY_OK);
+
+    verifier_free (verifier);
+}
+/*
+ * ECDSA quotes verify against the P-256 AK, a signature that doesn't fit
+ * the key type is a key error.
+ */
+static void
+quote_verify_ecdsa (void **state)
+{
+    const AK *ak = ak_get (EVP_PKEY_EC);
+    QUOTE_VERIFIER *verifier = verifier_new (0, 0);
+    QUOTE_VERIFY_ITEM item;
+    QUOTE quote;
+
+    quote_make (ak, TPM_ALG_ECDSA, &quote);
+    item_set (&item, &quote, ak);
+    assert_int_equal (verify_one (verifier, &item), QUOTE_VERIFY_OK);
+
+    quote.signature.signature.ecdsa.signatureS.t.buffer[31] ^= 1;
+    assert_int_equal (verify_one (verifier, &item), QUOTE_VERIFY_BAD_SIGNATURE);
+
+    item.ak_public = &ak_get (EVP_PKEY_RSA)->public;
+    assert_int_equal (verify_one (verifier, &item), QUOTE_VERIFY_BAD_KEY);
+
+    verifier_free (verifier);
+}
+/*
+ * A correctly signed quote over other PCRs than the expected ones matches
+ * its own pcrDigest but is rejected. So is a quote signed with a key that
+ * isn't a restricted signing key.
+ */
+static void
+quote_verify_selection (void **state)
+{
+    const AK *ak = ak_get (EVP_PKEY_RSA);
+    QUOTE_VERIFIER *verifier = verifier_new (0, 0);
+    QUOTE_VERIFY_ITEM item;
+    AK unrestricted;
+    QUOTE quote;
+
+    quote_make_pcrs (ak, TPM_ALG_RSASSA, 0, &quote);
+    item_set (&item, &quote, ak);
+    assert_int_equal (verify_one (verifier, &item), QUOTE_VERIFY_BAD_PCRS);
+    item.pcr_select = NULL;
+    assert_int_equal (verify_one (verifier, &item), QUOTE_VERIFY_ERROR);
+    item.expected = NULL;
+    assert_int_equal (verify_one (verifier, &item), QUOTE_VERIFY_OK);
+
+    quote_make_pcrs (ak, TPM_ALG_RSASSA, 0x80, &quote);
+    item_set (&item, &quote, ak);
+    assert_int_equal (verify_one (verifier, &item), QUOTE_VERIFY_BAD_PCRS);
+
+    quote_make (ak, TPM_ALG_RSASSA, &quote);
+    item_set (&item, &quote, ak);
+    assert_int_equal (verify_one (verifier, &item), QUOTE_VERIFY_OK);
+    unrestricted = *ak;
+    unrestricted.public.t.publicArea.objectAttributes.restricted = 0;
+    item.ak_public = &unrestricted.public;
+    assert_int_equal (verify_one (verifier, &item), QUOTE_VERIFY_BAD_KEY);
+
+    verifier_free (verifier);
+}
+/*
+ * Anything but a quote is rejected before the signature is looked at.
+ */
+static void
+quote_verify_malformed (void **state)
+{
+    const AK *ak = ak_get (EVP_PKEY_EC);
+    QUOTE_VERIFIER *verifier = verifier_new (0, 0);
+    QUOTE_VERIFIER_STATS stats;
+    QUOTE_VERIFY_ITEM item;
+    QUOTE quote;
+
+    quote_make (ak, TPM_ALG_ECDSA, &quote);
+    item_set (&item, &quote, ak);
+    quote.quoted.t.attestationData[0] = 0;
+    assert_int_equal (verify_one (verifier, &item), QUOTE_VERIFY_MALFORMED);
+    quote.quoted.t.attestationData[0] = 0xff;
+    quote.quoted.t.size = 3;
+    assert_int_equal (verify_one (verifier, &item), QUOTE_VERIFY_MALFORMED);
+    item.signature = NULL;
+    assert_int_equal (verify_one (verifier, &item), QUOTE_VERIFY_ERROR);
+
+    Tss2_QuoteVerifier_GetStats (verifier, &stats);
+    assert_int_equal (stats.rejected, 3);
+    assert_int_equal (stats.key_misses, 0);
+    verifier_free (verifier);
+}
+/*
+ * A batch over four workers: both AKs are converted about once, one bad
+ * quote fails only its own item.
+ */
+#define BATCH_SIZE 64
+static void
+quote_verify_batch (void **state)
+{
+    const AK *aks[] = { ak_get (EVP_PKEY_RSA), ak_get (EVP_PKEY_EC) };
+    QUOTE_VERIFIER *verifier = verifier_new (4, 0);
+    QUOTE_VERIFY_ITEM items[BATCH_SIZE];
+    QUOTE_VERIFIER_STATS stats;
+    QUOTE quotes[2];
+    size_t i;
+
+    quote_make (aks[0], TPM_ALG_RSASSA, &quotes[0]);
+    quote_make (aks[1], TPM_ALG_ECDSA, &quotes[1]);
+    for (i = 0; i < BATCH_SIZE; ++i) {
+        item_set (&items[i], &quotes[i % 2], aks[i % 2]);
+    }
+    assert_int_equal (Tss2_QuoteVerifier_Batch (verifier, items, BATCH_SIZE),
+                      TSS2_RC_SUCCESS);
+    for (i = 0; i < BATCH_SIZE; ++i) {
+        assert_int_equal (items[i].result, QUOTE_VERIFY_OK);
+    }
+    Tss2_QuoteVerifier_GetStats (verifier, &stats);
+    assert_int_equal (stats.verified, BATCH_SIZE);
+    assert_int_equal (stats.key_hits + stats.key_misses, BATCH_SIZE);
+    assert_in_range (stats.key_misses, 2, 2 + 4);
+
+    items[10].ak_public = &aks[1]->public;
+    assert_int_equal (Tss2_QuoteVerifier_Batch (verifier, items, BATCH_SIZE),
+                      TSS2_UTIL_RC_BAD_VALUE);
+    for (i = 0; i < BATCH_SIZE; ++i) {
+        assert_int_equal (items[i].result,
+                          i == 10 ? QUOTE_VERIFY_BAD_KEY : QUOTE_VERIFY_OK);
+    }
+    verifier_free (verifier);
+}
+/*
+ * With room for one key, alternating AKs evict each other.
+ */
+static void
+quote_verify_evict (void **state)
+{
+    const AK *aks[] = { ak_get (EVP_PKEY_RSA), ak_get (EVP_PKEY_EC) };
+    QUOTE_VERIFIER *verifier = verifier_new (0, 1);
+    QUOTE_VERIFY_ITEM items[4];
+    QUOTE_VERIFIER_STATS stats;
+    QUOTE quotes[2];
+    size_t i;
+
+    quote_make (aks[0], TPM_ALG_RSASSA, &quotes[0]);
+    quote_make (aks[1], TPM_ALG_ECDSA, &quotes[1]);
+    for (i = 0; i < 4; ++i) {
+        item_set (&items[i], &quotes[i / 2 % 2 ? 0 : 1], aks[i / 2 % 2 ? 0 : 1]);
+    }
+    assert_int_equal (Tss2_QuoteVerifier_Batch (verifier, items, 4),
+                      TSS2_RC_SUCCESS);
+    Tss2_QuoteVerifier_GetStats (verifier, &stats);
+    assert_int_equal (stats.key_misses, 2);
+    assert_int_equal (stats.key_hits, 2);
+
+    assert_int_equal (Tss2_QuoteVerifier_Batch (verifier, items, 1),
+                      TSS2_RC_SUCCESS);
+    Tss2_QuoteVerifier_GetStats (verifier, &stats);
+    assert_int_equal (stats.key_misses, 3);
+    verifier_free (verifier);
+}
+
+int
+main (void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test (quote_verify_rsa),
+        cmocka_unit_test (quote_verify_ecdsa),
+        cmocka_unit_test (quote_verify_malformed),
+        cmocka_unit_test (quote_verify_selection),
+        cmocka_unit_test (quote_verify_batch),
+        cmocka_unit_test (quote_verify_evict),
+    };
+    return cmocka_run_group_tests (tests, NULL, NULL);
+}
@@ -0,0 +1,129 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "sapi/tpm20.h"
+#include "scheduler.h"
+
+static int conn_a, conn_b, conn_c;
+
+/*
+ * A short command overtakes a long one that arrived earlier, equal
+ * commands run in arrival order.
+ */
+static void
+scheduler_short_first (void **state)
+{
+    SCHEDULER sched;
+    SCHEDULER_ENTRY entry;
+
+    scheduler_init (&sched, 0);
+    assert_true (scheduler_cost (&sched, TPM_CC_CreatePrimary) >
+                 scheduler_cost (&sched, TPM_CC_Sign));
+    assert_true (scheduler_cost (&sched, TPM_CC_Sign) >
+                 scheduler_cost (&sched, TPM_CC_GetRandom));
+
+    assert_int_equal (scheduler_enqueue (&sched, &conn_a, TPM_CC_CreatePrimary,
+                                         0, 0, 0), 0);
+    assert_int_equal (scheduler_enqueue (&sched, &conn_b, TPM_CC_GetRandom,
+                                         0, 0, 10), 0);
+    assert_int_equal (scheduler_enqueue (&sched, &conn_c, TPM_CC_GetRandom,
+                                         0, 0, 20), 0);
+    assert_int_equal (sched.stats.max_depth, 3);
+
+    assert_int_equal (scheduler_next (&sched, 100, &entry), 1);
+    assert_true (entry.data == &conn_b);
+    assert_int_equal (scheduler_next (&sched, 100, &entry), 1);
+    assert_true (entry.data == &conn_c);
+    assert_int_equal (scheduler_next (&sched, 100, &entry), 1);
+    assert_true (entry.data == &conn_a);
+    assert_int_equal (scheduler_next (&sched, 100, &entry), 0);
+    assert_int_equal (sched.stats.dispatched, 3);
+    assert_int_equal (sched.stats.wait_max_us, 100);
+}
+/*
+ * Priority beats cost, a deadline beats no deadline, and a command that
+ * waited past max_wait is promoted.
+ */
+static void
+scheduler_priority_deadline (void **state)
+{
+    SCHEDULER sched;
+    SCHEDULER_ENTRY entry;
+
+    scheduler_init (&sched, 1000000);
+    scheduler_enqueue (&sched, &conn_a, TPM_CC_GetRandom, 0, 0, 0);
+    scheduler_enqueue (&sched, &conn_b, TPM_CC_Create, 1, 0, 0);
+    scheduler_next (&sched, 10, &entry);
+    assert_true (entry.data == &conn_b);
+    scheduler_next (&sched, 10, &entry);
+
+    scheduler_enqueue (&sched, &conn_a, TPM_CC_Sign, 0, 0, 0);
+    scheduler_enqueue (&sched, &conn_b, TPM_CC_Sign, 0, 5, 0);
+    scheduler_next (&sched, 10, &entry);
+    assert_true (entry.data == &conn_b);
+    scheduler_complete (&sched, &entry, 10, 7000);
+    assert_int_equal (sched.stats.deadline_misses, 1);
+    scheduler_next (&sched, 10, &entry);
+
+    scheduler_enqueue (&sched, &conn_a, TPM_CC_Create, 0, 0, 0);
+    scheduler_enqueue (&sched, &conn_b, TPM_CC_GetRandom, 5, 0, 1500000);
+    scheduler_next (&sched, 1500000, &entry);
+    assert_true (entry.data == &conn_a);
+    assert_int_equal (sched.stats.promoted, 1);
+}
+/*
+ * Measured execution times replace the static estimate.
+ */
+static void
+scheduler_learn_cost (void **state)
+{
+    SCHEDULER sched;
+    SCHEDULER_ENTRY entry;
+    int i;
+
+    scheduler_init (&sched, 0);
+    for (i = 0; i < 50; ++i) {
+        scheduler_enqueue (&sched, &conn_a, TPM_CC_GetRandom, 0, 0, 0);
+        scheduler_next (&sched, 0, &entry);
+        scheduler_complete (&sched, &entry, 0, 800000);
+    }
+    assert_true (scheduler_cost (&sched, TPM_CC_GetRandom) > 700000);
+
+    /* now it's the long one */
+    scheduler_enqueue (&sched, &conn_a, TPM_CC_GetRandom, 0, 0, 0);
+    scheduler_enqueue (&sched, &conn_b, TPM_CC_Sign, 0, 0, 0);
+    scheduler_next (&sched, 0, &entry);
+    assert_true (entry.data == &conn_b);
+}
+/*
+ * A closed connection's command leaves the queue.
+ */
+static void
+scheduler_remove_entry (void **state)
+{
+    SCHEDULER sched;
+    SCHEDULER_ENTRY entry;
+
+    scheduler_init (&sched, 0);
+    scheduler_enqueue (&sched, &conn_a, TPM_CC_GetRandom, 0, 0, 0);
+    scheduler_enqueue (&sched, &conn_b, TPM_CC_Sign, 0, 0, 0);
+    scheduler_remove (&sched, &conn_a);
+    assert_int_equal (sched.stats.depth, 1);
+    scheduler_next (&sched, 0, &entry);
+    assert_true (entry.data == &conn_b);
+    assert_int_equal (scheduler_next (&sched, 0, &entry), 0);
+}
+
+int
+main (int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test (scheduler_short_first),
+        cmocka_unit_test (scheduler_priority_deadline),
+        cmocka_unit_test (scheduler_learn_cost),
+        cmocka_unit_test (scheduler_remove_entry),
+    };
+    return cmocka_run_group_tests (tests, NULL, NULL);
+}
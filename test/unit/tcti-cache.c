@@ -0,0 +1,355 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "sapi/tpm20.h"
+#include "sapi/tss2_mu.h"
+#include "tcti/tcti_cache.h"
+
+/*
+ * A fake downstream TCTI counting the commands it sees. Every response
+ * carries the count after the header so a test can tell a cached response
+ * from a fresh one. Commands with response handles return TRANSIENT_FIRST,
+ * GetCapability returns one TPM property equal to the one asked for.
+ */
+typedef struct {
+    TSS2_TCTI_CONTEXT_COMMON_V1 common;
+    UINT32 commands;
+    UINT8 response[1024];
+    size_t response_size;
+} FAKE_TPM;
+
+static TSS2_RC
+fake_transmit (TSS2_TCTI_CONTEXT *tcti, size_t size, uint8_t *command)
+{
+    FAKE_TPM *tpm = (FAKE_TPM*)tcti;
+    UINT8 *rsp = tpm->response;
+    size_t offset = 6, out = 0;
+    TPM_CC cc;
+    TPM_CAP capability;
+    TPM_PT property;
+
+    tpm->commands++;
+    Tss2_MU_UINT32_Unmarshal (command, size, &offset, &cc);
+    Tss2_MU_TPM_ST_Marshal (TPM_ST_NO_SESSIONS, rsp, 1024, &out);
+    Tss2_MU_UINT32_Marshal (0, rsp, 1024, &out);
+    Tss2_MU_UINT32_Marshal (TPM_RC_SUCCESS, rsp, 1024, &out);
+    switch (cc) {
+    case TPM_CC_Load:
+        Tss2_MU_UINT32_Marshal (TRANSIENT_FIRST, rsp, 1024, &out);
+        break;
+    case TPM_CC_GetCapability:
+        Tss2_MU_UINT32_Unmarshal (command, size, &offset, &capability);
+        Tss2_MU_UINT32_Unmarshal (command, size, &offset, &property);
+        Tss2_MU_UINT8_Marshal (NO, rsp, 1024, &out);
+        Tss2_MU_UINT32_Marshal (capability, rsp, 1024, &out);
+        Tss2_MU_UINT32_Marshal (1, rsp, 1024, &out);
+        Tss2_MU_UINT32_Marshal (property, rsp, 1024, &out);
+        Tss2_MU_UINT32_Marshal (tpm->commands, rsp, 1024, &out);
+        break;
+    default:
+        Tss2_MU_UINT32_Marshal (tpm->commands, rsp, 1024, &out);
+        break;
+    }
+    tpm->response_size = out;
+    out = 2;
+    Tss2_MU_UINT32_Marshal (tpm->response_size, rsp, 1024, &out);
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+fake_receive (TSS2_TCTI_CONTEXT *tcti, size_t *size, uint8_t *response,
+              int32_t timeout)
+{
+    FAKE_TPM *tpm = (FAKE_TPM*)tcti;
+
+    assert_true (*size >= tpm->response_size);
+    memcpy (response, tpm->response, tpm->response_size);
+    *size = tpm->response_size;
+    return TSS2_RC_SUCCESS;
+}
+
+typedef struct {
+    FAKE_TPM tpm;
+    TSS2_TCTI_CONTEXT *cache;
+} TEST_STATE;
+
+static int
+cache_setup (void **state, int cache_pcrs)
+{
+    TEST_STATE *data = calloc (1, sizeof (TEST_STATE));
+    TCTI_CACHE_CONF conf = {
+        .downstream = (TSS2_TCTI_CONTEXT*)&data->tpm,
+        .cache_pcrs = cache_pcrs,
+    };
+    size_t size;
+    TSS2_RC rc;
+
+    assert_non_null (data);
+    data->tpm.common.version = 1;
+    data->tpm.common.transmit = fake_transmit;
+    data->tpm.common.receive = fake_receive;
+    rc = InitCacheTcti (NULL, &size, &conf);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    data->cache = calloc (1, size);
+    assert_non_null (data->cache);
+    rc = InitCacheTcti (data->cache, &size, &conf);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+    *state = data;
+    return 0;
+}
+
+static int
+tcti_cache_setup (void **state)
+{
+    return cache_setup (state, 0);
+}
+
+static int
+tcti_cache_setup_pcrs (void **state)
+{
+    return cache_setup (state, 1);
+}
+
+static int
+tcti_cache_teardown (void **state)
+{
+    TEST_STATE *data = *state;
+
+    tss2_tcti_finalize (data->cache);
+    free (data->cache);
+    free (data);
+    return 0;
+}
+/*
+ * Send a command with up to two UINT32 arguments through the cache TCTI.
+ * The last UINT32 of the response is returned.
+ */
+static UINT32
+send_command (TSS2_TCTI_CONTEXT *tcti, TPM_ST tag, TPM_CC cc, int argc,
+              UINT32 arg0, UINT32 arg1)
+{
+    UINT8 buf[1024];
+    size_t offset = 0, size;
+    UINT32 out;
+    TSS2_RC rc;
+
+    Tss2_MU_TPM_ST_Marshal (tag, buf, sizeof (buf), &offset);
+    Tss2_MU_UINT32_Marshal (10 + 4 * argc, buf, sizeof (buf), &offset);
+    Tss2_MU_UINT32_Marshal (cc, buf, sizeof (buf), &offset);
+    if (argc > 0)
+        Tss2_MU_UINT32_Marshal (arg0, buf, sizeof (buf), &offset);
+    if (argc > 1)
+        Tss2_MU_UINT32_Marshal (arg1, buf, sizeof (buf), &offset);
+    rc = tss2_tcti_transmit (tcti, offset, buf);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    size = sizeof (buf);
+    rc = tss2_tcti_receive (tcti, &size, buf, TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    offset = size - sizeof (UINT32);
+    Tss2_MU_UINT32_Unmarshal (buf, size, &offset, &out);
+    return out;
+}
+
+static void
+tcti_cache_init_null_test (void **state)
+{
+    TCTI_CACHE_CONF conf = { 0 };
+    UINT8 buf[16];
+    TSS2_RC rc;
+
+    rc = InitCacheTcti (NULL, NULL, NULL);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_VALUE);
+    rc = InitCacheTcti ((TSS2_TCTI_CONTEXT*)buf, NULL, &conf);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_VALUE);
+}
+/*
+ * PCRs change without the cache seeing it, PCR_Read isn't cached unless
+ * asked for.
+ */
+static void
+tcti_cache_pcr_default_test (void **state)
+{
+    TEST_STATE *data = *state;
+    TCTI_CACHE_STATS stats;
+    TSS2_RC rc;
+
+    send_command (data->cache, TPM_ST_NO_SESSIONS, TPM_CC_PCR_Read,
+                  1, 0x00030001, 0);
+    send_command (data->cache, TPM_ST_NO_SESSIONS, TPM_CC_PCR_Read,
+                  1, 0x00030001, 0);
+    assert_int_equal (data->tpm.commands, 2);
+    rc = TctiCacheGetStats (data->cache, &stats);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (stats.hits, 0);
+    assert_int_equal (stats.uncacheable, 2);
+}
+/*
+ * With cache_pcrs PCR_Read is answered from the cache until a PCR is
+ * extended.
+ */
+static void
+tcti_cache_pcr_test (void **state)
+{
+    TEST_STATE *data = *state;
+    TCTI_CACHE_STATS stats;
+    UINT32 first, out;
+    TSS2_RC rc;
+
+    first = send_command (data->cache, TPM_ST_NO_SESSIONS, TPM_CC_PCR_Read,
+                          1, 0x00030001, 0);
+    out = send_command (data->cache, TPM_ST_NO_SESSIONS, TPM_CC_PCR_Read,
+                        1, 0x00030001, 0);
+    assert_int_equal (out, first);
+    assert_int_equal (data->tpm.commands, 1);
+    /* a different selection is a different key */
+    send_command (data->cache, TPM_ST_NO_SESSIONS, TPM_CC_PCR_Read,
+                  1, 0x00030002, 0);
+    assert_int_equal (data->tpm.commands, 2);
+
+    send_command (data->cache, TPM_ST_SESSIONS, TPM_CC_PCR_Extend,
+                  1, 0, 0);
+    out = send_command (data->cache, TPM_ST_NO_SESSIONS, TPM_CC_PCR_Read,
+                        1, 0x00030001, 0);
+    assert_int_equal (out, 4);
+
+    rc = TctiCacheGetStats (data->cache, &stats);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (stats.hits, 1);
+    assert_int_equal (stats.misses, 3);
+    assert_int_equal (stats.uncacheable, 1);
+    assert_int_equal (stats.invalidations, 2);
+}
+/*
+ * ReadPublic entries are dropped only for the handle that was flushed or
+ * reused, NV_ReadPublic entries only for the index written.
+ */
+static void
+tcti_cache_handle_test (void **state)
+{
+    TEST_STATE *data = *state;
+    TPM_HANDLE objects[2] = { TRANSIENT_FIRST, TRANSIENT_FIRST + 1 };
+    TPM_HANDLE indices[2] = { 0x01500000, 0x01500001 };
+    UINT32 public[2], nv[2];
+    int i;
+
+    for (i = 0; i < 2; ++i) {
+        public[i] = send_command (data->cache, TPM_ST_NO_SESSIONS,
+                                  TPM_CC_ReadPublic, 1, objects[i], 0);
+        nv[i] = send_command (data->cache, TPM_ST_NO_SESSIONS,
+                              TPM_CC_NV_ReadPublic, 1, indices[i], 0);
+    }
+    send_command (data->cache, TPM_ST_NO_SESSIONS, TPM_CC_FlushContext,
+                  1, objects[0], 0);
+    send_command (data->cache, TPM_ST_SESSIONS, TPM_CC_NV_Write,
+                  2, indices[1], indices[1]);
+    assert_int_equal (data->tpm.commands, 6);
+
+    assert_int_not_equal (send_command (data->cache, TPM_ST_NO_SESSIONS,
+                                        TPM_CC_ReadPublic, 1, objects[0], 0),
+                          public[0]);
+    assert_int_equal (send_command (data->cache, TPM_ST_NO_SESSIONS,
+                                    TPM_CC_ReadPublic, 1, objects[1], 0),
+                      public[1]);
+    assert_int_equal (send_command (data->cache, TPM_ST_NO_SESSIONS,
+                                    TPM_CC_NV_ReadPublic, 1, indices[0], 0),
+                      nv[0]);
+    assert_int_not_equal (send_command (data->cache, TPM_ST_NO_SESSIONS,
+                                        TPM_CC_NV_ReadPublic, 1, indices[1], 0),
+                          nv[1]);
+    assert_int_equal (data->tpm.commands, 8);
+
+    /* the fake TPM hands out TRANSIENT_FIRST again */
+    send_command (data->cache, TPM_ST_SESSIONS, TPM_CC_Load, 1,
+                  0x81000001, 0);
+    send_command (data->cache, TPM_ST_NO_SESSIONS, TPM_CC_ReadPublic, 1,
+                  objects[0], 0);
+    assert_int_equal (data->tpm.commands, 10);
+}
+/*
+ * Only fixed TPM properties are cached, sessions and handles never are.
+ */
+static void
+tcti_cache_capability_test (void **state)
+{
+    TEST_STATE *data = *state;
+    TCTI_CACHE_STATS stats;
+    TSS2_RC rc;
+    int i;
+
+    for (i = 0; i < 2; ++i) {
+        send_command (data->cache, TPM_ST_NO_SESSIONS, TPM_CC_GetCapability,
+                      2, TPM_CAP_TPM_PROPERTIES, TPM_PT_MANUFACTURER);
+        send_command (data->cache, TPM_ST_NO_SESSIONS, TPM_CC_GetCapability,
+                      2, TPM_CAP_TPM_PROPERTIES, TPM_PT_LOCKOUT_COUNTER);
+        send_command (data->cache, TPM_ST_NO_SESSIONS, TPM_CC_GetCapability,
+                      2, TPM_CAP_HANDLES, HR_TRANSIENT);
+        send_command (data->cache, TPM_ST_SESSIONS, TPM_CC_ReadPublic,
+                      1, TRANSIENT_FIRST, 0);
+    }
+    assert_int_equal (data->tpm.commands, 7);
+    rc = TctiCacheGetStats (data->cache, &stats);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (stats.hits, 1);
+    assert_int_equal (stats.uncacheable, 4);
+
+    send_command (data->cache, TPM_ST_NO_SESSIONS, TPM_CC_Startup,
+                  1, TPM_SU_CLEAR, 0);
+    send_command (data->cache, TPM_ST_NO_SESSIONS, TPM_CC_GetCapability,
+                  2, TPM_CAP_TPM_PROPERTIES, TPM_PT_MANUFACTURER);
+    assert_int_equal (data->tpm.commands, 9);
+}
+/*
+ * A cached response that doesn't fit is reported like the downstream TCTI
+ * would, with the size needed.
+ */
+static void
+tcti_cache_small_buffer_test (void **state)
+{
+    TEST_STATE *data = *state;
+    UINT8 cmd[14], rsp[14];
+    size_t offset = 0, size = 10;
+    TSS2_RC rc;
+
+    send_command (data->cache, TPM_ST_NO_SESSIONS, TPM_CC_PCR_Read,
+                  1, 0x00030001, 0);
+    Tss2_MU_TPM_ST_Marshal (TPM_ST_NO_SESSIONS, cmd, sizeof (cmd), &offset);
+    Tss2_MU_UINT32_Marshal (14, cmd, sizeof (cmd), &offset);
+    Tss2_MU_UINT32_Marshal (TPM_CC_PCR_Read, cmd, sizeof (cmd), &offset);
+    Tss2_MU_UINT32_Marshal (0x00030001, cmd, sizeof (cmd), &offset);
+    rc = tss2_tcti_transmit (data->cache, offset, cmd);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = tss2_tcti_receive (data->cache, &size, rsp, TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rc, TSS2_TCTI_RC_INSUFFICIENT_BUFFER);
+    assert_int_equal (size, 14);
+    rc = tss2_tcti_receive (data->cache, &size, rsp, TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (data->tpm.commands, 1);
+}
+
+int
+main (int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test (tcti_cache_init_null_test),
+        cmocka_unit_test_setup_teardown (tcti_cache_pcr_default_test,
+                                         tcti_cache_setup,
+                                         tcti_cache_teardown),
+        cmocka_unit_test_setup_teardown (tcti_cache_pcr_test,
+                                         tcti_cache_setup_pcrs,
+                                         tcti_cache_teardown),
+        cmocka_unit_test_setup_teardown (tcti_cache_handle_test,
+                                         tcti_cache_setup,
+                                         tcti_cache_teardown),
+        cmocka_unit_test_setup_teardown (tcti_cache_capability_test,
+                                         tcti_cache_setup,
+                                         tcti_cache_teardown),
+        cmocka_unit_test_setup_teardown (tcti_cache_small_buffer_test,
+                                         tcti_cache_setup_pcrs,
+                                         tcti_cache_teardown),
+    };
+    return cmocka_run_group_tests (tests, NULL, NULL);
+}
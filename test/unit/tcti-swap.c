@@ -0,0 +1,614 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "sapi/tpm20.h"
+#include "sapi/tss2_mu.h"
+#include "tcti/tcti_swap.h"
+
+#define FAKE_SLOTS 3
+/* persistent parent for all loaded objects, passed through untouched */
+static TPM_HANDLE parent = 0x81000001;
+#define FAKE_SESSIONS 3
+/*
+ * A fake downstream TCTI that behaves like a TPM with FAKE_SLOTS object
+ * slots and FAKE_SESSIONS session slots. It understands Load, Sign (returns
+ * the identity of the object), StartAuthSession, ContextSave, ContextLoad
+ * and FlushContext.
+ */
+enum { FAKE_SESSION_FREE, FAKE_SESSION_LOADED, FAKE_SESSION_SAVED };
+typedef struct {
+    TSS2_TCTI_CONTEXT_COMMON_V1 common;
+    UINT32 slots[FAKE_SLOTS];       /* object id, 0 when free */
+    int sessions[FAKE_SESSIONS];
+    unsigned int session_flushes;
+    UINT32 next_id;
+    unsigned int saves;
+    unsigned int flushes;
+    UINT32 last_saved_id;
+    UINT8 response[1024];
+    size_t response_size;
+} FAKE_TPM;
+
+static size_t
+fake_header (UINT8 *buf, TPM_RC rc)
+{
+    size_t offset = 0;
+
+    Tss2_MU_TPM_ST_Marshal (TPM_ST_NO_SESSIONS, buf, 1024, &offset);
+    Tss2_MU_UINT32_Marshal (0, buf, 1024, &offset);
+    Tss2_MU_UINT32_Marshal (rc, buf, 1024, &offset);
+    return offset;
+}
+
+static int
+fake_slot (FAKE_TPM *tpm, TPM_HANDLE handle)
+{
+    int slot = handle - TRANSIENT_FIRST;
+
+    if (slot < 0 || slot >= FAKE_SLOTS || tpm->slots[slot] == 0)
+        return -1;
+    return slot;
+}
+
+static TPM_HANDLE
+fake_alloc (FAKE_TPM *tpm, UINT32 id)
+{
+    int i;
+
+    for (i = 0; i < FAKE_SLOTS; ++i) {
+        if (tpm->slots[i] == 0) {
+            tpm->slots[i] = id;
+            return TRANSIENT_FIRST + i;
+        }
+    }
+    return 0;
+}
+
+static int
+fake_session (FAKE_TPM *tpm, TPM_HANDLE handle)
+{
+    int slot = handle - HMAC_SESSION_FIRST;
+
+    if (slot < 0 || slot >= FAKE_SESSIONS ||
+        tpm->sessions[slot] == FAKE_SESSION_FREE)
+        return -1;
+    return slot;
+}
+
+static TSS2_RC
+fake_transmit (TSS2_TCTI_CONTEXT *tcti, size_t size, uint8_t *command)
+{
+    FAKE_TPM *tpm = (FAKE_TPM*)tcti;
+    UINT8 *rsp = tpm->response;
+    size_t offset = 6, out;
+    TPM_CC cc;
+    TPM_HANDLE handle;
+    TPMS_CONTEXT context = { 0 };
+    int slot;
+
+    Tss2_MU_UINT32_Unmarshal (command, size, &offset, &cc);
+    switch (cc) {
+    case TPM_CC_Load:
+        Tss2_MU_UINT32_Unmarshal (command, size, &offset, &handle);
+        assert_int_equal (handle, parent);
+        handle = fake_alloc (tpm, ++tpm->next_id);
+        if (handle == 0) {
+            out = fake_header (rsp, TPM_RC_OBJECT_MEMORY);
+            break;
+        }
+        out = fake_header (rsp, TPM_RC_SUCCESS);
+        Tss2_MU_UINT32_Marshal (handle, rsp, 1024, &out);
+        break;
+    case TPM_CC_Sign:
+        Tss2_MU_UINT32_Unmarshal (command, size, &offset, &handle);
+        slot = fake_slot (tpm, handle);
+        if (slot < 0) {
+            out = fake_header (rsp, TPM_RC_HANDLE);
+            break;
+        }
+        out = fake_header (rsp, TPM_RC_SUCCESS);
+        Tss2_MU_UINT32_Marshal (tpm->slots[slot], rsp, 1024, &out);
+        break;
+    case TPM_CC_StartAuthSession:
+        for (slot = 0; slot < FAKE_SESSIONS; ++slot) {
+            if (tpm->sessions[slot] == FAKE_SESSION_FREE)
+                break;
+        }
+        if (slot == FAKE_SESSIONS) {
+            out = fake_header (rsp, TPM_RC_SESSION_HANDLES);
+            break;
+        }
+        tpm->sessions[slot] = FAKE_SESSION_LOADED;
+        out = fake_header (rsp, TPM_RC_SUCCESS);
+        Tss2_MU_UINT32_Marshal (HMAC_SESSION_FIRST + slot, rsp, 1024, &out);
+        break;
+    case TPM_CC_ContextSave:
+        Tss2_MU_UINT32_Unmarshal (command, size, &offset, &handle);
+        slot = fake_session (tpm, handle);
+        if (slot >= 0) {
+            /* saving a session evicts it, the handle stays assigned */
+            assert_int_equal (tpm->sessions[slot], FAKE_SESSION_LOADED);
+            tpm->sessions[slot] = FAKE_SESSION_SAVED;
+            tpm->saves++;
+            context.sequence = 0x100 + slot;
+            context.savedHandle = handle;
+            context.hierarchy = TPM_RH_NULL;
+            out = fake_header (rsp, TPM_RC_SUCCESS);
+            Tss2_MU_TPMS_CONTEXT_Marshal (&context, rsp, 1024, &out);
+            break;
+        }
+        slot = fake_slot (tpm, handle);
+        assert_true (slot >= 0);
+        tpm->saves++;
+        tpm->last_saved_id = tpm->slots[slot];
+        context.sequence = tpm->slots[slot];
+        context.savedHandle = handle;
+        context.hierarchy = TPM_RH_NULL;
+        out = fake_header (rsp, TPM_RC_SUCCESS);
+        Tss2_MU_TPMS_CONTEXT_Marshal (&context, rsp, 1024, &out);
+        break;
+    case TPM_CC_ContextLoad:
+        Tss2_MU_TPMS_CONTEXT_Unmarshal (command, size, &offset, &context);
+        slot = fake_session (tpm, context.savedHandle);
+        if (slot >= 0) {
+            assert_int_equal (tpm->sessions[slot], FAKE_SESSION_SAVED);
+            tpm->sessions[slot] = FAKE_SESSION_LOADED;
+            out = fake_header (rsp, TPM_RC_SUCCESS);
+            Tss2_MU_UINT32_Marshal (context.savedHandle, rsp, 1024, &out);
+            break;
+        }
+        handle = fake_alloc (tpm, context.sequence);
+        assert_int_not_equal (handle, 0);
+        out = fake_header (rsp, TPM_RC_SUCCESS);
+        Tss2_MU_UINT32_Marshal (handle, rsp, 1024, &out);
+        break;
+    case TPM_CC_FlushContext:
+        Tss2_MU_UINT32_Unmarshal (command, size, &offset, &handle);
+        slot = fake_session (tpm, handle);
+        if (slot >= 0) {
+            tpm->session_flushes++;
+            tpm->sessions[slot] = FAKE_SESSION_FREE;
+            out = fake_header (rsp, TPM_RC_SUCCESS);
+            break;
+        }
+        slot = fake_slot (tpm, handle);
+        assert_true (slot >= 0);
+        tpm->flushes++;
+        tpm->slots[slot] = 0;
+        out = fake_header (rsp, TPM_RC_SUCCESS);
+        break;
+    default:
+        out = fake_header (rsp, TPM_RC_COMMAND_CODE);
+        break;
+    }
+    offset = 2;
+    Tss2_MU_UINT32_Marshal (out, rsp, 1024, &offset);
+    tpm->response_size = out;
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+fake_receive (TSS2_TCTI_CONTEXT *tcti, size_t *size, uint8_t *response,
+              int32_t timeout)
+{
+    FAKE_TPM *tpm = (FAKE_TPM*)tcti;
+
+    assert_true (*size >= tpm->response_size);
+    memcpy (response, tpm->response, tpm->response_size);
+    *size = tpm->response_size;
+    return TSS2_RC_SUCCESS;
+}
+
+typedef struct {
+    FAKE_TPM tpm;
+    TSS2_TCTI_CONTEXT *swap;
+} TEST_STATE;
+
+static int
+tcti_swap_setup (void **state)
+{
+    TEST_STATE *data = calloc (1, sizeof (TEST_STATE));
+    TCTI_SWAP_CONF conf = { .downstream = (TSS2_TCTI_CONTEXT*)&data->tpm };
+    size_t size;
+    TSS2_RC rc;
+
+    assert_non_null (data);
+    data->tpm.common.version = 1;
+    data->tpm.common.transmit = fake_transmit;
+    data->tpm.common.receive = fake_receive;
+    rc = InitSwapTcti (NULL, &size, &conf);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    data->swap = calloc (1, size);
+    assert_non_null (data->swap);
+    rc = InitSwapTcti (data->swap, &size, &conf);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+    *state = data;
+    return 0;
+}
+
+static int
+tcti_swap_teardown (void **state)
+{
+    TEST_STATE *data = *state;
+
+    tss2_tcti_finalize (data->swap);
+    free (data->swap);
+    free (data);
+    return 0;
+}
+/*
+ * Send a command with an optional handle through the swap TCTI and return
+ * the response code. The UINT32 following the header is returned in 'out'.
+ */
+static TPM_RC
+send_command (TSS2_TCTI_CONTEXT *tcti, TPM_CC cc, TPM_HANDLE *handle,
+              UINT32 *out)
+{
+    UINT8 buf[1024];
+    size_t offset = 0, size;
+    TPM_RC tpm_rc;
+    TSS2_RC rc;
+
+    Tss2_MU_TPM_ST_Marshal (TPM_ST_NO_SESSIONS, buf, sizeof (buf), &offset);
+    Tss2_MU_UINT32_Marshal (handle ? 14 : 10, buf, sizeof (buf), &offset);
+    Tss2_MU_UINT32_Marshal (cc, buf, sizeof (buf), &offset);
+    if (handle)
+        Tss2_MU_UINT32_Marshal (*handle, buf, sizeof (buf), &offset);
+    rc = tss2_tcti_transmit (tcti, offset, buf);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    size = sizeof (buf);
+    rc = tss2_tcti_receive (tcti, &size, buf, TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    offset = 6;
+    Tss2_MU_UINT32_Unmarshal (buf, size, &offset, &tpm_rc);
+    if (out && tpm_rc == TPM_RC_SUCCESS)
+        Tss2_MU_UINT32_Unmarshal (buf, size, &offset, out);
+    return tpm_rc;
+}
+
+static void
+tcti_swap_init_null_test (void **state)
+{
+    TCTI_SWAP_CONF conf = { 0 };
+    UINT8 buf[16];
+    TSS2_RC rc;
+
+    rc = InitSwapTcti (NULL, NULL, NULL);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_VALUE);
+    rc = InitSwapTcti ((TSS2_TCTI_CONTEXT*)buf, NULL, &conf);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_VALUE);
+}
+/*
+ * Loading more objects than the TPM has slots for must succeed, the least
+ * recently used ones are swapped out and come back when referenced.
+ */
+static void
+tcti_swap_lru_test (void **state)
+{
+    TEST_STATE *data = *state;
+    TCTI_SWAP_STATS stats;
+    TPM_HANDLE handles[6];
+    UINT32 id;
+    TPM_RC rc;
+    int i;
+
+    for (i = 0; i < 6; ++i) {
+        rc = send_command (data->swap, TPM_CC_Load, &parent, &handles[i]);
+        assert_int_equal (rc, TPM_RC_SUCCESS);
+        assert_int_equal (handles[i] & 0xffff0000, TCTI_SWAP_VHANDLE_FIRST);
+    }
+    assert_int_equal (data->tpm.saves, 3);
+    for (i = 0; i < 6; ++i) {
+        rc = send_command (data->swap, TPM_CC_Sign, &handles[i], &id);
+        assert_int_equal (rc, TPM_RC_SUCCESS);
+        assert_int_equal (id, i + 1);
+    }
+    rc = TctiSwapGetStats (data->swap, &stats);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (stats.misses, 6);
+    assert_int_equal (stats.loads, 6);
+    /* the last three are loaded now */
+    rc = send_command (data->swap, TPM_CC_Sign, &handles[5], &id);
+    assert_int_equal (rc, TPM_RC_SUCCESS);
+    rc = TctiSwapGetStats (data->swap, &stats);
+    assert_int_equal (stats.hits, 1);
+}
+/*
+ * A pinned object stays loaded while others come and go.
+ */
+static void
+tcti_swap_pin_test (void **state)
+{
+    TEST_STATE *data = *state;
+    TPM_HANDLE hot, other;
+    TCTI_SWAP_STATS stats;
+    TPM_RC rc;
+    int i;
+
+    rc = send_command (data->swap, TPM_CC_Load, &parent, &hot);
+    assert_int_equal (rc, TPM_RC_SUCCESS);
+    rc = TctiSwapPin (data->swap, hot, 1);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    for (i = 0; i < 8; ++i) {
+        rc = send_command (data->swap, TPM_CC_Load, &parent, &other);
+        assert_int_equal (rc, TPM_RC_SUCCESS);
+        assert_int_not_equal (data->tpm.last_saved_id, 1);
+    }
+    rc = send_command (data->swap, TPM_CC_Sign, &hot, NULL);
+    assert_int_equal (rc, TPM_RC_SUCCESS);
+    rc = TctiSwapGetStats (data->swap, &stats);
+    assert_int_equal (stats.hits, 1);
+    rc = TctiSwapPin (data->swap, 0x80000000, 1);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_VALUE);
+}
+/*
+ * Flushing an object that's been swapped out never reaches the TPM, and
+ * the virtual handle is invalid afterwards.
+ */
+static void
+tcti_swap_flush_test (void **state)
+{
+    TEST_STATE *data = *state;
+    TPM_HANDLE handles[4];
+    TPM_RC rc;
+    int i;
+
+    for (i = 0; i < 4; ++i) {
+        rc = send_command (data->swap, TPM_CC_Load, &parent, &handles[i]);
+        assert_int_equal (rc, TPM_RC_SUCCESS);
+    }
+    assert_int_equal (data->tpm.flushes, 1);
+    rc = send_command (data->swap, TPM_CC_FlushContext, &handles[0], NULL);
+    assert_int_equal (rc, TPM_RC_SUCCESS);
+    assert_int_equal (data->tpm.flushes, 1);
+    rc = send_command (data->swap, TPM_CC_FlushContext, &handles[3], NULL);
+    assert_int_equal (rc, TPM_RC_SUCCESS);
+    assert_int_equal (data->tpm.flushes, 2);
+    rc = send_command (data->swap, TPM_CC_Sign, &handles[3], NULL);
+    assert_int_equal (rc, TPM_RC_HANDLE + TPM_RC_H + TPM_RC_1);
+}
+/*
+ * Physical object handles and sessions started by someone else never reach
+ * the TPM, whether in the handle or the authorization area.
+ */
+static void
+tcti_swap_foreign_test (void **state)
+{
+    TEST_STATE *data = *state;
+    TPM_HANDLE handle, physical = TRANSIENT_FIRST;
+    TPM_HANDLE session = HMAC_SESSION_FIRST;
+    UINT8 buf[1024];
+    size_t offset = 0, size;
+    TPM_RC tpm_rc;
+    TSS2_RC rc;
+
+    rc = send_command (data->swap, TPM_CC_Load, &parent, &handle);
+    assert_int_equal (rc, TPM_RC_SUCCESS);
+    rc = send_command (data->swap, TPM_CC_Sign, &physical, NULL);
+    assert_int_equal (rc, TPM_RC_HANDLE + TPM_RC_H + TPM_RC_1);
+    rc = send_command (data->swap, TPM_CC_FlushContext, &physical, NULL);
+    assert_int_equal (rc, TPM_RC_HANDLE + TPM_RC_H + TPM_RC_1);
+    rc = send_command (data->swap, TPM_CC_FlushContext, &session, NULL);
+    assert_int_equal (rc, TPM_RC_HANDLE + TPM_RC_H + TPM_RC_1);
+    assert_int_equal (data->tpm.flushes, 0);
+    assert_int_equal (data->tpm.slots[0], 1);
+
+    /* Sign with a password session followed by the foreign session */
+    Tss2_MU_TPM_ST_Marshal (TPM_ST_SESSIONS, buf, sizeof (buf), &offset);
+    offset += sizeof (UINT32);
+    Tss2_MU_UINT32_Marshal (TPM_CC_Sign, buf, sizeof (buf), &offset);
+    Tss2_MU_UINT32_Marshal (handle, buf, sizeof (buf), &offset);
+    Tss2_MU_UINT32_Marshal (18, buf, sizeof (buf), &offset);
+    Tss2_MU_UINT32_Marshal (TPM_RS_PW, buf, sizeof (buf), &offset);
+    Tss2_MU_UINT16_Marshal (0, buf, sizeof (buf), &offset);
+    Tss2_MU_UINT8_Marshal (0, buf, sizeof (buf), &offset);
+    Tss2_MU_UINT16_Marshal (0, buf, sizeof (buf), &offset);
+    Tss2_MU_UINT32_Marshal (session, buf, sizeof (buf), &offset);
+    Tss2_MU_UINT16_Marshal (0, buf, sizeof (buf), &offset);
+    Tss2_MU_UINT8_Marshal (1, buf, sizeof (buf), &offset);
+    Tss2_MU_UINT16_Marshal (0, buf, sizeof (buf), &offset);
+    size = offset;
+    offset = sizeof (TPM_ST);
+    Tss2_MU_UINT32_Marshal (size, buf, sizeof (buf), &offset);
+    rc = tss2_tcti_transmit (data->swap, size, buf);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    size = sizeof (buf);
+    rc = tss2_tcti_receive (data->swap, &size, buf, TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    offset = 6;
+    Tss2_MU_UINT32_Unmarshal (buf, size, &offset, &tpm_rc);
+    assert_int_equal (tpm_rc, TPM_RC_HANDLE + TPM_RC_S + TPM_RC_1 * 2);
+}
+/*
+ * Send the command in 'buf', filling in its size, and leave the response in
+ * 'buf'. Returns the response code.
+ */
+static TPM_RC
+send_raw (TSS2_TCTI_CONTEXT *tcti, UINT8 *buf, size_t size)
+{
+    size_t offset = sizeof (TPM_ST), response_size = 1024;
+    TPM_RC tpm_rc;
+
+    Tss2_MU_UINT32_Marshal (size, buf, 1024, &offset);
+    assert_int_equal (tss2_tcti_transmit (tcti, size, buf), TSS2_RC_SUCCESS);
+    assert_int_equal (tss2_tcti_receive (tcti, &response_size, buf,
+                                         TSS2_TCTI_TIMEOUT_BLOCK),
+                      TSS2_RC_SUCCESS);
+    offset = 6;
+    Tss2_MU_UINT32_Unmarshal (buf, response_size, &offset, &tpm_rc);
+    return tpm_rc;
+}
+
+static TPM_HANDLE
+start_session (TSS2_TCTI_CONTEXT *tcti)
+{
+    UINT8 buf[1024];
+    size_t offset = 0;
+    TPM_HANDLE handle;
+
+    Tss2_MU_TPM_ST_Marshal (TPM_ST_NO_SESSIONS, buf, sizeof (buf), &offset);
+    offset += sizeof (UINT32);
+    Tss2_MU_UINT32_Marshal (TPM_CC_StartAuthSession, buf, sizeof (buf),
+                            &offset);
+    Tss2_MU_UINT32_Marshal (TPM_RH_NULL, buf, sizeof (buf), &offset);
+    Tss2_MU_UINT32_Marshal (TPM_RH_NULL, buf, sizeof (buf), &offset);
+    assert_int_equal (send_raw (tcti, buf, offset), TPM_RC_SUCCESS);
+    offset = 10;
+    Tss2_MU_UINT32_Unmarshal (buf, sizeof (buf), &offset, &handle);
+    return handle;
+}
+/*
+ * A session the app saved itself is still the app's: flushing it reaches
+ * the TPM and loading it back keeps its handle.
+ */
+static void
+tcti_swap_app_saved_session_test (void **state)
+{
+    TEST_STATE *data = *state;
+    TPMS_CONTEXT context;
+    TPM_HANDLE session, loaded;
+    UINT8 buf[1024];
+    size_t offset;
+    TPM_RC rc;
+    int i;
+
+    for (i = 0; i < 2; ++i) {
+        session = start_session (data->swap);
+        offset = 0;
+        Tss2_MU_TPM_ST_Marshal (TPM_ST_NO_SESSIONS, buf, sizeof (buf),
+                                &offset);
+        offset += sizeof (UINT32);
+        Tss2_MU_UINT32_Marshal (TPM_CC_ContextSave, buf, sizeof (buf),
+                                &offset);
+        Tss2_MU_UINT32_Marshal (session, buf, sizeof (buf), &offset);
+        assert_int_equal (send_raw (data->swap, buf, offset), TPM_RC_SUCCESS);
+        offset = 10;
+        Tss2_MU_TPMS_CONTEXT_Unmarshal (buf, sizeof (buf), &offset, &context);
+        if (i == 0) {
+            rc = send_command (data->swap, TPM_CC_FlushContext, &session,
+                               NULL);
+            assert_int_equal (rc, TPM_RC_SUCCESS);
+            assert_int_equal (data->tpm.session_flushes, 1);
+            continue;
+        }
+        offset = 0;
+        Tss2_MU_TPM_ST_Marshal (TPM_ST_NO_SESSIONS, buf, sizeof (buf),
+                                &offset);
+        offset += sizeof (UINT32);
+        Tss2_MU_UINT32_Marshal (TPM_CC_ContextLoad, buf, sizeof (buf),
+                                &offset);
+        Tss2_MU_TPMS_CONTEXT_Marshal (&context, buf, sizeof (buf), &offset);
+        assert_int_equal (send_raw (data->swap, buf, offset), TPM_RC_SUCCESS);
+        offset = 10;
+        Tss2_MU_UINT32_Unmarshal (buf, sizeof (buf), &offset, &loaded);
+        assert_int_equal (loaded, session);
+    }
+    /* the session is tracked once and goes away with the instance */
+    tss2_tcti_finalize (data->swap);
+    assert_int_equal (data->tpm.session_flushes, 2);
+    for (i = 0; i < FAKE_SESSIONS; ++i)
+        assert_int_equal (data->tpm.sessions[i], FAKE_SESSION_FREE);
+}
+/*
+ * A TPM command carries at most three sessions, an authorization area with
+ * more is rejected before it reaches the TPM.
+ */
+static void
+tcti_swap_too_many_sessions_test (void **state)
+{
+    TEST_STATE *data = *state;
+    TPM_HANDLE handle;
+    UINT8 buf[1024];
+    size_t offset = 0, size;
+    TPM_RC rc;
+    int i;
+
+    rc = send_command (data->swap, TPM_CC_Load, &parent, &handle);
+    assert_int_equal (rc, TPM_RC_SUCCESS);
+
+    Tss2_MU_TPM_ST_Marshal (TPM_ST_SESSIONS, buf, sizeof (buf), &offset);
+    offset += sizeof (UINT32);
+    Tss2_MU_UINT32_Marshal (TPM_CC_Sign, buf, sizeof (buf), &offset);
+    Tss2_MU_UINT32_Marshal (handle, buf, sizeof (buf), &offset);
+    Tss2_MU_UINT32_Marshal (4 * 9, buf, sizeof (buf), &offset);
+    for (i = 0; i < 4; ++i) {
+        Tss2_MU_UINT32_Marshal (TPM_RS_PW, buf, sizeof (buf), &offset);
+        Tss2_MU_UINT16_Marshal (0, buf, sizeof (buf), &offset);
+        Tss2_MU_UINT8_Marshal (0, buf, sizeof (buf), &offset);
+        Tss2_MU_UINT16_Marshal (0, buf, sizeof (buf), &offset);
+    }
+    size = offset;
+    offset = sizeof (TPM_ST);
+    Tss2_MU_UINT32_Marshal (size, buf, sizeof (buf), &offset);
+    assert_int_equal (tss2_tcti_transmit (data->swap, size, buf),
+                      TSS2_TCTI_RC_BAD_VALUE);
+
+    /* the instance is still usable */
+    rc = send_command (data->swap, TPM_CC_Sign, &handle, NULL);
+    assert_int_equal (rc, TPM_RC_SUCCESS);
+}
+
+/*
+ * Saving everything empties the TPM, objects come back on next use.
+ */
+static void
+tcti_swap_save_all_test (void **state)
+{
+    TEST_STATE *data = *state;
+    TPM_HANDLE handles[2];
+    UINT32 id;
+    TPM_RC rc;
+    int i;
+
+    for (i = 0; i < 2; ++i) {
+        rc = send_command (data->swap, TPM_CC_Load, &parent, &handles[i]);
+        assert_int_equal (rc, TPM_RC_SUCCESS);
+    }
+    rc = TctiSwapSaveAll (data->swap);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (data->tpm.saves, 2);
+    for (i = 0; i < FAKE_SLOTS; ++i)
+        assert_int_equal (data->tpm.slots[i], 0);
+    /* nothing left to save */
+    rc = TctiSwapSaveAll (data->swap);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (data->tpm.saves, 2);
+
+    rc = send_command (data->swap, TPM_CC_Sign, &handles[1], &id);
+    assert_int_equal (rc, TPM_RC_SUCCESS);
+    assert_int_equal (id, 2);
+}
+
+int
+main (int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test (tcti_swap_init_null_test),
+        cmocka_unit_test_setup_teardown (tcti_swap_lru_test,
+                                         tcti_swap_setup,
+                                         tcti_swap_teardown),
+        cmocka_unit_test_setup_teardown (tcti_swap_pin_test,
+                                         tcti_swap_setup,
+                                         tcti_swap_teardown),
+        cmocka_unit_test_setup_teardown (tcti_swap_flush_test,
+                                         tcti_swap_setup,
+                                         tcti_swap_teardown),
+        cmocka_unit_test_setup_teardown (tcti_swap_foreign_test,
+                                         tcti_swap_setup,
+                                         tcti_swap_teardown),
+        cmocka_unit_test_setup_teardown (tcti_swap_app_saved_session_test,
+                                         tcti_swap_setup,
+                                         tcti_swap_teardown),
+        cmocka_unit_test_setup_teardown (tcti_swap_too_many_sessions_test,
+                                         tcti_swap_setup,
+                                         tcti_swap_teardown),
+        cmocka_unit_test_setup_teardown (tcti_swap_save_all_test,
+                                         tcti_swap_setup,
+                                         tcti_swap_teardown),
+    };
+    return cmocka_run_group_tests (tests, NULL, NULL);
+}
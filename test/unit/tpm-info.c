@@ -0,0 +1,333 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "sapi/tpm20.h"
+#include "util/tpm_info.h"
+
+/* the fake TPM returns at most this many values per GetCapability */
+#define PAGE 4
+#define FIXED_COUNT 40
+#define VENDOR_CC (TPM_CC_Vendor_TCG_Test | 0x1)
+
+static const TPM_ALG_ID algs[] = {
+    TPM_ALG_RSA, TPM_ALG_SHA1, TPM_ALG_HMAC, TPM_ALG_AES, TPM_ALG_SHA256,
+    TPM_ALG_NULL, TPM_ALG_ECC,
+};
+static const TPM_CC commands[] = {
+    TPM_CC_NV_UndefineSpaceSpecial, TPM_CC_CreatePrimary, TPM_CC_Create,
+    TPM_CC_Load, TPM_CC_GetCapability, TPM_CC_PCR_Read, VENDOR_CC,
+};
+/*
+ * Fake TPM state: fixed properties PT_FIXED + i with value i, except the
+ * firmware version which tests change to make the TPM look different, and
+ * a few variable properties that must not end up in the snapshot.
+ */
+static struct {
+    unsigned int calls;
+    UINT32 firmware;
+} tpm;
+
+static UINT32
+property_value (TPM_PT property)
+{
+    return property == TPM_PT_FIRMWARE_VERSION_1 ? tpm.firmware :
+                                                   property - PT_FIXED;
+}
+
+TPM_RC
+__wrap_Tss2_Sys_GetCapability (TSS2_SYS_CONTEXT *sysContext,
+                               TSS2_SYS_CMD_AUTHS const *cmdAuthsArray,
+                               TPM_CAP capability,
+                               UINT32 property,
+                               UINT32 propertyCount,
+                               TPMI_YES_NO *moreData,
+                               TPMS_CAPABILITY_DATA *capabilityData,
+                               TSS2_SYS_RSP_AUTHS *rspAuthsArray)
+{
+    UINT32 count = 0, max = propertyCount < PAGE ? propertyCount : PAGE;
+    size_t i;
+
+    tpm.calls++;
+    memset (capabilityData, 0, sizeof (*capabilityData));
+    capabilityData->capability = capability;
+    *moreData = NO;
+    switch (capability) {
+    case TPM_CAP_TPM_PROPERTIES:
+        for (i = 0; i < FIXED_COUNT + 4; ++i) {
+            TPM_PT pt = i < FIXED_COUNT ? PT_FIXED + i :
+                                          PT_VAR + i - FIXED_COUNT;
+            if (pt < property)
+                continue;
+            if (count == max) {
+                *moreData = YES;
+                break;
+            }
+            capabilityData->data.tpmProperties.tpmProperty[count].property = pt;
+            capabilityData->data.tpmProperties.tpmProperty[count].value =
+                property_value (pt);
+            count++;
+        }
+        capabilityData->data.tpmProperties.count = count;
+        break;
+    case TPM_CAP_ALGS:
+        for (i = 0; i < sizeof (algs) / sizeof (algs[0]); ++i) {
+            if (algs[i] < property)
+                continue;
+            if (count == max) {
+                *moreData = YES;
+                break;
+            }
+            capabilityData->data.algorithms.algProperties[count].alg = algs[i];
+            capabilityData->data.algorithms.algProperties[count].algProperties.val = i;
+            count++;
+        }
+        capabilityData->data.algorithms.count = count;
+        break;
+    case TPM_CAP_COMMANDS:
+        for (i = 0; i < sizeof (commands) / sizeof (commands[0]); ++i) {
+            if (commands[i] < property)
+                continue;
+            if (count == max) {
+                *moreData = YES;
+                break;
+            }
+            /* commandIndex and V bit line up with the command code */
+            capabilityData->data.command.commandAttributes[count].val =
+                commands[i] | (1 << 25);
+            count++;
+        }
+        capabilityData->data.command.count = count;
+        break;
+    case TPM_CAP_ECC_CURVES:
+        capabilityData->data.eccCurves.count = 1;
+        capabilityData->data.eccCurves.eccCurves[0] = TPM_ECC_NIST_P256;
+        break;
+    case TPM_CAP_PCRS:
+        capabilityData->data.assignedPCR.count = 1;
+        capabilityData->data.assignedPCR.pcrSelections[0].hash = TPM_ALG_SHA256;
+        capabilityData->data.assignedPCR.pcrSelections[0].sizeofSelect = 3;
+        memset (capabilityData->data.assignedPCR.pcrSelections[0].pcrSelect,
+                0xff, 3);
+        break;
+    default:
+        assert_true (0);
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+typedef struct {
+    char path[64];
+    TPM_INFO *info;
+} TEST_STATE;
+
+static TSS2_RC
+info_init (TEST_STATE *test, TSS2_SYS_CONTEXT *sys_context, const char *path,
+           int verify)
+{
+    TPM_INFO_CONF conf = {
+        .sys_context = sys_context,
+        .path = path,
+        .verify = verify,
+    };
+    size_t size = 0;
+    TSS2_RC rc;
+
+    rc = Tss2_TpmInfo_Init (NULL, &size, &conf);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    free (test->info);
+    test->info = calloc (1, size);
+    assert_non_null (test->info);
+    return Tss2_TpmInfo_Init (test->info, &size, &conf);
+}
+
+static int
+tpm_info_setup (void **state)
+{
+    TEST_STATE *test;
+    int fd;
+
+    memset (&tpm, 0, sizeof (tpm));
+    tpm.firmware = 0x20170619;
+    test = calloc (1, sizeof (TEST_STATE));
+    assert_non_null (test);
+    snprintf (test->path, sizeof (test->path), "/tmp/tpm-info-XXXXXX");
+    fd = mkstemp (test->path);
+    assert_true (fd >= 0);
+    close (fd);
+    /* start without a file */
+    unlink (test->path);
+
+    *state = test;
+    return 0;
+}
+
+static int
+tpm_info_teardown (void **state)
+{
+    TEST_STATE *test = *state;
+
+    unlink (test->path);
+    free (test->info);
+    free (test);
+    return 0;
+}
+/*
+ * Missing references are rejected, a NULL context returns the size.
+ */
+static void
+tpm_info_init_null_test (void **state)
+{
+    TPM_INFO_CONF conf = { .path = "/nonexistent", .verify = 1 };
+    size_t size = 0;
+    TSS2_RC rc;
+
+    rc = Tss2_TpmInfo_Init (NULL, NULL, &conf);
+    assert_int_equal (rc, TSS2_UTIL_RC_BAD_REFERENCE);
+    rc = Tss2_TpmInfo_Init (NULL, &size, NULL);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_true (size > 0);
+    /* verifying needs a TPM */
+    rc = Tss2_TpmInfo_Init ((TPM_INFO*)&conf, NULL, &conf);
+    assert_int_equal (rc, TSS2_UTIL_RC_BAD_REFERENCE);
+}
+/*
+ * Everything is fetched across pages, lookups find what the TPM reported
+ * and nothing else.
+ */
+static void
+tpm_info_fetch_test (void **state)
+{
+    TEST_STATE *test = *state;
+    TPMA_ALGORITHM alg_attributes;
+    TPMA_CC cc_attributes;
+    TPML_PCR_SELECTION banks;
+    UINT32 value;
+    TSS2_RC rc;
+    size_t i;
+
+    rc = info_init (test, (TSS2_SYS_CONTEXT*)0x1, NULL, 0);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    /* 40 / 4 + 1 property pages, 2 algorithm pages, 2 command pages */
+    assert_int_equal (tpm.calls, 11 + 2 + 2 + 1 + 1);
+
+    for (i = 0; i < FIXED_COUNT; ++i) {
+        rc = Tss2_TpmInfo_GetProperty (test->info, PT_FIXED + i, &value);
+        assert_int_equal (rc, TSS2_RC_SUCCESS);
+        assert_int_equal (value, property_value (PT_FIXED + i));
+    }
+    rc = Tss2_TpmInfo_GetProperty (test->info, TPM_PT_PERMANENT, &value);
+    assert_int_equal (rc, TSS2_UTIL_RC_NOT_SUPPORTED);
+
+    rc = Tss2_TpmInfo_GetAlgorithm (test->info, TPM_ALG_SHA256,
+                                    &alg_attributes);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (alg_attributes.val, 4);
+    rc = Tss2_TpmInfo_GetAlgorithm (test->info, TPM_ALG_SHA384, NULL);
+    assert_int_equal (rc, TSS2_UTIL_RC_NOT_SUPPORTED);
+
+    rc = Tss2_TpmInfo_GetCommand (test->info, TPM_CC_PCR_Read,
+                                  &cc_attributes);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (cc_attributes.val & 0xffff, TPM_CC_PCR_Read & 0xffff);
+    rc = Tss2_TpmInfo_GetCommand (test->info, VENDOR_CC, NULL);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = Tss2_TpmInfo_GetCommand (test->info, TPM_CC_Quote, NULL);
+    assert_int_equal (rc, TSS2_UTIL_RC_NOT_SUPPORTED);
+
+    rc = Tss2_TpmInfo_GetCurve (test->info, TPM_ECC_NIST_P256);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = Tss2_TpmInfo_GetCurve (test->info, TPM_ECC_NIST_P384);
+    assert_int_equal (rc, TSS2_UTIL_RC_NOT_SUPPORTED);
+
+    rc = Tss2_TpmInfo_GetPcrBanks (test->info, &banks);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (banks.count, 1);
+    assert_int_equal (banks.pcrSelections[0].hash, TPM_ALG_SHA256);
+}
+/*
+ * A stored snapshot is used by later processes without any round trip, or
+ * with one when verifying. A different TPM gets a fresh snapshot.
+ */
+static void
+tpm_info_file_test (void **state)
+{
+    TEST_STATE *test = *state;
+    UINT32 value;
+    TSS2_RC rc;
+
+    rc = info_init (test, NULL, test->path, 0);
+    assert_int_equal (rc, TSS2_UTIL_RC_IO_ERROR);
+
+    rc = info_init (test, (TSS2_SYS_CONTEXT*)0x1, test->path, 0);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    tpm.calls = 0;
+    rc = info_init (test, NULL, test->path, 0);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (tpm.calls, 0);
+    rc = Tss2_TpmInfo_GetProperty (test->info, TPM_PT_FIRMWARE_VERSION_1,
+                                   &value);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (value, 0x20170619);
+    rc = Tss2_TpmInfo_GetCommand (test->info, VENDOR_CC, NULL);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+    rc = info_init (test, (TSS2_SYS_CONTEXT*)0x1, test->path, 1);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    /* the eight identity properties come in two pages */
+    assert_int_equal (tpm.calls, 2);
+
+    tpm.firmware = 0x20171002;
+    tpm.calls = 0;
+    rc = info_init (test, (TSS2_SYS_CONTEXT*)0x1, test->path, 1);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_true (tpm.calls > 1);
+    rc = Tss2_TpmInfo_GetProperty (test->info, TPM_PT_FIRMWARE_VERSION_1,
+                                   &value);
+    assert_int_equal (value, 0x20171002);
+    /* and the file was replaced */
+    rc = info_init (test, NULL, test->path, 0);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = Tss2_TpmInfo_GetProperty (test->info, TPM_PT_FIRMWARE_VERSION_1,
+                                   &value);
+    assert_int_equal (value, 0x20171002);
+}
+/*
+ * Anything but a snapshot file is rejected.
+ */
+static void
+tpm_info_bad_file_test (void **state)
+{
+    TEST_STATE *test = *state;
+    FILE *file;
+    TSS2_RC rc;
+
+    file = fopen (test->path, "w");
+    assert_non_null (file);
+    fputs ("not a snapshot", file);
+    fclose (file);
+    rc = info_init (test, NULL, test->path, 0);
+    assert_int_equal (rc, TSS2_UTIL_RC_BAD_VALUE);
+}
+
+int
+main (int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test (tpm_info_init_null_test),
+        cmocka_unit_test_setup_teardown (tpm_info_fetch_test,
+                                         tpm_info_setup,
+                                         tpm_info_teardown),
+        cmocka_unit_test_setup_teardown (tpm_info_file_test,
+                                         tpm_info_setup,
+                                         tpm_info_teardown),
+        cmocka_unit_test_setup_teardown (tpm_info_bad_file_test,
+                                         tpm_info_setup,
+                                         tpm_info_teardown),
+    };
+    return cmocka_run_group_tests (tests, NULL, NULL);
+}
@@ -0,0 +1,238 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+#include <string.h>
+
+#include "sapi/tpm20.h"
+#include "sapi/tss2_mu.h"
+#include "sysapi_util.h"
+#include "util/audit_digest.h"
+#include "util/hash.h"
+
+TSS2_RC Tss2_AuditDigest_Init (
+    AUDIT_DIGEST      *audit,
+    AUDIT_DIGEST_TYPE  type,
+    TPMI_ALG_HASH      alg)
+{
+    UINT16 digest_size;
+
+    if (audit == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    if (type != AUDIT_DIGEST_SESSION && type != AUDIT_DIGEST_COMMAND) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    digest_size = GetDigestSize (alg);
+    if (digest_size == 0) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+
+    memset (audit, 0, sizeof (AUDIT_DIGEST));
+    audit->type = type;
+    audit->alg = alg;
+    if (type == AUDIT_DIGEST_SESSION) {
+        audit->digest.t.size = digest_size;
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_AuditDigest_Command (
+    AUDIT_DIGEST     *audit,
+    TSS2_SYS_CONTEXT *sys_context,
+    const TPM2B_NAME *names,
+    size_t            name_count)
+{
+    const uint8_t *cp_buffer;
+    size_t cp_size, i;
+    UTIL_HASH hash;
+    TSS2_RC rc;
+
+    if (audit == NULL || sys_context == NULL ||
+        (names == NULL && name_count > 0)) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    rc = Tss2_Sys_GetCommandCode (sys_context, &audit->command_code);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    rc = Tss2_Sys_GetCpBuffer (sys_context, &cp_size, &cp_buffer);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    /* cpHash = H(commandCode || Name1 || Name2 || Name3 || parameters) */
+    rc = util_hash_start (&hash, audit->alg);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    rc = util_hash_update (&hash, audit->command_code,
+                           sizeof (audit->command_code));
+    for (i = 0; i < name_count && rc == TSS2_RC_SUCCESS; ++i) {
+        rc = util_hash_update (&hash, names[i].t.name, names[i].t.size);
+    }
+    if (rc == TSS2_RC_SUCCESS) {
+        rc = util_hash_update (&hash, cp_buffer, cp_size);
+    }
+    if (rc != TSS2_RC_SUCCESS) {
+        util_hash_abort (&hash);
+        return rc;
+    }
+    rc = util_hash_finish (&hash, &audit->cp_hash);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    audit->pending = 1;
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_AuditDigest_Response (
+    AUDIT_DIGEST     *audit,
+    TSS2_SYS_CONTEXT *sys_context)
+{
+    static const UINT8 response_code[4] = { 0 };
+    TPM2B_DIGEST rp_hash = { .t.size = 0 };
+    const uint8_t *rp_buffer;
+    size_t rp_size;
+    UTIL_HASH hash;
+    TSS2_RC rc;
+
+    if (audit == NULL || sys_context == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    if (!audit->pending) {
+        return TSS2_UTIL_RC_BAD_SEQUENCE;
+    }
+    audit->pending = 0;
+    rc = Tss2_Sys_GetRpBuffer (sys_context, &rp_size, &rp_buffer);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    /* rpHash = H(responseCode || commandCode || parameters) */
+    rc = util_hash_start (&hash, audit->alg);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    rc = util_hash_update (&hash, response_code, sizeof (response_code));
+    if (rc == TSS2_RC_SUCCESS) {
+        rc = util_hash_update (&hash, audit->command_code,
+                               sizeof (audit->command_code));
+    }
+    if (rc == TSS2_RC_SUCCESS) {
+        rc = util_hash_update (&hash, rp_buffer, rp_size);
+    }
+    if (rc != TSS2_RC_SUCCESS) {
+        util_hash_abort (&hash);
+        return rc;
+    }
+    rc = util_hash_finish (&hash, &rp_hash);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    /* digest = H(digest || cpHash || rpHash) */
+    rc = util_hash_start (&hash, audit->alg);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    rc = util_hash_update (&hash, audit->digest.t.buffer, audit->digest.t.size);
+    if (rc == TSS2_RC_SUCCESS) {
+        rc = util_hash_update (&hash, audit->cp_hash.t.buffer,
+                               audit->cp_hash.t.size);
+    }
+    if (rc == TSS2_RC_SUCCESS) {
+        rc = util_hash_update (&hash, rp_hash.t.buffer, rp_hash.t.size);
+    }
+    if (rc != TSS2_RC_SUCCESS) {
+        util_hash_abort (&hash);
+        return rc;
+    }
+    rc = util_hash_finish (&hash, &audit->digest);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    audit->count++;
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_AuditDigest_Get (
+    AUDIT_DIGEST *audit,
+    TPM2B_DIGEST *digest)
+{
+    if (audit == NULL || digest == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    *digest = audit->digest;
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_AuditDigest_Verify (
+    AUDIT_DIGEST       *audit,
+    const TPM2B_ATTEST *audit_info)
+{
+    TPMS_ATTEST attest;
+    TPM2B_DIGEST *digest;
+    size_t offset = 0;
+    TSS2_RC rc;
+
+    if (audit == NULL || audit_info == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    rc = Tss2_MU_TPMS_ATTEST_Unmarshal (audit_info->t.attestationData,
+                                        audit_info->t.size,
+                                        &offset,
+                                        &attest);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    if (attest.magic != TPM_GENERATED_VALUE) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    switch (audit->type) {
+    case AUDIT_DIGEST_SESSION:
+        if (attest.type != TPM_ST_ATTEST_SESSION_AUDIT) {
+            return TSS2_UTIL_RC_BAD_VALUE;
+        }
+        digest = &attest.attested.sessionAudit.sessionDigest;
+        break;
+    case AUDIT_DIGEST_COMMAND:
+        if (attest.type != TPM_ST_ATTEST_COMMAND_AUDIT ||
+            attest.attested.commandAudit.digestAlg != audit->alg) {
+            return TSS2_UTIL_RC_BAD_VALUE;
+        }
+        digest = &attest.attested.commandAudit.auditDigest;
+        break;
+    default:
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    if (digest->t.size != audit->digest.t.size ||
+        memcmp (digest->t.buffer, audit->digest.t.buffer, digest->t.size) != 0) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+
+    return TSS2_RC_SUCCESS;
+}
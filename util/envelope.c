@@ -0,0 +1,510 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+
+#include "sapi/tpm20.h"
+#include "util/envelope.h"
+
+struct _ENVELOPE {
+    TSS2_SYS_CONTEXT *sys_context;
+    TPMI_DH_OBJECT parent;
+    TPM2B_AUTH parent_auth;
+    UINT32 ttl;
+    /* the sealed DEK, valid once CreateKey or SetKey succeeded */
+    int have_key;
+    TPM2B_AUTH key_auth;
+    TPM2B_PRIVATE private;
+    TPM2B_PUBLIC public;
+    /*
+     * The unsealed DEK lives in its own locked page. The cipher context is
+     * keyed for one record at a time and reset right after, so the expanded
+     * key schedule never outlives the operation in ordinary heap memory.
+     */
+    BYTE *dek;
+    size_t dek_map_size;
+    int dek_valid;
+    time_t dek_expires;
+    EVP_CIPHER_CTX *ctx;
+    ENVELOPE_STATS stats;
+};
+
+static time_t
+now (void)
+{
+    struct timespec ts;
+
+    if (clock_gettime (CLOCK_MONOTONIC, &ts) != 0) {
+        return 0;
+    }
+    return ts.tv_sec;
+}
+
+static TSS2_RC
+auth_copy (TPM2B_AUTH       *dest,
+           const TPM2B_AUTH *src)
+{
+    if (src == NULL) {
+        dest->t.size = 0;
+        return TSS2_RC_SUCCESS;
+    }
+    if (src->t.size > sizeof (dest->t.buffer)) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    dest->t.size = src->t.size;
+    memcpy (dest->t.buffer, src->t.buffer, src->t.size);
+    return TSS2_RC_SUCCESS;
+}
+
+static void
+auth_password (TSS2_SYS_CMD_AUTHS *auths,
+               TPMS_AUTH_COMMAND **auth_ptr,
+               TPMS_AUTH_COMMAND  *auth,
+               const TPM2B_AUTH   *password)
+{
+    memset (auth, 0, sizeof (*auth));
+    auth->sessionHandle = TPM_RS_PW;
+    auth->hmac = *password;
+    *auth_ptr = auth;
+    auths->cmdAuthsCount = 1;
+    auths->cmdAuths = auth_ptr;
+}
+
+TSS2_RC Tss2_Envelope_Init (
+    ENVELOPE            *envelope,
+    size_t              *size,
+    const ENVELOPE_CONF *config)
+{
+    long page_size;
+    TSS2_RC rc;
+
+    if (config == NULL || (envelope == NULL && size == NULL)) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    if (envelope == NULL) {
+        *size = sizeof (ENVELOPE);
+        return TSS2_RC_SUCCESS;
+    }
+    if (size != NULL && *size < sizeof (ENVELOPE)) {
+        return TSS2_UTIL_RC_INSUFFICIENT_BUFFER;
+    }
+    if (config->sys_context == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+
+    memset (envelope, 0, sizeof (*envelope));
+    envelope->sys_context = config->sys_context;
+    envelope->parent = config->parent;
+    envelope->ttl = config->ttl ? config->ttl : ENVELOPE_DEFAULT_TTL;
+    rc = auth_copy (&envelope->parent_auth, config->parent_auth);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+
+    page_size = sysconf (_SC_PAGESIZE);
+    envelope->dek_map_size = page_size > 0 ? page_size : ENVELOPE_KEY_SIZE;
+    envelope->dek = mmap (NULL, envelope->dek_map_size,
+                          PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                          -1, 0);
+    if (envelope->dek == MAP_FAILED) {
+        envelope->dek = NULL;
+        return TSS2_UTIL_RC_GENERAL_FAILURE;
+    }
+    envelope->stats.locked = mlock (envelope->dek,
+                                    envelope->dek_map_size) == 0;
+    if (!envelope->stats.locked && !config->allow_unlocked) {
+        munmap (envelope->dek, envelope->dek_map_size);
+        envelope->dek = NULL;
+        return TSS2_UTIL_RC_GENERAL_FAILURE;
+    }
+#ifdef MADV_DONTDUMP
+    madvise (envelope->dek, envelope->dek_map_size, MADV_DONTDUMP);
+#endif
+    envelope->ctx = EVP_CIPHER_CTX_new ();
+    if (envelope->ctx == NULL) {
+        Tss2_Envelope_Finalize (envelope);
+        return TSS2_UTIL_RC_GENERAL_FAILURE;
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
+void Tss2_Envelope_Forget (
+    ENVELOPE *envelope)
+{
+    if (envelope == NULL || envelope->dek == NULL) {
+        return;
+    }
+    OPENSSL_cleanse (envelope->dek, ENVELOPE_KEY_SIZE);
+    envelope->dek_valid = 0;
+}
+/*
+ * The DEK in the locked page is ready for use, start its TTL.
+ */
+static void
+dek_ready (ENVELOPE *envelope)
+{
+    envelope->dek_valid = 1;
+    envelope->dek_expires = now () + envelope->ttl;
+}
+/*
+ * Load the sealed object, Unseal the DEK into the locked page and flush
+ * the object again.
+ */
+static TSS2_RC
+dek_unseal (ENVELOPE *envelope)
+{
+    TSS2_SYS_CMD_AUTHS auths;
+    TPMS_AUTH_COMMAND auth, *auth_ptr;
+    TPM2B_NAME name = { .t.size = sizeof (TPMU_NAME) };
+    TPM2B_SENSITIVE_DATA data = { .t.size = sizeof (data.t.buffer) };
+    TPM_HANDLE handle;
+    TSS2_RC rc, flush_rc;
+
+    auth_password (&auths, &auth_ptr, &auth, &envelope->parent_auth);
+    rc = Tss2_Sys_Load (envelope->sys_context, envelope->parent, &auths,
+                        &envelope->private, &envelope->public, &handle,
+                        &name, NULL);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    auth_password (&auths, &auth_ptr, &auth, &envelope->key_auth);
+    rc = Tss2_Sys_Unseal (envelope->sys_context, handle, &auths, &data,
+                          NULL);
+    flush_rc = Tss2_Sys_FlushContext (envelope->sys_context, handle);
+    if (rc == TSS2_RC_SUCCESS) {
+        rc = flush_rc;
+    }
+    if (rc == TSS2_RC_SUCCESS && data.t.size != ENVELOPE_KEY_SIZE) {
+        rc = TSS2_UTIL_RC_BAD_VALUE;
+    }
+    if (rc == TSS2_RC_SUCCESS) {
+        memcpy (envelope->dek, data.t.buffer, ENVELOPE_KEY_SIZE);
+        envelope->stats.unseals++;
+        dek_ready (envelope);
+    }
+    OPENSSL_cleanse (&data, sizeof (data));
+    OPENSSL_cleanse (&auth, sizeof (auth));
+
+    return rc;
+}
+int Tss2_Envelope_Expire (
+    ENVELOPE *envelope)
+{
+    if (envelope == NULL || !envelope->dek_valid) {
+        return 1;
+    }
+    if (now () < envelope->dek_expires) {
+        return 0;
+    }
+    Tss2_Envelope_Forget (envelope);
+    envelope->stats.expired++;
+
+    return 1;
+}
+/*
+ * Make sure the DEK is unsealed, wiping it first if its TTL ran out.
+ */
+static TSS2_RC
+dek_get (ENVELOPE *envelope)
+{
+    if (!Tss2_Envelope_Expire (envelope)) {
+        return TSS2_RC_SUCCESS;
+    }
+    if (!envelope->have_key) {
+        return TSS2_UTIL_RC_BAD_SEQUENCE;
+    }
+    return dek_unseal (envelope);
+}
+
+TSS2_RC Tss2_Envelope_CreateKey (
+    ENVELOPE         *envelope,
+    const TPM2B_AUTH *key_auth,
+    TPM2B_PRIVATE    *out_private,
+    TPM2B_PUBLIC     *out_public)
+{
+    TSS2_SYS_CMD_AUTHS auths;
+    TPMS_AUTH_COMMAND auth, *auth_ptr;
+    TPM2B_SENSITIVE_CREATE sensitive = { .t.size = 0 };
+    TPM2B_PUBLIC template = { .t.size = 0 };
+    TPMT_PUBLIC *area = &template.t.publicArea;
+    TPM2B_DATA outside_info = { .t.size = 0 };
+    TPML_PCR_SELECTION creation_pcr = { .count = 0 };
+    TPM2B_CREATION_DATA creation_data = { .t.size = 0 };
+    TPM2B_DIGEST creation_hash = { .t.size = sizeof (creation_hash.t.buffer) };
+    TPMT_TK_CREATION creation_ticket = { .tag = 0 };
+    TSS2_RC rc;
+
+    if (envelope == NULL || out_private == NULL || out_public == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    rc = auth_copy (&sensitive.t.sensitive.userAuth, key_auth);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    Tss2_Envelope_Forget (envelope);
+    envelope->have_key = 0;
+    if (RAND_bytes (envelope->dek, ENVELOPE_KEY_SIZE) != 1) {
+        return TSS2_UTIL_RC_GENERAL_FAILURE;
+    }
+    sensitive.t.sensitive.data.t.size = ENVELOPE_KEY_SIZE;
+    memcpy (sensitive.t.sensitive.data.t.buffer, envelope->dek,
+            ENVELOPE_KEY_SIZE);
+
+    area->type = TPM_ALG_KEYEDHASH;
+    area->nameAlg = TPM_ALG_SHA256;
+    area->objectAttributes.fixedTPM = 1;
+    area->objectAttributes.fixedParent = 1;
+    area->objectAttributes.userWithAuth = 1;
+    area->parameters.keyedHashDetail.scheme.scheme = TPM_ALG_NULL;
+
+    auth_password (&auths, &auth_ptr, &auth, &envelope->parent_auth);
+    out_private->t.size = 0;
+    out_public->t.size = 0;
+    rc = Tss2_Sys_Create (envelope->sys_context, envelope->parent, &auths,
+                          &sensitive, &template, &outside_info, &creation_pcr,
+                          out_private, out_public, &creation_data,
+                          &creation_hash, &creation_ticket, NULL);
+    OPENSSL_cleanse (&sensitive, sizeof (sensitive));
+    OPENSSL_cleanse (&auth, sizeof (auth));
+    if (rc != TSS2_RC_SUCCESS) {
+        OPENSSL_cleanse (envelope->dek, ENVELOPE_KEY_SIZE);
+        return rc;
+    }
+
+    envelope->private = *out_private;
+    envelope->public = *out_public;
+    auth_copy (&envelope->key_auth, key_auth);
+    envelope->have_key = 1;
+    dek_ready (envelope);
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_Envelope_SetKey (
+    ENVELOPE            *envelope,
+    const TPM2B_AUTH    *key_auth,
+    const TPM2B_PRIVATE *in_private,
+    const TPM2B_PUBLIC  *in_public)
+{
+    TSS2_RC rc;
+
+    if (envelope == NULL || in_private == NULL || in_public == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    Tss2_Envelope_Forget (envelope);
+    envelope->have_key = 0;
+    rc = auth_copy (&envelope->key_auth, key_auth);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    envelope->private = *in_private;
+    envelope->public = *in_public;
+    envelope->have_key = 1;
+
+    return TSS2_RC_SUCCESS;
+}
+/*
+ * The version byte of a record is authenticated along with the caller's
+ * additional data.
+ */
+static int
+cipher_aad (EVP_CIPHER_CTX *ctx,
+            const uint8_t  *version,
+            const uint8_t  *aad,
+            size_t          aad_size)
+{
+    int len;
+
+    if (EVP_CipherUpdate (ctx, NULL, &len, version, 1) != 1) {
+        return 0;
+    }
+    return aad_size == 0 ||
+           EVP_CipherUpdate (ctx, NULL, &len, aad, aad_size) == 1;
+}
+
+TSS2_RC Tss2_Envelope_Seal (
+    ENVELOPE      *envelope,
+    const uint8_t *aad,
+    size_t         aad_size,
+    const uint8_t *data,
+    size_t         data_size,
+    uint8_t       *record,
+    size_t        *record_size)
+{
+    EVP_CIPHER_CTX *ctx;
+    uint8_t *iv, *out, *tag;
+    int len, ok;
+    TSS2_RC rc;
+
+    if (envelope == NULL || record == NULL || record_size == NULL ||
+        (data == NULL && data_size != 0) || (aad == NULL && aad_size != 0)) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    if (data_size > INT32_MAX || aad_size > INT32_MAX) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    if (*record_size < data_size + ENVELOPE_OVERHEAD) {
+        *record_size = data_size + ENVELOPE_OVERHEAD;
+        return TSS2_UTIL_RC_INSUFFICIENT_BUFFER;
+    }
+    rc = dek_get (envelope);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+
+    ctx = envelope->ctx;
+    record[0] = ENVELOPE_VERSION;
+    iv = record + 1;
+    out = iv + ENVELOPE_IV_SIZE;
+    tag = out + data_size;
+    ok = RAND_bytes (iv, ENVELOPE_IV_SIZE) == 1 &&
+         EVP_EncryptInit_ex (ctx, EVP_aes_256_gcm (), NULL, envelope->dek,
+                             iv) == 1 &&
+         cipher_aad (ctx, record, aad, aad_size) &&
+         (data_size == 0 ||
+          EVP_EncryptUpdate (ctx, out, &len, data, data_size) == 1) &&
+         EVP_EncryptFinal_ex (ctx, out + data_size, &len) == 1 &&
+         EVP_CIPHER_CTX_ctrl (ctx, EVP_CTRL_GCM_GET_TAG, ENVELOPE_TAG_SIZE,
+                              tag) == 1;
+    /* cleanses the expanded key schedule */
+    EVP_CIPHER_CTX_reset (ctx);
+    if (!ok) {
+        OPENSSL_cleanse (record, data_size + ENVELOPE_OVERHEAD);
+        return TSS2_UTIL_RC_GENERAL_FAILURE;
+    }
+    *record_size = data_size + ENVELOPE_OVERHEAD;
+    envelope->stats.sealed++;
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_Envelope_Unseal (
+    ENVELOPE      *envelope,
+    const uint8_t *aad,
+    size_t         aad_size,
+    const uint8_t *record,
+    size_t         record_size,
+    uint8_t       *data,
+    size_t        *data_size)
+{
+    EVP_CIPHER_CTX *ctx;
+    const uint8_t *iv, *in, *tag;
+    size_t size;
+    int len, ok;
+    TSS2_RC rc = TSS2_RC_SUCCESS;
+
+    if (envelope == NULL || record == NULL || data_size == NULL ||
+        (aad == NULL && aad_size != 0)) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    if (record_size < ENVELOPE_OVERHEAD || record[0] != ENVELOPE_VERSION ||
+        record_size - ENVELOPE_OVERHEAD > INT32_MAX || aad_size > INT32_MAX) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    size = record_size - ENVELOPE_OVERHEAD;
+    if (*data_size < size) {
+        *data_size = size;
+        return TSS2_UTIL_RC_INSUFFICIENT_BUFFER;
+    }
+    if (data == NULL && size != 0) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    rc = dek_get (envelope);
+    if (rc != TSS2_RC_SUCCESS) {
+        goto out;
+    }
+
+    ctx = envelope->ctx;
+    iv = record + 1;
+    in = iv + ENVELOPE_IV_SIZE;
+    tag = in + size;
+    ok = EVP_DecryptInit_ex (ctx, EVP_aes_256_gcm (), NULL, envelope->dek,
+                             iv) == 1 &&
+         cipher_aad (ctx, record, aad, aad_size) &&
+         (size == 0 || EVP_DecryptUpdate (ctx, data, &len, in, size) == 1) &&
+         EVP_CIPHER_CTX_ctrl (ctx, EVP_CTRL_GCM_SET_TAG, ENVELOPE_TAG_SIZE,
+                              (void*)tag) == 1;
+    if (!ok) {
+        rc = TSS2_UTIL_RC_GENERAL_FAILURE;
+    } else if (EVP_DecryptFinal_ex (ctx, data + size, &len) != 1) {
+        envelope->stats.rejected++;
+        rc = TSS2_UTIL_RC_BAD_VALUE;
+    }
+    /* cleanses the expanded key schedule */
+    EVP_CIPHER_CTX_reset (ctx);
+out:
+    /* never hand out plaintext that wasn't authenticated */
+    if (rc != TSS2_RC_SUCCESS) {
+        if (size != 0) {
+            OPENSSL_cleanse (data, size);
+        }
+        return rc;
+    }
+    *data_size = size;
+    envelope->stats.opened++;
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_Envelope_GetStats (
+    ENVELOPE       *envelope,
+    ENVELOPE_STATS *stats)
+{
+    if (envelope == NULL || stats == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    *stats = envelope->stats;
+    return TSS2_RC_SUCCESS;
+}
+
+void Tss2_Envelope_Finalize (
+    ENVELOPE *envelope)
+{
+    if (envelope == NULL) {
+        return;
+    }
+    Tss2_Envelope_Forget (envelope);
+    EVP_CIPHER_CTX_free (envelope->ctx);
+    envelope->ctx = NULL;
+    if (envelope->dek != NULL) {
+        if (envelope->stats.locked) {
+            munlock (envelope->dek, envelope->dek_map_size);
+        }
+        munmap (envelope->dek, envelope->dek_map_size);
+        envelope->dek = NULL;
+    }
+    OPENSSL_cleanse (&envelope->key_auth, sizeof (envelope->key_auth));
+    OPENSSL_cleanse (&envelope->parent_auth, sizeof (envelope->parent_auth));
+    envelope->have_key = 0;
+}
@@ -0,0 +1,486 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "sapi/tpm20.h"
+#include "sysapi_util.h"
+#include "util/event_log.h"
+#include "hash.h"
+
+/* TCG_PCR_EVENT: pcrIndex, eventType, SHA1 digest, eventSize */
+#define HEADER_EVENT_SIZE  (4 + 4 + 20 + 4)
+/* TCG_EfiSpecIdEvent up to and including numberOfAlgorithms */
+#define SPEC_ID_SIZE       (16 + 4 + 1 + 1 + 1 + 1 + 4)
+#define SPEC_ID_SIGNATURE  "Spec ID Event03"
+#define STARTUP_LOCALITY   "StartupLocality"
+/* the DRTM PCRs, all ones after TPM2_Startup */
+#define PCR_DRTM_FIRST     17
+#define PCR_DRTM_LAST      22
+
+typedef enum {
+    LOG_BORROWED,
+    LOG_MAPPED,
+    LOG_ALLOCATED,
+} LOG_STORAGE;
+
+typedef struct {
+    TPM_ALG_ID alg;
+    UINT16 size;
+} LOG_ALGORITHM;
+
+struct _EVENT_LOG {
+    const uint8_t *data;
+    size_t size;
+    LOG_STORAGE storage;
+    /* offset of the first TCG_PCR_EVENT2 and of the next one handed out */
+    size_t first;
+    size_t cursor;
+    UINT32 alg_count;
+    LOG_ALGORITHM algs[EVENT_LOG_MAX_ALGORITHMS];
+};
+
+/* The event log is little endian, unlike everything the TPM marshals. */
+static UINT16
+le16 (const uint8_t *p)
+{
+    return (UINT16)(p[0] | p[1] << 8);
+}
+
+static UINT32
+le32 (const uint8_t *p)
+{
+    return (UINT32)p[0] | (UINT32)p[1] << 8 |
+           (UINT32)p[2] << 16 | (UINT32)p[3] << 24;
+}
+/*
+ * securityfs files report a size of 0 and can't be mapped, they are read
+ * into memory instead.
+ */
+static TSS2_RC
+log_read (EVENT_LOG *log, int fd)
+{
+    uint8_t *buffer = NULL, *grown;
+    size_t size = 0, capacity = 0;
+    ssize_t n;
+
+    for (;;) {
+        if (size == capacity) {
+            capacity = capacity ? capacity * 2 : 65536;
+            grown = realloc (buffer, capacity);
+            if (grown == NULL) {
+                free (buffer);
+                return TSS2_UTIL_RC_GENERAL_FAILURE;
+            }
+            buffer = grown;
+        }
+        n = read (fd, buffer + size, capacity - size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            free (buffer);
+            return TSS2_UTIL_RC_IO_ERROR;
+        }
+        if (n == 0) {
+            break;
+        }
+        size += n;
+    }
+    log->data = buffer;
+    log->size = size;
+    log->storage = LOG_ALLOCATED;
+
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+log_open (EVENT_LOG *log, const char *path)
+{
+    struct stat st;
+    void *map;
+    TSS2_RC rc;
+    int fd;
+
+    fd = open (path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return TSS2_UTIL_RC_IO_ERROR;
+    }
+    if (fstat (fd, &st) != 0) {
+        close (fd);
+        return TSS2_UTIL_RC_IO_ERROR;
+    }
+    if (st.st_size > 0) {
+        map = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            log->data = map;
+            log->size = st.st_size;
+            log->storage = LOG_MAPPED;
+            close (fd);
+            return TSS2_RC_SUCCESS;
+        }
+    }
+    rc = log_read (log, fd);
+    close (fd);
+
+    return rc;
+}
+
+static void
+log_release (EVENT_LOG *log)
+{
+    switch (log->storage) {
+    case LOG_MAPPED:
+        munmap ((void*)log->data, log->size);
+        break;
+    case LOG_ALLOCATED:
+        free ((void*)log->data);
+        break;
+    case LOG_BORROWED:
+        break;
+    }
+    log->data = NULL;
+    log->size = 0;
+}
+
+static TSS2_RC
+header_parse (EVENT_LOG *log)
+{
+    const uint8_t *p = log->data, *spec;
+    UINT32 event_size, count, i;
+    UINT16 size;
+
+    if (log->size < HEADER_EVENT_SIZE ||
+        le32 (p + 4) != EV_NO_ACTION) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    event_size = le32 (p + HEADER_EVENT_SIZE - 4);
+    if (event_size > log->size - HEADER_EVENT_SIZE) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    spec = p + HEADER_EVENT_SIZE;
+    if (event_size < SPEC_ID_SIZE ||
+        memcmp (spec, SPEC_ID_SIGNATURE, sizeof (SPEC_ID_SIGNATURE)) != 0) {
+        return TSS2_UTIL_RC_NOT_SUPPORTED;
+    }
+    count = le32 (spec + SPEC_ID_SIZE - 4);
+    if (count == 0 || count > EVENT_LOG_MAX_ALGORITHMS ||
+        count > (event_size - SPEC_ID_SIZE) / 4) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    for (i = 0; i < count; ++i) {
+        log->algs[i].alg = le16 (spec + SPEC_ID_SIZE + i * 4);
+        log->algs[i].size = size = le16 (spec + SPEC_ID_SIZE + i * 4 + 2);
+        if (GetDigestSize (log->algs[i].alg) != 0 &&
+            GetDigestSize (log->algs[i].alg) != size) {
+            return TSS2_UTIL_RC_BAD_VALUE;
+        }
+    }
+    log->alg_count = count;
+    log->first = log->cursor = HEADER_EVENT_SIZE + event_size;
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_EventLog_Init (
+    EVENT_LOG            *log,
+    size_t               *size,
+    const EVENT_LOG_CONF *config)
+{
+    TSS2_RC rc;
+
+    if (config == NULL || (log == NULL && size == NULL)) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    if (log == NULL) {
+        *size = sizeof (EVENT_LOG);
+        return TSS2_RC_SUCCESS;
+    }
+    if (size != NULL && *size < sizeof (EVENT_LOG)) {
+        return TSS2_UTIL_RC_INSUFFICIENT_BUFFER;
+    }
+    if (config->path == NULL && config->buffer == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+
+    memset (log, 0, sizeof (*log));
+    if (config->path != NULL) {
+        rc = log_open (log, config->path);
+        if (rc != TSS2_RC_SUCCESS) {
+            return rc;
+        }
+    } else {
+        log->data = config->buffer;
+        log->size = config->size;
+        log->storage = LOG_BORROWED;
+    }
+    rc = header_parse (log);
+    if (rc != TSS2_RC_SUCCESS) {
+        log_release (log);
+    }
+
+    return rc;
+}
+
+static const LOG_ALGORITHM*
+algorithm_find (const EVENT_LOG *log, TPM_ALG_ID alg)
+{
+    UINT32 i;
+
+    for (i = 0; i < log->alg_count; ++i) {
+        if (log->algs[i].alg == alg) {
+            return &log->algs[i];
+        }
+    }
+    return NULL;
+}
+/* Parse the TCG_PCR_EVENT2 at 'offset', 'next' is set to the one after. */
+static TSS2_RC
+event_parse (const EVENT_LOG *log,
+             size_t           offset,
+             EVENT_LOG_EVENT *event,
+             size_t          *next)
+{
+    const uint8_t *p = log->data + offset;
+    size_t left = log->size - offset;
+    const LOG_ALGORITHM *alg;
+    UINT32 count, i;
+
+    if (left < 12) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    event->pcr = le32 (p);
+    event->type = le32 (p + 4);
+    count = le32 (p + 8);
+    if (count > log->alg_count) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    p += 12;
+    left -= 12;
+
+    event->digests.count = 0;
+    for (i = 0; i < count; ++i) {
+        if (left < 2) {
+            return TSS2_UTIL_RC_BAD_VALUE;
+        }
+        alg = algorithm_find (log, le16 (p));
+        if (alg == NULL || left - 2 < alg->size) {
+            return TSS2_UTIL_RC_BAD_VALUE;
+        }
+        if (alg->size <= sizeof (TPMU_HA) &&
+            event->digests.count < HASH_COUNT) {
+            TPMT_HA *ha = &event->digests.digests[event->digests.count++];
+
+            ha->hashAlg = alg->alg;
+            memcpy (&ha->digest, p + 2, alg->size);
+        }
+        p += 2 + alg->size;
+        left -= 2 + alg->size;
+    }
+
+    if (left < 4 || le32 (p) > left - 4) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    event->size = le32 (p);
+    event->data = p + 4;
+    *next = (event->data + event->size) - log->data;
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_EventLog_Next (
+    EVENT_LOG       *log,
+    EVENT_LOG_EVENT *event,
+    int             *end)
+{
+    size_t next;
+    TSS2_RC rc;
+
+    if (log == NULL || event == NULL || end == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    if (log->cursor >= log->size) {
+        *end = 1;
+        return TSS2_RC_SUCCESS;
+    }
+    rc = event_parse (log, log->cursor, event, &next);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    log->cursor = next;
+    *end = 0;
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_EventLog_Rewind (
+    EVENT_LOG *log)
+{
+    if (log == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    log->cursor = log->first;
+    return TSS2_RC_SUCCESS;
+}
+
+static void
+replay_init (PCR_MATRIX *matrix, UINT16 digest_size)
+{
+    PCR_BANK *bank = &matrix->banks[matrix->count - 1];
+    UINT32 pcr;
+
+    for (pcr = 0; pcr < IMPLEMENTATION_PCR; ++pcr) {
+        bank->pcrSelect[pcr / 8] |= 1 << (pcr % 8);
+        bank->digests[pcr].t.size = digest_size;
+        if (pcr >= PCR_DRTM_FIRST && pcr <= PCR_DRTM_LAST) {
+            memset (bank->digests[pcr].t.buffer, 0xff, digest_size);
+        }
+    }
+}
+
+static int
+startup_locality (const EVENT_LOG_EVENT *event)
+{
+    if (event->pcr != 0 || event->size < sizeof (STARTUP_LOCALITY) + 1 ||
+        memcmp (event->data, STARTUP_LOCALITY, sizeof (STARTUP_LOCALITY)) != 0) {
+        return -1;
+    }
+    return event->data[sizeof (STARTUP_LOCALITY)];
+}
+/*
+ * Extend one event into every bank it has a digest for. The hash contexts
+ * are kept across events, 'hashes' is indexed like the matrix banks.
+ */
+static TSS2_RC
+replay_extend (PCR_MATRIX            *matrix,
+               UTIL_HASH             *hashes,
+               const EVENT_LOG_EVENT *event)
+{
+    UINT32 i, k;
+    TSS2_RC rc;
+
+    for (i = 0; i < event->digests.count; ++i) {
+        const TPMT_HA *ha = &event->digests.digests[i];
+        TPM2B_DIGEST *value;
+
+        for (k = 0; k < matrix->count; ++k) {
+            if (matrix->banks[k].hash == ha->hashAlg) {
+                break;
+            }
+        }
+        if (k == matrix->count) {
+            continue;
+        }
+        value = &matrix->banks[k].digests[event->pcr];
+        rc = util_hash_update (&hashes[k], value->t.buffer, value->t.size);
+        if (rc == TSS2_RC_SUCCESS) {
+            rc = util_hash_update (&hashes[k], (const uint8_t*)&ha->digest,
+                                   value->t.size);
+        }
+        if (rc == TSS2_RC_SUCCESS) {
+            rc = util_hash_finish_reuse (&hashes[k], value);
+        }
+        if (rc != TSS2_RC_SUCCESS) {
+            return rc;
+        }
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_EventLog_Replay (
+    EVENT_LOG  *log,
+    PCR_MATRIX *matrix)
+{
+    UTIL_HASH hashes[HASH_COUNT] = { { 0 } };
+    EVENT_LOG_EVENT event;
+    size_t offset, next;
+    UINT32 i, k;
+    int locality;
+    TSS2_RC rc = TSS2_RC_SUCCESS;
+
+    if (log == NULL || matrix == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+
+    memset (matrix, 0, sizeof (*matrix));
+    for (i = 0; i < log->alg_count && matrix->count < HASH_COUNT; ++i) {
+        if (util_hash_start (&hashes[matrix->count], log->algs[i].alg) !=
+            TSS2_RC_SUCCESS) {
+            continue;
+        }
+        matrix->banks[matrix->count++].hash = log->algs[i].alg;
+        replay_init (matrix, log->algs[i].size);
+    }
+    if (matrix->count == 0) {
+        return TSS2_UTIL_RC_NOT_SUPPORTED;
+    }
+
+    for (offset = log->first; offset < log->size; offset = next) {
+        rc = event_parse (log, offset, &event, &next);
+        if (rc != TSS2_RC_SUCCESS) {
+            break;
+        }
+        if (event.type == EV_NO_ACTION) {
+            locality = startup_locality (&event);
+            for (k = 0; locality >= 0 && k < matrix->count; ++k) {
+                TPM2B_DIGEST *value = &matrix->banks[k].digests[0];
+
+                memset (value->t.buffer, 0, value->t.size);
+                value->t.buffer[value->t.size - 1] = (BYTE)locality;
+            }
+            continue;
+        }
+        if (event.pcr >= IMPLEMENTATION_PCR) {
+            rc = TSS2_UTIL_RC_BAD_VALUE;
+            break;
+        }
+        rc = replay_extend (matrix, hashes, &event);
+        if (rc != TSS2_RC_SUCCESS) {
+            break;
+        }
+    }
+
+    for (k = 0; k < matrix->count; ++k) {
+        util_hash_abort (&hashes[k]);
+    }
+    return rc;
+}
+
+TSS2_RC Tss2_EventLog_Finalize (
+    EVENT_LOG *log)
+{
+    if (log == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    log_release (log);
+    return TSS2_RC_SUCCESS;
+}
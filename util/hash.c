@@ -0,0 +1,169 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+#include <openssl/evp.h>
+
+#include "sapi/tpm20.h"
+#include "sysapi_util.h"
+#include "util/common.h"
+#include "util/hash.h"
+
+static const EVP_MD*
+hash_md (TPMI_ALG_HASH alg)
+{
+    switch (alg) {
+    case TPM_ALG_SHA1:
+        return EVP_sha1 ();
+    case TPM_ALG_SHA256:
+        return EVP_sha256 ();
+    case TPM_ALG_SHA384:
+        return EVP_sha384 ();
+    case TPM_ALG_SHA512:
+        return EVP_sha512 ();
+    default:
+        return NULL;
+    }
+}
+
+TSS2_RC util_hash_start (
+    UTIL_HASH     *hash,
+    TPMI_ALG_HASH  alg)
+{
+    const EVP_MD *md;
+    EVP_MD_CTX *ctx;
+
+    if (hash == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    md = hash_md (alg);
+    if (md == NULL) {
+        return TSS2_UTIL_RC_NOT_SUPPORTED;
+    }
+    ctx = EVP_MD_CTX_create ();
+    if (ctx == NULL) {
+        return TSS2_UTIL_RC_GENERAL_FAILURE;
+    }
+    if (EVP_DigestInit_ex (ctx, md, NULL) != 1) {
+        EVP_MD_CTX_destroy (ctx);
+        return TSS2_UTIL_RC_GENERAL_FAILURE;
+    }
+    hash->alg = alg;
+    hash->md_ctx = ctx;
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC util_hash_update (
+    UTIL_HASH     *hash,
+    const uint8_t *buf,
+    size_t         size)
+{
+    if (hash == NULL || hash->md_ctx == NULL || (buf == NULL && size > 0)) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    if (size == 0) {
+        return TSS2_RC_SUCCESS;
+    }
+    if (EVP_DigestUpdate (hash->md_ctx, buf, size) != 1) {
+        return TSS2_UTIL_RC_GENERAL_FAILURE;
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC util_hash_finish (
+    UTIL_HASH    *hash,
+    TPM2B_DIGEST *digest)
+{
+    unsigned int size = 0;
+    TSS2_RC rc = TSS2_RC_SUCCESS;
+
+    if (hash == NULL || hash->md_ctx == NULL || digest == NULL) {
+        util_hash_abort (hash);
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    if (GetDigestSize (hash->alg) > sizeof (digest->t.buffer)) {
+        rc = TSS2_UTIL_RC_INSUFFICIENT_BUFFER;
+    } else if (EVP_DigestFinal_ex (hash->md_ctx, digest->t.buffer, &size) != 1) {
+        rc = TSS2_UTIL_RC_GENERAL_FAILURE;
+    } else {
+        digest->t.size = size;
+    }
+    util_hash_abort (hash);
+
+    return rc;
+}
+
+TSS2_RC util_hash_finish_reuse (
+    UTIL_HASH    *hash,
+    TPM2B_DIGEST *digest)
+{
+    unsigned int size = 0;
+
+    if (hash == NULL || hash->md_ctx == NULL || digest == NULL) {
+        util_hash_abort (hash);
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    if (GetDigestSize (hash->alg) > sizeof (digest->t.buffer)) {
+        util_hash_abort (hash);
+        return TSS2_UTIL_RC_INSUFFICIENT_BUFFER;
+    }
+    if (EVP_DigestFinal_ex (hash->md_ctx, digest->t.buffer, &size) != 1 ||
+        EVP_DigestInit_ex (hash->md_ctx, hash_md (hash->alg), NULL) != 1) {
+        util_hash_abort (hash);
+        return TSS2_UTIL_RC_GENERAL_FAILURE;
+    }
+    digest->t.size = size;
+
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+hash_sink_write (
+    void          *data,
+    const uint8_t *bytes,
+    size_t         size)
+{
+    return util_hash_update ((UTIL_HASH*)data, bytes, size);
+}
+
+void util_hash_sink (
+    UTIL_HASH    *hash,
+    TSS2_MU_SINK *sink)
+{
+    sink->write = hash_sink_write;
+    sink->data = hash;
+}
+
+void util_hash_abort (
+    UTIL_HASH *hash)
+{
+    if (hash == NULL || hash->md_ctx == NULL) {
+        return;
+    }
+    EVP_MD_CTX_destroy (hash->md_ctx);
+    hash->md_ctx = NULL;
+}
@@ -0,0 +1,81 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+#ifndef TSS2_UTIL_HASH_H
+#define TSS2_UTIL_HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "sapi/tpm20.h"
+#include "sapi/tss2_mu.h"
+
+/*
+ * Software hash provider used by the utility library for everything that
+ * has to be computed on the host (cache keys, cpHash / rpHash etc). The
+ * digest algorithms are identified by their TPM_ALG_ID.
+ */
+typedef struct {
+    TPMI_ALG_HASH alg;
+    void *md_ctx;
+} UTIL_HASH;
+
+TSS2_RC util_hash_start (
+    UTIL_HASH     *hash,
+    TPMI_ALG_HASH  alg
+    );
+TSS2_RC util_hash_update (
+    UTIL_HASH     *hash,
+    const uint8_t *buf,
+    size_t         size
+    );
+/* Writes the digest and releases the context, also on failure. */
+TSS2_RC util_hash_finish (
+    UTIL_HASH    *hash,
+    TPM2B_DIGEST *digest
+    );
+/*
+ * Write the digest and start over with the same algorithm, keeping the
+ * context. Saves the allocation when many short messages are hashed in a
+ * row. On failure the context is released.
+ */
+TSS2_RC util_hash_finish_reuse (
+    UTIL_HASH    *hash,
+    TPM2B_DIGEST *digest
+    );
+void util_hash_abort (
+    UTIL_HASH *hash
+    );
+/*
+ * Set up 'sink' so that Tss2_MU_MarshalSink feeds the marshalled bytes to
+ * util_hash_update on 'hash'.
+ */
+void util_hash_sink (
+    UTIL_HASH    *hash,
+    TSS2_MU_SINK *sink
+    );
+
+#endif /* TSS2_UTIL_HASH_H */
@@ -0,0 +1,467 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+#include <string.h>
+
+#include "sapi/tpm20.h"
+#include "util/key_cache.h"
+#include "util/name.h"
+
+#define TPM_RC_IS_TPM_ERROR(rc) \
+    ((rc) != TSS2_RC_SUCCESS && ((rc) & TSS2_ERROR_LEVEL_MASK) == TSS2_TPM_ERROR_LEVEL)
+/* the TPM's response code without the layer, parameter and handle bits */
+#define TPM_RC_BASE(rc) \
+    (((rc) & RC_FMT1) ? ((rc) & (RC_FMT1 | 0x3f)) : ((rc) & 0xfff))
+
+#define NO_PARENT ((size_t)-1)
+
+typedef enum {
+    NODE_EMPTY,
+    /* only the blobs */
+    NODE_UNLOADED,
+    NODE_LOADED,
+    NODE_SAVED,
+    /* registered with AddRoot, loaded by the application */
+    NODE_ROOT,
+} NODE_STATE;
+
+typedef struct {
+    NODE_STATE state;
+    size_t parent;
+    /* set while a child is being loaded, the node can't be evicted */
+    unsigned int pinned;
+    UINT64 last_used;
+    TPM2B_NAME name;
+    TPMS_AUTH_COMMAND auth;
+    TPMI_DH_OBJECT handle;
+    TPM2B_PRIVATE private;
+    TPM2B_PUBLIC public;
+    TPMS_CONTEXT context;
+} KEY_CACHE_NODE;
+
+struct _KEY_CACHE {
+    KEY_CACHE_CONF conf;
+    UINT64 tick;
+    KEY_CACHE_STATS stats;
+    KEY_CACHE_NODE nodes[];
+};
+
+TSS2_RC Tss2_KeyCache_Init (
+    KEY_CACHE            *cache,
+    size_t               *size,
+    const KEY_CACHE_CONF *config)
+{
+    size_t cache_size;
+
+    if (config == NULL || (cache == NULL && size == NULL)) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    if (config->key_count == 0 ||
+        (config->max_loaded != 0 &&
+         (config->max_loaded < KEY_CACHE_MIN_LOADED ||
+          config->max_loaded > MAX_LOADED_OBJECTS))) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    cache_size = sizeof (KEY_CACHE) +
+                 config->key_count * sizeof (KEY_CACHE_NODE);
+    if (cache == NULL) {
+        *size = cache_size;
+        return TSS2_RC_SUCCESS;
+    }
+    if (size != NULL && *size < cache_size) {
+        return TSS2_UTIL_RC_INSUFFICIENT_BUFFER;
+    }
+    if (config->sys_context == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+
+    memset (cache, 0, cache_size);
+    cache->conf = *config;
+    if (cache->conf.max_loaded == 0) {
+        cache->conf.max_loaded = KEY_CACHE_DEFAULT_LOADED;
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
+static KEY_CACHE_NODE*
+node_find (KEY_CACHE        *cache,
+           const TPM2B_NAME *name)
+{
+    KEY_CACHE_NODE *node;
+    size_t i;
+
+    for (i = 0; i < cache->conf.key_count; ++i) {
+        node = &cache->nodes[i];
+        if (node->state != NODE_EMPTY &&
+            node->name.t.size == name->t.size &&
+            memcmp (node->name.t.name, name->t.name, name->t.size) == 0) {
+            return node;
+        }
+    }
+    return NULL;
+}
+
+static KEY_CACHE_NODE*
+node_new (KEY_CACHE               *cache,
+          const TPMS_AUTH_COMMAND *auth)
+{
+    KEY_CACHE_NODE *node;
+    size_t i;
+
+    for (i = 0; i < cache->conf.key_count; ++i) {
+        node = &cache->nodes[i];
+        if (node->state != NODE_EMPTY) {
+            continue;
+        }
+        memset (node, 0, sizeof (*node));
+        node->parent = NO_PARENT;
+        if (auth != NULL) {
+            node->auth = *auth;
+        } else {
+            node->auth.sessionHandle = TPM_RS_PW;
+        }
+        return node;
+    }
+    return NULL;
+}
+
+TSS2_RC Tss2_KeyCache_AddRoot (
+    KEY_CACHE               *cache,
+    TPMI_DH_OBJECT           handle,
+    const TPMS_AUTH_COMMAND *auth,
+    TPM2B_NAME              *name)
+{
+    TPM2B_PUBLIC public = { .t.size = 0 };
+    TPM2B_NAME qualified = { .t.size = sizeof (TPMU_NAME) };
+    KEY_CACHE_NODE *node;
+    TSS2_RC rc;
+
+    if (cache == NULL || name == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    name->t.size = sizeof (TPMU_NAME);
+    rc = Tss2_Sys_ReadPublic (cache->conf.sys_context, handle, NULL, &public,
+                              name, &qualified, NULL);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    node = node_find (cache, name);
+    if (node != NULL) {
+        return node->state == NODE_ROOT && node->handle == handle ?
+            TSS2_RC_SUCCESS : TSS2_UTIL_RC_BAD_VALUE;
+    }
+    node = node_new (cache, auth);
+    if (node == NULL) {
+        return TSS2_UTIL_RC_INSUFFICIENT_BUFFER;
+    }
+    node->state = NODE_ROOT;
+    node->name = *name;
+    node->handle = handle;
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_KeyCache_AddKey (
+    KEY_CACHE               *cache,
+    const TPM2B_NAME        *parent,
+    const TPM2B_PRIVATE     *in_private,
+    const TPM2B_PUBLIC      *in_public,
+    const TPMS_AUTH_COMMAND *auth,
+    TPM2B_NAME              *name)
+{
+    KEY_CACHE_NODE *parent_node, *node;
+    TSS2_RC rc;
+
+    if (cache == NULL || parent == NULL || in_private == NULL ||
+        in_public == NULL || name == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    parent_node = node_find (cache, parent);
+    if (parent_node == NULL) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    rc = Tss2_Name_FromPublic (&in_public->t.publicArea, name);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    node = node_find (cache, name);
+    if (node != NULL) {
+        return node->parent == (size_t)(parent_node - cache->nodes) ?
+            TSS2_RC_SUCCESS : TSS2_UTIL_RC_BAD_VALUE;
+    }
+    node = node_new (cache, auth);
+    if (node == NULL) {
+        return TSS2_UTIL_RC_INSUFFICIENT_BUFFER;
+    }
+    node->state = NODE_UNLOADED;
+    node->parent = parent_node - cache->nodes;
+    node->name = *name;
+    node->private = *in_private;
+    node->public = *in_public;
+
+    return TSS2_RC_SUCCESS;
+}
+
+static KEY_CACHE_NODE*
+node_victim (KEY_CACHE *cache)
+{
+    KEY_CACHE_NODE *node, *victim = NULL;
+    size_t i;
+
+    for (i = 0; i < cache->conf.key_count; ++i) {
+        node = &cache->nodes[i];
+        if (node->state != NODE_LOADED || node->pinned) {
+            continue;
+        }
+        if (victim == NULL || node->last_used < victim->last_used) {
+            victim = node;
+        }
+    }
+    return victim;
+}
+/*
+ * Save and flush the least recently used key. A key whose context can't be
+ * saved is flushed all the same and loaded from its blobs next time.
+ */
+static TSS2_RC
+node_evict (KEY_CACHE *cache)
+{
+    KEY_CACHE_NODE *victim = node_victim (cache);
+    TSS2_RC rc;
+
+    if (victim == NULL) {
+        return TSS2_UTIL_RC_INSUFFICIENT_BUFFER;
+    }
+    rc = Tss2_Sys_ContextSave (cache->conf.sys_context, victim->handle,
+                               &victim->context);
+    if (rc != TSS2_RC_SUCCESS && !TPM_RC_IS_TPM_ERROR (rc)) {
+        return rc;
+    }
+    victim->state = rc == TSS2_RC_SUCCESS ? NODE_SAVED : NODE_UNLOADED;
+    if (rc == TSS2_RC_SUCCESS) {
+        cache->stats.context_saves++;
+    }
+    cache->stats.loaded--;
+
+    return Tss2_Sys_FlushContext (cache->conf.sys_context, victim->handle);
+}
+static TSS2_RC
+node_make_room (KEY_CACHE *cache)
+{
+    TSS2_RC rc = TSS2_RC_SUCCESS;
+
+    while (cache->stats.loaded >= cache->conf.max_loaded &&
+           rc == TSS2_RC_SUCCESS) {
+        rc = node_evict (cache);
+    }
+    return rc;
+}
+/*
+ * The TPM may be out of object memory even with a free slot, when somebody
+ * else has objects loaded. Evict another key and have the caller retry,
+ * for as long as there is something to evict.
+ */
+static int
+node_retry (KEY_CACHE *cache,
+            TSS2_RC   *rc)
+{
+    if (TPM_RC_BASE (*rc) != TPM_RC_OBJECT_MEMORY ||
+        node_victim (cache) == NULL) {
+        return 0;
+    }
+    *rc = node_evict (cache);
+    return *rc == TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+node_load (KEY_CACHE      *cache,
+           KEY_CACHE_NODE *node)
+{
+    TSS2_SYS_CMD_AUTHS auths;
+    TPMS_AUTH_COMMAND *auth;
+    TPM2B_NAME name = { .t.size = sizeof (TPMU_NAME) };
+    KEY_CACHE_NODE *parent;
+    TSS2_RC rc;
+
+    switch (node->state) {
+    case NODE_ROOT:
+    case NODE_LOADED:
+        node->last_used = ++cache->tick;
+        return TSS2_RC_SUCCESS;
+    case NODE_SAVED:
+        rc = node_make_room (cache);
+        while (rc == TSS2_RC_SUCCESS) {
+            rc = Tss2_Sys_ContextLoad (cache->conf.sys_context,
+                                       &node->context, &node->handle);
+            if (!node_retry (cache, &rc)) {
+                break;
+            }
+        }
+        if (rc == TSS2_RC_SUCCESS) {
+            cache->stats.context_loads++;
+            break;
+        }
+        if (!TPM_RC_IS_TPM_ERROR (rc)) {
+            return rc;
+        }
+        cache->stats.stale++;
+        node->state = NODE_UNLOADED;
+        /* fall through */
+    case NODE_UNLOADED:
+        parent = &cache->nodes[node->parent];
+        parent->pinned++;
+        rc = node_load (cache, parent);
+        if (rc == TSS2_RC_SUCCESS) {
+            auth = &parent->auth;
+            auths.cmdAuthsCount = 1;
+            auths.cmdAuths = &auth;
+            rc = node_make_room (cache);
+        }
+        while (rc == TSS2_RC_SUCCESS) {
+            rc = Tss2_Sys_Load (cache->conf.sys_context, parent->handle,
+                                &auths, &node->private, &node->public,
+                                &node->handle, &name, NULL);
+            if (!node_retry (cache, &rc)) {
+                break;
+            }
+        }
+        parent->pinned--;
+        if (rc != TSS2_RC_SUCCESS) {
+            return rc;
+        }
+        cache->stats.loads++;
+        break;
+    default:
+        return TSS2_UTIL_RC_GENERAL_FAILURE;
+    }
+
+    node->state = NODE_LOADED;
+    node->last_used = ++cache->tick;
+    cache->stats.loaded++;
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_KeyCache_Load (
+    KEY_CACHE        *cache,
+    const TPM2B_NAME *name,
+    TPMI_DH_OBJECT   *handle)
+{
+    KEY_CACHE_NODE *node;
+    TSS2_RC rc;
+
+    if (cache == NULL || name == NULL || handle == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    node = node_find (cache, name);
+    if (node == NULL) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    if (node->state == NODE_LOADED || node->state == NODE_ROOT) {
+        cache->stats.hits++;
+    }
+    rc = node_load (cache, node);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    *handle = node->handle;
+
+    return TSS2_RC_SUCCESS;
+}
+
+static int
+node_below (KEY_CACHE      *cache,
+            KEY_CACHE_NODE *node,
+            KEY_CACHE_NODE *ancestor)
+{
+    while (node != ancestor && node->parent != NO_PARENT) {
+        node = &cache->nodes[node->parent];
+    }
+    return node == ancestor;
+}
+
+static void
+node_forget (KEY_CACHE      *cache,
+             KEY_CACHE_NODE *node)
+{
+    if (node->state == NODE_LOADED) {
+        Tss2_Sys_FlushContext (cache->conf.sys_context, node->handle);
+        cache->stats.loaded--;
+    }
+    node->state = NODE_EMPTY;
+}
+
+TSS2_RC Tss2_KeyCache_Remove (
+    KEY_CACHE        *cache,
+    const TPM2B_NAME *name)
+{
+    KEY_CACHE_NODE *target;
+    size_t i;
+
+    if (cache == NULL || name == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    target = node_find (cache, name);
+    if (target == NULL) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    for (i = 0; i < cache->conf.key_count; ++i) {
+        KEY_CACHE_NODE *node = &cache->nodes[i];
+
+        if (node != target && node->state != NODE_EMPTY &&
+            node_below (cache, node, target)) {
+            node_forget (cache, node);
+        }
+    }
+    node_forget (cache, target);
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_KeyCache_GetStats (
+    KEY_CACHE       *cache,
+    KEY_CACHE_STATS *stats)
+{
+    if (cache == NULL || stats == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    *stats = cache->stats;
+    return TSS2_RC_SUCCESS;
+}
+
+void Tss2_KeyCache_Finalize (
+    KEY_CACHE *cache)
+{
+    size_t i;
+
+    if (cache == NULL) {
+        return;
+    }
+    for (i = 0; i < cache->conf.key_count; ++i) {
+        node_forget (cache, &cache->nodes[i]);
+    }
+}
@@ -0,0 +1,373 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+#include <string.h>
+#include <time.h>
+
+#include "sapi/tpm20.h"
+#include "util/key_pool.h"
+
+typedef struct {
+    TPM2B_PRIVATE private;
+    TPM2B_PUBLIC public;
+} KEY_POOL_KEY;
+
+typedef struct {
+    KEY_POOL_TEMPLATE tmpl;
+    KEY_POOL_STATS stats;
+    KEY_POOL_KEY keys[KEY_POOL_MAX_DEPTH];
+} KEY_POOL_ENTRY;
+
+struct _KEY_POOL {
+    TSS2_SYS_CONTEXT *sys_context;
+    UINT32 refill_interval;
+    size_t template_count;
+    /* a background Create is outstanding for entry 'pending_index' */
+    UINT8 pending;
+    size_t pending_index;
+    UINT64 last_start;
+    KEY_POOL_ENTRY entries[];
+};
+
+#define TPM_RC_IS_TPM_ERROR(rc) \
+    ((rc) != TSS2_RC_SUCCESS && ((rc) & TSS2_ERROR_LEVEL_MASK) == TSS2_TPM_ERROR_LEVEL)
+
+static UINT64
+time_ms (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (UINT64)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+TSS2_RC Tss2_KeyPool_Init (
+    KEY_POOL            *pool,
+    size_t              *size,
+    const KEY_POOL_CONF *config)
+{
+    size_t pool_size, i;
+
+    if (config == NULL || (pool == NULL && size == NULL)) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    if (config->templates == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    if (config->template_count == 0) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    for (i = 0; i < config->template_count; ++i) {
+        if (config->templates[i].depth > KEY_POOL_MAX_DEPTH) {
+            return TSS2_UTIL_RC_BAD_VALUE;
+        }
+    }
+    pool_size = sizeof (KEY_POOL) +
+                config->template_count * sizeof (KEY_POOL_ENTRY);
+    if (pool == NULL) {
+        *size = pool_size;
+        return TSS2_RC_SUCCESS;
+    }
+    if (size != NULL && *size < pool_size) {
+        return TSS2_UTIL_RC_INSUFFICIENT_BUFFER;
+    }
+    if (config->sys_context == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+
+    memset (pool, 0, pool_size);
+    pool->sys_context = config->sys_context;
+    pool->refill_interval = config->refill_interval;
+    pool->template_count = config->template_count;
+    for (i = 0; i < config->template_count; ++i) {
+        pool->entries[i].tmpl = config->templates[i];
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+/* The template furthest below its depth, NULL when all of them are full. */
+static KEY_POOL_ENTRY*
+refill_next (KEY_POOL *pool, size_t *index)
+{
+    KEY_POOL_ENTRY *next = NULL;
+    size_t i;
+
+    for (i = 0; i < pool->template_count; ++i) {
+        KEY_POOL_ENTRY *entry = &pool->entries[i];
+
+        if (entry->stats.available >= entry->tmpl.depth)
+            continue;
+        if (next == NULL ||
+            entry->stats.available * next->tmpl.depth <
+            next->stats.available * entry->tmpl.depth) {
+            next = entry;
+            *index = i;
+        }
+    }
+
+    return next;
+}
+
+static TSS2_RC
+refill_start (KEY_POOL *pool, KEY_POOL_ENTRY *entry)
+{
+    TPM2B_DATA outside_info = { .t.size = 0 };
+    TPML_PCR_SELECTION creation_pcr = { .count = 0 };
+    TSS2_RC rc;
+
+    rc = Tss2_Sys_Create_Prepare (pool->sys_context,
+                                  entry->tmpl.parent,
+                                  &entry->tmpl.sensitive,
+                                  &entry->tmpl.template,
+                                  &outside_info,
+                                  &creation_pcr);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    if (entry->tmpl.parent_auths != NULL) {
+        rc = Tss2_Sys_SetCmdAuths (pool->sys_context, entry->tmpl.parent_auths);
+        if (rc != TSS2_RC_SUCCESS) {
+            return rc;
+        }
+    }
+
+    return Tss2_Sys_ExecuteAsync (pool->sys_context);
+}
+
+static TSS2_RC
+refill_finish (KEY_POOL *pool, int32_t timeout)
+{
+    KEY_POOL_ENTRY *entry = &pool->entries[pool->pending_index];
+    KEY_POOL_KEY *key = &entry->keys[entry->stats.available];
+    TPM2B_CREATION_DATA creation_data = { .t.size = 0 };
+    TPM2B_DIGEST creation_hash = { .t.size = sizeof (creation_hash.t.buffer) };
+    TPMT_TK_CREATION creation_ticket = { .tag = 0 };
+    TSS2_RC rc;
+
+    rc = Tss2_Sys_ExecuteFinish (pool->sys_context, timeout);
+    if (rc == TSS2_TCTI_RC_TRY_AGAIN) {
+        return TSS2_UTIL_RC_TRY_AGAIN;
+    }
+    pool->pending = 0;
+    if (rc == TSS2_RC_SUCCESS) {
+        key->private.t.size = 0;
+        key->public.t.size = 0;
+        rc = Tss2_Sys_Create_Complete (pool->sys_context,
+                                       &key->private,
+                                       &key->public,
+                                       &creation_data,
+                                       &creation_hash,
+                                       &creation_ticket);
+    }
+    if (rc != TSS2_RC_SUCCESS) {
+        entry->stats.errors++;
+        return rc;
+    }
+    entry->stats.available++;
+    entry->stats.created++;
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_KeyPool_Service (
+    KEY_POOL *pool,
+    int32_t   timeout)
+{
+    KEY_POOL_ENTRY *entry;
+    size_t index = 0;
+    UINT64 now;
+    TSS2_RC rc;
+
+    if (pool == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    if (pool->pending) {
+        rc = refill_finish (pool, timeout);
+        if (rc != TSS2_RC_SUCCESS) {
+            return rc;
+        }
+    }
+    entry = refill_next (pool, &index);
+    if (entry == NULL) {
+        return TSS2_RC_SUCCESS;
+    }
+    now = time_ms ();
+    if (pool->refill_interval > 0 && pool->last_start > 0 &&
+        now - pool->last_start < pool->refill_interval) {
+        return TSS2_UTIL_RC_TRY_AGAIN;
+    }
+    rc = refill_start (pool, entry);
+    if (rc != TSS2_RC_SUCCESS) {
+        entry->stats.errors++;
+        return rc;
+    }
+    pool->pending = 1;
+    pool->pending_index = index;
+    pool->last_start = now;
+
+    return TSS2_UTIL_RC_TRY_AGAIN;
+}
+
+static TSS2_RC
+key_create (TSS2_SYS_CONTEXT *sys_context,
+            KEY_POOL_ENTRY   *entry,
+            KEY_POOL_KEY     *key)
+{
+    TPM2B_DATA outside_info = { .t.size = 0 };
+    TPML_PCR_SELECTION creation_pcr = { .count = 0 };
+    TPM2B_CREATION_DATA creation_data = { .t.size = 0 };
+    TPM2B_DIGEST creation_hash = { .t.size = sizeof (creation_hash.t.buffer) };
+    TPMT_TK_CREATION creation_ticket = { .tag = 0 };
+
+    key->private.t.size = 0;
+    key->public.t.size = 0;
+    return Tss2_Sys_Create (sys_context,
+                            entry->tmpl.parent,
+                            entry->tmpl.parent_auths,
+                            &entry->tmpl.sensitive,
+                            &entry->tmpl.template,
+                            &outside_info,
+                            &creation_pcr,
+                            &key->private,
+                            &key->public,
+                            &creation_data,
+                            &creation_hash,
+                            &creation_ticket,
+                            NULL);
+}
+
+static TSS2_RC
+key_load (TSS2_SYS_CONTEXT *sys_context,
+          KEY_POOL_ENTRY   *entry,
+          KEY_POOL_KEY     *key,
+          TPM_HANDLE       *object_handle,
+          TPM2B_NAME       *name)
+{
+    return Tss2_Sys_Load (sys_context,
+                          entry->tmpl.parent,
+                          entry->tmpl.parent_auths,
+                          &key->private,
+                          &key->public,
+                          object_handle,
+                          name,
+                          NULL);
+}
+
+TSS2_RC Tss2_KeyPool_Acquire (
+    KEY_POOL         *pool,
+    TSS2_SYS_CONTEXT *sys_context,
+    size_t            index,
+    TPM_HANDLE       *object_handle,
+    TPM2B_PUBLIC     *out_public,
+    TPM2B_NAME       *name)
+{
+    TPM2B_NAME object_name = { .t.size = sizeof (object_name.t.name) };
+    KEY_POOL_ENTRY *entry;
+    KEY_POOL_KEY key;
+    TSS2_RC rc;
+
+    if (pool == NULL || sys_context == NULL || object_handle == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    if (index >= pool->template_count) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    entry = &pool->entries[index];
+    /* the SAPI context can't send another command before this completes */
+    if (sys_context == pool->sys_context && pool->pending) {
+        refill_finish (pool, TSS2_TCTI_TIMEOUT_BLOCK);
+    }
+    if (entry->stats.available > 0) {
+        key = entry->keys[--entry->stats.available];
+        memset (&entry->keys[entry->stats.available], 0, sizeof (KEY_POOL_KEY));
+        rc = key_load (sys_context, entry, &key, object_handle, &object_name);
+        if (rc == TSS2_RC_SUCCESS) {
+            entry->stats.hits++;
+            goto out;
+        }
+        /*
+         * A TPM error here usually means the key no longer matches its
+         * parent. Drop it and create a fresh one instead.
+         */
+        if (!TPM_RC_IS_TPM_ERROR (rc)) {
+            return rc;
+        }
+    }
+    entry->stats.misses++;
+    rc = key_create (sys_context, entry, &key);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    object_name.t.size = sizeof (object_name.t.name);
+    rc = key_load (sys_context, entry, &key, object_handle, &object_name);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+out:
+    if (out_public != NULL) {
+        *out_public = key.public;
+    }
+    if (name != NULL) {
+        *name = object_name;
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_KeyPool_GetStats (
+    KEY_POOL       *pool,
+    size_t          index,
+    KEY_POOL_STATS *stats)
+{
+    if (pool == NULL || stats == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    if (index >= pool->template_count) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    *stats = pool->entries[index].stats;
+
+    return TSS2_RC_SUCCESS;
+}
+
+void Tss2_KeyPool_Finalize (
+    KEY_POOL *pool)
+{
+    size_t i;
+
+    if (pool == NULL) {
+        return;
+    }
+    if (pool->pending) {
+        refill_finish (pool, TSS2_TCTI_TIMEOUT_BLOCK);
+    }
+    for (i = 0; i < pool->template_count; ++i) {
+        KEY_POOL_ENTRY *entry = &pool->entries[i];
+
+        memset (entry->keys, 0, sizeof (entry->keys));
+        entry->stats.available = 0;
+    }
+}
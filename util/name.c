@@ -0,0 +1,99 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+#include <string.h>
+
+#include "sapi/tpm20.h"
+#include "sapi/tss2_mu.h"
+#include "util/name.h"
+#include "util/hash.h"
+
+static TSS2_RC
+name_compute (
+    TPMI_ALG_HASH        name_alg,
+    TSS2_MU_MARSHAL_FCN  marshal,
+    const void          *public_area,
+    TPM2B_NAME          *name)
+{
+    TPM2B_DIGEST digest = { .t.size = 0 };
+    TSS2_MU_SINK sink;
+    UTIL_HASH hash;
+    size_t offset = 0;
+    TSS2_RC rc;
+
+    if (public_area == NULL || name == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    if (name_alg == TPM_ALG_NULL) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    rc = util_hash_start (&hash, name_alg);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    util_hash_sink (&hash, &sink);
+    rc = Tss2_MU_MarshalSink (marshal, public_area, &sink, NULL);
+    if (rc != TSS2_RC_SUCCESS) {
+        util_hash_abort (&hash);
+        return rc;
+    }
+    rc = util_hash_finish (&hash, &digest);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+
+    rc = Tss2_MU_UINT16_Marshal (name_alg,
+                                 name->t.name,
+                                 sizeof (name->t.name),
+                                 &offset);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    memcpy (&name->t.name [offset], digest.t.buffer, digest.t.size);
+    name->t.size = offset + digest.t.size;
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_Name_FromPublic (
+    const TPMT_PUBLIC *public_area,
+    TPM2B_NAME        *name)
+{
+    return name_compute (public_area ? public_area->nameAlg : TPM_ALG_NULL,
+                         (TSS2_MU_MARSHAL_FCN)Tss2_MU_TPMT_PUBLIC_Marshal,
+                         public_area,
+                         name);
+}
+
+TSS2_RC Tss2_Name_FromNvPublic (
+    const TPMS_NV_PUBLIC *nv_public,
+    TPM2B_NAME           *name)
+{
+    return name_compute (nv_public ? nv_public->nameAlg : TPM_ALG_NULL,
+                         (TSS2_MU_MARSHAL_FCN)Tss2_MU_TPMS_NV_PUBLIC_Marshal,
+                         nv_public,
+                         name);
+}
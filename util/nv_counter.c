@@ -0,0 +1,435 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "sapi/tpm20.h"
+#include "util/nv_counter.h"
+
+#define JOURNAL_MAGIC   0x316e632d32737374ULL
+#define JOURNAL_VERSION 2
+
+#define BOOT_ID_PATH "/proc/sys/kernel/random/boot_id"
+#define BOOT_ID_SIZE 36
+
+/*
+ * The current lease: NV counter value 'epoch' allows logical values up to
+ * epoch * lease, 'value' is the last one handed out. The journal is only
+ * trusted in the boot that wrote it, 'boot_id' is the kernel's.
+ */
+typedef struct {
+    UINT64 magic;
+    UINT32 version;
+    TPMI_RH_NV_INDEX nv_index;
+    char boot_id[BOOT_ID_SIZE];
+    UINT64 lease;
+    UINT64 epoch;
+    UINT64 value;
+} JOURNAL;
+
+struct _NV_COUNTER {
+    TSS2_SYS_CONTEXT *sys_context;
+    TPMI_RH_NV_INDEX nv_index;
+    TPMI_RH_NV_AUTH auth_handle;
+    TPM2B_AUTH auth;
+    UINT64 lease;
+    /* the mapped journal file, or 'local' if there is none */
+    int fd;
+    JOURNAL *journal;
+    JOURNAL local;
+    /* all zero if it can't be read, a journal then never counts as current */
+    char boot_id[BOOT_ID_SIZE];
+    NV_COUNTER_STATS stats;
+};
+
+static void
+auth_password (NV_COUNTER         *counter,
+               TSS2_SYS_CMD_AUTHS *auths,
+               TPMS_AUTH_COMMAND **auth_ptr,
+               TPMS_AUTH_COMMAND  *auth)
+{
+    memset (auth, 0, sizeof (*auth));
+    auth->sessionHandle = TPM_RS_PW;
+    auth->hmac = counter->auth;
+    *auth_ptr = auth;
+    auths->cmdAuthsCount = 1;
+    auths->cmdAuths = auth_ptr;
+}
+/*
+ * Read the NV counter. An index that was never incremented reads as 0,
+ * the first NV_Increment initializes it.
+ */
+static TSS2_RC
+nv_read (NV_COUNTER *counter,
+         UINT64     *value)
+{
+    TSS2_SYS_CMD_AUTHS auths;
+    TPMS_AUTH_COMMAND auth, *auth_ptr;
+    TPM2B_MAX_NV_BUFFER data = { .t.size = sizeof (data.t.buffer) };
+    TSS2_RC rc;
+    size_t i;
+
+    auth_password (counter, &auths, &auth_ptr, &auth);
+    rc = Tss2_Sys_NV_Read (counter->sys_context, counter->auth_handle,
+                           counter->nv_index, &auths, sizeof (UINT64), 0,
+                           &data, NULL);
+    counter->stats.nv_reads++;
+    if (rc == TPM_RC_NV_UNINITIALIZED) {
+        *value = 0;
+        return TSS2_RC_SUCCESS;
+    }
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    if (data.t.size != sizeof (UINT64)) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    *value = 0;
+    for (i = 0; i < sizeof (UINT64); ++i) {
+        *value = (*value << 8) | data.t.buffer[i];
+    }
+    return TSS2_RC_SUCCESS;
+}
+/*
+ * Give up all values up to epoch * lease, they belong to a lease that is
+ * used up, lost or was taken by somebody else.
+ */
+static TSS2_RC
+lease_drop (NV_COUNTER *counter,
+            UINT64      epoch)
+{
+    JOURNAL *journal = counter->journal;
+    UINT64 last;
+
+    if (epoch > UINT64_MAX / counter->lease) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    last = epoch * counter->lease;
+    if (journal->value < last) {
+        counter->stats.skipped += last - journal->value;
+        journal->value = last;
+    }
+    journal->epoch = epoch;
+    return TSS2_RC_SUCCESS;
+}
+/*
+ * Start a new lease: NV_Increment, then NV_Read for the value it actually
+ * got, which is not epoch + 1 if somebody else incremented the index.
+ */
+static TSS2_RC
+lease_take (NV_COUNTER *counter)
+{
+    TSS2_SYS_CMD_AUTHS auths;
+    TPMS_AUTH_COMMAND auth, *auth_ptr;
+    UINT64 epoch;
+    TSS2_RC rc;
+
+    auth_password (counter, &auths, &auth_ptr, &auth);
+    rc = Tss2_Sys_NV_Increment (counter->sys_context, counter->auth_handle,
+                                counter->nv_index, &auths, NULL);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    counter->stats.nv_increments++;
+    rc = nv_read (counter, &epoch);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    if (epoch <= counter->journal->epoch) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    if (epoch != counter->journal->epoch + 1) {
+        /* the leases in between were taken by somebody else */
+        rc = lease_drop (counter, epoch - 1);
+        if (rc != TSS2_RC_SUCCESS) {
+            return rc;
+        }
+    }
+    counter->journal->epoch = epoch;
+    return TSS2_RC_SUCCESS;
+}
+
+static int
+lease_covers (NV_COUNTER *counter,
+              UINT64      value)
+{
+    const JOURNAL *journal = counter->journal;
+
+    return journal->epoch <= UINT64_MAX / counter->lease &&
+           value <= journal->epoch * counter->lease;
+}
+
+static void
+journal_lock (NV_COUNTER *counter,
+              int         operation)
+{
+    if (counter->fd >= 0) {
+        flock (counter->fd, operation);
+    }
+}
+static void
+boot_id_read (char *boot_id)
+{
+    ssize_t size = -1;
+    int fd;
+
+    fd = open (BOOT_ID_PATH, O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        size = read (fd, boot_id, BOOT_ID_SIZE);
+        close (fd);
+    }
+    if (size != BOOT_ID_SIZE) {
+        memset (boot_id, 0, BOOT_ID_SIZE);
+    }
+}
+
+static int
+boot_id_known (const char *boot_id)
+{
+    static const char unknown[BOOT_ID_SIZE];
+
+    return memcmp (boot_id, unknown, BOOT_ID_SIZE) != 0;
+}
+/*
+ * Map the journal file, creating it if it is empty. Called with the file
+ * locked.
+ */
+static TSS2_RC
+journal_map (NV_COUNTER *counter,
+             int        *created)
+{
+    JOURNAL *journal;
+    struct stat st;
+
+    if (fstat (counter->fd, &st) != 0) {
+        return TSS2_UTIL_RC_IO_ERROR;
+    }
+    *created = st.st_size == 0;
+    if (*created && ftruncate (counter->fd, sizeof (JOURNAL)) != 0) {
+        return TSS2_UTIL_RC_IO_ERROR;
+    }
+    if (!*created && st.st_size != sizeof (JOURNAL)) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    journal = mmap (NULL, sizeof (JOURNAL), PROT_READ | PROT_WRITE,
+                    MAP_SHARED, counter->fd, 0);
+    if (journal == MAP_FAILED) {
+        return TSS2_UTIL_RC_IO_ERROR;
+    }
+    if (*created) {
+        journal->magic = JOURNAL_MAGIC;
+        journal->version = JOURNAL_VERSION;
+        journal->nv_index = counter->nv_index;
+        journal->lease = counter->lease;
+        journal->epoch = 0;
+        journal->value = 0;
+    } else if (journal->magic != JOURNAL_MAGIC ||
+               journal->version != JOURNAL_VERSION ||
+               journal->nv_index != counter->nv_index ||
+               journal->lease != counter->lease) {
+        munmap (journal, sizeof (JOURNAL));
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    counter->journal = journal;
+    return TSS2_RC_SUCCESS;
+}
+/*
+ * Check the journal against the NV counter. A journal written in this boot
+ * for the current NV value is a live lease. Anything else is a lost lease,
+ * all of whose values count as used: the journal isn't synced to disk, a
+ * copy that survived a reboot may be older than the values handed out.
+ */
+static TSS2_RC
+journal_sync (NV_COUNTER *counter,
+              int         created)
+{
+    JOURNAL *journal = counter->journal;
+    UINT64 epoch;
+    TSS2_RC rc;
+
+    rc = nv_read (counter, &epoch);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    if (!created && journal->epoch == epoch &&
+        boot_id_known (counter->boot_id) &&
+        memcmp (journal->boot_id, counter->boot_id, BOOT_ID_SIZE) == 0) {
+        return lease_covers (counter, journal->value) ?
+            TSS2_RC_SUCCESS : TSS2_UTIL_RC_BAD_VALUE;
+    }
+    memcpy (journal->boot_id, counter->boot_id, BOOT_ID_SIZE);
+    rc = lease_drop (counter, epoch);
+    if (created) {
+        /* there was no lease to lose */
+        counter->stats.skipped = 0;
+    }
+    return rc;
+}
+
+TSS2_RC Tss2_NvCounter_Init (
+    NV_COUNTER            *counter,
+    size_t                *size,
+    const NV_COUNTER_CONF *config)
+{
+    int created = 1;
+    TSS2_RC rc;
+
+    if (config == NULL || (counter == NULL && size == NULL)) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    if (counter == NULL) {
+        *size = sizeof (NV_COUNTER);
+        return TSS2_RC_SUCCESS;
+    }
+    if (size != NULL && *size < sizeof (NV_COUNTER)) {
+        return TSS2_UTIL_RC_INSUFFICIENT_BUFFER;
+    }
+    if (config->sys_context == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    if (config->auth != NULL &&
+        config->auth->t.size > sizeof (counter->auth.t.buffer)) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+
+    memset (counter, 0, sizeof (*counter));
+    counter->sys_context = config->sys_context;
+    counter->nv_index = config->nv_index;
+    counter->auth_handle = config->auth_handle ? config->auth_handle :
+                                                 config->nv_index;
+    if (config->auth != NULL) {
+        counter->auth = *config->auth;
+    }
+    counter->lease = config->lease ? config->lease : NV_COUNTER_DEFAULT_LEASE;
+    counter->fd = -1;
+    counter->journal = &counter->local;
+    boot_id_read (counter->boot_id);
+    if (config->journal == NULL) {
+        return journal_sync (counter, created);
+    }
+
+    counter->fd = open (config->journal, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (counter->fd < 0) {
+        return TSS2_UTIL_RC_IO_ERROR;
+    }
+    if (flock (counter->fd, LOCK_EX) != 0) {
+        close (counter->fd);
+        counter->fd = -1;
+        return TSS2_UTIL_RC_IO_ERROR;
+    }
+    rc = journal_map (counter, &created);
+    if (rc == TSS2_RC_SUCCESS) {
+        rc = journal_sync (counter, created);
+    }
+    flock (counter->fd, LOCK_UN);
+    if (rc != TSS2_RC_SUCCESS) {
+        Tss2_NvCounter_Finalize (counter);
+    }
+
+    return rc;
+}
+
+TSS2_RC Tss2_NvCounter_Increment (
+    NV_COUNTER *counter,
+    UINT64      count,
+    UINT64     *value)
+{
+    JOURNAL *journal;
+    TSS2_RC rc = TSS2_RC_SUCCESS;
+
+    if (counter == NULL || value == NULL || counter->journal == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    if (count == 0) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+
+    journal_lock (counter, LOCK_EX);
+    journal = counter->journal;
+    while (rc == TSS2_RC_SUCCESS) {
+        if (journal->value > UINT64_MAX - count) {
+            rc = TSS2_UTIL_RC_BAD_VALUE;
+        } else if (lease_covers (counter, journal->value + count)) {
+            break;
+        } else {
+            rc = lease_take (counter);
+        }
+    }
+    if (rc == TSS2_RC_SUCCESS) {
+        journal->value += count;
+        *value = journal->value;
+        counter->stats.increments++;
+        counter->stats.values += count;
+    }
+    journal_lock (counter, LOCK_UN);
+
+    return rc;
+}
+
+TSS2_RC Tss2_NvCounter_Read (
+    NV_COUNTER *counter,
+    UINT64     *value)
+{
+    if (counter == NULL || value == NULL || counter->journal == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    journal_lock (counter, LOCK_SH);
+    *value = counter->journal->value;
+    journal_lock (counter, LOCK_UN);
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_NvCounter_GetStats (
+    NV_COUNTER       *counter,
+    NV_COUNTER_STATS *stats)
+{
+    if (counter == NULL || stats == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    *stats = counter->stats;
+    return TSS2_RC_SUCCESS;
+}
+
+void Tss2_NvCounter_Finalize (
+    NV_COUNTER *counter)
+{
+    if (counter == NULL) {
+        return;
+    }
+    if (counter->journal != NULL && counter->journal != &counter->local) {
+        munmap (counter->journal, sizeof (JOURNAL));
+    }
+    if (counter->fd >= 0) {
+        close (counter->fd);
+    }
+    counter->journal = NULL;
+    counter->fd = -1;
+}
@@ -0,0 +1,545 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+#include <string.h>
+
+#include "sapi/tpm20.h"
+#include "sapi/tss2_mu.h"
+#include "sysapi_util.h"
+#include "util/pcr.h"
+#include "hash.h"
+
+#define PCR_BIT_TEST(select, pcr)  ((select)[(pcr) / 8] &  (1 << ((pcr) % 8)))
+#define PCR_BIT_SET(select, pcr)   ((select)[(pcr) / 8] |= (1 << ((pcr) % 8)))
+#define PCR_BIT_CLEAR(select, pcr) ((select)[(pcr) / 8] &= ~(1 << ((pcr) % 8)))
+
+static TSS2_RC
+selection_check (const TPML_PCR_SELECTION *selection)
+{
+    UINT32 i;
+
+    if (selection->count > HASH_COUNT) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    for (i = 0; i < selection->count; ++i) {
+        if (selection->pcrSelections[i].sizeofSelect > PCR_SELECT_MAX) {
+            return TSS2_UTIL_RC_BAD_VALUE;
+        }
+    }
+    return TSS2_RC_SUCCESS;
+}
+/*
+ * Move the first PCR_READ_MAX_DIGESTS selected PCRs from 'pending' into
+ * 'chunk', in the order the TPM returns them: bank by bank, lowest PCR
+ * first. Banks keep their sizeofSelect. Returns the number of PCRs moved.
+ */
+static size_t
+chunk_take (TPML_PCR_SELECTION *pending,
+            TPML_PCR_SELECTION *chunk)
+{
+    size_t taken = 0;
+    UINT32 i, pcr;
+
+    memset (chunk, 0, sizeof (*chunk));
+    for (i = 0; i < pending->count && taken < PCR_READ_MAX_DIGESTS; ++i) {
+        TPMS_PCR_SELECTION *from = &pending->pcrSelections[i];
+        TPMS_PCR_SELECTION *to = NULL;
+
+        for (pcr = 0;
+             pcr < from->sizeofSelect * 8u && taken < PCR_READ_MAX_DIGESTS;
+             ++pcr)
+        {
+            if (!PCR_BIT_TEST (from->pcrSelect, pcr)) {
+                continue;
+            }
+            if (to == NULL) {
+                to = &chunk->pcrSelections[chunk->count++];
+                to->hash = from->hash;
+                to->sizeofSelect = from->sizeofSelect;
+            }
+            PCR_BIT_SET (to->pcrSelect, pcr);
+            PCR_BIT_CLEAR (from->pcrSelect, pcr);
+            ++taken;
+        }
+    }
+    return taken;
+}
+
+TSS2_RC Tss2_Pcr_Partition (
+    const TPML_PCR_SELECTION *selection,
+    TPML_PCR_SELECTION       *chunks,
+    size_t                   *count)
+{
+    TPML_PCR_SELECTION pending, chunk;
+    size_t used = 0;
+    TSS2_RC rc;
+
+    if (selection == NULL || count == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    rc = selection_check (selection);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    pending = *selection;
+    while (chunk_take (&pending, &chunk) > 0) {
+        if (chunks != NULL) {
+            if (used >= *count) {
+                return TSS2_UTIL_RC_INSUFFICIENT_BUFFER;
+            }
+            chunks[used] = chunk;
+        }
+        ++used;
+    }
+    *count = used;
+
+    return TSS2_RC_SUCCESS;
+}
+
+static PCR_BANK*
+matrix_bank (const PCR_MATRIX *matrix,
+             TPMI_ALG_HASH     hash)
+{
+    UINT32 i;
+
+    for (i = 0; i < matrix->count; ++i) {
+        if (matrix->banks[i].hash == hash) {
+            return (PCR_BANK*)&matrix->banks[i];
+        }
+    }
+    return NULL;
+}
+
+static void
+matrix_init (PCR_MATRIX               *matrix,
+             const TPML_PCR_SELECTION *selection)
+{
+    UINT32 i;
+
+    memset (matrix, 0, sizeof (*matrix));
+    for (i = 0; i < selection->count; ++i) {
+        TPMI_ALG_HASH hash = selection->pcrSelections[i].hash;
+
+        if (matrix_bank (matrix, hash) == NULL) {
+            matrix->banks[matrix->count++].hash = hash;
+        }
+    }
+}
+/*
+ * Store the digests of one PCR_Read response. The TPM leaves out PCRs that
+ * aren't allocated and stops when the response is full, so a requested PCR
+ * missing from 'out' is unallocated if anything after it was returned (or
+ * nothing was returned at all). The PCRs after the last one returned are
+ * put back into 'pending' to be asked for again.
+ */
+static TSS2_RC
+chunk_store (PCR_MATRIX               *matrix,
+             TPML_PCR_SELECTION       *pending,
+             const TPML_PCR_SELECTION *chunk,
+             const TPML_PCR_SELECTION *out,
+             const TPML_DIGEST        *values)
+{
+    UINT32 i, j, pcr, n = 0, position = 0, last = 0;
+
+    for (i = 0; i < out->count; ++i) {
+        const TPMS_PCR_SELECTION *sel = &out->pcrSelections[i];
+        PCR_BANK *bank = matrix_bank (matrix, sel->hash);
+
+        if (bank == NULL || sel->sizeofSelect > PCR_SELECT_MAX) {
+            return TSS2_UTIL_RC_BAD_VALUE;
+        }
+        for (pcr = 0; pcr < sel->sizeofSelect * 8u; ++pcr) {
+            if (!PCR_BIT_TEST (sel->pcrSelect, pcr)) {
+                continue;
+            }
+            if (n >= values->count || pcr >= IMPLEMENTATION_PCR) {
+                return TSS2_UTIL_RC_BAD_VALUE;
+            }
+            bank->digests[pcr] = values->digests[n++];
+            PCR_BIT_SET (bank->pcrSelect, pcr);
+        }
+    }
+    if (n == 0) {
+        return TSS2_RC_SUCCESS;
+    }
+
+    for (i = 0; i < chunk->count; ++i) {
+        const TPMS_PCR_SELECTION *sel = &chunk->pcrSelections[i];
+        PCR_BANK *bank = matrix_bank (matrix, sel->hash);
+
+        for (pcr = 0; pcr < sel->sizeofSelect * 8u; ++pcr) {
+            if (PCR_BIT_TEST (sel->pcrSelect, pcr)) {
+                ++position;
+                if (PCR_BIT_TEST (bank->pcrSelect, pcr)) {
+                    last = position;
+                }
+            }
+        }
+    }
+
+    position = 0;
+    for (i = 0; i < chunk->count; ++i) {
+        const TPMS_PCR_SELECTION *sel = &chunk->pcrSelections[i];
+
+        for (pcr = 0; pcr < sel->sizeofSelect * 8u; ++pcr) {
+            if (!PCR_BIT_TEST (sel->pcrSelect, pcr) || ++position <= last) {
+                continue;
+            }
+            for (j = 0; j < pending->count; ++j) {
+                if (pending->pcrSelections[j].hash == sel->hash) {
+                    PCR_BIT_SET (pending->pcrSelections[j].pcrSelect, pcr);
+                    break;
+                }
+            }
+        }
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_Pcr_ReadAll (
+    TSS2_SYS_CONTEXT         *sys_context,
+    const TPML_PCR_SELECTION *selection,
+    PCR_MATRIX               *matrix)
+{
+    TPML_PCR_SELECTION pending, chunk, out;
+    TPML_DIGEST values;
+    UINT32 counter;
+    unsigned int attempt;
+    int first, torn;
+    TSS2_RC rc;
+
+    if (sys_context == NULL || selection == NULL || matrix == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    rc = selection_check (selection);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+
+    for (attempt = 0; attempt <= PCR_READ_RETRIES; ++attempt) {
+        matrix_init (matrix, selection);
+        pending = *selection;
+        first = 1;
+        torn = 0;
+        /*
+         * The pending selection is partitioned again after every response,
+         * a short answer then only costs the PCRs it left out.
+         */
+        while (chunk_take (&pending, &chunk) > 0) {
+            TPML_PCR_SELECTION request = chunk;
+
+            rc = Tss2_Sys_PCR_Read (sys_context, NULL, &request, &counter,
+                                    &out, &values, NULL);
+            if (rc != TSS2_RC_SUCCESS) {
+                return rc;
+            }
+            if (!first && counter != matrix->update_counter) {
+                torn = 1;
+                break;
+            }
+            matrix->update_counter = counter;
+            first = 0;
+            rc = chunk_store (matrix, &pending, &chunk, &out, &values);
+            if (rc != TSS2_RC_SUCCESS) {
+                return rc;
+            }
+        }
+        if (!torn) {
+            return TSS2_RC_SUCCESS;
+        }
+    }
+
+    return TSS2_UTIL_RC_TRY_AGAIN;
+}
+
+const TPM2B_DIGEST* Tss2_Pcr_MatrixGet (
+    const PCR_MATRIX *matrix,
+    TPMI_ALG_HASH     hash,
+    UINT32            pcr)
+{
+    PCR_BANK *bank;
+
+    if (matrix == NULL || pcr >= IMPLEMENTATION_PCR) {
+        return NULL;
+    }
+    bank = matrix_bank (matrix, hash);
+    if (bank == NULL || !PCR_BIT_TEST (bank->pcrSelect, pcr)) {
+        return NULL;
+    }
+    return &bank->digests[pcr];
+}
+
+static int
+digests_have (const TPML_DIGEST_VALUES *digests,
+              TPMI_ALG_HASH             hash)
+{
+    UINT32 i;
+
+    for (i = 0; i < digests->count; ++i) {
+        if (digests->digests[i].hashAlg == hash) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+TSS2_RC Tss2_Pcr_Extend (
+    TSS2_SYS_CONTEXT         *sys_context,
+    TPMI_DH_PCR               pcr,
+    TSS2_SYS_CMD_AUTHS const *cmd_auths,
+    const TPML_PCR_SELECTION *banks,
+    const uint8_t            *event,
+    size_t                    event_size,
+    TPML_DIGEST_VALUES       *digests)
+{
+    TPML_DIGEST_VALUES values = { 0 };
+    TPM2B_DIGEST digest;
+    UTIL_HASH hash;
+    UINT32 i;
+    TSS2_RC rc;
+
+    if (sys_context == NULL || banks == NULL ||
+        (event == NULL && event_size > 0)) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    if (pcr > PCR_LAST) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    rc = selection_check (banks);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+
+    for (i = 0; i < banks->count; ++i) {
+        const TPMS_PCR_SELECTION *bank = &banks->pcrSelections[i];
+        TPMT_HA *ha = &values.digests[values.count];
+
+        if (pcr >= bank->sizeofSelect * 8u ||
+            !PCR_BIT_TEST (bank->pcrSelect, pcr) ||
+            digests_have (&values, bank->hash)) {
+            continue;
+        }
+        rc = util_hash_start (&hash, bank->hash);
+        if (rc != TSS2_RC_SUCCESS) {
+            return rc;
+        }
+        rc = util_hash_update (&hash, event, event_size);
+        if (rc != TSS2_RC_SUCCESS) {
+            util_hash_abort (&hash);
+            return rc;
+        }
+        rc = util_hash_finish (&hash, &digest);
+        if (rc != TSS2_RC_SUCCESS) {
+            return rc;
+        }
+        ha->hashAlg = bank->hash;
+        memcpy (&ha->digest, digest.t.buffer, digest.t.size);
+        ++values.count;
+    }
+    if (values.count == 0) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+
+    rc = Tss2_Sys_PCR_Extend (sys_context, pcr, cmd_auths, &values, NULL);
+    if (rc == TSS2_RC_SUCCESS && digests != NULL) {
+        *digests = values;
+    }
+    return rc;
+}
+
+TSS2_RC Tss2_Pcr_MatrixExtend (
+    PCR_MATRIX               *matrix,
+    UINT32                    pcr,
+    const TPML_DIGEST_VALUES *digests)
+{
+    UTIL_HASH hash;
+    UINT32 i;
+    TSS2_RC rc;
+
+    if (matrix == NULL || digests == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    if (pcr >= IMPLEMENTATION_PCR || digests->count > HASH_COUNT) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+
+    for (i = 0; i < digests->count; ++i) {
+        const TPMT_HA *ha = &digests->digests[i];
+        PCR_BANK *bank = matrix_bank (matrix, ha->hashAlg);
+        TPM2B_DIGEST *value;
+
+        if (bank == NULL || !PCR_BIT_TEST (bank->pcrSelect, pcr)) {
+            continue;
+        }
+        value = &bank->digests[pcr];
+        rc = util_hash_start (&hash, ha->hashAlg);
+        if (rc != TSS2_RC_SUCCESS) {
+            return rc;
+        }
+        rc = util_hash_update (&hash, value->t.buffer, value->t.size);
+        if (rc == TSS2_RC_SUCCESS) {
+            rc = util_hash_update (&hash, (const uint8_t*)&ha->digest,
+                                   GetDigestSize (ha->hashAlg));
+        }
+        if (rc != TSS2_RC_SUCCESS) {
+            util_hash_abort (&hash);
+            return rc;
+        }
+        rc = util_hash_finish (&hash, value);
+        if (rc != TSS2_RC_SUCCESS) {
+            return rc;
+        }
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_Pcr_MatrixDigest (
+    const PCR_MATRIX         *matrix,
+    const TPML_PCR_SELECTION *selection,
+    TPMI_ALG_HASH             hash,
+    TPM2B_DIGEST             *digest)
+{
+    UTIL_HASH ctx;
+    UINT32 i, pcr;
+    TSS2_RC rc;
+
+    if (matrix == NULL || selection == NULL || digest == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    rc = selection_check (selection);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    rc = util_hash_start (&ctx, hash);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    for (i = 0; i < selection->count; ++i) {
+        const TPMS_PCR_SELECTION *sel = &selection->pcrSelections[i];
+
+        for (pcr = 0; pcr < sel->sizeofSelect * 8u; ++pcr) {
+            const TPM2B_DIGEST *value;
+
+            if (!PCR_BIT_TEST (sel->pcrSelect, pcr)) {
+                continue;
+            }
+            value = Tss2_Pcr_MatrixGet (matrix, sel->hash, pcr);
+            if (value == NULL) {
+                util_hash_abort (&ctx);
+                return TSS2_UTIL_RC_BAD_VALUE;
+            }
+            rc = util_hash_update (&ctx, value->t.buffer, value->t.size);
+            if (rc != TSS2_RC_SUCCESS) {
+                util_hash_abort (&ctx);
+                return rc;
+            }
+        }
+    }
+
+    return util_hash_finish (&ctx, digest);
+}
+
+/*
+ * PCR_BIT_TEST over 'select' with bytes past 'size' reading as zero, so
+ * selections only differing in sizeofSelect compare equal.
+ */
+static int
+select_test (const TPMS_PCR_SELECTION *select,
+             UINT32                    pcr)
+{
+    return pcr / 8 < select->sizeofSelect &&
+           PCR_BIT_TEST (select->pcrSelect, pcr);
+}
+
+int Tss2_Pcr_SelectionEqual (
+    const TPML_PCR_SELECTION *a,
+    const TPML_PCR_SELECTION *b)
+{
+    UINT32 i, pcr;
+
+    if (a == NULL || b == NULL || a->count != b->count ||
+        selection_check (a) != TSS2_RC_SUCCESS ||
+        selection_check (b) != TSS2_RC_SUCCESS) {
+        return 0;
+    }
+    for (i = 0; i < a->count; ++i) {
+        if (a->pcrSelections[i].hash != b->pcrSelections[i].hash) {
+            return 0;
+        }
+        for (pcr = 0; pcr < PCR_SELECT_MAX * 8; ++pcr) {
+            if (!select_test (&a->pcrSelections[i], pcr) !=
+                !select_test (&b->pcrSelections[i], pcr)) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+TSS2_RC Tss2_Pcr_VerifyQuote (
+    const PCR_MATRIX         *matrix,
+    const TPML_PCR_SELECTION *selection,
+    const TPM2B_ATTEST       *quoted,
+    TPMI_ALG_HASH             hash)
+{
+    TPMS_ATTEST attest;
+    TPMS_QUOTE_INFO *quote;
+    TPM2B_DIGEST digest;
+    size_t offset = 0;
+    TSS2_RC rc;
+
+    if (matrix == NULL || selection == NULL || quoted == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    rc = Tss2_MU_TPMS_ATTEST_Unmarshal (quoted->t.attestationData,
+                                        quoted->t.size,
+                                        &offset,
+                                        &attest);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    if (attest.magic != TPM_GENERATED_VALUE ||
+        attest.type != TPM_ST_ATTEST_QUOTE) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    quote = &attest.attested.quote;
+    /* the matrix holds every PCR, any subset of it would match */
+    if (!Tss2_Pcr_SelectionEqual (&quote->pcrSelect, selection)) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    rc = Tss2_Pcr_MatrixDigest (matrix, &quote->pcrSelect, hash, &digest);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    if (digest.t.size != quote->pcrDigest.t.size ||
+        memcmp (digest.t.buffer, quote->pcrDigest.t.buffer, digest.t.size) != 0) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+
+    return TSS2_RC_SUCCESS;
+}
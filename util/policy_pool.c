@@ -0,0 +1,459 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+
+#include <string.h>
+
+#include <openssl/rand.h>
+
+#include "sapi/tpm20.h"
+#include "sysapi_util.h"
+#include "util/policy_pool.h"
+
+typedef enum {
+    SLOT_EMPTY,
+    SLOT_LOADED,
+    SLOT_SAVED,
+} SLOT_STATE;
+
+typedef struct {
+    SLOT_STATE state;
+    UINT8 in_use;
+    /* set once the policy digest may differ from the replayed sequence */
+    UINT8 dirty;
+    TPMI_SH_POLICY handle;
+    UINT64 last_used;
+    POLICY_POOL_NONCES nonces;
+    TPMS_CONTEXT context;
+} POLICY_POOL_SLOT;
+
+struct _POLICY_POOL {
+    POLICY_POOL_CONF conf;
+    TPM2B_ENCRYPTED_SECRET salt;
+    UINT16 nonce_size;
+    UINT64 tick;
+    POLICY_POOL_STATS stats;
+    POLICY_POOL_SLOT slots[];
+};
+
+/* format one response code without the handle / session / parameter number */
+#define TPM_RC_FMT1_BASE(rc) \
+    (((rc) & RC_FMT1) ? (rc) & (RC_FMT1 | 0x3f) : (rc))
+
+TSS2_RC Tss2_PolicyPool_Init (
+    POLICY_POOL            *pool,
+    size_t                 *size,
+    const POLICY_POOL_CONF *config)
+{
+    size_t pool_size;
+    UINT16 digest_size;
+
+    if (config == NULL || (pool == NULL && size == NULL)) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    if (config->slot_count == 0 ||
+        config->slot_count > MAX_ACTIVE_SESSIONS ||
+        config->max_loaded > MAX_LOADED_SESSIONS) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    pool_size = sizeof (POLICY_POOL) +
+                config->slot_count * sizeof (POLICY_POOL_SLOT);
+    if (pool == NULL) {
+        *size = pool_size;
+        return TSS2_RC_SUCCESS;
+    }
+    if (size != NULL && *size < pool_size) {
+        return TSS2_UTIL_RC_INSUFFICIENT_BUFFER;
+    }
+    if (config->sys_context == NULL ||
+        (config->assertion_count > 0 && config->assertions == NULL)) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    digest_size = GetDigestSize (config->auth_hash);
+    if (digest_size == 0) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+
+    memset (pool, 0, pool_size);
+    pool->conf = *config;
+    if (config->encrypted_salt != NULL) {
+        pool->salt = *config->encrypted_salt;
+    }
+    pool->conf.encrypted_salt = NULL;
+    pool->nonce_size = digest_size;
+
+    return TSS2_RC_SUCCESS;
+}
+
+static POLICY_POOL_SLOT*
+slot_find_idle (POLICY_POOL *pool)
+{
+    POLICY_POOL_SLOT *loaded = NULL, *saved = NULL, *empty = NULL;
+    size_t i;
+
+    for (i = 0; i < pool->conf.slot_count; ++i) {
+        POLICY_POOL_SLOT *slot = &pool->slots[i];
+
+        if (slot->in_use) {
+            continue;
+        }
+        switch (slot->state) {
+        case SLOT_LOADED:
+            if (loaded == NULL || slot->last_used > loaded->last_used)
+                loaded = slot;
+            break;
+        case SLOT_SAVED:
+            if (saved == NULL || slot->last_used > saved->last_used)
+                saved = slot;
+            break;
+        case SLOT_EMPTY:
+            if (empty == NULL)
+                empty = slot;
+            break;
+        }
+    }
+    /* a ContextLoad is cheaper than StartAuthSession, so warm slots first */
+    if (loaded != NULL)
+        return loaded;
+    if (saved != NULL)
+        return saved;
+    return empty;
+}
+/* Save the least recently used idle session that's still loaded. */
+static TSS2_RC
+slot_save_lru (POLICY_POOL *pool)
+{
+    POLICY_POOL_SLOT *victim = NULL;
+    TSS2_RC rc;
+    size_t i;
+
+    for (i = 0; i < pool->conf.slot_count; ++i) {
+        POLICY_POOL_SLOT *slot = &pool->slots[i];
+
+        if (slot->in_use || slot->state != SLOT_LOADED)
+            continue;
+        if (victim == NULL || slot->last_used < victim->last_used)
+            victim = slot;
+    }
+    if (victim == NULL) {
+        return TSS2_UTIL_RC_TRY_AGAIN;
+    }
+    rc = Tss2_Sys_ContextSave (pool->conf.sys_context,
+                               victim->handle,
+                               &victim->context);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    victim->state = SLOT_SAVED;
+    pool->stats.saved++;
+
+    return TSS2_RC_SUCCESS;
+}
+/* Save idle sessions until no more than 'max_loaded' of them are loaded. */
+static TSS2_RC
+slot_trim (POLICY_POOL *pool)
+{
+    size_t i, idle = 0;
+    TSS2_RC rc;
+
+    for (i = 0; i < pool->conf.slot_count; ++i) {
+        if (!pool->slots[i].in_use && pool->slots[i].state == SLOT_LOADED)
+            ++idle;
+    }
+    for (; idle > pool->conf.max_loaded; --idle) {
+        rc = slot_save_lru (pool);
+        if (rc != TSS2_RC_SUCCESS)
+            return rc;
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
+static POLICY_POOL_SLOT*
+slot_find_in_use (POLICY_POOL *pool, TPMI_SH_POLICY session)
+{
+    size_t i;
+
+    for (i = 0; i < pool->conf.slot_count; ++i) {
+        if (pool->slots[i].in_use && pool->slots[i].handle == session)
+            return &pool->slots[i];
+    }
+
+    return NULL;
+}
+/*
+ * Start the session of a slot with a fresh nonceCaller. Both nonces are
+ * kept so the caller can derive the session key.
+ */
+static TSS2_RC
+slot_start (POLICY_POOL *pool, POLICY_POOL_SLOT *slot)
+{
+    TPM2B_NONCE nonce_tpm = { .t.size = sizeof (nonce_tpm.t.buffer) };
+    TPMT_SYM_DEF symmetric = pool->conf.symmetric;
+    TPM2B_ENCRYPTED_SECRET salt = pool->salt;
+    TPM2B_NONCE nonce_caller = { .t.size = pool->nonce_size };
+    TSS2_RC rc;
+
+    if (RAND_bytes (nonce_caller.t.buffer, nonce_caller.t.size) != 1) {
+        return TSS2_UTIL_RC_GENERAL_FAILURE;
+    }
+    rc = Tss2_Sys_StartAuthSession (pool->conf.sys_context,
+                                    pool->conf.tpm_key,
+                                    pool->conf.bind,
+                                    NULL,
+                                    &nonce_caller,
+                                    &salt,
+                                    TPM_SE_POLICY,
+                                    &symmetric,
+                                    pool->conf.auth_hash,
+                                    &slot->handle,
+                                    &nonce_tpm,
+                                    NULL);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    slot->state = SLOT_LOADED;
+    slot->dirty = 0;
+    slot->nonces.nonce_caller = nonce_caller;
+    slot->nonces.nonce_tpm_start = nonce_tpm;
+    slot->nonces.nonce_tpm = nonce_tpm;
+    pool->stats.started++;
+
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+slot_load (POLICY_POOL *pool, POLICY_POOL_SLOT *slot)
+{
+    TPMI_DH_CONTEXT handle;
+    TSS2_RC rc;
+
+    rc = Tss2_Sys_ContextLoad (pool->conf.sys_context,
+                               &slot->context,
+                               &handle);
+    if (TPM_RC_FMT1_BASE (rc) == TPM_RC_INTEGRITY ||
+        TPM_RC_FMT1_BASE (rc) == TPM_RC_HANDLE) {
+        /*
+         * Saved sessions don't survive a TPM reset, the context then fails
+         * the integrity check or names a session that's gone. Nothing is
+         * left in the TPM, pay for a new StartAuthSession instead. Other
+         * errors (e.g. TPM_RC_CONTEXT_GAP) keep the saved context.
+         */
+        slot->state = SLOT_EMPTY;
+        return slot_start (pool, slot);
+    } else if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    slot->handle = handle;
+    slot->state = SLOT_LOADED;
+    pool->stats.loaded++;
+
+    return TSS2_RC_SUCCESS;
+}
+static TSS2_RC
+policy_replay (POLICY_POOL *pool, TPMI_SH_POLICY session)
+{
+    TSS2_SYS_CONTEXT *sys_context = pool->conf.sys_context;
+    TPM2B_DIGEST digest;
+    TPML_PCR_SELECTION pcrs;
+    TSS2_RC rc = TSS2_RC_SUCCESS;
+    size_t i;
+
+    for (i = 0; i < pool->conf.assertion_count && rc == TSS2_RC_SUCCESS; ++i) {
+        const POLICY_ASSERTION *assertion = &pool->conf.assertions[i];
+
+        switch (assertion->type) {
+        case POLICY_ASSERT_COMMAND_CODE:
+            rc = Tss2_Sys_PolicyCommandCode (sys_context, session, NULL,
+                                             assertion->u.command_code, NULL);
+            break;
+        case POLICY_ASSERT_PCR:
+            digest = assertion->u.pcr.digest;
+            pcrs = assertion->u.pcr.pcrs;
+            rc = Tss2_Sys_PolicyPCR (sys_context, session, NULL,
+                                     &digest, &pcrs, NULL);
+            break;
+        case POLICY_ASSERT_LOCALITY:
+            rc = Tss2_Sys_PolicyLocality (sys_context, session, NULL,
+                                          assertion->u.locality, NULL);
+            break;
+        case POLICY_ASSERT_AUTH_VALUE:
+            rc = Tss2_Sys_PolicyAuthValue (sys_context, session, NULL, NULL);
+            break;
+        case POLICY_ASSERT_PASSWORD:
+            rc = Tss2_Sys_PolicyPassword (sys_context, session, NULL, NULL);
+            break;
+        case POLICY_ASSERT_CALLBACK:
+            if (assertion->u.callback.func == NULL)
+                return TSS2_UTIL_RC_BAD_REFERENCE;
+            rc = assertion->u.callback.func (sys_context, session,
+                                             assertion->u.callback.data);
+            break;
+        default:
+            return TSS2_UTIL_RC_BAD_VALUE;
+        }
+    }
+
+    return rc;
+}
+
+TSS2_RC Tss2_PolicyPool_Acquire (
+    POLICY_POOL    *pool,
+    TPMI_SH_POLICY *session)
+{
+    POLICY_POOL_SLOT *slot;
+    TSS2_RC rc = TSS2_RC_SUCCESS;
+
+    if (pool == NULL || session == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    slot = slot_find_idle (pool);
+    if (slot == NULL) {
+        return TSS2_UTIL_RC_TRY_AGAIN;
+    }
+    if (slot->state == SLOT_SAVED) {
+        rc = slot_load (pool, slot);
+    } else if (slot->state == SLOT_EMPTY) {
+        rc = slot_start (pool, slot);
+    }
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    if (slot->dirty) {
+        rc = Tss2_Sys_PolicyRestart (pool->conf.sys_context, slot->handle,
+                                     NULL, NULL);
+        if (rc != TSS2_RC_SUCCESS) {
+            return rc;
+        }
+        pool->stats.restarted++;
+    }
+    /* whatever happens from here on the policy digest must be reset */
+    slot->dirty = 1;
+    slot->last_used = ++pool->tick;
+    rc = policy_replay (pool, slot->handle);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    slot->in_use = 1;
+    pool->stats.acquired++;
+    *session = slot->handle;
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_PolicyPool_Release (
+    POLICY_POOL    *pool,
+    TPMI_SH_POLICY  session,
+    UINT32          flags)
+{
+    POLICY_POOL_SLOT *slot;
+
+    if (pool == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    slot = slot_find_in_use (pool, session);
+    if (slot == NULL) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    slot->in_use = 0;
+    if ((flags & POLICY_POOL_RELEASE_FLUSHED) && slot->state == SLOT_LOADED) {
+        slot->state = SLOT_EMPTY;
+    }
+
+    return slot_trim (pool);
+}
+
+TSS2_RC Tss2_PolicyPool_GetNonces (
+    POLICY_POOL        *pool,
+    TPMI_SH_POLICY      session,
+    POLICY_POOL_NONCES *nonces)
+{
+    POLICY_POOL_SLOT *slot;
+
+    if (pool == NULL || nonces == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    slot = slot_find_in_use (pool, session);
+    if (slot == NULL) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    *nonces = slot->nonces;
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_PolicyPool_SetNonceTpm (
+    POLICY_POOL       *pool,
+    TPMI_SH_POLICY     session,
+    const TPM2B_NONCE *nonce_tpm)
+{
+    POLICY_POOL_SLOT *slot;
+
+    if (pool == NULL || nonce_tpm == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    if (nonce_tpm->t.size > sizeof (nonce_tpm->t.buffer)) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    slot = slot_find_in_use (pool, session);
+    if (slot == NULL) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    slot->nonces.nonce_tpm = *nonce_tpm;
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_PolicyPool_GetStats (
+    POLICY_POOL       *pool,
+    POLICY_POOL_STATS *stats)
+{
+    if (pool == NULL || stats == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    *stats = pool->stats;
+
+    return TSS2_RC_SUCCESS;
+}
+
+void Tss2_PolicyPool_Finalize (
+    POLICY_POOL *pool)
+{
+    size_t i;
+
+    if (pool == NULL) {
+        return;
+    }
+    for (i = 0; i < pool->conf.slot_count; ++i) {
+        POLICY_POOL_SLOT *slot = &pool->slots[i];
+
+        /* saved sessions still hold a TPM session slot, flush those too */
+        if (slot->state != SLOT_EMPTY)
+            Tss2_Sys_FlushContext (pool->conf.sys_context, slot->handle);
+        slot->state = SLOT_EMPTY;
+        slot->in_use = 0;
+    }
+}
@@ -0,0 +1,489 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "sapi/tpm20.h"
+#include "sapi/tss2_mu.h"
+#include "util/primary_cache.h"
+#include "util/hash.h"
+
+#define STORE_MAGIC   0x3163702d32737374ULL
+#define STORE_VERSION 1
+
+/*
+ * Store file layout: a header followed by 'entry_count' fixed size
+ * entries. The saved context, public area and name of an entry are kept
+ * in marshalled form so the file doesn't depend on structure layout.
+ */
+typedef struct {
+    UINT64 magic;
+    UINT32 version;
+    UINT32 entry_count;
+    /* bumped on every store, orders entries for replacement */
+    UINT64 tick;
+} STORE_HEADER;
+
+typedef struct {
+    UINT32 valid;
+    TPMI_RH_HIERARCHY hierarchy;
+    BYTE key[SHA256_DIGEST_SIZE];
+    UINT64 stored;
+    UINT32 blob_size;
+    BYTE blob[sizeof (TPMS_CONTEXT) + sizeof (TPM2B_PUBLIC) +
+              sizeof (TPM2B_NAME)];
+} STORE_ENTRY;
+
+struct _PRIMARY_CACHE {
+    TSS2_SYS_CONTEXT *sys_context;
+    int fd;
+    size_t map_size;
+    STORE_HEADER *header;
+    STORE_ENTRY *entries;
+    PRIMARY_CACHE_STATS stats;
+};
+
+#define STORE_SIZE(count) \
+    (sizeof (STORE_HEADER) + (size_t)(count) * sizeof (STORE_ENTRY))
+
+/* format one response code without the handle / session / parameter number */
+#define TPM_RC_FMT1_BASE(rc) \
+    (((rc) & RC_FMT1) ? (rc) & (RC_FMT1 | 0x3f) : (rc))
+
+/*
+ * Map the store, creating it if the file is empty. Called with the file
+ * locked so two processes can't both initialize a new store.
+ */
+static TSS2_RC
+store_map (PRIMARY_CACHE *cache, size_t entry_count)
+{
+    struct stat st;
+    size_t size;
+    void *map;
+    int created = 0;
+
+    if (fstat (cache->fd, &st) != 0) {
+        return TSS2_UTIL_RC_IO_ERROR;
+    }
+    if (st.st_size == 0) {
+        size = STORE_SIZE (entry_count);
+        if (ftruncate (cache->fd, size) != 0) {
+            return TSS2_UTIL_RC_IO_ERROR;
+        }
+        created = 1;
+    } else if ((size_t)st.st_size < sizeof (STORE_HEADER)) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    } else {
+        size = st.st_size;
+    }
+    map = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, cache->fd, 0);
+    if (map == MAP_FAILED) {
+        return TSS2_UTIL_RC_IO_ERROR;
+    }
+    cache->map_size = size;
+    cache->header = map;
+    cache->entries = (STORE_ENTRY*)(cache->header + 1);
+    if (created) {
+        cache->header->magic = STORE_MAGIC;
+        cache->header->version = STORE_VERSION;
+        cache->header->entry_count = entry_count;
+        cache->header->tick = 0;
+    } else if (cache->header->magic != STORE_MAGIC ||
+               cache->header->version != STORE_VERSION ||
+               STORE_SIZE (cache->header->entry_count) != size) {
+        munmap (map, size);
+        cache->header = NULL;
+        cache->entries = NULL;
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_PrimaryCache_Init (
+    PRIMARY_CACHE            *cache,
+    size_t                   *size,
+    const PRIMARY_CACHE_CONF *config)
+{
+    size_t entry_count;
+    TSS2_RC rc;
+
+    if (cache == NULL && size == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    if (cache == NULL) {
+        *size = sizeof (PRIMARY_CACHE);
+        return TSS2_RC_SUCCESS;
+    }
+    if (size != NULL && *size < sizeof (PRIMARY_CACHE)) {
+        return TSS2_UTIL_RC_INSUFFICIENT_BUFFER;
+    }
+    if (config == NULL || config->sys_context == NULL ||
+        config->path == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    entry_count = config->entry_count;
+    if (entry_count == 0) {
+        entry_count = PRIMARY_CACHE_DEFAULT_ENTRIES;
+    } else if (entry_count > UINT16_MAX) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+
+    memset (cache, 0, sizeof (PRIMARY_CACHE));
+    cache->sys_context = config->sys_context;
+    cache->fd = open (config->path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (cache->fd < 0) {
+        return TSS2_UTIL_RC_IO_ERROR;
+    }
+    if (flock (cache->fd, LOCK_EX) != 0) {
+        close (cache->fd);
+        return TSS2_UTIL_RC_IO_ERROR;
+    }
+    rc = store_map (cache, entry_count);
+    flock (cache->fd, LOCK_UN);
+    if (rc != TSS2_RC_SUCCESS) {
+        close (cache->fd);
+        cache->fd = -1;
+    }
+
+    return rc;
+}
+/*
+ * The cache key is the SHA256 over the marshalled template. Only requests
+ * with empty sensitive data are cached, so together with the hierarchy it
+ * determines the primary key and nothing secret ends up in the store.
+ */
+static TSS2_RC
+cache_key (TPM2B_PUBLIC *in_public,
+           TPM2B_DIGEST *key)
+{
+    TSS2_MU_SINK sink;
+    UTIL_HASH hash;
+    TSS2_RC rc;
+
+    rc = util_hash_start (&hash, TPM_ALG_SHA256);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    /* the template goes straight into the hash, no marshalling buffer */
+    util_hash_sink (&hash, &sink);
+    rc = TSS2_MU_MARSHAL_SINK (TPM2B_PUBLIC, in_public, &sink, NULL);
+    if (rc != TSS2_RC_SUCCESS) {
+        util_hash_abort (&hash);
+        return rc;
+    }
+
+    return util_hash_finish (&hash, key);
+}
+
+static STORE_ENTRY*
+entry_find (PRIMARY_CACHE     *cache,
+            TPMI_RH_HIERARCHY  hierarchy,
+            TPM2B_DIGEST      *key)
+{
+    UINT32 i;
+
+    for (i = 0; i < cache->header->entry_count; ++i) {
+        STORE_ENTRY *entry = &cache->entries[i];
+
+        if (entry->valid && entry->hierarchy == hierarchy &&
+            memcmp (entry->key, key->t.buffer, sizeof (entry->key)) == 0)
+            return entry;
+    }
+
+    return NULL;
+}
+/* Pick a free entry, or the one that was stored longest ago. */
+static STORE_ENTRY*
+entry_victim (PRIMARY_CACHE *cache)
+{
+    STORE_ENTRY *victim = NULL;
+    UINT32 i;
+
+    for (i = 0; i < cache->header->entry_count; ++i) {
+        STORE_ENTRY *entry = &cache->entries[i];
+
+        if (!entry->valid)
+            return entry;
+        if (victim == NULL || entry->stored < victim->stored)
+            victim = entry;
+    }
+
+    return victim;
+}
+
+static TSS2_RC
+entry_load (PRIMARY_CACHE *cache,
+            STORE_ENTRY   *entry,
+            TPM_HANDLE    *object_handle,
+            TPM2B_PUBLIC  *out_public,
+            TPM2B_NAME    *name)
+{
+    TPMS_CONTEXT context;
+    size_t offset = 0;
+
+    /* a damaged entry is treated like one that failed to load */
+    if (entry->blob_size > sizeof (entry->blob) ||
+        Tss2_MU_TPMS_CONTEXT_Unmarshal (entry->blob,
+                                        entry->blob_size,
+                                        &offset,
+                                        &context) != TSS2_RC_SUCCESS ||
+        Tss2_MU_TPM2B_PUBLIC_Unmarshal (entry->blob,
+                                        entry->blob_size,
+                                        &offset,
+                                        out_public) != TSS2_RC_SUCCESS ||
+        Tss2_MU_TPM2B_NAME_Unmarshal (entry->blob,
+                                      entry->blob_size,
+                                      &offset,
+                                      name) != TSS2_RC_SUCCESS) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+
+    return Tss2_Sys_ContextLoad (cache->sys_context, &context, object_handle);
+}
+
+static TSS2_RC
+entry_store (PRIMARY_CACHE     *cache,
+             TPMI_RH_HIERARCHY  hierarchy,
+             TPM2B_DIGEST      *key,
+             TPM_HANDLE         object_handle,
+             TPM2B_PUBLIC      *out_public,
+             TPM2B_NAME        *name)
+{
+    STORE_ENTRY *entry;
+    TPMS_CONTEXT context;
+    size_t offset = 0;
+    TSS2_RC rc;
+
+    rc = Tss2_Sys_ContextSave (cache->sys_context, object_handle, &context);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    entry = entry_find (cache, hierarchy, key);
+    if (entry == NULL) {
+        entry = entry_victim (cache);
+    }
+    entry->valid = 0;
+    rc = Tss2_MU_TPMS_CONTEXT_Marshal (&context,
+                                      entry->blob,
+                                      sizeof (entry->blob),
+                                      &offset);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    rc = Tss2_MU_TPM2B_PUBLIC_Marshal (out_public,
+                                      entry->blob,
+                                      sizeof (entry->blob),
+                                      &offset);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    rc = Tss2_MU_TPM2B_NAME_Marshal (name,
+                                    entry->blob,
+                                    sizeof (entry->blob),
+                                    &offset);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    entry->hierarchy = hierarchy;
+    memcpy (entry->key, key->t.buffer, sizeof (entry->key));
+    entry->blob_size = offset;
+    entry->stored = ++cache->header->tick;
+    entry->valid = 1;
+    msync (cache->header, cache->map_size, MS_ASYNC);
+
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+primary_create (PRIMARY_CACHE            *cache,
+                TPMI_RH_HIERARCHY         hierarchy,
+                TSS2_SYS_CMD_AUTHS const *cmd_auths,
+                TPM2B_SENSITIVE_CREATE   *in_sensitive,
+                TPM2B_PUBLIC             *in_public,
+                TPM_HANDLE               *object_handle,
+                TPM2B_PUBLIC             *out_public,
+                TPM2B_NAME               *name)
+{
+    TPM2B_CREATION_DATA creation_data = { .t.size = 0 };
+    TPM2B_DIGEST creation_hash = { .t.size = sizeof (creation_hash.t.buffer) };
+    TPMT_TK_CREATION creation_ticket = { .tag = 0 };
+    TPM2B_DATA outside_info = { .t.size = 0 };
+    TPML_PCR_SELECTION creation_pcr = { .count = 0 };
+
+    return Tss2_Sys_CreatePrimary (cache->sys_context,
+                                   hierarchy,
+                                   cmd_auths,
+                                   in_sensitive,
+                                   in_public,
+                                   &outside_info,
+                                   &creation_pcr,
+                                   object_handle,
+                                   out_public,
+                                   &creation_data,
+                                   &creation_hash,
+                                   &creation_ticket,
+                                   name,
+                                   NULL);
+}
+
+/*
+ * Load the key from the store or create and store it. Called with the
+ * store locked.
+ */
+static TSS2_RC
+cached_create (PRIMARY_CACHE            *cache,
+               TPMI_RH_HIERARCHY         hierarchy,
+               TSS2_SYS_CMD_AUTHS const *cmd_auths,
+               TPM2B_SENSITIVE_CREATE   *in_sensitive,
+               TPM2B_PUBLIC             *in_public,
+               TPM2B_DIGEST             *key,
+               TPM_HANDLE               *object_handle,
+               TPM2B_PUBLIC             *out_public,
+               TPM2B_NAME               *name)
+{
+    STORE_ENTRY *entry;
+    TSS2_RC rc;
+
+    entry = entry_find (cache, hierarchy, key);
+    if (entry != NULL) {
+        rc = entry_load (cache, entry, object_handle, out_public, name);
+        if (rc == TSS2_RC_SUCCESS) {
+            cache->stats.hits++;
+            return TSS2_RC_SUCCESS;
+        }
+        /*
+         * Only a damaged entry or a context the TPM no longer accepts
+         * (TPM Reset, Clear) is stale. Transient errors such as
+         * TPM_RC_OBJECT_MEMORY leave the entry alone.
+         */
+        if (rc != TSS2_UTIL_RC_BAD_VALUE &&
+            TPM_RC_FMT1_BASE (rc) != TPM_RC_INTEGRITY &&
+            TPM_RC_FMT1_BASE (rc) != TPM_RC_HANDLE) {
+            return rc;
+        }
+        entry->valid = 0;
+        cache->stats.stale++;
+    }
+    cache->stats.misses++;
+    /*
+     * The lock is held across CreatePrimary so concurrent processes wait
+     * for this one to populate the entry instead of creating the key too.
+     */
+    rc = primary_create (cache, hierarchy, cmd_auths, in_sensitive,
+                         in_public, object_handle, out_public, name);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    /* failing to cache the key doesn't make it any less usable */
+    entry_store (cache, hierarchy, key, *object_handle, out_public, name);
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_PrimaryCache_CreatePrimary (
+    PRIMARY_CACHE            *cache,
+    TPMI_RH_HIERARCHY         hierarchy,
+    TSS2_SYS_CMD_AUTHS const *cmd_auths,
+    TPM2B_SENSITIVE_CREATE   *in_sensitive,
+    TPM2B_PUBLIC             *in_public,
+    TPM_HANDLE               *object_handle,
+    TPM2B_PUBLIC             *out_public,
+    TPM2B_NAME               *name)
+{
+    TPM2B_PUBLIC public = { .t.size = 0 };
+    TPM2B_NAME object_name = { .t.size = sizeof (object_name.t.name) };
+    TPM2B_DIGEST key = { .t.size = 0 };
+    TSS2_RC rc;
+
+    if (cache == NULL || cache->header == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    if (in_sensitive == NULL || in_public == NULL || object_handle == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    if (in_sensitive->t.sensitive.userAuth.t.size != 0 ||
+        in_sensitive->t.sensitive.data.t.size != 0) {
+        /* caching would put something derived from the secrets on disk */
+        cache->stats.uncacheable++;
+        rc = primary_create (cache, hierarchy, cmd_auths, in_sensitive,
+                             in_public, object_handle, &public, &object_name);
+    } else {
+        rc = cache_key (in_public, &key);
+        if (rc != TSS2_RC_SUCCESS) {
+            return rc;
+        }
+        if (flock (cache->fd, LOCK_EX) != 0) {
+            return TSS2_UTIL_RC_IO_ERROR;
+        }
+        rc = cached_create (cache, hierarchy, cmd_auths, in_sensitive,
+                            in_public, &key, object_handle, &public,
+                            &object_name);
+        flock (cache->fd, LOCK_UN);
+    }
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    if (out_public != NULL) {
+        *out_public = public;
+    }
+    if (name != NULL) {
+        *name = object_name;
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_PrimaryCache_GetStats (
+    PRIMARY_CACHE       *cache,
+    PRIMARY_CACHE_STATS *stats)
+{
+    if (cache == NULL || stats == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    *stats = cache->stats;
+
+    return TSS2_RC_SUCCESS;
+}
+
+void Tss2_PrimaryCache_Finalize (
+    PRIMARY_CACHE *cache)
+{
+    if (cache == NULL || cache->header == NULL) {
+        return;
+    }
+    munmap (cache->header, cache->map_size);
+    close (cache->fd);
+    cache->header = NULL;
+    cache->entries = NULL;
+    cache->fd = -1;
+}
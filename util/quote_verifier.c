@@ -0,0 +1,640 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+
+#include "sapi/tpm20.h"
+#include "sapi/tss2_mu.h"
+#include "util/name.h"
+#include "util/quote_verifier.h"
+#include "hash.h"
+
+/* the four magic bytes of a TPMS_ATTEST, TPM_GENERATED_VALUE big endian */
+static const uint8_t attest_magic[] = { 0xff, 0x54, 0x43, 0x47 };
+
+/* AlgorithmIdentifier for rsaEncryption */
+static const uint8_t rsa_algorithm[] = {
+    0x30, 0x0d, 0x06, 0x09, 0x2a, 0x86, 0x48, 0x86,
+    0xf7, 0x0d, 0x01, 0x01, 0x01, 0x05, 0x00,
+};
+/* OIDs of id-ecPublicKey and the supported curves */
+static const uint8_t ec_public_key[] = {
+    0x06, 0x07, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x02, 0x01,
+};
+static const uint8_t ec_nist_p256[] = {
+    0x06, 0x08, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x03, 0x01, 0x07,
+};
+static const uint8_t ec_nist_p384[] = {
+    0x06, 0x05, 0x2b, 0x81, 0x04, 0x00, 0x22,
+};
+
+/* large enough for the SubjectPublicKeyInfo of a MAX_RSA_KEY_BYTES key */
+#define DER_MAX (MAX_RSA_KEY_BYTES + 64)
+
+typedef struct {
+    TPM2B_NAME name;
+    EVP_PKEY *key;
+    UINT64 last_used;
+} KEY_ENTRY;
+
+struct _QUOTE_VERIFIER {
+    QUOTE_VERIFIER_CONF conf;
+    pthread_mutex_t mutex;
+    UINT64 tick;
+    QUOTE_VERIFIER_STATS stats;
+    KEY_ENTRY keys[];
+};
+
+typedef struct {
+    QUOTE_VERIFIER *verifier;
+    QUOTE_VERIFY_ITEM *items;
+    size_t count;
+    size_t next;
+} BATCH;
+
+TSS2_RC Tss2_QuoteVerifier_Init (
+    QUOTE_VERIFIER            *verifier,
+    size_t                    *size,
+    const QUOTE_VERIFIER_CONF *config)
+{
+    size_t key_count, verifier_size;
+
+    if (config == NULL || (verifier == NULL && size == NULL)) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    key_count = config->key_count ? config->key_count
+                                  : QUOTE_VERIFIER_DEFAULT_KEYS;
+    verifier_size = sizeof (QUOTE_VERIFIER) + key_count * sizeof (KEY_ENTRY);
+    if (verifier == NULL) {
+        *size = verifier_size;
+        return TSS2_RC_SUCCESS;
+    }
+    if (size != NULL && *size < verifier_size) {
+        return TSS2_UTIL_RC_INSUFFICIENT_BUFFER;
+    }
+
+    memset (verifier, 0, verifier_size);
+    verifier->conf = *config;
+    verifier->conf.key_count = key_count;
+    if (pthread_mutex_init (&verifier->mutex, NULL) != 0) {
+        return TSS2_UTIL_RC_GENERAL_FAILURE;
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+/*
+ * Minimal DER writer, enough for a SubjectPublicKeyInfo and an
+ * ECDSA-Sig-Value. 'out' may be NULL to get the encoded size only.
+ */
+static size_t
+der_header (uint8_t *out, uint8_t tag, size_t length)
+{
+    size_t size = length < 0x80 ? 2 : length < 0x100 ? 3 : 4;
+
+    if (out != NULL) {
+        out[0] = tag;
+        switch (size) {
+        case 2:
+            out[1] = length;
+            break;
+        case 3:
+            out[1] = 0x81;
+            out[2] = length;
+            break;
+        default:
+            out[1] = 0x82;
+            out[2] = length >> 8;
+            out[3] = length;
+        }
+    }
+    return size;
+}
+/* An unsigned big endian number as an INTEGER. */
+static size_t
+der_integer (uint8_t *out, const uint8_t *number, size_t size)
+{
+    size_t pad, header;
+
+    while (size > 1 && number[0] == 0) {
+        ++number;
+        --size;
+    }
+    pad = (size == 0 || number[0] & 0x80) ? 1 : 0;
+    header = der_header (out, 0x02, pad + size);
+    if (out != NULL) {
+        if (pad) {
+            out[header] = 0;
+        }
+        memcpy (out + header + pad, number, size);
+    }
+    return header + pad + size;
+}
+/* A tag around 'size' bytes of content. */
+static size_t
+der_tlv (uint8_t *out, uint8_t tag, const uint8_t *content, size_t size)
+{
+    size_t header = der_header (out, tag, size);
+
+    memcpy (out + header, content, size);
+    return header + size;
+}
+
+static EVP_PKEY*
+key_from_der (const uint8_t *der, size_t size)
+{
+    const uint8_t *p = der;
+
+    return d2i_PUBKEY (NULL, &p, size);
+}
+/* SEQUENCE { algorithm, BIT STRING { SEQUENCE { n, e } } } */
+static EVP_PKEY*
+key_from_rsa (const TPMT_PUBLIC *public_area)
+{
+    const TPM2B_PUBLIC_KEY_RSA *modulus = &public_area->unique.rsa;
+    UINT32 exponent = public_area->parameters.rsaDetail.exponent;
+    uint8_t a[DER_MAX], b[DER_MAX], e[4];
+    size_t size;
+
+    if (modulus->t.size == 0 || modulus->t.size > MAX_RSA_KEY_BYTES) {
+        return NULL;
+    }
+    if (exponent == 0) {
+        exponent = 65537;
+    }
+    e[0] = exponent >> 24;
+    e[1] = exponent >> 16;
+    e[2] = exponent >> 8;
+    e[3] = exponent;
+
+    size = der_integer (a, modulus->t.buffer, modulus->t.size);
+    size += der_integer (a + size, e, sizeof (e));
+    b[0] = 0;
+    size = 1 + der_tlv (b + 1, 0x30, a, size);
+    memcpy (a, rsa_algorithm, sizeof (rsa_algorithm));
+    size = sizeof (rsa_algorithm) +
+           der_tlv (a + sizeof (rsa_algorithm), 0x03, b, size);
+    size = der_tlv (b, 0x30, a, size);
+
+    return key_from_der (b, size);
+}
+/*
+ * SEQUENCE { SEQUENCE { id-ecPublicKey, curve },
+ *            BIT STRING { 04 || x || y } }
+ */
+static EVP_PKEY*
+key_from_ecc (const TPMT_PUBLIC *public_area)
+{
+    const TPMS_ECC_POINT *point = &public_area->unique.ecc;
+    const uint8_t *curve;
+    size_t curve_size, coordinate, size, point_size;
+    uint8_t algorithm[sizeof (ec_public_key) + sizeof (ec_nist_p256)];
+    uint8_t a[DER_MAX], b[DER_MAX];
+
+    switch (public_area->parameters.eccDetail.curveID) {
+    case TPM_ECC_NIST_P256:
+        curve = ec_nist_p256;
+        curve_size = sizeof (ec_nist_p256);
+        coordinate = 32;
+        break;
+    case TPM_ECC_NIST_P384:
+        curve = ec_nist_p384;
+        curve_size = sizeof (ec_nist_p384);
+        coordinate = 48;
+        break;
+    default:
+        return NULL;
+    }
+    if (point->x.t.size > coordinate || point->y.t.size > coordinate) {
+        return NULL;
+    }
+
+    point_size = 2 + 2 * coordinate;
+    memset (b, 0, point_size);
+    b[1] = 0x04;
+    memcpy (b + 2 + coordinate - point->x.t.size,
+            point->x.t.buffer, point->x.t.size);
+    memcpy (b + point_size - point->y.t.size,
+            point->y.t.buffer, point->y.t.size);
+
+    memcpy (algorithm, ec_public_key, sizeof (ec_public_key));
+    memcpy (algorithm + sizeof (ec_public_key), curve, curve_size);
+    size = der_tlv (a, 0x30, algorithm, sizeof (ec_public_key) + curve_size);
+    size += der_tlv (a + size, 0x03, b, point_size);
+    size = der_tlv (b, 0x30, a, size);
+
+    return key_from_der (b, size);
+}
+
+static KEY_ENTRY*
+key_find (QUOTE_VERIFIER *verifier, const TPM2B_NAME *name)
+{
+    KEY_ENTRY *entry;
+    size_t i;
+
+    for (i = 0; i < verifier->conf.key_count; ++i) {
+        entry = &verifier->keys[i];
+        if (entry->key != NULL && entry->name.t.size == name->t.size &&
+            memcmp (entry->name.t.name, name->t.name, name->t.size) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static KEY_ENTRY*
+key_victim (QUOTE_VERIFIER *verifier)
+{
+    KEY_ENTRY *entry, *victim = NULL;
+    size_t i;
+
+    for (i = 0; i < verifier->conf.key_count; ++i) {
+        entry = &verifier->keys[i];
+        if (entry->key == NULL) {
+            return entry;
+        }
+        if (victim == NULL || entry->last_used < victim->last_used) {
+            victim = entry;
+        }
+    }
+    return victim;
+}
+/*
+ * Find the key for 'ak_public' by Name or convert and insert it, evicting
+ * the least recently used entry. The caller owns a reference to the key.
+ */
+static EVP_PKEY*
+key_get (QUOTE_VERIFIER     *verifier,
+         const TPM2B_PUBLIC *ak_public)
+{
+    const TPMT_PUBLIC *public_area = &ak_public->t.publicArea;
+    TPM2B_NAME name = { .t.size = 0 };
+    EVP_PKEY *key = NULL;
+    KEY_ENTRY *entry;
+
+    if (Tss2_Name_FromPublic (public_area, &name) != TSS2_RC_SUCCESS) {
+        return NULL;
+    }
+
+    pthread_mutex_lock (&verifier->mutex);
+    entry = key_find (verifier, &name);
+    if (entry != NULL) {
+        entry->last_used = ++verifier->tick;
+        EVP_PKEY_up_ref (entry->key);
+        ++verifier->stats.key_hits;
+        pthread_mutex_unlock (&verifier->mutex);
+        return entry->key;
+    }
+    ++verifier->stats.key_misses;
+    pthread_mutex_unlock (&verifier->mutex);
+
+    /* converted without the lock, other workers keep going meanwhile */
+    switch (public_area->type) {
+    case TPM_ALG_RSA:
+        key = key_from_rsa (public_area);
+        break;
+    case TPM_ALG_ECC:
+        key = key_from_ecc (public_area);
+        break;
+    default:
+        break;
+    }
+    if (key == NULL) {
+        return NULL;
+    }
+
+    pthread_mutex_lock (&verifier->mutex);
+    entry = key_find (verifier, &name);
+    if (entry == NULL) {
+        entry = key_victim (verifier);
+        if (entry->key != NULL) {
+            EVP_PKEY_free (entry->key);
+        }
+        entry->name = name;
+        entry->key = key;
+    } else {
+        /* another worker converted the same key first */
+        EVP_PKEY_free (key);
+    }
+    entry->last_used = ++verifier->tick;
+    EVP_PKEY_up_ref (entry->key);
+    key = entry->key;
+    pthread_mutex_unlock (&verifier->mutex);
+
+    return key;
+}
+/* ECDSA-Sig-Value: SEQUENCE { r, s } */
+static size_t
+ecdsa_signature_der (const TPMS_SIGNATURE_ECC *ecdsa, uint8_t *der)
+{
+    uint8_t integers[2 * MAX_ECC_KEY_BYTES + 8];
+    size_t size;
+
+    size = der_integer (integers, ecdsa->signatureR.t.buffer,
+                        ecdsa->signatureR.t.size);
+    size += der_integer (integers + size, ecdsa->signatureS.t.buffer,
+                         ecdsa->signatureS.t.size);
+    return der_tlv (der, 0x30, integers, size);
+}
+
+static QUOTE_VERIFY_RESULT
+signature_check (EVP_PKEY             *key,
+                 const TPMT_SIGNATURE *signature,
+                 const TPM2B_DIGEST   *digest,
+                 const EVP_MD         *md)
+{
+    QUOTE_VERIFY_RESULT result = QUOTE_VERIFY_BAD_SIGNATURE;
+    const uint8_t *sig;
+    uint8_t der[2 * MAX_ECC_KEY_BYTES + 16];
+    size_t sig_size;
+    EVP_PKEY_CTX *ctx;
+    int padding = 0;
+
+    switch (signature->sigAlg) {
+    case TPM_ALG_RSASSA:
+    case TPM_ALG_RSAPSS:
+        if (EVP_PKEY_base_id (key) != EVP_PKEY_RSA) {
+            return QUOTE_VERIFY_BAD_KEY;
+        }
+        sig = signature->signature.rsassa.sig.t.buffer;
+        sig_size = signature->signature.rsassa.sig.t.size;
+        padding = signature->sigAlg == TPM_ALG_RSASSA ? RSA_PKCS1_PADDING
+                                                      : RSA_PKCS1_PSS_PADDING;
+        break;
+    case TPM_ALG_ECDSA:
+        if (EVP_PKEY_base_id (key) != EVP_PKEY_EC) {
+            return QUOTE_VERIFY_BAD_KEY;
+        }
+        sig_size = ecdsa_signature_der (&signature->signature.ecdsa, der);
+        sig = der;
+        break;
+    default:
+        return QUOTE_VERIFY_BAD_KEY;
+    }
+
+    ctx = EVP_PKEY_CTX_new (key, NULL);
+    if (ctx == NULL) {
+        return QUOTE_VERIFY_ERROR;
+    }
+    if (EVP_PKEY_verify_init (ctx) != 1 ||
+        EVP_PKEY_CTX_set_signature_md (ctx, md) != 1 ||
+        (padding != 0 &&
+         EVP_PKEY_CTX_set_rsa_padding (ctx, padding) != 1) ||
+        (padding == RSA_PKCS1_PSS_PADDING &&
+         EVP_PKEY_CTX_set_rsa_pss_saltlen (ctx, RSA_PSS_SALTLEN_AUTO) != 1)) {
+        result = QUOTE_VERIFY_ERROR;
+    } else if (EVP_PKEY_verify (ctx, sig, sig_size, digest->t.buffer,
+                                digest->t.size) == 1) {
+        result = QUOTE_VERIFY_OK;
+    }
+    EVP_PKEY_CTX_free (ctx);
+
+    return result;
+}
+
+static const EVP_MD*
+signature_md (TPMI_ALG_HASH hash)
+{
+    switch (hash) {
+    case TPM_ALG_SHA1:
+        return EVP_sha1 ();
+    case TPM_ALG_SHA256:
+        return EVP_sha256 ();
+    case TPM_ALG_SHA384:
+        return EVP_sha384 ();
+    case TPM_ALG_SHA512:
+        return EVP_sha512 ();
+    default:
+        return NULL;
+    }
+}
+
+static QUOTE_VERIFY_RESULT
+attest_digest (const TPM2B_ATTEST *quoted,
+               TPMI_ALG_HASH       hash,
+               TPM2B_DIGEST       *digest)
+{
+    UTIL_HASH ctx;
+
+    if (util_hash_start (&ctx, hash) != TSS2_RC_SUCCESS) {
+        return QUOTE_VERIFY_BAD_SIGNATURE;
+    }
+    if (util_hash_update (&ctx, quoted->t.attestationData,
+                          quoted->t.size) != TSS2_RC_SUCCESS) {
+        util_hash_abort (&ctx);
+        return QUOTE_VERIFY_ERROR;
+    }
+    if (util_hash_finish (&ctx, digest) != TSS2_RC_SUCCESS) {
+        return QUOTE_VERIFY_ERROR;
+    }
+    return QUOTE_VERIFY_OK;
+}
+/*
+ * The cheap checks on the attestation structure come first, the signature
+ * and the PCR digest only for quotes that pass them.
+ */
+static QUOTE_VERIFY_RESULT
+item_verify (QUOTE_VERIFIER          *verifier,
+             const QUOTE_VERIFY_ITEM *item)
+{
+    TSS2_MU_TPMS_ATTEST_VIEW view;
+    TPMU_ATTEST attested;
+    TPM2B_DIGEST digest;
+    TPMI_ALG_HASH hash;
+    QUOTE_VERIFY_RESULT result;
+    const uint8_t *extra;
+    size_t extra_size;
+    TPMA_OBJECT attributes;
+    EVP_PKEY *key;
+
+    if (item->quoted == NULL || item->signature == NULL ||
+        item->ak_public == NULL ||
+        (item->expected != NULL && item->pcr_select == NULL)) {
+        return QUOTE_VERIFY_ERROR;
+    }
+    if (Tss2_MU_TPMS_ATTEST_View (item->quoted->t.attestationData,
+                                  item->quoted->t.size, NULL,
+                                  &view) != TSS2_RC_SUCCESS ||
+        memcmp (view.buffer, attest_magic, sizeof (attest_magic)) != 0 ||
+        view.type != TPM_ST_ATTEST_QUOTE) {
+        return QUOTE_VERIFY_MALFORMED;
+    }
+    if (item->qualifying_data != NULL) {
+        Tss2_MU_TPMS_ATTEST_View_ExtraData (&view, &extra, &extra_size);
+        if (extra_size != item->qualifying_data->t.size ||
+            memcmp (extra, item->qualifying_data->t.buffer, extra_size) != 0) {
+            return QUOTE_VERIFY_BAD_NONCE;
+        }
+    }
+
+    hash = item->signature->signature.any.hashAlg;
+    if (signature_md (hash) == NULL) {
+        return QUOTE_VERIFY_BAD_SIGNATURE;
+    }
+    result = attest_digest (item->quoted, hash, &digest);
+    if (result != QUOTE_VERIFY_OK) {
+        return result;
+    }
+    attributes = item->ak_public->t.publicArea.objectAttributes;
+    if (!attributes.sign || !attributes.restricted || !attributes.fixedTPM) {
+        return QUOTE_VERIFY_BAD_KEY;
+    }
+    key = key_get (verifier, item->ak_public);
+    if (key == NULL) {
+        return QUOTE_VERIFY_BAD_KEY;
+    }
+    result = signature_check (key, item->signature, &digest,
+                              signature_md (hash));
+    EVP_PKEY_free (key);
+    if (result != QUOTE_VERIFY_OK || item->expected == NULL) {
+        return result;
+    }
+
+    if (Tss2_MU_TPMS_ATTEST_View_Attested (&view, &attested) !=
+        TSS2_RC_SUCCESS) {
+        return QUOTE_VERIFY_MALFORMED;
+    }
+    if (!Tss2_Pcr_SelectionEqual (&attested.quote.pcrSelect,
+                                  item->pcr_select) ||
+        Tss2_Pcr_MatrixDigest (item->expected, &attested.quote.pcrSelect,
+                               hash, &digest) != TSS2_RC_SUCCESS ||
+        digest.t.size != attested.quote.pcrDigest.t.size ||
+        memcmp (digest.t.buffer, attested.quote.pcrDigest.t.buffer,
+                digest.t.size) != 0) {
+        return QUOTE_VERIFY_BAD_PCRS;
+    }
+
+    return QUOTE_VERIFY_OK;
+}
+
+static void*
+batch_worker (void *data)
+{
+    BATCH *batch = data;
+    QUOTE_VERIFIER *verifier = batch->verifier;
+    UINT64 verified = 0, rejected = 0;
+    size_t i;
+
+    while ((i = __atomic_fetch_add (&batch->next, 1, __ATOMIC_RELAXED)) <
+           batch->count) {
+        batch->items[i].result = item_verify (verifier, &batch->items[i]);
+        if (batch->items[i].result == QUOTE_VERIFY_OK) {
+            ++verified;
+        } else {
+            ++rejected;
+        }
+    }
+
+    pthread_mutex_lock (&verifier->mutex);
+    verifier->stats.verified += verified;
+    verifier->stats.rejected += rejected;
+    pthread_mutex_unlock (&verifier->mutex);
+
+    return NULL;
+}
+
+TSS2_RC Tss2_QuoteVerifier_Batch (
+    QUOTE_VERIFIER    *verifier,
+    QUOTE_VERIFY_ITEM *items,
+    size_t             count)
+{
+    BATCH batch = {
+        .verifier = verifier,
+        .items = items,
+        .count = count,
+    };
+    pthread_t *threads = NULL;
+    size_t i, started = 0, wanted;
+
+    if (verifier == NULL || (items == NULL && count > 0)) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+
+    /* the calling thread takes its share, a single item needs no workers */
+    wanted = verifier->conf.threads;
+    if (count > 0 && wanted > count - 1) {
+        wanted = count - 1;
+    }
+    if (wanted > 0) {
+        threads = calloc (wanted, sizeof (*threads));
+    }
+    for (i = 0; threads != NULL && i < wanted; ++i) {
+        if (pthread_create (&threads[i], NULL, batch_worker, &batch) != 0) {
+            break;
+        }
+        ++started;
+    }
+    batch_worker (&batch);
+    for (i = 0; i < started; ++i) {
+        pthread_join (threads[i], NULL);
+    }
+    free (threads);
+
+    for (i = 0; i < count; ++i) {
+        if (items[i].result != QUOTE_VERIFY_OK) {
+            return TSS2_UTIL_RC_BAD_VALUE;
+        }
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_QuoteVerifier_GetStats (
+    QUOTE_VERIFIER       *verifier,
+    QUOTE_VERIFIER_STATS *stats)
+{
+    if (verifier == NULL || stats == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    pthread_mutex_lock (&verifier->mutex);
+    *stats = verifier->stats;
+    pthread_mutex_unlock (&verifier->mutex);
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_QuoteVerifier_Finalize (
+    QUOTE_VERIFIER *verifier)
+{
+    size_t i;
+
+    if (verifier == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    for (i = 0; i < verifier->conf.key_count; ++i) {
+        if (verifier->keys[i].key != NULL) {
+            EVP_PKEY_free (verifier->keys[i].key);
+            verifier->keys[i].key = NULL;
+        }
+    }
+    pthread_mutex_destroy (&verifier->mutex);
+
+    return TSS2_RC_SUCCESS;
+}
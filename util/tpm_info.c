@@ -0,0 +1,581 @@
+/***********************************************************************
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ ***********************************************************************/
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "sapi/tpm20.h"
+#include "sapi/tss2_mu.h"
+#include "util/tpm_info.h"
+
+#define INFO_MAGIC   0x6f666e692d6d7074ULL
+#define INFO_VERSION 1
+
+/* the properties identifying a TPM, checked before a stored file is used */
+#define IDENTITY_FIRST TPM_PT_MANUFACTURER
+#define IDENTITY_LAST  TPM_PT_FIRMWARE_VERSION_2
+
+/* command codes are looked up by index and vendor bit */
+#define CC_KEY(cc) ((cc) & (TPM_CC_Vendor_TCG_Test | 0xffff))
+
+struct _TPM_INFO {
+    TPML_TAGGED_TPM_PROPERTY properties;
+    TPML_ALG_PROPERTY algorithms;
+    TPML_CCA commands;
+    TPML_ECC_CURVE curves;
+    TPML_PCR_SELECTION pcrs;
+};
+
+/*
+ * File layout: UINT64 magic, UINT32 version followed by the five lists in
+ * marshalled form, so the file doesn't depend on structure layout.
+ */
+#define INFO_FILE_MAX (sizeof (UINT64) + sizeof (UINT32) + sizeof (TPM_INFO))
+
+static int
+property_compare (const void *a, const void *b)
+{
+    TPM_PT pa = ((const TPMS_TAGGED_PROPERTY*)a)->property;
+    TPM_PT pb = ((const TPMS_TAGGED_PROPERTY*)b)->property;
+
+    return pa < pb ? -1 : pa > pb;
+}
+
+static int
+algorithm_compare (const void *a, const void *b)
+{
+    TPM_ALG_ID aa = ((const TPMS_ALG_PROPERTY*)a)->alg;
+    TPM_ALG_ID ab = ((const TPMS_ALG_PROPERTY*)b)->alg;
+
+    return aa < ab ? -1 : aa > ab;
+}
+
+static int
+command_compare (const void *a, const void *b)
+{
+    UINT32 ca = CC_KEY (((const TPMA_CC*)a)->val);
+    UINT32 cb = CC_KEY (((const TPMA_CC*)b)->val);
+
+    return ca < cb ? -1 : ca > cb;
+}
+
+static int
+curve_compare (const void *a, const void *b)
+{
+    TPM_ECC_CURVE ca = *(const TPM_ECC_CURVE*)a;
+    TPM_ECC_CURVE cb = *(const TPM_ECC_CURVE*)b;
+
+    return ca < cb ? -1 : ca > cb;
+}
+
+static void
+info_sort (TPM_INFO *info)
+{
+    qsort (info->properties.tpmProperty, info->properties.count,
+           sizeof (info->properties.tpmProperty[0]), property_compare);
+    qsort (info->algorithms.algProperties, info->algorithms.count,
+           sizeof (info->algorithms.algProperties[0]), algorithm_compare);
+    qsort (info->commands.commandAttributes, info->commands.count,
+           sizeof (info->commands.commandAttributes[0]), command_compare);
+    qsort (info->curves.eccCurves, info->curves.count,
+           sizeof (info->curves.eccCurves[0]), curve_compare);
+}
+/*
+ * Append one page of capability data to the snapshot. Returns the property
+ * to continue from in 'next', or sets 'done' when there is nothing more we
+ * want.
+ */
+static TSS2_RC
+page_append (TPM_INFO *info, TPMS_CAPABILITY_DATA *data, UINT32 *next,
+             int *done)
+{
+    UINT32 i;
+
+    switch (data->capability) {
+    case TPM_CAP_TPM_PROPERTIES:
+        for (i = 0; i < data->data.tpmProperties.count; ++i) {
+            TPMS_TAGGED_PROPERTY *prop = &data->data.tpmProperties.tpmProperty[i];
+
+            if (prop->property >= PT_VAR) {
+                *done = 1;
+                return TSS2_RC_SUCCESS;
+            }
+            if (info->properties.count == MAX_TPM_PROPERTIES) {
+                return TSS2_UTIL_RC_INSUFFICIENT_BUFFER;
+            }
+            info->properties.tpmProperty[info->properties.count++] = *prop;
+            *next = prop->property + 1;
+        }
+        break;
+    case TPM_CAP_ALGS:
+        for (i = 0; i < data->data.algorithms.count; ++i) {
+            if (info->algorithms.count == MAX_CAP_ALGS) {
+                return TSS2_UTIL_RC_INSUFFICIENT_BUFFER;
+            }
+            info->algorithms.algProperties[info->algorithms.count++] =
+                data->data.algorithms.algProperties[i];
+            *next = data->data.algorithms.algProperties[i].alg + 1;
+        }
+        break;
+    case TPM_CAP_COMMANDS:
+        for (i = 0; i < data->data.command.count; ++i) {
+            TPMA_CC attributes = data->data.command.commandAttributes[i];
+
+            if (info->commands.count == MAX_CAP_CC) {
+                return TSS2_UTIL_RC_INSUFFICIENT_BUFFER;
+            }
+            info->commands.commandAttributes[info->commands.count++] =
+                attributes;
+            *next = CC_KEY (attributes.val) + 1;
+        }
+        break;
+    case TPM_CAP_ECC_CURVES:
+        for (i = 0; i < data->data.eccCurves.count; ++i) {
+            if (info->curves.count == MAX_ECC_CURVES) {
+                return TSS2_UTIL_RC_INSUFFICIENT_BUFFER;
+            }
+            info->curves.eccCurves[info->curves.count++] =
+                data->data.eccCurves.eccCurves[i];
+            *next = data->data.eccCurves.eccCurves[i] + 1;
+        }
+        break;
+    case TPM_CAP_PCRS:
+        info->pcrs = data->data.assignedPCR;
+        *done = 1;
+        break;
+    default:
+        return TSS2_UTIL_RC_GENERAL_FAILURE;
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+/*
+ * Fetch every value of 'capability' starting at 'first', following
+ * moreData until the TPM has nothing left.
+ */
+static TSS2_RC
+capability_fetch (TSS2_SYS_CONTEXT *sys_context, TPM_INFO *info,
+                  TPM_CAP capability, UINT32 first, UINT32 count)
+{
+    TPMS_CAPABILITY_DATA data;
+    TPMI_YES_NO more = YES;
+    UINT32 property = first, next;
+    int done = 0;
+    TSS2_RC rc;
+
+    while (more == YES && !done) {
+        rc = Tss2_Sys_GetCapability (sys_context, NULL, capability, property,
+                                     count, &more, &data, NULL);
+        if (rc != TSS2_RC_SUCCESS) {
+            return rc;
+        }
+        if (data.capability != capability) {
+            return TSS2_UTIL_RC_GENERAL_FAILURE;
+        }
+        next = property;
+        rc = page_append (info, &data, &next, &done);
+        if (rc != TSS2_RC_SUCCESS) {
+            return rc;
+        }
+        /* a page without progress would loop forever */
+        if (next == property) {
+            break;
+        }
+        property = next;
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+info_fetch (TSS2_SYS_CONTEXT *sys_context, TPM_INFO *info)
+{
+    TSS2_RC rc;
+
+    memset (info, 0, sizeof (*info));
+    rc = capability_fetch (sys_context, info, TPM_CAP_TPM_PROPERTIES,
+                           PT_FIXED, MAX_TPM_PROPERTIES);
+    if (rc == TSS2_RC_SUCCESS) {
+        rc = capability_fetch (sys_context, info, TPM_CAP_ALGS,
+                               TPM_ALG_FIRST, MAX_CAP_ALGS);
+    }
+    if (rc == TSS2_RC_SUCCESS) {
+        rc = capability_fetch (sys_context, info, TPM_CAP_COMMANDS,
+                               TPM_CC_FIRST, MAX_CAP_CC);
+    }
+    if (rc == TSS2_RC_SUCCESS) {
+        rc = capability_fetch (sys_context, info, TPM_CAP_ECC_CURVES,
+                               0, MAX_ECC_CURVES);
+    }
+    if (rc == TSS2_RC_SUCCESS) {
+        rc = capability_fetch (sys_context, info, TPM_CAP_PCRS, 0, 1);
+    }
+    if (rc == TSS2_RC_SUCCESS) {
+        info_sort (info);
+    }
+
+    return rc;
+}
+/*
+ * Compare the identity properties of the TPM with the snapshot, a single
+ * GetCapability unless the TPM returns them in several pages.
+ */
+static TSS2_RC
+info_verify (TSS2_SYS_CONTEXT *sys_context, TPM_INFO *info)
+{
+    TPMS_CAPABILITY_DATA data;
+    TPMI_YES_NO more = YES;
+    TPM_PT property = IDENTITY_FIRST;
+    UINT32 i, value;
+    TSS2_RC rc;
+
+    while (more == YES && property <= IDENTITY_LAST) {
+        rc = Tss2_Sys_GetCapability (sys_context, NULL, TPM_CAP_TPM_PROPERTIES,
+                                     property, IDENTITY_LAST - property + 1,
+                                     &more, &data, NULL);
+        if (rc != TSS2_RC_SUCCESS) {
+            return rc;
+        }
+        if (data.capability != TPM_CAP_TPM_PROPERTIES ||
+            data.data.tpmProperties.count == 0) {
+            break;
+        }
+        for (i = 0; i < data.data.tpmProperties.count; ++i) {
+            TPMS_TAGGED_PROPERTY *prop = &data.data.tpmProperties.tpmProperty[i];
+
+            if (prop->property > IDENTITY_LAST) {
+                return TSS2_RC_SUCCESS;
+            }
+            if (Tss2_TpmInfo_GetProperty (info, prop->property, &value) !=
+                TSS2_RC_SUCCESS || value != prop->value) {
+                return TSS2_UTIL_RC_BAD_VALUE;
+            }
+            property = prop->property + 1;
+        }
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+info_load (TPM_INFO *info, const char *path)
+{
+    UINT8 *buffer;
+    size_t size = 0, offset = 0;
+    ssize_t ret;
+    UINT64 magic;
+    UINT32 version;
+    TSS2_RC rc;
+    int fd;
+
+    fd = open (path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return TSS2_UTIL_RC_IO_ERROR;
+    }
+    buffer = malloc (INFO_FILE_MAX);
+    if (buffer == NULL) {
+        close (fd);
+        return TSS2_UTIL_RC_GENERAL_FAILURE;
+    }
+    do {
+        ret = read (fd, buffer + size, INFO_FILE_MAX - size);
+        if (ret > 0) {
+            size += ret;
+        }
+    } while (ret > 0 && size < INFO_FILE_MAX);
+    close (fd);
+    if (ret < 0) {
+        free (buffer);
+        return TSS2_UTIL_RC_IO_ERROR;
+    }
+
+    memset (info, 0, sizeof (*info));
+    rc = Tss2_MU_UINT64_Unmarshal (buffer, size, &offset, &magic);
+    if (rc == TSS2_RC_SUCCESS) {
+        rc = Tss2_MU_UINT32_Unmarshal (buffer, size, &offset, &version);
+    }
+    if (rc == TSS2_RC_SUCCESS &&
+        (magic != INFO_MAGIC || version != INFO_VERSION)) {
+        rc = TSS2_UTIL_RC_BAD_VALUE;
+    }
+    if (rc == TSS2_RC_SUCCESS) {
+        rc = Tss2_MU_TPML_TAGGED_TPM_PROPERTY_Unmarshal (buffer, size, &offset,
+                                                        &info->properties);
+    }
+    if (rc == TSS2_RC_SUCCESS) {
+        rc = Tss2_MU_TPML_ALG_PROPERTY_Unmarshal (buffer, size, &offset,
+                                                  &info->algorithms);
+    }
+    if (rc == TSS2_RC_SUCCESS) {
+        rc = Tss2_MU_TPML_CCA_Unmarshal (buffer, size, &offset,
+                                         &info->commands);
+    }
+    if (rc == TSS2_RC_SUCCESS) {
+        rc = Tss2_MU_TPML_ECC_CURVE_Unmarshal (buffer, size, &offset,
+                                               &info->curves);
+    }
+    if (rc == TSS2_RC_SUCCESS) {
+        rc = Tss2_MU_TPML_PCR_SELECTION_Unmarshal (buffer, size, &offset,
+                                                   &info->pcrs);
+    }
+    free (buffer);
+    if (rc != TSS2_RC_SUCCESS || offset != size) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    /* files are written sorted, but don't rely on it for the lookups */
+    info_sort (info);
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_TpmInfo_Init (
+    TPM_INFO            *info,
+    size_t              *size,
+    const TPM_INFO_CONF *config)
+{
+    TSS2_RC rc = TSS2_UTIL_RC_IO_ERROR;
+
+    if (info == NULL && size == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    if (info == NULL) {
+        *size = sizeof (TPM_INFO);
+        return TSS2_RC_SUCCESS;
+    }
+    if (size != NULL && *size < sizeof (TPM_INFO)) {
+        return TSS2_UTIL_RC_INSUFFICIENT_BUFFER;
+    }
+    if (config == NULL ||
+        (config->sys_context == NULL &&
+         (config->path == NULL || config->verify))) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+
+    if (config->path != NULL) {
+        rc = info_load (info, config->path);
+        if (rc == TSS2_RC_SUCCESS && config->verify) {
+            rc = info_verify (config->sys_context, info);
+        }
+        if (rc == TSS2_RC_SUCCESS) {
+            return TSS2_RC_SUCCESS;
+        }
+    }
+    if (config->sys_context == NULL) {
+        return rc;
+    }
+    rc = info_fetch (config->sys_context, info);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    /* the snapshot is good even if it can't be stored */
+    if (config->path != NULL) {
+        Tss2_TpmInfo_Save (info, config->path);
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_TpmInfo_Save (
+    TPM_INFO   *info,
+    const char *path)
+{
+    char tmp[PATH_MAX];
+    UINT8 *buffer;
+    size_t size = 0, written = 0;
+    ssize_t ret = 0;
+    TSS2_RC rc;
+    int fd;
+
+    if (info == NULL || path == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    if (snprintf (tmp, sizeof (tmp), "%s.XXXXXX", path) >= (int)sizeof (tmp)) {
+        return TSS2_UTIL_RC_BAD_VALUE;
+    }
+    buffer = malloc (INFO_FILE_MAX);
+    if (buffer == NULL) {
+        return TSS2_UTIL_RC_GENERAL_FAILURE;
+    }
+    rc = Tss2_MU_UINT64_Marshal (INFO_MAGIC, buffer, INFO_FILE_MAX, &size);
+    if (rc == TSS2_RC_SUCCESS) {
+        rc = Tss2_MU_UINT32_Marshal (INFO_VERSION, buffer, INFO_FILE_MAX,
+                                     &size);
+    }
+    if (rc == TSS2_RC_SUCCESS) {
+        rc = Tss2_MU_TPML_TAGGED_TPM_PROPERTY_Marshal (&info->properties,
+                                                      buffer, INFO_FILE_MAX,
+                                                      &size);
+    }
+    if (rc == TSS2_RC_SUCCESS) {
+        rc = Tss2_MU_TPML_ALG_PROPERTY_Marshal (&info->algorithms, buffer,
+                                                INFO_FILE_MAX, &size);
+    }
+    if (rc == TSS2_RC_SUCCESS) {
+        rc = Tss2_MU_TPML_CCA_Marshal (&info->commands, buffer,
+                                       INFO_FILE_MAX, &size);
+    }
+    if (rc == TSS2_RC_SUCCESS) {
+        rc = Tss2_MU_TPML_ECC_CURVE_Marshal (&info->curves, buffer,
+                                             INFO_FILE_MAX, &size);
+    }
+    if (rc == TSS2_RC_SUCCESS) {
+        rc = Tss2_MU_TPML_PCR_SELECTION_Marshal (&info->pcrs, buffer,
+                                                 INFO_FILE_MAX, &size);
+    }
+    if (rc != TSS2_RC_SUCCESS) {
+        free (buffer);
+        return rc;
+    }
+
+    /* write a temporary file and rename it so readers never see half */
+    fd = mkstemp (tmp);
+    if (fd < 0) {
+        free (buffer);
+        return TSS2_UTIL_RC_IO_ERROR;
+    }
+    while (written < size) {
+        ret = write (fd, buffer + written, size - written);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            break;
+        }
+        written += ret;
+    }
+    free (buffer);
+    if (written != size || fchmod (fd, 0644) != 0) {
+        close (fd);
+        unlink (tmp);
+        return TSS2_UTIL_RC_IO_ERROR;
+    }
+    if (close (fd) != 0 || rename (tmp, path) != 0) {
+        unlink (tmp);
+        return TSS2_UTIL_RC_IO_ERROR;
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_TpmInfo_GetProperty (
+    TPM_INFO *info,
+    TPM_PT    property,
+    UINT32   *value)
+{
+    TPMS_TAGGED_PROPERTY key = { .property = property };
+    TPMS_TAGGED_PROPERTY *found;
+
+    if (info == NULL || value == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    found = bsearch (&key, info->properties.tpmProperty,
+                     info->properties.count, sizeof (key), property_compare);
+    if (found == NULL) {
+        return TSS2_UTIL_RC_NOT_SUPPORTED;
+    }
+    *value = found->value;
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_TpmInfo_GetAlgorithm (
+    TPM_INFO       *info,
+    TPM_ALG_ID      alg,
+    TPMA_ALGORITHM *attributes)
+{
+    TPMS_ALG_PROPERTY key = { .alg = alg };
+    TPMS_ALG_PROPERTY *found;
+
+    if (info == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    found = bsearch (&key, info->algorithms.algProperties,
+                     info->algorithms.count, sizeof (key), algorithm_compare);
+    if (found == NULL) {
+        return TSS2_UTIL_RC_NOT_SUPPORTED;
+    }
+    if (attributes != NULL) {
+        *attributes = found->algProperties;
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_TpmInfo_GetCommand (
+    TPM_INFO *info,
+    TPM_CC    command_code,
+    TPMA_CC  *attributes)
+{
+    TPMA_CC key = { .val = command_code };
+    TPMA_CC *found;
+
+    if (info == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    found = bsearch (&key, info->commands.commandAttributes,
+                     info->commands.count, sizeof (key), command_compare);
+    if (found == NULL) {
+        return TSS2_UTIL_RC_NOT_SUPPORTED;
+    }
+    if (attributes != NULL) {
+        *attributes = *found;
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_TpmInfo_GetCurve (
+    TPM_INFO      *info,
+    TPM_ECC_CURVE  curve)
+{
+    if (info == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    if (bsearch (&curve, info->curves.eccCurves, info->curves.count,
+                 sizeof (curve), curve_compare) == NULL) {
+        return TSS2_UTIL_RC_NOT_SUPPORTED;
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC Tss2_TpmInfo_GetPcrBanks (
+    TPM_INFO           *info,
+    TPML_PCR_SELECTION *banks)
+{
+    if (info == NULL || banks == NULL) {
+        return TSS2_UTIL_RC_BAD_REFERENCE;
+    }
+    *banks = info->pcrs;
+
+    return TSS2_RC_SUCCESS;
+}